@@ -98,6 +98,11 @@ IF( ICONV_ACCEPTS_CONST_INPUT )
     MESSAGE ( "ICONV_ACCEPTS_CONST_INPUT : yes" )
 ENDIF( ICONV_ACCEPTS_CONST_INPUT )
 
+FIND_PACKAGE( Threads )
+IF( CMAKE_USE_PTHREADS_INIT )
+    SET( HAVE_PTHREAD 1 )
+ENDIF( CMAKE_USE_PTHREADS_INIT )
+
 FIND_PACKAGE(MSGFMT)
 IF(MSGFMT_FOUND)
     MESSAGE(STATUS "Program msgfmt found (${MSGFMT_EXECUTABLE})")
@@ -205,6 +210,7 @@ SET( EXV_SYMBOLS ENABLE_NLS
                  HAVE_MUNMAP
                  HAVE_PRINTUCS2
                  HAVE_PROCESS_H
+                 HAVE_PTHREAD
                  HAVE_REALLOC
                  HAVE_STDBOOL_H
                  HAVE_STDINT_H
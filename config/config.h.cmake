@@ -125,6 +125,9 @@
 /* Define to 1 if you have the <process.h> header file. */
 #cmakedefine EXV_HAVE_PROCESS_H 1
 
+/* Define to 1 if you have POSIX threads. */
+#cmakedefine EXV_HAVE_PTHREAD 1
+
 /* Define to 1 if you have the Adobe XMP Toolkit. */
 #cmakedefine EXV_HAVE_XMP_TOOLKIT 1
 
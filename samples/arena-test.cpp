@@ -0,0 +1,65 @@
+// ***************************************************************** -*- C++ -*-
+// arena-test.cpp, $Rev$
+// Read an image with Image::setUseArena(true) and check that copies of the
+// metadata outlive the image and later reads of it. Run the test with
+// VALGRIND set to check that no memory of an arena is used after it has
+// been released.
+
+#include <exiv2/exiv2.hpp>
+
+#include <iostream>
+#include <cassert>
+
+using namespace Exiv2;
+
+void print(const std::string& label, const ExifData& exifData)
+{
+    long size = 0;
+    for (ExifData::const_iterator i = exifData.begin(); i != exifData.end(); ++i) {
+        size += i->size();
+    }
+    std::cout << label << ": " << exifData.count() << " tags, "
+              << size << " bytes\n";
+}
+
+int main(int argc, char* const argv[])
+try {
+    if (argc != 2) {
+        std::cout << "Usage: " << argv[0] << " file\n";
+        return 1;
+    }
+    const ExifKey key("Exif.Image.Model");
+
+    Image::AutoPtr image = ImageFactory::open(argv[1]);
+    assert(image.get() != 0);
+    image->setUseArena(true);
+    image->readMetadata();
+    print("First read", image->exifData());
+
+    // A copy of the container and a single datum from the first read
+    ExifData copy = image->exifData();
+    ExifData::const_iterator pos = copy.findKey(key);
+    assert(pos != copy.end());
+    Exifdatum datum = *pos;
+    // A value cloned from the heap, it does not refer to the arena
+    Value::AutoPtr value = pos->getValue();
+
+    // The second read uses a new arena, the first one is kept by the copies
+    image->readMetadata();
+    print("Second read", image->exifData());
+    image.reset();
+
+    print("Copy", copy);
+    copy.clear();
+    // Only the datum refers to the arena of the first read now
+    std::cout << "Datum: " << datum.key() << " = " << datum.value() << "\n";
+    datum.setValue("Changed");
+    std::cout << "Datum: " << datum.key() << " = " << datum.value() << "\n";
+    std::cout << "Value: " << *value << "\n";
+
+    return 0;
+}
+catch (AnyError& e) {
+    std::cout << "Caught Exiv2 exception '" << e << "'\n";
+    return -1;
+}
@@ -0,0 +1,213 @@
+// ***************************************************************** -*- C++ -*-
+// bigtiff-test.cpp, $Rev$
+// Create a small BigTIFF image with its strip and IFD at the offset given on
+// the command line (use an offset above 4 GB to create a sparse file with
+// 64-bit offsets), then patch a value in place, write new metadata and check
+// that the image data is unchanged. With "classic" as third argument, create
+// a classic TIFF image instead (use an offset between 2 and 4 GB to check
+// 32-bit offsets which do not fit into a signed long).
+
+#include <exiv2/exiv2.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+using namespace Exiv2;
+
+namespace {
+
+    const byte strip[16] = {
+        0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+        0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+    };
+
+    // Write a BigTIFF IFD entry with an inline value
+    byte* entry(byte* p, uint16_t tag, uint16_t type, uint64_t count, uint64_t value)
+    {
+        std::memset(p, 0x0, 20);
+        us2Data(p, tag, littleEndian);
+        us2Data(p + 2, type, littleEndian);
+        ull2Data(p + 4, count, littleEndian);
+        if (type == unsignedShort) us2Data(p + 12, static_cast<uint16_t>(value), littleEndian);
+        else ull2Data(p + 12, value, littleEndian);
+        return p + 20;
+    }
+
+    // Write a classic TIFF IFD entry with an inline value
+    byte* classicEntry(byte* p, uint16_t tag, uint16_t type, uint32_t count, uint32_t value)
+    {
+        std::memset(p, 0x0, 12);
+        us2Data(p, tag, littleEndian);
+        us2Data(p + 2, type, littleEndian);
+        ul2Data(p + 4, count, littleEndian);
+        if (type == unsignedShort) us2Data(p + 8, static_cast<uint16_t>(value), littleEndian);
+        else ul2Data(p + 8, value, littleEndian);
+        return p + 12;
+    }
+
+    void write(const char* path, const byte* header, long size, uint64_t offset, const byte* buf, long len)
+    {
+        FileIo file(path);
+        if (file.open("wb") != 0) throw Error(10, path, "wb", strError());
+        file.write(header, size);
+        file.seek(static_cast<long>(offset), BasicIo::beg);
+        file.write(strip, sizeof(strip));
+        file.write(buf, len);
+        if (file.error()) throw Error(21);
+    }
+
+    void createClassic(const char* path, uint32_t offset)
+    {
+        const char desc[] = "Classic TIFF test image";
+        const uint32_t ifdOffset = offset + sizeof(strip);
+        const uint32_t descOffset = ifdOffset + 2 + 11 * 12 + 4;
+        const uint32_t exifOffset = descOffset + sizeof(desc) + 1;
+
+        byte buf[512];
+        std::memset(buf, 0x0, sizeof(buf));
+        byte* p = buf;
+        us2Data(p, 11, littleEndian);
+        p += 2;
+        p = classicEntry(p, 0x0100, unsignedShort, 1, 4);
+        p = classicEntry(p, 0x0101, unsignedShort, 1, 4);
+        p = classicEntry(p, 0x0102, unsignedShort, 1, 8);
+        p = classicEntry(p, 0x0103, unsignedShort, 1, 1);
+        p = classicEntry(p, 0x0106, unsignedShort, 1, 1);
+        p = classicEntry(p, 0x010e, asciiString, sizeof(desc), descOffset);
+        p = classicEntry(p, 0x0111, unsignedLong, 1, offset);
+        p = classicEntry(p, 0x0115, unsignedShort, 1, 1);
+        p = classicEntry(p, 0x0116, unsignedShort, 1, 4);
+        p = classicEntry(p, 0x0117, unsignedLong, 1, sizeof(strip));
+        p = classicEntry(p, 0x8769, unsignedLong, 1, exifOffset);
+        p += 4; // Next IFD
+        std::memcpy(p, desc, sizeof(desc));
+        p += sizeof(desc) + 1;
+        // Exif IFD
+        us2Data(p, 1, littleEndian);
+        p += 2;
+        p = classicEntry(p, 0xa002, unsignedLong, 1, 4);
+        p += 4; // Next IFD
+
+        byte header[8] = { 'I', 'I', 42, 0 };
+        ul2Data(header + 4, ifdOffset, littleEndian);
+        write(path, header, sizeof(header), offset, buf, static_cast<long>(p - buf));
+    }
+
+    void create(const char* path, uint64_t offset)
+    {
+        const char desc[] = "BigTIFF test image";
+        const uint64_t ifdOffset = offset + sizeof(strip);
+        const uint64_t descOffset = ifdOffset + 8 + 11 * 20 + 8;
+        const uint64_t exifOffset = descOffset + sizeof(desc) + 1;
+
+        byte buf[512];
+        std::memset(buf, 0x0, sizeof(buf));
+        byte* p = buf;
+        ull2Data(p, 11, littleEndian);
+        p += 8;
+        p = entry(p, 0x0100, unsignedShort, 1, 4);
+        p = entry(p, 0x0101, unsignedShort, 1, 4);
+        p = entry(p, 0x0102, unsignedShort, 1, 8);
+        p = entry(p, 0x0103, unsignedShort, 1, 1);
+        p = entry(p, 0x0106, unsignedShort, 1, 1);
+        p = entry(p, 0x010e, asciiString, sizeof(desc), descOffset);
+        p = entry(p, 0x0111, unsignedLongLong, 1, offset);
+        p = entry(p, 0x0115, unsignedShort, 1, 1);
+        p = entry(p, 0x0116, unsignedShort, 1, 4);
+        p = entry(p, 0x0117, unsignedLongLong, 1, sizeof(strip));
+        p = entry(p, 0x8769, tiffIfd8, 1, exifOffset);
+        p += 8; // Next IFD
+        std::memcpy(p, desc, sizeof(desc));
+        p += sizeof(desc) + 1;
+        // Exif IFD
+        ull2Data(p, 1, littleEndian);
+        p += 8;
+        p = entry(p, 0xa002, unsignedLongLong, 1, 4);
+        p += 8; // Next IFD
+
+        byte header[16] = { 'I', 'I', 43, 0, 8, 0, 0, 0 };
+        ull2Data(header + 8, ifdOffset, littleEndian);
+        write(path, header, sizeof(header), offset, buf, static_cast<long>(p - buf));
+    }
+
+    void print(const char* path)
+    {
+        Image::AutoPtr image = ImageFactory::open(path);
+        assert(image.get() != 0);
+        image->readMetadata();
+        ExifData& exifData = image->exifData();
+        uint64_t stripOffset = 0;
+        for (ExifData::const_iterator i = exifData.begin(); i != exifData.end(); ++i) {
+            std::cout << std::setw(36) << std::left << i->key() << " "
+                      << std::setw(9) << std::left << i->typeName() << " "
+                      << i->count() << "  " << i->value() << "\n";
+            if (i->key() == "Exif.Image.StripOffsets") {
+                stripOffset = static_cast<uint32_t>(i->toLong());
+                if (i->typeId() == unsignedLongLong) {
+                    stripOffset = dynamic_cast<const ULongLongValue&>(i->value()).value_[0];
+                }
+            }
+        }
+        FileIo file(path);
+        if (file.open() != 0) throw Error(10, path, "rb", strError());
+        byte header[16];
+        file.read(header, sizeof(header));
+        std::cout << "IFD0 offset: "
+                  << (header[2] == 42 ? getULong(header + 4, littleEndian)
+                                      : getULongLong(header + 8, littleEndian)) << "\n";
+        byte data[sizeof(strip)];
+        file.seek(static_cast<long>(stripOffset), BasicIo::beg);
+        file.read(data, sizeof(data));
+        std::cout << "Strip data "
+                  << (std::memcmp(data, strip, sizeof(strip)) == 0 ? "unchanged" : "CHANGED")
+                  << "\n";
+    }
+
+}
+
+int main(int argc, char* const argv[])
+try {
+    if (argc != 3 && (argc != 4 || std::strcmp(argv[3], "classic") != 0)) {
+        std::cout << "Usage: " << argv[0] << " file offset [classic]\n";
+        return 1;
+    }
+    const char* path = argv[1];
+    uint64_t offset = std::strtoul(argv[2], 0, 0);
+
+    if (argc == 4) {
+        createClassic(path, static_cast<uint32_t>(offset));
+    }
+    else {
+        create(path, offset);
+    }
+    std::cout << "------> Created <-------\n";
+    print(path);
+
+    std::cout << "------> Patch in place <-------\n";
+    Image::AutoPtr image = ImageFactory::open(path);
+    assert(image.get() != 0);
+    image->readMetadata();
+    AsciiValue value;
+    value.read(argc == 4 ? "Patched classic TIFF   " : "Patched BigTIFF   ");
+    bool patched = image->patchInPlace(ExifKey("Exif.Image.ImageDescription"), value);
+    std::cout << "Exif.Image.ImageDescription: "
+              << (patched ? "patched" : "not patched") << "\n";
+    print(path);
+
+    std::cout << "------> Write metadata <-------\n";
+    image = ImageFactory::open(path);
+    assert(image.get() != 0);
+    image->readMetadata();
+    image->exifData()["Exif.Image.Artist"] = argc == 4 ? "Exiv2 classic TIFF test" : "Exiv2 BigTIFF test";
+    image->writeMetadata();
+    print(path);
+
+    return 0;
+}
+catch (AnyError& e) {
+    std::cout << "Caught Exiv2 exception '" << e << "'\n";
+    return -1;
+}
@@ -0,0 +1,127 @@
+// ***************************************************************** -*- C++ -*-
+// pages-test.cpp, $Rev$
+// Create a multi-page TIFF image with the number of pages given on the
+// command line, print the metadata of the pages given after it, read with
+// TiffImage::readPageMetadata(), and the number of pages.
+
+#include <exiv2/exiv2.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+
+using namespace Exiv2;
+
+namespace {
+
+    // Write an IFD entry with an inline value
+    byte* entry(byte* p, uint16_t tag, uint16_t type, uint32_t count, uint32_t value)
+    {
+        std::memset(p, 0x0, 12);
+        us2Data(p, tag, littleEndian);
+        us2Data(p + 2, type, littleEndian);
+        ul2Data(p + 4, count, littleEndian);
+        if (type == unsignedShort) us2Data(p + 8, static_cast<uint16_t>(value), littleEndian);
+        else ul2Data(p + 8, value, littleEndian);
+        return p + 12;
+    }
+
+    // Each page has a 4x1 8-bit strip, an IFD with 10 entries, a
+    // description and an Exif IFD with one entry
+    void create(const char* path, uint32_t pages)
+    {
+        const uint32_t ifdSize = 2 + 10 * 12 + 4;
+        const uint32_t pageSize = 4 + ifdSize + 16 + 2 + 12 + 4;
+
+        FileIo file(path);
+        if (file.open("wb") != 0) throw Error(10, path, "wb", strError());
+        byte header[8] = { 'I', 'I', 42, 0 };
+        ul2Data(header + 4, 8 + 4, littleEndian);
+        file.write(header, sizeof(header));
+
+        for (uint32_t i = 0; i < pages; ++i) {
+            const uint32_t offset = 8 + i * pageSize;
+            const uint32_t descOffset = offset + 4 + ifdSize;
+            const uint32_t exifOffset = descOffset + 16;
+            std::ostringstream os;
+            os << "Page " << i + 1;
+            byte buf[pageSize];
+            std::memset(buf, 0x0, sizeof(buf));
+            byte* p = buf;
+            ul2Data(p, 0x01020304 * (i + 1), littleEndian);
+            p += 4;
+            us2Data(p, 10, littleEndian);
+            p += 2;
+            p = entry(p, 0x0100, unsignedShort, 1, 4);
+            p = entry(p, 0x0101, unsignedShort, 1, 1);
+            p = entry(p, 0x0102, unsignedShort, 1, 8);
+            p = entry(p, 0x0103, unsignedShort, 1, 1);
+            p = entry(p, 0x010e, asciiString, 16, descOffset);
+            p = entry(p, 0x0111, unsignedLong, 1, offset);
+            p = entry(p, 0x0116, unsignedShort, 1, 1);
+            p = entry(p, 0x0117, unsignedLong, 1, 4);
+            p = entry(p, 0x0129, unsignedShort, 2, 0);
+            us2Data(p - 4, static_cast<uint16_t>(i), littleEndian);
+            us2Data(p - 2, static_cast<uint16_t>(pages), littleEndian);
+            p = entry(p, 0x8769, unsignedLong, 1, exifOffset);
+            ul2Data(p, i + 1 < pages ? offset + pageSize + 4 : 0, littleEndian);
+            p += 4;
+            std::memcpy(p, os.str().c_str(), os.str().size());
+            p += 16;
+            us2Data(p, 1, littleEndian);
+            p += 2;
+            p = entry(p, 0x9000, undefined, 4, 0);
+            std::memcpy(p - 4, "0220", 4);
+            p += 4;
+            file.write(buf, sizeof(buf));
+        }
+        if (file.error()) throw Error(21);
+    }
+
+    void print(TiffImage& image, long page)
+    {
+        std::cout << "------> Page " << page << " <-------\n";
+        try {
+            image.readPageMetadata(page);
+        }
+        catch (AnyError& e) {
+            std::cout << "Caught Exiv2 exception '" << e << "'\n";
+            return;
+        }
+        ExifData& exifData = image.exifData();
+        for (ExifData::const_iterator i = exifData.begin(); i != exifData.end(); ++i) {
+            std::cout << std::setw(36) << std::left << i->key() << " "
+                      << std::setw(9) << std::left << i->typeName() << " "
+                      << i->count() << "  " << i->value() << "\n";
+        }
+    }
+
+}
+
+int main(int argc, char* const argv[])
+try {
+    if (argc < 3) {
+        std::cout << "Usage: " << argv[0] << " file pages [page...]\n";
+        return 1;
+    }
+    const char* path = argv[1];
+    create(path, static_cast<uint32_t>(std::strtoul(argv[2], 0, 10)));
+
+    TiffImage image(BasicIo::AutoPtr(new FileIo(path)), false);
+    for (int arg = 3; arg < argc; ++arg) {
+        print(image, std::strtol(argv[arg], 0, 10));
+    }
+    std::cout << "------> pageCount <-------\n"
+              << path << ": " << image.pageCount() << " pages\n";
+    image.readMetadata();
+    std::cout << "------> readMetadata <-------\n"
+              << image.exifData().count() << " Exif metadata\n";
+
+    return 0;
+}
+catch (AnyError& e) {
+    std::cout << "Caught Exiv2 exception '" << e << "'\n";
+    return -1;
+}
@@ -0,0 +1,47 @@
+// ***************************************************************** -*- C++ -*-
+// parselimits-test.cpp, $Rev$
+// Read the metadata of an image with the parse limits given on the command
+// line and print the number of Exif, IPTC and XMP metadata read.
+
+#include <exiv2/exiv2.hpp>
+
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+using namespace Exiv2;
+
+int main(int argc, char* const argv[])
+try {
+    ParseLimits limits;
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+        uint32_t n = static_cast<uint32_t>(std::strtoul(argv[arg + 1], 0, 10));
+        if (std::strcmp(argv[arg], "-c") == 0) limits.maxComponents_ = n;
+        else if (std::strcmp(argv[arg], "-b") == 0) limits.maxValueBytes_ = n;
+        else if (std::strcmp(argv[arg], "-d") == 0) limits.maxDepth_ = n;
+        else if (std::strcmp(argv[arg], "-t") == 0) limits.maxTime_ = n;
+        else break;
+    }
+    if (argc - arg != 1) {
+        std::cout << "Usage: " << argv[0]
+                  << " [-c components] [-b bytes] [-d depth] [-t ms] file\n";
+        return 1;
+    }
+
+    Image::AutoPtr image = ImageFactory::open(argv[arg]);
+    assert(image.get() != 0);
+    image->setParseLimits(limits);
+    image->readMetadata();
+
+    std::cout << "Exif: " << image->exifData().count()
+              << ", IPTC: " << image->iptcData().count()
+              << ", XMP: " << image->xmpData().count() << "\n";
+
+    return 0;
+}
+catch (AnyError& e) {
+    std::cout << "Caught Exiv2 exception '" << e << "'\n";
+    return -1;
+}
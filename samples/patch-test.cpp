@@ -0,0 +1,63 @@
+// ***************************************************************** -*- C++ -*-
+// patch-test.cpp, $Rev$
+// Overwrite an Exif value in an image file with Image::patchInPlace() and
+// print the value read back from the file. The value is given as a string
+// and read with the type of the existing tag, or the default type of the
+// key if the tag is not in the image.
+
+#include <exiv2/exiv2.hpp>
+
+#include <iostream>
+#include <cassert>
+
+using namespace Exiv2;
+
+int main(int argc, char* const argv[])
+try {
+    if (argc != 4) {
+        std::cout << "Usage: " << argv[0] << " file key value\n";
+        return 1;
+    }
+    const char* path = argv[1];
+    ExifKey key(argv[2]);
+
+    Image::AutoPtr image = ImageFactory::open(path);
+    assert(image.get() != 0);
+    image->readMetadata();
+
+    ExifData& exifData = image->exifData();
+    ExifData::const_iterator pos = exifData.findKey(key);
+    TypeId typeId = pos != exifData.end() ? pos->typeId() : key.defaultTypeId();
+    Value::AutoPtr value = Value::create(typeId);
+    if (value->read(argv[3]) != 0) {
+        std::cout << "Failed to read the value\n";
+        return 2;
+    }
+
+    bool patched = image->patchInPlace(key, *value);
+    std::cout << key << ": " << (patched ? "patched" : "not patched") << "\n";
+    if (patched) {
+        pos = exifData.findKey(key);
+        assert(pos != exifData.end());
+        std::cout << "Exif data: " << pos->value() << "\n";
+    }
+
+    // Read the image again
+    image = ImageFactory::open(path);
+    assert(image.get() != 0);
+    image->readMetadata();
+    pos = image->exifData().findKey(key);
+    std::cout << "File:      ";
+    if (pos != image->exifData().end()) {
+        std::cout << pos->value() << "\n";
+    }
+    else {
+        std::cout << "(not found)\n";
+    }
+
+    return 0;
+}
+catch (AnyError& e) {
+    std::cout << "Caught Exiv2 exception '" << e << "'\n";
+    return -1;
+}
@@ -0,0 +1,74 @@
+// ***************************************************************** -*- C++ -*-
+// print-bench.cpp, $Rev$
+// Time the interpretation of the Exif tags of images, i.e., Exifdatum::write(),
+// which looks up most makernote values in the tables of the makernotes. Each
+// image is read once and all its tags are printed count times.
+
+#include <exiv2/exiv2.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+using namespace Exiv2;
+
+int main(int argc, char* const argv[])
+try {
+    long count = 100;
+    int arg = 1;
+    if (arg + 1 < argc && std::strcmp(argv[arg], "-c") == 0) {
+        count = std::atol(argv[arg + 1]);
+        arg += 2;
+    }
+    if (arg >= argc || count <= 0) {
+        std::cout << "Usage: " << argv[0] << " [-c count] file...\n";
+        return 1;
+    }
+
+    double total = 0.0;
+    long totalTags = 0;
+    for (; arg < argc; ++arg) {
+        const char* path = argv[arg];
+        Image::AutoPtr image = ImageFactory::open(path);
+        assert(image.get() != 0);
+        image->readMetadata();
+        const ExifData& exifData = image->exifData();
+        long tags = 0;
+        long mnTags = 0;
+        for (ExifData::const_iterator i = exifData.begin(); i != exifData.end(); ++i) {
+            ++tags;
+            if (ExifTags::isMakerGroup(i->groupName())) ++mnTags;
+        }
+
+        std::size_t size = 0;
+        const std::clock_t start = std::clock();
+        for (long n = 0; n < count; ++n) {
+            std::ostringstream os;
+            for (ExifData::const_iterator i = exifData.begin(); i != exifData.end(); ++i) {
+                i->write(os, &exifData);
+            }
+            size += os.str().size();
+        }
+        const double ms = 1000.0 * (std::clock() - start) / CLOCKS_PER_SEC;
+        total += ms;
+        totalTags += tags * count;
+
+        std::cout << path << ": " << tags << " Exif tags (" << mnTags
+                  << " makernote tags), " << size / count << " bytes, "
+                  << std::fixed << std::setprecision(3)
+                  << 1000.0 * ms / count << " us per image\n";
+    }
+    if (totalTags > 0) {
+        std::cout << "Total: " << std::fixed << std::setprecision(1)
+                  << 1000000.0 * total / totalTags << " ns per tag\n";
+    }
+    return 0;
+}
+catch (AnyError& e) {
+    std::cout << "Caught Exiv2 exception '" << e << "'\n";
+    return -1;
+}
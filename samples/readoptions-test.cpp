@@ -0,0 +1,155 @@
+// ***************************************************************** -*- C++ -*-
+// readoptions-test.cpp, $Rev$
+// Read only some of the metadata of an image with
+// Image::readMetadata(const ReadOptions&) and compare the result with the
+// matching metadata from a complete read. Compare the tags of a makernote
+// which is parsed later with those of one parsed while the image is read,
+// also after the image is written.
+
+#include <exiv2/exiv2.hpp>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+
+using namespace Exiv2;
+
+// Print the keys and values of the metadata selected by options
+template<typename T>
+std::string dump(const T& data, const ReadOptions& options)
+{
+    std::ostringstream os;
+    for (typename T::const_iterator i = data.begin(); i != data.end(); ++i) {
+        if (options.selected(*i)) os << i->key() << " " << i->value() << "\n";
+    }
+    return os.str();
+}
+
+// Return the keys and values of the Exif metadata in the order of the keys,
+// only those of the makernote if makernote is true
+std::string sorted(const ExifData& exifData, bool makernote =false)
+{
+    std::vector<std::string> lines;
+    for (ExifData::const_iterator i = exifData.begin(); i != exifData.end(); ++i) {
+        if (makernote && !ExifTags::isMakerGroup(i->groupName())) continue;
+        std::ostringstream os;
+        os << i->key() << " " << i->value() << "\n";
+        lines.push_back(os.str());
+    }
+    std::sort(lines.begin(), lines.end());
+    std::string s;
+    for (std::vector<std::string>::const_iterator i = lines.begin(); i != lines.end(); ++i) {
+        s += *i;
+    }
+    return s;
+}
+
+// Read the image with a deferred makernote, parse it and compare the result
+// with that of image, then write the image and read it again
+void compareDeferred(const char* path, const Image& image)
+{
+    ReadOptions options;
+    options.deferMakernote_ = true;
+    Image::AutoPtr deferred = ImageFactory::open(path);
+    assert(deferred.get() != 0);
+    deferred->readMetadata(options);
+    ExifData& exifData = deferred->exifData();
+    const bool isDeferred = exifData.deferredMakernote();
+    const long before = exifData.count();
+    // A copy shares the makernote which is not parsed yet
+    ExifData copy = exifData;
+    exifData.parseMakernote();
+    const std::string eager = sorted(image.exifData());
+    std::cout << "Deferred makernote: " << (isDeferred ? "yes" : "no")
+              << ", " << before << " Exif before parsing, "
+              << exifData.count() << " after, "
+              << (sorted(exifData) == eager ? "same" : "differs") << ", copy "
+              << (copy.parseMakernote(), sorted(copy) == eager ? "same" : "differs") << "\n";
+
+    // Writing a deferred makernote keeps its tags
+    const std::string mn = sorted(image.exifData(), true);
+    deferred->readMetadata(options);
+    deferred->writeMetadata();
+    Image::AutoPtr written = ImageFactory::open(path);
+    assert(written.get() != 0);
+    written->readMetadata();
+    std::cout << "Written: " << written->exifData().count() << " Exif, makernote "
+              << (sorted(written->exifData(), true) == mn ? "same" : "differs") << "\n";
+}
+
+// Read the metadata selected by options and compare it with that of image
+void compare(const std::string& label,
+             const char* path,
+             const Image& image,
+             const ReadOptions& options)
+{
+    Image::AutoPtr sel = ImageFactory::open(path);
+    assert(sel.get() != 0);
+    sel->readMetadata(options);
+
+    const ReadOptions all;
+    const bool same =    dump(sel->exifData(), all) == dump(image.exifData(), options)
+                      && dump(sel->iptcData(), all) == dump(image.iptcData(), options)
+                      && dump(sel->xmpData(),  all) == dump(image.xmpData(),  options);
+    std::cout << label << ": "
+              << sel->exifData().count() << " Exif, "
+              << sel->iptcData().count() << " IPTC, "
+              << sel->xmpData().count() << " XMP, "
+              << (same ? "same" : "differs") << "\n";
+}
+
+int main(int argc, char* const argv[])
+try {
+    if (argc != 2) {
+        std::cout << "Usage: " << argv[0] << " file\n";
+        return 1;
+    }
+    const char* path = argv[1];
+
+    Image::AutoPtr image = ImageFactory::open(path);
+    assert(image.get() != 0);
+    image->readMetadata();
+    std::cout << path << ": "
+              << image->exifData().count() << " Exif, "
+              << image->iptcData().count() << " IPTC, "
+              << image->xmpData().count() << " XMP\n";
+
+    ReadOptions keys;
+    keys.keys_.insert("Exif.Image.Orientation");
+    keys.keys_.insert("Exif.Photo.PixelXDimension");
+    keys.keys_.insert("Xmp.xmp.CreateDate");
+    compare("Keys", path, *image, keys);
+
+    ReadOptions groups;
+    groups.groups_.insert("Exif.Thumbnail");
+    groups.groups_.insert("Iptc.Application2");
+    compare("Groups", path, *image, groups);
+
+    ReadOptions families;
+    families.metadata_ = mdIptc | mdXmp;
+    compare("Families", path, *image, families);
+
+    ReadOptions none;
+    none.metadata_ = mdNone;
+    compare("None", path, *image, none);
+
+    compareDeferred(path, *image);
+
+    // The overload can be called on the concrete image classes too
+    if (std::strstr(path, ".psd") != 0) {
+        PsdImage psd(BasicIo::AutoPtr(new FileIo(path)));
+        psd.readMetadata(keys);
+        std::cout << "PsdImage: " << psd.exifData().count() << " Exif, "
+                  << psd.xmpData().count() << " XMP\n";
+    }
+
+    return 0;
+}
+catch (AnyError& e) {
+    std::cout << "Caught Exiv2 exception '" << e << "'\n";
+    return -1;
+}
@@ -0,0 +1,197 @@
+// ***************************************************************** -*- C++ -*-
+// subifd-test.cpp, $Rev$
+// Create a small classic TIFF image with two SubIFDs, an Exif and an
+// Interoperability IFD and a strip for each image, add tags to the nested
+// IFDs and write the image with the write mode given on the command line.
+// Then check the strips of all images. With a size as third argument, the
+// file is extended to that size (use a size just below 4 GB to create a
+// sparse file to which the new IFDs cannot be appended, so that the image is
+// written again after all).
+
+#include <exiv2/exiv2.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+using namespace Exiv2;
+
+namespace {
+
+    const long stripSize = 16;
+    const int  images = 3;
+
+    // The strip of image n, each image has different data
+    void fillStrip(byte* buf, int n)
+    {
+        for (long i = 0; i < stripSize; ++i) {
+            buf[i] = static_cast<byte>(0x11 * i + n);
+        }
+    }
+
+    // Write a classic TIFF IFD entry with an inline value
+    byte* entry(byte* p, uint16_t tag, uint16_t type, uint32_t count, uint32_t value)
+    {
+        std::memset(p, 0x0, 12);
+        us2Data(p, tag, littleEndian);
+        us2Data(p + 2, type, littleEndian);
+        ul2Data(p + 4, count, littleEndian);
+        if (type == unsignedShort) us2Data(p + 8, static_cast<uint16_t>(value), littleEndian);
+        else ul2Data(p + 8, value, littleEndian);
+        return p + 12;
+    }
+
+    // Write the entries of an image with its strip at stripOffset
+    byte* imageEntries(byte* p, uint32_t subfileType, uint32_t stripOffset)
+    {
+        p = entry(p, 0x00fe, unsignedLong, 1, subfileType);
+        p = entry(p, 0x0100, unsignedShort, 1, 4);
+        p = entry(p, 0x0101, unsignedShort, 1, 4);
+        p = entry(p, 0x0102, unsignedShort, 1, 8);
+        p = entry(p, 0x0103, unsignedShort, 1, 1);
+        p = entry(p, 0x0106, unsignedShort, 1, 1);
+        p = entry(p, 0x0111, unsignedLong, 1, stripOffset);
+        p = entry(p, 0x0115, unsignedShort, 1, 1);
+        p = entry(p, 0x0116, unsignedShort, 1, 4);
+        p = entry(p, 0x0117, unsignedLong, 1, stripSize);
+        return p;
+    }
+
+    void create(const char* path, long size)
+    {
+        // Header, IFD0, two SubIFDs, Exif IFD, Interoperability IFD, the
+        // SubIFD offsets, then the strips
+        const uint32_t ifd0 = 8;
+        const uint32_t subIfd1 = ifd0 + 2 + 12 * 12 + 4;
+        const uint32_t subIfd2 = subIfd1 + 2 + 10 * 12 + 4;
+        const uint32_t exifIfd = subIfd2 + 2 + 10 * 12 + 4;
+        const uint32_t iopIfd = exifIfd + 2 + 2 * 12 + 4;
+        const uint32_t subIfds = iopIfd + 2 + 1 * 12 + 4;
+        const uint32_t strips = subIfds + 2 * 4;
+
+        byte buf[1024];
+        std::memset(buf, 0x0, sizeof(buf));
+        byte* p = buf;
+        const byte header[8] = { 'I', 'I', 42, 0, ifd0, 0, 0, 0 };
+        std::memcpy(p, header, sizeof(header));
+        p += sizeof(header);
+        // IFD0
+        us2Data(p, 12, littleEndian);
+        p = imageEntries(p + 2, 0, strips);
+        p = entry(p, 0x014a, unsignedLong, 2, subIfds);
+        p = entry(p, 0x8769, unsignedLong, 1, exifIfd);
+        p += 4;
+        // SubIFDs
+        for (int n = 1; n < images; ++n) {
+            us2Data(p, 10, littleEndian);
+            p = imageEntries(p + 2, 1, strips + n * stripSize);
+            p += 4;
+        }
+        // Exif IFD
+        us2Data(p, 2, littleEndian);
+        p = entry(p + 2, 0xa002, unsignedLong, 1, 4);
+        p = entry(p, 0xa005, unsignedLong, 1, iopIfd);
+        p += 4;
+        // Interoperability IFD
+        us2Data(p, 1, littleEndian);
+        p = entry(p + 2, 0x0001, asciiString, 4, 0);
+        std::memcpy(p - 4, "R98", 4);
+        p += 4;
+        // SubIFD offsets
+        ul2Data(p, subIfd1, littleEndian);
+        ul2Data(p + 4, subIfd2, littleEndian);
+        p += 8;
+        assert(p == buf + strips);
+        for (int n = 0; n < images; ++n) {
+            fillStrip(p, n);
+            p += stripSize;
+        }
+
+        FileIo file(path);
+        if (file.open("wb") != 0) throw Error(10, path, "wb", strError());
+        file.write(buf, static_cast<long>(p - buf));
+        if (size > p - buf) {
+            // Leave a hole up to the last byte
+            file.seek(size - 1, BasicIo::beg);
+            file.putb(0x0);
+        }
+        if (file.error()) throw Error(21);
+    }
+
+    void print(const char* path)
+    {
+        Image::AutoPtr image = ImageFactory::open(path);
+        assert(image.get() != 0);
+        image->readMetadata();
+        const ExifData& exifData = image->exifData();
+        for (ExifData::const_iterator i = exifData.begin(); i != exifData.end(); ++i) {
+            std::cout << std::setw(36) << std::left << i->key() << " "
+                      << std::setw(9) << std::left << i->typeName() << " "
+                      << i->count() << "  " << i->value() << "\n";
+        }
+        // Check the strip of each image
+        FileIo file(path);
+        if (file.open() != 0) throw Error(10, path, "rb", strError());
+        std::cout << "File size: " << (file.size() < 0x10000 ? "small" : "large") << "\n";
+        const char* groups[images] = { "Image", "SubImage1", "SubImage2" };
+        for (int n = 0; n < images; ++n) {
+            const std::string group(groups[n]);
+            ExifData::const_iterator offset = exifData.findKey(ExifKey("Exif." + group + ".StripOffsets"));
+            ExifData::const_iterator count = exifData.findKey(ExifKey("Exif." + group + ".StripByteCounts"));
+            std::cout << "Strip of " << group << ": ";
+            if (offset == exifData.end() || count == exifData.end() || count->toLong() != stripSize) {
+                std::cout << "MISSING\n";
+                continue;
+            }
+            byte expected[stripSize];
+            fillStrip(expected, n);
+            byte data[stripSize];
+            file.seek(static_cast<uint32_t>(offset->toLong()), BasicIo::beg);
+            const long len = file.read(data, stripSize);
+            std::cout << (   len == stripSize
+                          && std::memcmp(data, expected, stripSize) == 0 ? "unchanged" : "CHANGED")
+                      << "\n";
+        }
+    }
+
+}
+
+int main(int argc, char* const argv[])
+try {
+    if (   (argc != 3 && argc != 4)
+        || (std::strcmp(argv[2], "rewrite") != 0 && std::strcmp(argv[2], "append") != 0)) {
+        std::cout << "Usage: " << argv[0] << " file rewrite|append [size]\n";
+        return 1;
+    }
+    const char* path = argv[1];
+    const TiffWriteMode writeMode = std::strcmp(argv[2], "append") == 0 ? twAppend : twRewrite;
+    const long size = argc == 4 ? std::strtol(argv[3], 0, 0) : 0;
+
+    create(path, size);
+    std::cout << "------> Created <-------\n";
+    print(path);
+
+    std::cout << "------> Write metadata (" << argv[2] << ") <-------\n";
+    Image::AutoPtr image = ImageFactory::open(path);
+    assert(image.get() != 0);
+    image->readMetadata();
+    ExifData& exifData = image->exifData();
+    exifData["Exif.Image.Artist"] = "Exiv2 SubIFD test";
+    exifData["Exif.SubImage1.ImageDescription"] = "First SubIFD of the Exiv2 SubIFD test";
+    exifData["Exif.SubImage2.Software"] = "Exiv2";
+    exifData["Exif.Photo.UserComment"] = "charset=Ascii Nested IFDs";
+    exifData["Exif.Iop.InteroperabilityVersion"] = "48 49 48 48";
+    TiffImage* tiffImage = dynamic_cast<TiffImage*>(image.get());
+    assert(tiffImage != 0);
+    tiffImage->setWriteMode(writeMode);
+    image->writeMetadata();
+    print(path);
+
+    return 0;
+}
+catch (AnyError& e) {
+    std::cout << "Caught Exiv2 exception '" << e << "'\n";
+    return -1;
+}
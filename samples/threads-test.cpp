@@ -0,0 +1,63 @@
+// ***************************************************************** -*- C++ -*-
+// threads-test.cpp, $Rev$
+// Read the Exif metadata of images with the number of decode threads given
+// on the command line and compare it with the metadata decoded in one
+// thread.
+
+#include <exiv2/exiv2.hpp>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+
+using namespace Exiv2;
+
+namespace {
+
+    // Return the Exif metadata of an image as text
+    std::string exif(const char* path, int threads, long& count)
+    {
+        ReadOptions options;
+        options.decodeThreads_ = threads;
+        Image::AutoPtr image = ImageFactory::open(path);
+        image->readMetadata(options);
+        const ExifData& exifData = image->exifData();
+        count = exifData.count();
+        std::ostringstream os;
+        for (ExifData::const_iterator i = exifData.begin(); i != exifData.end(); ++i) {
+            os << i->key() << " " << i->typeName() << " " << i->count()
+               << " " << i->value() << "\n";
+        }
+        os << "Makernote modified: " << exifData.makernoteModified() << "\n";
+        return os.str();
+    }
+
+}
+
+int main(int argc, char* const argv[])
+{
+    if (argc < 3) {
+        std::cout << "Usage: " << argv[0] << " threads file...\n";
+        return 1;
+    }
+    const int threads = std::atoi(argv[1]);
+    int rc = 0;
+    for (int i = 2; i < argc; ++i) {
+        try {
+            long count1 = 0;
+            long count = 0;
+            const std::string exif1 = exif(argv[i], 1, count1);
+            const std::string exifN = exif(argv[i], threads, count);
+            std::cout << argv[i] << ": " << count << " Exif metadata, "
+                      << (exifN == exif1 ? "same as" : "DIFFERENT from")
+                      << " one thread\n";
+            if (exifN != exif1) rc = 2;
+        }
+        catch (AnyError& e) {
+            std::cout << argv[i] << ": Caught Exiv2 exception '" << e << "'\n";
+            rc = -1;
+        }
+    }
+    return rc;
+}
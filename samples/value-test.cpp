@@ -0,0 +1,124 @@
+// ***************************************************************** -*- C++ -*-
+// value-test.cpp, $Rev$
+// Tests for the Value classes: access to the values of a ValueType through
+// its standard container and, for the files given as arguments, the type,
+// count and size of Exif values which are read only when they are used.
+
+#include <exiv2/exiv2.hpp>
+
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cassert>
+
+using namespace Exiv2;
+
+// Print the type, count, size and the values
+void print(const std::string& label, const Value& value)
+{
+    std::cout << label << ": " << TypeInfo::typeName(value.typeId())
+              << ", count " << value.count()
+              << ", size " << value.size()
+              << ": " << value << "\n";
+}
+
+void testValueList()
+{
+    std::cout << "ValueType::value_\n";
+    UShortValue us;
+    us.read("1 2 3");
+    print("read", us);
+
+    // The values can be used like a std::vector
+    UShortValue::ValueList& v = us.value_;
+    v.insert(v.begin() + 1, 7);
+    v.erase(v.begin());
+    v.at(2) = 9;
+    v.push_back(4);
+    print("edited", us);
+    try {
+        v.at(10);
+        std::cout << "at(10): no exception\n";
+    }
+    catch (const std::out_of_range&) {
+        std::cout << "at(10): std::out_of_range\n";
+    }
+
+    std::sort(v.begin(), v.end());
+    print("sorted", us);
+
+    // Round trip through the binary representation
+    byte buf[32];
+    long len = us.copy(buf, bigEndian);
+    UShortValue us2;
+    us2.read(buf, len, bigEndian);
+    print("copy", us2);
+
+    URationalValue ur;
+    ur.read("1/2 3/4");
+    ur.value_.insert(ur.value_.end(), 2, URational(5, 6));
+    print("rational", ur);
+
+    // Values stored inline and on the heap
+    UShortValue one(5);
+    UShortValue many(us);
+    std::cout << "equal copy: " << (many.value_ == us.value_ ? "yes" : "no") << "\n";
+    one.value_.swap(many.value_);
+    print("swapped", one);
+    print("swapped", many);
+    many.value_.resize(3, 1);
+    many.value_.insert(many.value_.begin(), many.value_.rbegin(), many.value_.rend());
+    print("resized", many);
+    many.value_.erase(many.value_.begin() + 1, many.value_.end() - 1);
+    print("erased", many);
+}
+
+// Compare the type, count and size of each Exif value before it is read
+// with those of the value, then use the values after the image is gone
+void testDeferred(const char* path)
+{
+    Image::AutoPtr image = ImageFactory::open(path);
+    assert(image.get() != 0);
+    image->readMetadata();
+    ExifData exifData = image->exifData();
+    image.reset();
+
+    long mismatches = 0;
+    for (ExifData::const_iterator i = exifData.begin(); i != exifData.end(); ++i) {
+        const TypeId typeId = i->typeId();
+        const long count = i->count();
+        const long size = i->size();
+        const Value& value = i->value();
+        if (   typeId != value.typeId()
+            || count != value.count()
+            || size != value.size()) {
+            std::cout << i->key() << ": " << TypeInfo::typeName(typeId)
+                      << ", count " << count << ", size " << size
+                      << " before, " << TypeInfo::typeName(value.typeId())
+                      << ", count " << value.count() << ", size " << value.size()
+                      << " after reading the value\n";
+            ++mismatches;
+        }
+    }
+    long size = 0;
+    for (ExifData::const_iterator i = exifData.begin(); i != exifData.end(); ++i) {
+        size += static_cast<long>(i->toString().size());
+    }
+    std::cout << path << ": " << exifData.count() << " tags, "
+              << mismatches << " mismatches, " << size << " characters\n";
+}
+
+int main(int argc, char* const argv[])
+try {
+    if (argc == 1) {
+        testValueList();
+    }
+    for (int i = 1; i < argc; ++i) {
+        testDeferred(argv[i]);
+    }
+    return 0;
+}
+catch (AnyError& e) {
+    std::cout << "Caught Exiv2 exception '" << e << "'\n";
+    return -1;
+}
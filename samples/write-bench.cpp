@@ -0,0 +1,92 @@
+// ***************************************************************** -*- C++ -*-
+// write-bench.cpp, $Rev$
+// Time repeated writes of the metadata of an image. With option -m, a
+// makernote tag is modified before each write, so that the makernote is
+// encoded tag by tag instead of being copied as it was read. With option -i,
+// a tag is added or removed before each write, so that each write creates a
+// new TIFF structure, e.g., to time images with nested SubIFDs.
+
+#include <exiv2/exiv2.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+using namespace Exiv2;
+
+int main(int argc, char* const argv[])
+try {
+    bool modify = false;
+    bool intrusive = false;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; ++arg) {
+        if (std::strcmp(argv[arg], "-m") == 0) modify = true;
+        else if (std::strcmp(argv[arg], "-i") == 0) intrusive = true;
+        else break;
+    }
+    if (argc - arg < 1 || argc - arg > 2) {
+        std::cout << "Usage: " << argv[0] << " [-m] [-i] file [count]\n";
+        return 1;
+    }
+    const char* path = argv[arg];
+    const long count = argc - arg == 2 ? std::atol(argv[arg + 1]) : 100;
+
+    // Work on a copy of the image in memory, the file is not modified
+    FileIo file(path);
+    if (file.open("rb") != 0) {
+        throw Error(9, path, strError());
+    }
+    DataBuf buf(file.size());
+    file.read(buf.pData_, buf.size_);
+    file.close();
+    Image::AutoPtr image = ImageFactory::open(buf.pData_, buf.size_);
+    assert(image.get() != 0);
+    image->readMetadata();
+
+    ExifData& exifData = image->exifData();
+    ExifData::iterator mn = exifData.end();
+    if (modify) {
+        for (ExifData::iterator i = exifData.begin(); i != exifData.end(); ++i) {
+            if (ExifTags::isMakerGroup(i->groupName()) && i->typeId() == unsignedShort) {
+                mn = i;
+                break;
+            }
+        }
+        if (mn == exifData.end()) {
+            std::cerr << path << ": No makernote tag to modify\n";
+            return 2;
+        }
+        std::cout << "Modifying " << mn->key() << "\n";
+    }
+
+    const ExifKey key("Exif.Image.DocumentName");
+    const std::clock_t start = std::clock();
+    for (long i = 0; i < count; ++i) {
+        if (mn != exifData.end()) {
+            mn->setValue(toString(i % 2));
+        }
+        if (intrusive) {
+            ExifData::iterator pos = exifData.findKey(key);
+            if (pos == exifData.end()) {
+                exifData[key.key()] = "write-bench";
+            }
+            else {
+                exifData.erase(pos);
+            }
+        }
+        image->writeMetadata();
+    }
+    const double ms = 1000.0 * (std::clock() - start) / CLOCKS_PER_SEC;
+
+    std::cout << path << ": " << exifData.count() << " Exif tags, "
+              << count << " writes, " << std::fixed << std::setprecision(3)
+              << ms / count << " ms per write\n";
+    return 0;
+}
+catch (AnyError& e) {
+    std::cout << "Caught Exiv2 exception '" << e << "'\n";
+    return -1;
+}
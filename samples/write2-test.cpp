@@ -15,10 +15,16 @@
 #include <iostream>
 #include <iomanip>
 #include <string>
+#include <cstring>
 #include <cassert>
 
 void write(const std::string& file, Exiv2::ExifData& ed);
+void writeTiff(Exiv2::ExifData& ed);
+Exiv2::DataBuf encodeTiff(const Exiv2::ExifData& ed);
+void writeTiff(const std::string& file, const char* artist, Exiv2::TiffWriteMode mode);
+void checkStrip(const std::string& file, const Exiv2::byte* strip, long size);
 void print(const std::string& file);
+void print(const Exiv2::ExifData& ed);
 
 // *****************************************************************************
 // Main
@@ -196,6 +202,41 @@ try {
     write(file, ed7);
     print(file);
 
+    std::cout <<"\n----- New TIFF structure with nested IFDs: SubIFDs, Exif, GPS and IOP\n";
+    Exiv2::ExifData ed8;
+    ed8["Exif.Image.Model"] = "Test 8";
+    ed8["Exif.SubImage1.NewSubfileType"] = uint32_t(1);
+    ed8["Exif.SubImage1.ImageDescription"] = "Test 8 SubImage1 tag";
+    ed8["Exif.SubImage2.NewSubfileType"] = uint32_t(0);
+    ed8["Exif.SubImage2.Artist"] = "Test 8 SubImage2 tag";
+    ed8["Exif.Photo.DateTimeOriginal"] = "Test 8 Exif tag";
+    ed8["Exif.Iop.InteroperabilityIndex"] = "Test 8 Iop tag";
+    ed8["Exif.GPSInfo.GPSMapDatum"] = "Test 8 GPS tag";
+    ed8["Exif.Thumbnail.Artist"] = "Test 8 Ifd1 tag";
+    writeTiff(ed8);
+    print(ed8);
+
+    std::cout <<"\n----- Append new IFDs to a TIFF image, then compact it\n";
+    const Exiv2::byte strip[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    Exiv2::ExifData ed9;
+    ed9["Exif.Image.Model"] = "Test 9";
+    Exiv2::Value::AutoPtr v9 = Exiv2::Value::create(Exiv2::unsignedLong);
+    v9->read("0");
+    v9->setDataArea(strip, sizeof(strip));
+    ed9.add(Exiv2::ExifKey("Exif.Image.StripOffsets"), v9.get());
+    ed9["Exif.Image.StripByteCounts"] = uint32_t(sizeof(strip));
+    std::string tiff(file + ".tif");
+    Exiv2::DataBuf buf9 = encodeTiff(ed9);
+    Exiv2::writeFile(buf9, tiff);
+    std::cout << "File size: " << buf9.size_ << "\n";
+    writeTiff(tiff, "Test 9 appended", Exiv2::twAppend);
+    writeTiff(tiff, "Test 9 appended again", Exiv2::twAppend);
+    print(tiff);
+    checkStrip(tiff, strip, sizeof(strip));
+    writeTiff(tiff, 0, Exiv2::twCompact);
+    print(tiff);
+    checkStrip(tiff, strip, sizeof(strip));
+
     return 0;
 }
 catch (Exiv2::AnyError& e) {
@@ -213,13 +254,64 @@ void write(const std::string& file, Exiv2::ExifData& ed)
     image->writeMetadata();
 }
 
+void writeTiff(Exiv2::ExifData& ed)
+{
+    Exiv2::DataBuf buf = encodeTiff(ed);
+    Exiv2::IptcData iptcData;
+    Exiv2::XmpData xmpData;
+    ed.clear();
+    Exiv2::TiffParser::decode(ed, iptcData, xmpData, buf.pData_, buf.size_);
+}
+
+Exiv2::DataBuf encodeTiff(const Exiv2::ExifData& ed)
+{
+    Exiv2::MemIo io;
+    Exiv2::IptcData iptcData;
+    Exiv2::XmpData xmpData;
+    Exiv2::WriteMethod wm = Exiv2::TiffParser::encode(io, 0, 0, Exiv2::littleEndian,
+                                                      ed, iptcData, xmpData);
+    assert(wm == Exiv2::wmIntrusive);
+    Exiv2::DataBuf buf(static_cast<long>(io.size()));
+    io.seek(0, Exiv2::BasicIo::beg);
+    io.read(buf.pData_, buf.size_);
+    return buf;
+}
+
+void writeTiff(const std::string& file, const char* artist, Exiv2::TiffWriteMode mode)
+{
+    Exiv2::Image::AutoPtr image = Exiv2::ImageFactory::open(file);
+    assert(image.get() != 0);
+    Exiv2::TiffImage* tiffImage = dynamic_cast<Exiv2::TiffImage*>(image.get());
+    assert(tiffImage != 0);
+    image->readMetadata();
+    if (artist) image->exifData()["Exif.Image.Artist"] = artist;
+    tiffImage->setWriteMode(mode);
+    image->writeMetadata();
+    std::cout << "File size: " << image->io().size() << "\n";
+}
+
+void checkStrip(const std::string& file, const Exiv2::byte* strip, long size)
+{
+    Exiv2::Image::AutoPtr image = Exiv2::ImageFactory::open(file);
+    assert(image.get() != 0);
+    image->readMetadata();
+    long offset = image->exifData()["Exif.Image.StripOffsets"].toLong();
+    Exiv2::DataBuf buf = Exiv2::readFile(file);
+    bool ok = offset + size <= buf.size_ && std::memcmp(buf.pData_ + offset, strip, size) == 0;
+    std::cout << "Image data at offset " << offset << ": " << (ok ? "ok" : "FAILED") << "\n";
+}
+
 void print(const std::string& file)
 {
     Exiv2::Image::AutoPtr image = Exiv2::ImageFactory::open(file);
     assert(image.get() != 0);
     image->readMetadata();
 
-    Exiv2::ExifData &ed = image->exifData();
+    print(image->exifData());
+}
+
+void print(const Exiv2::ExifData& ed)
+{
     Exiv2::ExifData::const_iterator end = ed.end();
     for (Exiv2::ExifData::const_iterator i = ed.begin(); i != end; ++i) {
         std::cout << std::setw(45) << std::setfill(' ') << std::left
@@ -1,6 +1,8 @@
 // ***************************************************************** -*- C++ -*-
 // xmpparse.cpp, $Rev$
 // Read an XMP packet from a file, parse it and print all (known) properties.
+// Option -s decodes the packet with the streaming decoder instead of the XMP
+// toolkit.
 
 #include <exiv2/exiv2.hpp>
 
@@ -10,21 +12,26 @@
 
 int main(int argc, char* const argv[])
 try {
-    if (argc != 2) {
-        std::cout << "Usage: " << argv[0] << " file\n";
+    int arg = 1;
+    if (argc == 3 && std::string(argv[1]) == "-s") {
+        Exiv2::XmpParser::setDecoder(Exiv2::XmpParser::streamingDecoder);
+        ++arg;
+    }
+    if (argc != arg + 1) {
+        std::cout << "Usage: " << argv[0] << " [-s] file\n";
         return 1;
     }
-    Exiv2::DataBuf buf = Exiv2::readFile(argv[1]);
+    Exiv2::DataBuf buf = Exiv2::readFile(argv[arg]);
     std::string xmpPacket;
     xmpPacket.assign(reinterpret_cast<char*>(buf.pData_), buf.size_);
     Exiv2::XmpData xmpData;
     if (0 != Exiv2::XmpParser::decode(xmpData, xmpPacket)) {
-        std::string error(argv[1]);
+        std::string error(argv[arg]);
         error += ": Failed to parse file contents (XMP packet)";
         throw Exiv2::Error(1, error);
     }
     if (xmpData.empty()) {
-        std::string error(argv[1]);
+        std::string error(argv[arg]);
         error += ": No XMP properties found in the XMP packet";
         throw Exiv2::Error(1, error);
     }
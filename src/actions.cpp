@@ -488,7 +488,28 @@ namespace Action {
         }
         Exiv2::Image::AutoPtr image = Exiv2::ImageFactory::open(path_);
         assert(image.get() != 0);
-        image->readMetadata();
+        // Read only the metadata to grep for, if it is known to which
+        // families the keys belong
+        Exiv2::ReadOptions options;
+        int families = Exiv2::mdNone;
+        for (Params::Keys::const_iterator k = Params::instance().keys_.begin();
+             k != Params::instance().keys_.end(); ++k) {
+            options.keys_.insert(*k);
+            if      (k->compare(0, 5, "Exif.") == 0) families |= Exiv2::mdExif;
+            else if (k->compare(0, 5, "Iptc.") == 0) families |= Exiv2::mdIptc;
+            else if (k->compare(0, 4, "Xmp.") == 0)  families |= Exiv2::mdXmp;
+            else families = Exiv2::mdNone;
+            if (families == Exiv2::mdNone) break;
+        }
+        if (families != Exiv2::mdNone) {
+            if (Params::instance().printTags_ == Exiv2::mdNone) {
+                Params::instance().printTags_ = families;
+            }
+            image->readMetadata(options);
+        }
+        else {
+            image->readMetadata();
+        }
         // Set defaults for metadata types and data columns
         if (Params::instance().printTags_ == Exiv2::mdNone) {
             Params::instance().printTags_ = Exiv2::mdExif | Exiv2::mdIptc | Exiv2::mdXmp;
@@ -0,0 +1,413 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2011 Andreas Huggel <ahuggel@gmx.net>
+ *
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+  File:      arena.cpp
+  Version:   $Rev$
+  Author(s): Andreas Huggel (ahu) <ahuggel@gmx.net>
+  History:   19-Oct-26, ahu: created
+ */
+// *****************************************************************************
+#include "rcsid_int.hpp"
+EXIV2_RCSID("@(#) $Id$")
+
+// *****************************************************************************
+// included header files
+#ifdef _MSC_VER
+# include "exv_msvc.h"
+#else
+# include "exv_conf.h"
+#endif
+
+#include "arena_int.hpp"
+
+// + standard includes
+#include <new>
+#include <set>
+#include <cassert>
+#include <cstring>
+#if defined _MSC_VER
+# include <intrin.h>
+#endif
+#if defined WIN32 && !defined __CYGWIN__
+# include <windows.h>
+#elif defined EXV_HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+// *****************************************************************************
+// local declarations
+namespace {
+
+    using Exiv2::byte;
+    using Exiv2::Internal::atomicAdd;
+
+    /*!
+      @brief Alignment of the memory returned by Arena::allocate(), as by
+             operator new. The count of a block is in front of its first
+             allocation.
+     */
+    const std::size_t alignment = 16;
+
+    /*!
+      @brief Added to the count of a block while it is the current block of
+             its arena, so that the count cannot drop to 0 before the arena
+             adds the number of objects allocated from the block.
+     */
+    const long openBias = 0x40000000L;
+
+    //! Round \em size up to a multiple of the alignment.
+    std::size_t align(std::size_t size)
+    {
+        return (size + alignment - 1) & ~(alignment - 1);
+    }
+
+    //! Return the number of live objects in the block \em pBlock.
+    long& objectCount(byte* pBlock)
+    {
+        return *reinterpret_cast<long*>(pBlock);
+    }
+
+    //! Mutex for the block registry, locked for the lifetime of the object
+    class RegistryLock {
+    public:
+        //! Constructor, locks the registry.
+        RegistryLock();
+        //! Destructor, unlocks the registry.
+        ~RegistryLock();
+    private:
+#if defined WIN32 && !defined __CYGWIN__
+        //! Initializes the critical section before the registry is used
+        struct Init {
+            Init() { InitializeCriticalSection(&cs_); }
+        };
+        static CRITICAL_SECTION cs_;
+        static Init init_;
+#elif defined EXV_HAVE_PTHREAD
+        static pthread_mutex_t mutex_;
+#endif
+    }; // class RegistryLock
+
+#if defined WIN32 && !defined __CYGWIN__
+    CRITICAL_SECTION RegistryLock::cs_;
+    RegistryLock::Init RegistryLock::init_;
+
+    RegistryLock::RegistryLock() { EnterCriticalSection(&cs_); }
+    RegistryLock::~RegistryLock() { LeaveCriticalSection(&cs_); }
+#elif defined EXV_HAVE_PTHREAD
+    pthread_mutex_t RegistryLock::mutex_ = PTHREAD_MUTEX_INITIALIZER;
+
+    RegistryLock::RegistryLock() { pthread_mutex_lock(&mutex_); }
+    RegistryLock::~RegistryLock() { pthread_mutex_unlock(&mutex_); }
+#else
+    RegistryLock::RegistryLock() {}
+    RegistryLock::~RegistryLock() {}
+#endif
+
+    /*!
+      @brief The blocks of all arenas which are still in use, protected by
+             RegistryLock. Never deleted, objects may be released during
+             static destruction.
+     */
+    std::set<byte*>* pBlocks = new std::set<byte*>;
+    //! Number of blocks in the registry, to skip the lookup while there are none
+    long liveBlocks = 0;
+
+    //! Add a new block to the registry and return it.
+    byte* newBlock(std::size_t size)
+    {
+        byte* pBlock = static_cast<byte*>(::operator new(size));
+        objectCount(pBlock) = openBias;
+        RegistryLock lock;
+        pBlocks->insert(pBlock);
+        atomicAdd(liveBlocks, 1);
+        return pBlock;
+    }
+
+    //! Remove the block \em pBlock, in which no objects are left, from the registry and free it.
+    void freeBlock(byte* pBlock)
+    {
+        {
+            RegistryLock lock;
+            pBlocks->erase(pBlock);
+            atomicAdd(liveBlocks, -1);
+        }
+        ::operator delete(pBlock);
+    }
+
+    //! Return the block of \em size bytes which contains \em p, 0 if \em p is not in a block.
+    byte* findBlock(void* p, std::size_t size)
+    {
+        byte* pb = static_cast<byte*>(p);
+        RegistryLock lock;
+        std::set<byte*>::const_iterator pos = pBlocks->upper_bound(pb);
+        if (pos == pBlocks->begin()) return 0;
+        --pos;
+        return pb < *pos + size ? *pos : 0;
+    }
+
+}
+
+#if defined __GNUC__
+# define EXV_THREAD_LOCAL __thread
+#elif defined _MSC_VER
+# define EXV_THREAD_LOCAL __declspec(thread)
+#endif
+
+#ifdef EXV_THREAD_LOCAL
+//! The arenas which are current for the thread, by pool, set by ArenaScope
+static EXV_THREAD_LOCAL Exiv2::Internal::Arena* pCurrentArena[Exiv2::Internal::Arena::poolCount];
+#endif
+
+// *****************************************************************************
+// class member definitions
+namespace Exiv2 {
+    namespace Internal {
+
+    Arena::Arena()
+        : pBlock_(0), used_(blockSize_), allocated_(0)
+    {
+    }
+
+    Arena::~Arena()
+    {
+        closeBlock();
+    }
+
+    void* Arena::allocate(std::size_t size, Pool pool)
+    {
+#ifdef EXV_THREAD_LOCAL
+        Arena* pArena = pCurrentArena[pool];
+        if (pArena != 0 && size <= maxSize_) {
+            return pArena->alloc(align(size));
+        }
+#else
+        (void)pool;
+#endif
+        return ::operator new(size);
+    }
+
+    void Arena::deallocate(void* p)
+    {
+        if (p == 0) return;
+        if (atomicLoad(&liveBlocks) != 0) {
+            // The block cannot be freed meanwhile, p is still counted
+            byte* pBlock = findBlock(p, blockSize_);
+            if (pBlock != 0) {
+                if (atomicAdd(objectCount(pBlock), -1) == 0) freeBlock(pBlock);
+                return;
+            }
+        }
+        ::operator delete(p);
+    }
+
+    void* Arena::alloc(std::size_t size)
+    {
+        assert(size <= blockSize_ - alignment);
+        if (used_ + size > blockSize_) {
+            closeBlock();
+            pBlock_ = newBlock(blockSize_);
+            used_ = alignment;
+        }
+        void* p = pBlock_ + used_;
+        used_ += size;
+        ++allocated_;
+        return p;
+    }
+
+    void Arena::closeBlock()
+    {
+        if (pBlock_ == 0) return;
+        // Objects deleted so far have already been subtracted
+        if (atomicAdd(objectCount(pBlock_), allocated_ - openBias) == 0) {
+            freeBlock(pBlock_);
+        }
+        pBlock_ = 0;
+        used_ = blockSize_;
+        allocated_ = 0;
+    }
+
+    ArenaScope::ArenaScope(bool enable, Arena::Pool pool)
+        : pArena_(0), pPrevious_(0), pool_(pool)
+    {
+#ifdef EXV_THREAD_LOCAL
+        if (enable) {
+            pArena_ = new Arena;
+            pPrevious_ = pCurrentArena[pool_];
+            pCurrentArena[pool_] = pArena_;
+        }
+#else
+        (void)enable;
+#endif
+    }
+
+    ArenaScope::~ArenaScope()
+    {
+#ifdef EXV_THREAD_LOCAL
+        if (pArena_ != 0) {
+            pCurrentArena[pool_] = pPrevious_;
+            delete pArena_;
+        }
+#endif
+    }
+
+    RawStore::RawStore()
+        : pBase_(0), pBuf_(0), bufSize_(0),
+          pChunks_(0), used_(chunkSize_), refCount_(1)
+    {
+    }
+
+    RawStore::RawStore(DataBuf& buf)
+        : buf_(buf), pBase_(0), pBuf_(buf_.pData_), bufSize_(buf_.size_),
+          pChunks_(0), used_(chunkSize_), refCount_(1)
+    {
+    }
+
+    RawStore::RawStore(RawStore& base)
+        : pBase_(&base), pBuf_(base.pBuf_), bufSize_(base.bufSize_),
+          pChunks_(0), used_(chunkSize_), refCount_(1)
+    {
+        pBase_->addRef();
+    }
+
+    RawStore::~RawStore()
+    {
+        while (pChunks_ != 0) {
+            byte* pPrev = *reinterpret_cast<byte**>(pChunks_);
+            delete[] pChunks_;
+            pChunks_ = pPrev;
+        }
+        if (pBase_ != 0) pBase_->release();
+    }
+
+    bool RawStore::contains(const byte* pData, uint64_t size) const
+    {
+        return    pBuf_ != 0
+               && pData >= pBuf_ && pData <= pBuf_ + bufSize_
+               && size <= static_cast<uint64_t>(pBuf_ + bufSize_ - pData);
+    }
+
+    const byte* RawStore::add(const byte* pData, long size)
+    {
+        const long headerSize = sizeof(byte*);
+        if (size <= 0) return 0;
+        if (contains(pData, size)) return pData;
+        byte* p = 0;
+        if (size > chunkSize_ / 4) {
+            // Large data gets its own chunk, linked behind the current one
+            byte* pChunk = new byte[headerSize + size];
+            if (pChunks_ == 0) {
+                *reinterpret_cast<byte**>(pChunk) = 0;
+                pChunks_ = pChunk;
+                used_ = chunkSize_;
+            }
+            else {
+                *reinterpret_cast<byte**>(pChunk) = *reinterpret_cast<byte**>(pChunks_);
+                *reinterpret_cast<byte**>(pChunks_) = pChunk;
+            }
+            p = pChunk + headerSize;
+        }
+        else {
+            if (used_ + size > chunkSize_) {
+                byte* pChunk = new byte[chunkSize_];
+                *reinterpret_cast<byte**>(pChunk) = pChunks_;
+                pChunks_ = pChunk;
+                used_ = headerSize;
+            }
+            p = pChunks_ + used_;
+            used_ += size;
+        }
+        std::memcpy(p, pData, size);
+        return p;
+    }
+
+    void RawStore::addRef()
+    {
+        atomicIncrement(refCount_);
+    }
+
+    void RawStore::release()
+    {
+        if (atomicDecrement(refCount_) == 0) delete this;
+    }
+
+    long atomicIncrement(long& count)
+    {
+#if defined __GNUC__
+        return __sync_add_and_fetch(&count, 1);
+#elif defined _MSC_VER
+        return _InterlockedIncrement(&count);
+#else
+        return ++count;
+#endif
+    }
+
+    long atomicDecrement(long& count)
+    {
+#if defined __GNUC__
+        return __sync_sub_and_fetch(&count, 1);
+#elif defined _MSC_VER
+        return _InterlockedDecrement(&count);
+#else
+        return --count;
+#endif
+    }
+
+    long atomicAdd(long& count, long n)
+    {
+#if defined __GNUC__
+        return __sync_add_and_fetch(&count, n);
+#elif defined _MSC_VER
+        return _InterlockedExchangeAdd(&count, n) + n;
+#else
+        return count += n;
+#endif
+    }
+
+    bool atomicCompareAndSwap(void** target, void* expected, void* desired)
+    {
+#if defined __GNUC__
+        return __sync_bool_compare_and_swap(target, expected, desired);
+#elif defined _MSC_VER
+        return _InterlockedCompareExchangePointer(target, desired, expected) == expected;
+#else
+        if (*target != expected) return false;
+        *target = desired;
+        return true;
+#endif
+    }
+
+    void* atomicLoad(void* const* target)
+    {
+#if defined __GNUC__ && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+        return __atomic_load_n(target, __ATOMIC_ACQUIRE);
+#elif defined __GNUC__
+        void* p = *const_cast<void* const volatile*>(target);
+        __sync_synchronize();
+        return p;
+#elif defined _MSC_VER
+        // Volatile reads have acquire semantics with MSVC
+        return *const_cast<void* const volatile*>(target);
+#else
+        return *target;
+#endif
+    }
+
+}}                                      // namespace Internal, Exiv2
@@ -0,0 +1,276 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2011 Andreas Huggel <ahuggel@gmx.net>
+ *
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*!
+  @file    arena_int.hpp
+  @brief   Memory arena for metadata decoded from an image
+  @version $Rev$
+  @author  Andreas Huggel (ahu)
+           <a href="mailto:ahuggel@gmx.net">ahuggel@gmx.net</a>
+  @date    19-Oct-26, ahu: created
+ */
+#ifndef ARENA_INT_HPP_
+#define ARENA_INT_HPP_
+
+// *****************************************************************************
+// included header files
+#include "types.hpp"
+
+// + standard includes
+#include <cstddef>
+
+// *****************************************************************************
+// namespace extensions
+namespace Exiv2 {
+    namespace Internal {
+
+// *****************************************************************************
+// class definitions
+
+    /*!
+      @brief Monotonic memory arena for the metadata objects of one image.
+
+      While an ArenaScope for an arena is active, Arena::allocate() takes
+      memory for values and keys from large blocks of the arena instead of
+      the global heap. Without an active scope, allocate() and deallocate()
+      are plain ::operator new and ::operator delete, nothing is added to
+      the allocations.
+
+      Memory is never reused individually. Each block counts the objects
+      allocated from it and is released when the last of them is deleted
+      and the arena has moved on to the next block or its scope has ended.
+      Objects can therefore safely outlive the image, e.g., in copies of
+      its metadata containers. The image does not own the arena: one object
+      which survives keeps the block it was allocated from alive.
+
+      The blocks of all arenas are registered, so that deallocate() can tell
+      memory from a block from memory from the heap. While no block exists,
+      this costs one atomic load.
+
+      Allocation is only done from the thread which activated the scope,
+      deallocation is thread-safe.
+
+      Each pool has its own current arena, so that the nodes of a TIFF
+      composite, which are freed after each parse, and the metadata decoded
+      at the same time do not share blocks.
+     */
+    class Arena {
+    public:
+        //! Pools with a separate current arena
+        enum Pool { metadataPool, tiffTreePool, poolCount };
+
+        /*!
+          @brief Allocate \em size bytes from the arena which is current for
+                 the calling thread in \em pool, or from the heap if there is
+                 none. Memory allocated with this function must be released
+                 with deallocate().
+         */
+        static void* allocate(std::size_t size, Pool pool =metadataPool);
+        //! Release memory obtained from allocate().
+        static void deallocate(void* p);
+
+    private:
+        friend class ArenaScope;
+
+        //! @name Creators
+        //@{
+        //! Default constructor.
+        Arena();
+        //! Destructor, releases the current block unless objects still use it.
+        ~Arena();
+        //@}
+
+        //! @name Manipulators
+        //@{
+        //! Allocate \em size bytes from the current block, add a block if necessary.
+        void* alloc(std::size_t size);
+        //! Hand the current block over to its objects, which release it.
+        void closeBlock();
+        //@}
+
+        // NOT implemented
+        //! Copy constructor
+        Arena(const Arena& rhs);
+        //! Assignment operator
+        Arena& operator=(const Arena& rhs);
+
+        // DATA
+        //! Size of the blocks
+        static const std::size_t blockSize_ = 16384;
+        //! Allocations larger than this are taken from the heap
+        static const std::size_t maxSize_ = 1024;
+
+        byte* pBlock_;                  //!< Current block, 0 if none
+        std::size_t used_;              //!< Number of bytes used in the current block
+        long allocated_;                //!< Number of allocations from the current block
+
+    }; // class Arena
+
+    /*!
+      @brief Make a new arena current for the calling thread for the lifetime
+             of the scope object. Used by Image::readMetadata()
+             implementations and by the TIFF parser for the nodes of its
+             trees. A disabled scope does nothing, in particular it leaves
+             an enclosing scope in effect.
+     */
+    class ArenaScope {
+    public:
+        //! @name Creators
+        //@{
+        /*!
+          @brief Constructor, creates a new arena and makes it current for
+                 \em pool if \em enable is true.
+         */
+        explicit ArenaScope(bool enable, Arena::Pool pool =Arena::metadataPool);
+        //! Destructor, restores the previously current arena.
+        ~ArenaScope();
+        //@}
+
+    private:
+        // NOT implemented
+        //! Copy constructor
+        ArenaScope(const ArenaScope& rhs);
+        //! Assignment operator
+        ArenaScope& operator=(const ArenaScope& rhs);
+
+        // DATA
+        Arena* pArena_;                 //!< The arena of this scope, 0 if disabled
+        Arena* pPrevious_;              //!< The arena current before the scope
+        Arena::Pool pool_;              //!< The pool of the arena
+
+    }; // class ArenaScope
+
+    /*!
+      @brief Reference-counted store for the raw data of deferred values, see
+             SharedValue::defer().
+
+      A store can take over the buffer with the data which is decoded, or
+      refer to the buffer of another store. Raw data within that buffer is
+      not copied, the values refer to it directly. Other data is copied to
+      chunks of the store. The data stays in place until the creator of the
+      store and all values which refer to it have released it.
+
+      Adding data which has to be copied is not thread-safe, each thread
+      needs a store of its own. Stores can refer to the same buffer.
+     */
+    class RawStore {
+    public:
+        //! @name Creators
+        //@{
+        //! Default constructor, for a store which copies all data. The caller holds the first reference.
+        RawStore();
+        //! Constructor, takes over the data of \em buf, which is left empty.
+        explicit RawStore(DataBuf& buf);
+        /*!
+          @brief Constructor, for a store which refers to the buffer of
+                 \em base and keeps \em base alive.
+         */
+        explicit RawStore(RawStore& base);
+        //@}
+
+        //! @name Manipulators
+        //@{
+        /*!
+          @brief Return a pointer to the \em size bytes at \em pData which
+                 stays valid as long as the store: \em pData itself if the
+                 data is in the buffer of the store, else a copy.
+         */
+        const byte* add(const byte* pData, long size);
+        //! Increment the reference count.
+        void addRef();
+        //! Decrement the reference count, delete the store if it drops to 0.
+        void release();
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return true if the \em size bytes at \em pData are in the buffer of the store.
+        bool contains(const byte* pData, uint64_t size) const;
+        //! Return a pointer to the buffer of the store, 0 if there is none.
+        const byte* pData() const { return pBuf_; }
+        //! Return the size of the buffer of the store.
+        long size() const { return bufSize_; }
+        //@}
+
+    private:
+        //! Destructor, releases all chunks. Use release() instead.
+        ~RawStore();
+        // NOT implemented
+        //! Copy constructor
+        RawStore(const RawStore& rhs);
+        //! Assignment operator
+        RawStore& operator=(const RawStore& rhs);
+
+        // DATA
+        //! Size of the chunks, larger data gets a chunk of its own
+        static const long chunkSize_ = 4096;
+        DataBuf buf_;                   //!< Buffer taken over by the store
+        RawStore* pBase_;               //!< Store whose buffer is referred to, 0 if none
+        const byte* pBuf_;              //!< Buffer of the store or of the base
+        long bufSize_;                  //!< Size of the buffer
+        byte* pChunks_;                 //!< Current chunk, links to the previous ones
+        long used_;                     //!< Number of bytes used in the current chunk
+        long refCount_;                 //!< Number of references to the store
+
+    }; // class RawStore
+
+// *****************************************************************************
+// free functions
+
+    //! Atomically increment \em count and return the new value.
+    long atomicIncrement(long& count);
+    //! Atomically decrement \em count and return the new value.
+    long atomicDecrement(long& count);
+    //! Atomically add \em n to \em count and return the new value.
+    long atomicAdd(long& count, long n);
+    /*!
+      @brief Atomically set \em *target to \em desired if it is equal to
+             \em expected. Return true if it was set.
+     */
+    bool atomicCompareAndSwap(void** target, void* expected, void* desired);
+    /*!
+      @brief Return the value of \em *target, with memory which was written
+             before it was set with atomicCompareAndSwap() visible.
+     */
+    void* atomicLoad(void* const* target);
+    /*!
+      @brief Return the value of \em *target, which is changed with
+             atomicIncrement(). Inline, as it is called for each size of a
+             TIFF component with a size cache.
+     */
+    inline long atomicLoad(const long* target)
+    {
+#if defined __GNUC__ && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+        return __atomic_load_n(target, __ATOMIC_ACQUIRE);
+#elif defined __GNUC__
+        long n = *const_cast<const volatile long*>(target);
+        __sync_synchronize();
+        return n;
+#elif defined _MSC_VER
+        // Volatile reads have acquire semantics with MSVC
+        return *const_cast<const volatile long*>(target);
+#else
+        return *target;
+#endif
+    }
+
+}}                                      // namespace Internal, Exiv2
+
+#endif                                  // #ifndef ARENA_INT_HPP_
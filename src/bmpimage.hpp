@@ -85,6 +85,7 @@ namespace Exiv2 {
         //! @name Manipulators
         //@{
         void readMetadata();
+        using Image::readMetadata;
         /*!
           @brief Todo: Write metadata back to the image. This method is not
               yet(?) implemented. Calling it will throw an Error(31).
@@ -95,11 +96,13 @@ namespace Exiv2 {
               an instance of Error(32).
          */
         void setExifData(const ExifData& exifData);
+        using Image::setExifData;
         /*!
           @brief Todo: Not supported yet(?). Calling this function will throw
               an instance of Error(32).
          */
         void setIptcData(const IptcData& iptcData);
+        using Image::setIptcData;
         /*!
           @brief Not supported. Calling this function will throw an instance
               of Error(32).
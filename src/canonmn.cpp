@@ -646,6 +646,9 @@ namespace Exiv2 {
         { 488, "Canon EF-S 15-85mm f/3.5-5.6 IS USM"                        }
     };
 
+    //! Index of the lens types, built once
+    const TagDetailsIndex canonCsLensTypeIndex(canonCsLensType, EXV_COUNTOF(canonCsLensType));
+
     //! A lens id and a pretty-print function for special treatment of the id.
     struct LensIdFct {
         long     id_;                           //!< Lens id
@@ -1184,9 +1187,8 @@ namespace Exiv2 {
             return os << value;
         }
 
-        ExifKey key("Exif.CanonCs.Lens");
-        ExifData::const_iterator pos = metadata->findKey(key);
-        if (   pos != metadata->end()
+        const Exifdatum* pos = findTag(*metadata, 0x0017, canonCsId); // Exif.CanonCs.Lens
+        if (   pos != 0
             && pos->value().count() >= 3
             && pos->value().typeId() == unsignedShort) {
             float fu = pos->value().toFloat(2);
@@ -1266,9 +1268,8 @@ namespace Exiv2 {
         LensTypeAndFocalLength ltfl;
         ltfl.lensType_ = value.toLong();
 
-        ExifKey key("Exif.CanonCs.Lens");
-        ExifData::const_iterator pos = metadata->findKey(key);
-        if (   pos != metadata->end()
+        const Exifdatum* pos = findTag(*metadata, 0x0017, canonCsId); // Exif.CanonCs.Lens
+        if (   pos != 0
             && pos->value().count() >= 3
             && pos->value().typeId() == unsignedShort) {
             float fu = pos->value().toFloat(2);
@@ -1287,9 +1288,13 @@ namespace Exiv2 {
         }
         if (ltfl.focalLength_.empty()) return os << value;
 
-        const TagDetails* td = find(canonCsLensType, ltfl);
-        if (!td) return os << value;
-        return os << td->label_;
+        // Only the lenses with the same lens type need to be compared
+        typedef TagDetailsIndex::Rows::const_iterator Iter;
+        std::pair<Iter, Iter> range = canonCsLensTypeIndex.equalRange(ltfl.lensType_);
+        for (Iter i = range.first; i != range.second; ++i) {
+            if (**i == ltfl) return os << (*i)->label_;
+        }
+        return os << value;
     }
 
     std::ostream& CanonMakerNote::printCsLensType(std::ostream& os,
@@ -1301,7 +1306,9 @@ namespace Exiv2 {
 
         const LensIdFct* lif = find(lensIdFct, value.toLong());
         if (!lif) {
-            return EXV_PRINT_TAG(canonCsLensType)(os, value, metadata);
+            const TagDetails* td = canonCsLensTypeIndex.find(value.toLong());
+            if (!td) return os << "(" << value << ")";
+            return os << exvGettext(td->label_);
         }
         if (metadata && lif->fct_) {
             return lif->fct_(os, value, metadata);
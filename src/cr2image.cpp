@@ -38,6 +38,8 @@ EXIV2_RCSID("@(#) $Id$")
 #endif
 
 #include "cr2image.hpp"
+#include "arena_int.hpp"
+#include "parsebudget_int.hpp"
 #include "cr2image_int.hpp"
 #include "tiffcomposite_int.hpp"
 #include "tiffimage_int.hpp"
@@ -106,6 +108,8 @@ namespace Exiv2 {
 
     void Cr2Image::readMetadata()
     {
+        Internal::ArenaScope arenaScope(useArena());
+        Internal::ParseBudgetScope budgetScope(parseLimits());
 #ifdef DEBUG
         std::cerr << "Reading CR2 file " << io_->path() << "\n";
 #endif
@@ -123,7 +127,8 @@ namespace Exiv2 {
                                          iptcData_,
                                          xmpData_,
                                          io_->mmap(),
-                                         io_->size());
+                                         io_->size(),
+                                         readOptions());
         setByteOrder(bo);
     } // Cr2Image::readMetadata
 
@@ -138,7 +143,8 @@ namespace Exiv2 {
               IptcData& iptcData,
               XmpData&  xmpData,
         const byte*     pData,
-              uint32_t  size
+              uint32_t  size,
+        const ReadOptions* pOptions
     )
     {
         Cr2Header cr2Header;
@@ -149,7 +155,8 @@ namespace Exiv2 {
                                         size,
                                         Tag::root,
                                         TiffMapping::findDecoder,
-                                        &cr2Header);
+                                        &cr2Header,
+                                        pOptions);
     }
 
     WriteMethod Cr2Parser::encode(
@@ -42,6 +42,8 @@ EXIV2_RCSID("@(#) $Id$")
 #endif
 
 #include "crwimage.hpp"
+#include "arena_int.hpp"
+#include "parsebudget_int.hpp"
 #include "crwimage_int.hpp"
 #include "error.hpp"
 #include "futils.hpp"
@@ -127,6 +129,8 @@ namespace Exiv2 {
 
     void CrwImage::readMetadata()
     {
+        Internal::ArenaScope arenaScope(useArena());
+        Internal::ParseBudgetScope budgetScope(parseLimits());
 #ifdef DEBUG
         std::cerr << "Reading CRW file " << io_->path() << "\n";
 #endif
@@ -446,7 +450,11 @@ namespace Exiv2 {
 #ifdef DEBUG
         std::cout << "Reading directory 0x" << std::hex << tag() << "\n";
 #endif
-        readDirectory(pData + offset(), this->size(), byteOrder);
+        ParseBudgetScope budgetScope;
+        if (budgetScope.budget().enter()) {
+            readDirectory(pData + offset(), this->size(), byteOrder);
+        }
+        budgetScope.budget().leave();
 #ifdef DEBUG
         std::cout << "<---- 0x" << std::hex << tag() << "\n";
 #endif
@@ -463,6 +471,9 @@ namespace Exiv2 {
         std::cout << "Directory at offset " << std::dec << o
                   <<", " << count << " entries \n";
 #endif
+        ParseBudgetScope budgetScope;
+        ParseBudget& budget = budgetScope.budget();
+        if (!budget.addComponents(count)) return;
         o += 2;
         for (uint16_t i = 0; i < count; ++i) {
             if (o + 10 > size) throw Error(33);
@@ -474,6 +485,8 @@ namespace Exiv2 {
             }
             m->setDir(this->tag());
             m->read(pData, size, o, byteOrder);
+            if (   CiffComponent::typeId(tag) != directory
+                && !budget.addValueBytes(m->size())) return;
             add(m);
             o += 10;
         }
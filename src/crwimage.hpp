@@ -87,12 +87,14 @@ namespace Exiv2 {
         //! @name Manipulators
         //@{
         void readMetadata();
+        using Image::readMetadata;
         void writeMetadata();
         /*!
           @brief Not supported. CRW format does not contain IPTC metadata.
               Calling this function will throw an Error(32).
          */
         void setIptcData(const IptcData& iptcData);
+        using Image::setIptcData;
         //@}
 
         //! @name Accessors
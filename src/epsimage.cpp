@@ -41,6 +41,8 @@ EXIV2_RCSID("@(#) $Id: epsimage.cpp $")
 # include "exv_conf.h"
 #endif
 #include "epsimage.hpp"
+#include "arena_int.hpp"
+#include "parsebudget_int.hpp"
 #include "image.hpp"
 #include "basicio.hpp"
 #include "error.hpp"
@@ -1051,6 +1053,8 @@ namespace Exiv2
 
     void EpsImage::readMetadata()
     {
+        Internal::ArenaScope arenaScope(useArena());
+        Internal::ParseBudgetScope budgetScope(parseLimits());
         #ifdef DEBUG
         EXV_DEBUG << "Exiv2::EpsImage::readMetadata: Reading EPS file " << io_->path() << "\n";
         #endif
@@ -1059,7 +1063,9 @@ namespace Exiv2
         readWriteEpsMetadata(*io_, xmpPacket_, nativePreviews_, /* write = */ false);
 
         // decode XMP metadata
-        if (xmpPacket_.size() > 0 && XmpParser::decode(xmpData_, xmpPacket_) > 1) {
+        if (   xmpPacket_.size() > 0
+            && (!readOptions() || readOptions()->selected(mdXmp))
+            && XmpParser::decode(xmpData_, xmpPacket_) > 1) {
             #ifndef SUPPRESS_WARNINGS
             EXV_WARNING << "Failed to decode XMP metadata.\n";
             #endif
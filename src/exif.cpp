@@ -183,6 +183,18 @@ namespace {
     //! Helper function to delete all tags of a specific IFD from the metadata.
     void eraseIfd(Exiv2::ExifData& ed, Exiv2::Internal::IfdId ifdId);
 
+    //! Return true if tag \em tag of IFD \em ifdId is the makernote or part of it.
+    bool isMakernoteTag(uint16_t tag, int ifdId);
+
+    /*!
+      @brief Remove large previews and other large tags from \em ed, which
+             does not fit into a JPEG Exif APP1 segment.
+     */
+    void filterLargeTags(Exiv2::ExifData& ed);
+
+    //! Warn about IPTC and XMP metadata in Exif data, which is ignored.
+    void warnEmbedded(const Exiv2::IptcData& iptcData, const Exiv2::XmpData& xmpData);
+
 }
 
 // *****************************************************************************
@@ -205,7 +217,7 @@ namespace Exiv2 {
         std::auto_ptr<Exiv2::ValueType<T> > v
             = std::auto_ptr<Exiv2::ValueType<T> >(new Exiv2::ValueType<T>);
         v->value_.push_back(value);
-        exifDatum.value_ = v;
+        exifDatum.value_ = Value::AutoPtr(v);
         return exifDatum;
     }
 
@@ -215,15 +227,19 @@ namespace Exiv2 {
         if (pValue) value_ = pValue->clone();
     }
 
+    Exifdatum::Exifdatum(const ExifKey& key, const SharedValue& value)
+        : key_(key.clone()), value_(value)
+    {
+    }
+
     Exifdatum::~Exifdatum()
     {
     }
 
     Exifdatum::Exifdatum(const Exifdatum& rhs)
-        : Metadatum(rhs)
+        : Metadatum(rhs), value_(rhs.value_) // shared value
     {
         if (rhs.key_.get() != 0) key_ = rhs.key_->clone(); // deep copy
-        if (rhs.value_.get() != 0) value_ = rhs.value_->clone(); // deep copy
     }
 
     std::ostream& Exifdatum::write(std::ostream& os, const ExifData* pMetadata) const
@@ -249,12 +265,19 @@ namespace Exiv2 {
         key_.reset();
         if (rhs.key_.get() != 0) key_ = rhs.key_->clone(); // deep copy
 
-        value_.reset();
-        if (rhs.value_.get() != 0) value_ = rhs.value_->clone(); // deep copy
+        value_ = rhs.value_; // shared value
 
         return *this;
     } // Exifdatum::operator=
 
+    void Exifdatum::swap(Exifdatum& rhs)
+    {
+        ExifKey::AutoPtr key = key_;
+        key_ = rhs.key_;
+        rhs.key_ = key;
+        value_.swap(rhs.value_);
+    }
+
     Exifdatum& Exifdatum::operator=(const std::string& value)
     {
         setValue(value);
@@ -309,12 +332,12 @@ namespace Exiv2 {
             TypeId type = key_->defaultTypeId();
             value_ = Value::create(type);
         }
-        return value_->read(value);
+        return value_.modify()->read(value);
     }
 
     int Exifdatum::setDataArea(const byte* buf, long len)
     {
-        return value_.get() == 0 ? -1 : value_->setDataArea(buf, len);
+        return value_.empty() ? -1 : value_.modify()->setDataArea(buf, len);
     }
 
     std::string Exifdatum::key() const
@@ -369,7 +392,7 @@ namespace Exiv2 {
 
     TypeId Exifdatum::typeId() const
     {
-        return value_.get() == 0 ? invalidTypeId : value_->typeId();
+        return value_.typeId();
     }
 
     const char* Exifdatum::typeName() const
@@ -384,12 +407,12 @@ namespace Exiv2 {
 
     long Exifdatum::count() const
     {
-        return value_.get() == 0 ? 0 : value_->count();
+        return value_.count();
     }
 
     long Exifdatum::size() const
     {
-        return value_.get() == 0 ? 0 : value_->size();
+        return value_.size();
     }
 
     std::string Exifdatum::toString() const
@@ -560,6 +583,33 @@ namespace Exiv2 {
         eraseIfd(exifData_, ifd1Id);
     }
 
+    ExifData::ExifData()
+        : pMnSpan_(0), mnCount_(0), mnModified_(false)
+    {
+    }
+
+    ExifData::ExifData(const ExifData& rhs)
+        : exifMetadata_(rhs.exifMetadata_),
+          pMnSpan_(rhs.pMnSpan_),
+          mnCount_(rhs.mnCount_),
+          mnModified_(rhs.mnModified_)
+    {
+        if (pMnSpan_ != 0) pMnSpan_->addRef();
+    }
+
+    ExifData::~ExifData()
+    {
+        if (pMnSpan_ != 0) pMnSpan_->release();
+    }
+
+    ExifData& ExifData::operator=(const ExifData& rhs)
+    {
+        if (this == &rhs) return *this;
+        ExifData tmp(rhs);
+        swap(tmp);
+        return *this;
+    }
+
     Exifdatum& ExifData::operator[](const std::string& key)
     {
         ExifKey exifKey(key);
@@ -578,10 +628,34 @@ namespace Exiv2 {
 
     void ExifData::add(const Exifdatum& exifdatum)
     {
+        if (isMakernoteTag(exifdatum.tag(), exifdatum.ifdId())) {
+            parseMakernote();
+            const IfdId ifdId = static_cast<IfdId>(exifdatum.ifdId());
+            if (ifdId != Internal::mnId && Internal::isMakerIfd(ifdId)) mnModified_ = true;
+        }
         // allow duplicates
         exifMetadata_.push_back(exifdatum);
     }
 
+#ifdef EXV_HAVE_RVALUE_REFERENCES
+    void ExifData::add(Exifdatum&& exifdatum)
+    {
+        if (isMakernoteTag(exifdatum.tag(), exifdatum.ifdId())) {
+            parseMakernote();
+            const IfdId ifdId = static_cast<IfdId>(exifdatum.ifdId());
+            if (ifdId != Internal::mnId && Internal::isMakerIfd(ifdId)) mnModified_ = true;
+        }
+        exifMetadata_.push_back(std::move(exifdatum));
+    }
+#endif
+
+    void ExifData::append(ExifData& exifData)
+    {
+        parseMakernote();
+        exifData.parseMakernote();
+        exifMetadata_.splice(exifMetadata_.end(), exifData.exifMetadata_);
+    }
+
     ExifData::const_iterator ExifData::findKey(const ExifKey& key) const
     {
         return std::find_if(exifMetadata_.begin(), exifMetadata_.end(),
@@ -597,18 +671,94 @@ namespace Exiv2 {
     void ExifData::clear()
     {
         exifMetadata_.clear();
+        setMakernote(0);
+        mnCount_ = 0;
+        mnModified_ = false;
+    }
+
+    void ExifData::swap(ExifData& rhs)
+    {
+        exifMetadata_.swap(rhs.exifMetadata_);
+        std::swap(pMnSpan_, rhs.pMnSpan_);
+        std::swap(mnCount_, rhs.mnCount_);
+        std::swap(mnModified_, rhs.mnModified_);
+    }
+
+    bool ExifData::makernoteModified() const
+    {
+        if (mnModified_) return true;
+        if (pMnSpan_ != 0) return false;
+
+        // Makernote tags are unchanged if they are all there, still refer
+        // to the raw data they were decoded from and this data is shared
+        long count = 0;
+        bool hasMakernote = false;
+        const Internal::RawStore* pStore = 0;
+        for (const_iterator i = exifMetadata_.begin(); i != exifMetadata_.end(); ++i) {
+            const IfdId ifdId = static_cast<IfdId>(i->ifdId());
+            if (i->tag() == 0x927c && ifdId == Internal::exifId) {
+                if (i->value_.rawStore() == 0) return true;
+                hasMakernote = true;
+                continue;
+            }
+            if (ifdId == Internal::mnId || !Internal::isMakerIfd(ifdId)) continue;
+            const Internal::RawStore* p = i->value_.rawStore();
+            if (p == 0 || (pStore != 0 && p != pStore)) return true;
+            pStore = p;
+            ++count;
+        }
+        return count != mnCount_ || (count > 0 && !hasMakernote);
     }
 
     void ExifData::sortByKey()
     {
+        parseMakernote();
         exifMetadata_.sort(cmpMetadataByKey);
     }
 
     void ExifData::sortByTag()
     {
+        parseMakernote();
         exifMetadata_.sort(cmpMetadataByTag);
     }
 
+    void ExifData::setMakernote(Internal::TiffMnSpan* pMnSpan)
+    {
+        if (pMnSpan_ != 0) pMnSpan_->release();
+        pMnSpan_ = pMnSpan;
+    }
+
+    void ExifData::decodeMakernote()
+    {
+        // Reset the makernote first, decoding adds metadata to this container
+        Internal::TiffMnSpan* pMnSpan = pMnSpan_;
+        pMnSpan_ = 0;
+        try {
+            pMnSpan->decode(*this);
+        }
+        catch (const AnyError& error) {
+#ifndef SUPPRESS_WARNINGS
+            EXV_WARNING << "Failed to decode the makernote: " << error << "\n";
+#endif
+        }
+        catch (...) {
+            pMnSpan->release();
+            throw;
+        }
+        pMnSpan->release();
+        setMakernoteCount();
+    }
+
+    void ExifData::setMakernoteCount()
+    {
+        mnCount_ = 0;
+        for (const_iterator i = exifMetadata_.begin(); i != exifMetadata_.end(); ++i) {
+            const IfdId ifdId = static_cast<IfdId>(i->ifdId());
+            if (ifdId != Internal::mnId && Internal::isMakerIfd(ifdId)) ++mnCount_;
+        }
+        mnModified_ = false;
+    }
+
     ExifData::iterator ExifData::erase(ExifData::iterator beg, ExifData::iterator end)
     {
         return exifMetadata_.erase(beg, end);
@@ -622,7 +772,8 @@ namespace Exiv2 {
     ByteOrder ExifParser::decode(
               ExifData& exifData,
         const byte*     pData,
-              uint32_t  size
+              uint32_t  size,
+        const ReadOptions* pOptions
     )
     {
         IptcData iptcData;
@@ -631,25 +782,22 @@ namespace Exiv2 {
                                           iptcData,
                                           xmpData,
                                           pData,
-                                          size);
-#ifndef SUPPRESS_WARNINGS
-        if (!iptcData.empty()) {
-            EXV_WARNING << "Ignoring IPTC information encoded in the Exif data.\n";
-        }
-        if (!xmpData.empty()) {
-            EXV_WARNING << "Ignoring XMP information encoded in the Exif data.\n";
-        }
-#endif
+                                          size,
+                                          pOptions);
+        warnEmbedded(iptcData, xmpData);
         return bo;
     } // ExifParser::decode
 
-    //! @cond IGNORE
-    enum Ptt { pttLen, pttTag, pttIfd };
-    struct PreviewTags {
-        Ptt ptt_;
-        const char* key_;
-    };
-    //! @endcond
+    ByteOrder Internal::decodeExif(ExifData&          exifData,
+                                   DataBuf&           buf,
+                                   const ReadOptions* pOptions)
+    {
+        IptcData iptcData;
+        XmpData  xmpData;
+        ByteOrder bo = decodeTiff(exifData, iptcData, xmpData, buf, 0, pOptions);
+        warnEmbedded(iptcData, xmpData);
+        return bo;
+    } // Internal::decodeExif
 
     WriteMethod ExifParser::encode(
               Blob&     blob,
@@ -709,10 +857,11 @@ namespace Exiv2 {
         IptcData emptyIptc;
         XmpData  emptyXmp;
 
-        // Encode and check if the result fits into a JPEG Exif APP1 segment
-        MemIo mio1;
+        // Encode, drop large tags first if the result would not fit into a
+        // JPEG Exif APP1 segment
+        MemIo mio;
         std::auto_ptr<TiffHeaderBase> header(new TiffHeader(byteOrder, 0x00000008, false));
-        WriteMethod wm = TiffParserWorker::encode(mio1,
+        WriteMethod wm = TiffParserWorker::encode(mio,
                                                   pData,
                                                   size,
                                                   ed,
@@ -720,108 +869,36 @@ namespace Exiv2 {
                                                   emptyXmp,
                                                   Tag::root,
                                                   TiffMapping::findEncoder,
-                                                  header.get());
-        if (mio1.size() <= 65527) {
-            append(blob, mio1.mmap(), mio1.size());
-            return wm;
-        }
-
-        // If it doesn't fit, remove additional tags
-
-        // Delete preview tags if the preview is larger than 32kB.
-        // Todo: Enhance preview classes to be able to write and delete previews and use that instead.
-        // Table must be sorted by preview, the first tag in each group is the size
-        static const PreviewTags filteredPvTags[] = {
-            { pttLen, "Exif.Minolta.ThumbnailLength"                  },
-            { pttTag, "Exif.Minolta.ThumbnailOffset"                  },
-            { pttLen, "Exif.Minolta.Thumbnail"                        },
-            { pttLen, "Exif.NikonPreview.JPEGInterchangeFormatLength" },
-            { pttIfd, "NikonPreview"                                  },
-            { pttLen, "Exif.Olympus.ThumbnailLength"                  },
-            { pttTag, "Exif.Olympus.ThumbnailOffset"                  },
-            { pttLen, "Exif.Olympus.ThumbnailImage"                   },
-            { pttLen, "Exif.Olympus.Thumbnail"                        },
-            { pttLen, "Exif.Olympus2.ThumbnailLength"                 },
-            { pttTag, "Exif.Olympus2.ThumbnailOffset"                 },
-            { pttLen, "Exif.Olympus2.ThumbnailImage"                  },
-            { pttLen, "Exif.Olympus2.Thumbnail"                       },
-            { pttLen, "Exif.OlympusCs.PreviewImageLength"             },
-            { pttTag, "Exif.OlympusCs.PreviewImageStart"              },
-            { pttTag, "Exif.OlympusCs.PreviewImageValid"              },
-            { pttLen, "Exif.Pentax.PreviewLength"                     },
-            { pttTag, "Exif.Pentax.PreviewOffset"                     },
-            { pttTag, "Exif.Pentax.PreviewResolution"                 },
-            { pttLen, "Exif.Thumbnail.StripByteCounts"                },
-            { pttIfd, "Thumbnail"                                     },
-            { pttLen, "Exif.Thumbnail.JPEGInterchangeFormatLength"    },
-            { pttIfd, "Thumbnail"                                     }
-        };
-        bool delTags = false;
-        ExifData::iterator pos;
-        for (unsigned int i = 0; i < EXV_COUNTOF(filteredPvTags); ++i) {
-            switch (filteredPvTags[i].ptt_) {
-            case pttLen:
-                delTags = false;
-                pos = ed.findKey(ExifKey(filteredPvTags[i].key_));
-                if (pos != ed.end() && sumToLong(*pos) > 32768) {
-                    delTags = true;
-#ifndef SUPPRESS_WARNINGS
-                    EXV_WARNING << "Exif tag " << pos->key() << " not encoded\n";
-#endif
-                    ed.erase(pos);
-                }
-                break;
-            case pttTag:
-                if (delTags) {
-                    pos = ed.findKey(ExifKey(filteredPvTags[i].key_));
-                    if (pos != ed.end()) {
-#ifndef SUPPRESS_WARNINGS
-                        EXV_WARNING << "Exif tag " << pos->key() << " not encoded\n";
-#endif
-                        ed.erase(pos);
-                    }
-                }
-                break;
-            case pttIfd:
-                if (delTags) {
-#ifndef SUPPRESS_WARNINGS
-                    EXV_WARNING << "Exif IFD " << filteredPvTags[i].key_ << " not encoded\n";
-#endif
-                    eraseIfd(ed, Internal::groupId(filteredPvTags[i].key_));
-                }
-                break;
-            }
+                                                  header.get(),
+                                                  65527,
+                                                  filterLargeTags);
+        // Check the final result, a non-intrusive write leaves the data in
+        // place with its original size
+        if ((wm == wmIntrusive ? mio.size() : size) > 65527) {
+            // Remove the large tags and write a new TIFF structure, don't
+            // care if it fits this time
+            filterLargeTags(ed);
+            MemIo mio2;
+            wm = TiffParserWorker::encode(mio2,
+                                          pData,
+                                          size,
+                                          ed,
+                                          emptyIptc,
+                                          emptyXmp,
+                                          Tag::root,
+                                          TiffMapping::findEncoder,
+                                          header.get(),
+                                          0,
+                                          0,
+                                          twCompact);
+            append(blob, mio2.mmap(), mio2.size());
         }
-
-        // Delete unknown tags larger than 4kB and known tags larger than 40kB.
-        for (ExifData::iterator pos = ed.begin(); pos != ed.end(); ) {
-            if (   (pos->size() > 4096 && pos->tagName().substr(0, 2) == "0x")
-                || pos->size() > 40960) {
-#ifndef SUPPRESS_WARNINGS
-                EXV_WARNING << "Exif tag " << pos->key() << " not encoded\n";
-#endif
-                pos = ed.erase(pos);
-            }
-            else {
-                ++pos;
-            }
+        else {
+            append(blob, mio.mmap(), mio.size());
         }
-
-        // Encode the remaining Exif tags again, don't care if it fits this time
-        MemIo mio2;
-        wm = TiffParserWorker::encode(mio2,
-                                      pData,
-                                      size,
-                                      ed,
-                                      emptyIptc,
-                                      emptyXmp,
-                                      Tag::root,
-                                      TiffMapping::findEncoder,
-                                      header.get());
-        append(blob, mio2.mmap(), mio2.size());
 #ifdef DEBUG
         if (wm == wmIntrusive) {
-            std::cerr << "SIZE OF EXIF DATA IS " << std::dec << io.size() << " BYTES\n";
+            std::cerr << "SIZE OF EXIF DATA IS " << std::dec << blob.size() << " BYTES\n";
         }
         else {
             std::cerr << "SIZE DOESN'T MATTER, NON-INTRUSIVE WRITING USED\n";
@@ -939,5 +1016,118 @@ namespace {
                                 Exiv2::FindExifdatum(ifdId)),
                  ed.end());
     }
+
+    bool isMakernoteTag(uint16_t tag, int ifdId)
+    {
+        return    Exiv2::Internal::isMakerIfd(static_cast<Exiv2::Internal::IfdId>(ifdId))
+               || (tag == 0x927c && ifdId == Exiv2::Internal::exifId);
+    }
+
+    enum Ptt { pttLen, pttTag, pttIfd };
+    struct PreviewTags {
+        Ptt ptt_;
+        const char* key_;
+    };
+
+    void warnEmbedded(const Exiv2::IptcData& iptcData, const Exiv2::XmpData& xmpData)
+    {
+#ifndef SUPPRESS_WARNINGS
+        using namespace Exiv2;
+
+        if (!iptcData.empty()) {
+            EXV_WARNING << "Ignoring IPTC information encoded in the Exif data.\n";
+        }
+        if (!xmpData.empty()) {
+            EXV_WARNING << "Ignoring XMP information encoded in the Exif data.\n";
+        }
+#else
+        (void)iptcData;
+        (void)xmpData;
+#endif
+    }
+
+    void filterLargeTags(Exiv2::ExifData& ed)
+    {
+        using namespace Exiv2;
+
+        // Delete preview tags if the preview is larger than 32kB.
+        // Todo: Enhance preview classes to be able to write and delete previews and use that instead.
+        // Table must be sorted by preview, the first tag in each group is the size
+        static const PreviewTags filteredPvTags[] = {
+            { pttLen, "Exif.Minolta.ThumbnailLength"                  },
+            { pttTag, "Exif.Minolta.ThumbnailOffset"                  },
+            { pttLen, "Exif.Minolta.Thumbnail"                        },
+            { pttLen, "Exif.NikonPreview.JPEGInterchangeFormatLength" },
+            { pttIfd, "NikonPreview"                                  },
+            { pttLen, "Exif.Olympus.ThumbnailLength"                  },
+            { pttTag, "Exif.Olympus.ThumbnailOffset"                  },
+            { pttLen, "Exif.Olympus.ThumbnailImage"                   },
+            { pttLen, "Exif.Olympus.Thumbnail"                        },
+            { pttLen, "Exif.Olympus2.ThumbnailLength"                 },
+            { pttTag, "Exif.Olympus2.ThumbnailOffset"                 },
+            { pttLen, "Exif.Olympus2.ThumbnailImage"                  },
+            { pttLen, "Exif.Olympus2.Thumbnail"                       },
+            { pttLen, "Exif.OlympusCs.PreviewImageLength"             },
+            { pttTag, "Exif.OlympusCs.PreviewImageStart"              },
+            { pttTag, "Exif.OlympusCs.PreviewImageValid"              },
+            { pttLen, "Exif.Pentax.PreviewLength"                     },
+            { pttTag, "Exif.Pentax.PreviewOffset"                     },
+            { pttTag, "Exif.Pentax.PreviewResolution"                 },
+            { pttLen, "Exif.Thumbnail.StripByteCounts"                },
+            { pttIfd, "Thumbnail"                                     },
+            { pttLen, "Exif.Thumbnail.JPEGInterchangeFormatLength"    },
+            { pttIfd, "Thumbnail"                                     }
+        };
+        bool delTags = false;
+        ExifData::iterator pos;
+        for (unsigned int i = 0; i < EXV_COUNTOF(filteredPvTags); ++i) {
+            switch (filteredPvTags[i].ptt_) {
+            case pttLen:
+                delTags = false;
+                pos = ed.findKey(ExifKey(filteredPvTags[i].key_));
+                if (pos != ed.end() && sumToLong(*pos) > 32768) {
+                    delTags = true;
+#ifndef SUPPRESS_WARNINGS
+                    EXV_WARNING << "Exif tag " << pos->key() << " not encoded\n";
+#endif
+                    ed.erase(pos);
+                }
+                break;
+            case pttTag:
+                if (delTags) {
+                    pos = ed.findKey(ExifKey(filteredPvTags[i].key_));
+                    if (pos != ed.end()) {
+#ifndef SUPPRESS_WARNINGS
+                        EXV_WARNING << "Exif tag " << pos->key() << " not encoded\n";
+#endif
+                        ed.erase(pos);
+                    }
+                }
+                break;
+            case pttIfd:
+                if (delTags) {
+#ifndef SUPPRESS_WARNINGS
+                    EXV_WARNING << "Exif IFD " << filteredPvTags[i].key_ << " not encoded\n";
+#endif
+                    eraseIfd(ed, Internal::groupId(filteredPvTags[i].key_));
+                }
+                break;
+            }
+        }
+
+        // Delete unknown tags larger than 4kB and known tags larger than 40kB.
+        for (ExifData::iterator pos = ed.begin(); pos != ed.end(); ) {
+            if (   (pos->size() > 4096 && pos->tagName().substr(0, 2) == "0x")
+                || pos->size() > 40960) {
+#ifndef SUPPRESS_WARNINGS
+                EXV_WARNING << "Exif tag " << pos->key() << " not encoded\n";
+#endif
+                pos = ed.erase(pos);
+            }
+            else {
+                ++pos;
+            }
+        }
+    } // filterLargeTags
     //! @endcond
 }
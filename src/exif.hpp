@@ -52,6 +52,11 @@ namespace Exiv2 {
 // *****************************************************************************
 // class declarations
     class ExifData;
+    namespace Internal {
+        class TiffMnSpan;
+        class TiffDecoder;
+        class TiffEncoder;
+    }
 
 // *****************************************************************************
 // class definitions
@@ -62,6 +67,7 @@ namespace Exiv2 {
      */
     class EXIV2API Exifdatum : public Metadatum {
         template<typename T> friend Exifdatum& setValue(Exifdatum&, const T&);
+        friend class ExifData;
     public:
         //! @name Creators
         //@{
@@ -77,8 +83,17 @@ namespace Exiv2 {
           @throw Error if the key cannot be parsed and converted.
          */
         explicit Exifdatum(const ExifKey& key, const Value* pValue =0);
+        /*!
+          @brief Constructor for a %Exifdatum which shares \em value, which
+                 may be deferred. Used by the decoders.
+         */
+        Exifdatum(const ExifKey& key, const SharedValue& value);
         //! Copy constructor
         Exifdatum(const Exifdatum& rhs);
+#ifdef EXV_HAVE_RVALUE_REFERENCES
+        //! Move constructor, leaves \em rhs without key and value
+        Exifdatum(Exifdatum&& rhs) noexcept : Metadatum(rhs) { swap(rhs); }
+#endif
         //! Destructor
         virtual ~Exifdatum();
         //@}
@@ -87,6 +102,12 @@ namespace Exiv2 {
         //@{
         //! Assignment operator
         Exifdatum& operator=(const Exifdatum& rhs);
+#ifdef EXV_HAVE_RVALUE_REFERENCES
+        //! Move assignment operator, exchanges key and value with \em rhs
+        Exifdatum& operator=(Exifdatum&& rhs) noexcept { swap(rhs); return *this; }
+#endif
+        //! Exchange key and value with \em rhs, without copying either.
+        void swap(Exifdatum& rhs);
         /*!
           @brief Assign \em value to the %Exifdatum. The type of the new Value
                  is set to UShortValue.
@@ -218,7 +239,7 @@ namespace Exiv2 {
     private:
         // DATA
         ExifKey::AutoPtr key_;                  //!< Key
-        Value::AutoPtr   value_;                //!< Value
+        SharedValue      value_;                //!< Value, shared between copies
 
     }; // class Exifdatum
 
@@ -434,14 +455,36 @@ namespace Exiv2 {
       - write Exif data to JPEG files
       - extract Exif metadata to files, insert from these files
       - extract and delete Exif thumbnail (JPEG and TIFF thumbnails)
+
+      If the makernote was not parsed when the image was read (see
+      ReadOptions::deferMakernote_), the container holds no makernote tags
+      until parseMakernote() is called. Adding a makernote tag, appending
+      and sorting parse it too. Const member functions never do.
     */
     class EXIV2API ExifData {
+        friend class Internal::TiffDecoder;
+        friend class Internal::TiffEncoder;
     public:
         //! ExifMetadata iterator type
         typedef ExifMetadata::iterator iterator;
         //! ExifMetadata const iterator type
         typedef ExifMetadata::const_iterator const_iterator;
 
+        //! @name Creators
+        //@{
+        //! Default constructor
+        ExifData();
+        //! Copy constructor, a deferred makernote is shared with \em rhs
+        ExifData(const ExifData& rhs);
+#ifdef EXV_HAVE_RVALUE_REFERENCES
+        //! Move constructor, leaves \em rhs empty
+        ExifData(ExifData&& rhs) noexcept
+            : pMnSpan_(0), mnCount_(0), mnModified_(false) { swap(rhs); }
+#endif
+        //! Destructor
+        ~ExifData();
+        //@}
+
         //! @name Manipulators
         //@{
         /*!
@@ -453,6 +496,12 @@ namespace Exiv2 {
                  member function.
          */
         Exifdatum& operator[](const std::string& key);
+        //! Assignment operator
+        ExifData& operator=(const ExifData& rhs);
+#ifdef EXV_HAVE_RVALUE_REFERENCES
+        //! Move assignment operator, exchanges the metadata with \em rhs
+        ExifData& operator=(ExifData&& rhs) noexcept { swap(rhs); return *this; }
+#endif
         /*!
           @brief Add an Exifdatum from the supplied key and value pair.  This
                  method copies (clones) key and value. No duplicate checks are
@@ -468,6 +517,19 @@ namespace Exiv2 {
           @throw Error if the makernote cannot be created
          */
         void add(const Exifdatum& exifdatum);
+#ifdef EXV_HAVE_RVALUE_REFERENCES
+        /*!
+          @brief Move the \em exifdatum to the end of the Exif metadata. No
+                 duplicate checks are performed.
+         */
+        void add(Exifdatum&& exifdatum);
+#endif
+        /*!
+          @brief Move all metadata from \em exifData to the end of this
+                 container, leaving \em exifData empty. No metadatum is
+                 copied and no duplicate checks are performed.
+         */
+        void append(ExifData& exifData);
         /*!
           @brief Delete the Exifdatum at iterator position \em pos, return the
                  position of the next exifdatum. Note that iterators into
@@ -486,10 +548,18 @@ namespace Exiv2 {
                  Note that this also removes thumbnails.
          */
         void clear();
+        //! Exchange the contents with those of \em rhs, without copying any metadata.
+        void swap(ExifData& rhs);
         //! Sort metadata by key
         void sortByKey();
         //! Sort metadata by tag
         void sortByTag();
+        /*!
+          @brief Parse the makernote if its parsing was deferred and add its
+                 metadata to the end of the container. Does nothing if the
+                 makernote is already parsed.
+         */
+        void parseMakernote() { if (pMnSpan_ != 0) decodeMakernote(); }
         //! Begin of the metadata
         iterator begin() { return exifMetadata_.begin(); }
         //! End of the metadata
@@ -503,6 +573,8 @@ namespace Exiv2 {
 
         //! @name Accessors
         //@{
+        //! Return true if the makernote is not parsed yet, see parseMakernote()
+        bool deferredMakernote() const { return pMnSpan_ != 0; }
         //! Begin of the metadata
         const_iterator begin() const { return exifMetadata_.begin(); }
         //! End of the metadata
@@ -513,14 +585,32 @@ namespace Exiv2 {
          */
         const_iterator findKey(const ExifKey& key) const;
         //! Return true if there is no Exif metadata
-        bool empty() const { return count() == 0; }
+        bool empty() const { return exifMetadata_.empty() && pMnSpan_ == 0; }
         //! Get the number of metadata entries
         long count() const { return static_cast<long>(exifMetadata_.size()); }
+        /*!
+          @brief Return true if makernote tags were added, deleted or
+                 modified since the metadata was read, or if the makernote
+                 tag Exif.Photo.MakerNote was modified. Unchanged makernotes
+                 are written as they were read. Does not parse a deferred
+                 makernote.
+         */
+        bool makernoteModified() const;
         //@}
 
     private:
+        //! Set the makernote to parse when it is needed, takes ownership of one reference
+        void setMakernote(Internal::TiffMnSpan* pMnSpan);
+        //! Parse the deferred makernote
+        void decodeMakernote();
+        //! Remember the number of makernote tags as decoded, see makernoteModified()
+        void setMakernoteCount();
+
         // DATA
         ExifMetadata exifMetadata_;
+        Internal::TiffMnSpan* pMnSpan_; //!< Makernote which is not parsed yet
+        long mnCount_;                  //!< Number of makernote tags as decoded
+        bool mnModified_;               //!< True if a makernote tag was added
 
     }; // class ExifData
 
@@ -543,12 +633,15 @@ namespace Exiv2 {
           @param pData 	  Pointer to the data buffer. Must point to data in
                           binary Exif format; no checks are performed.
           @param size 	  Length of the data buffer
+          @param pOptions Optional selection of the metadata to decode, see
+                          Image::readMetadata(const ReadOptions&).
           @return Byte order in which the data is encoded.
         */
         static ByteOrder decode(
                   ExifData& exifData,
             const byte*     pData,
-                  uint32_t  size
+                  uint32_t  size,
+            const ReadOptions* pOptions =0
         );
         /*!
           @brief Encode Exif metadata from the provided metadata to binary Exif
@@ -131,6 +131,17 @@ namespace {
         { ImageType::none, 0,               0,          amNone,      amNone,      amNone,      amNone      }
     };
 
+    //! Erase all metadata from \em data which is not selected by \em options.
+    template<typename T>
+    void filterMetadata(T& data, const ReadOptions& options)
+    {
+        typename T::iterator i = data.begin();
+        while (i != data.end()) {
+            if (options.selected(*i)) ++i;
+            else i = data.erase(i);
+        }
+    }
+
 }
 
 // *****************************************************************************
@@ -150,7 +161,9 @@ namespace Exiv2 {
 #else
           writeXmpFromPacket_(true),
 #endif
-          byteOrder_(invalidByteOrder)
+          byteOrder_(invalidByteOrder),
+          useArena_(false),
+          pReadOptions_(0)
     {
     }
 
@@ -204,11 +217,75 @@ namespace Exiv2 {
         }
     }
 
+    void Image::adoptExifData(ExifData& exifData)
+    {
+        if (checkMode(mdExif) & amWrite) {
+            exifData_.clear();
+            exifData_.swap(exifData);
+        }
+        else {
+            setExifData(exifData);
+            exifData.clear();
+        }
+    }
+
+    void Image::adoptIptcData(IptcData& iptcData)
+    {
+        if (checkMode(mdIptc) & amWrite) {
+            iptcData_.clear();
+            iptcData_.swap(iptcData);
+        }
+        else {
+            setIptcData(iptcData);
+            iptcData.clear();
+        }
+    }
+
+    void Image::adoptXmpData(XmpData& xmpData)
+    {
+        if (checkMode(mdXmp) & amWrite) {
+            xmpData_.clear();
+            xmpData_.swap(xmpData);
+            writeXmpFromPacket(false);
+        }
+        else {
+            setXmpData(xmpData);
+            xmpData.clear();
+        }
+    }
+
+    ExifData Image::takeExifData()
+    {
+        ExifData exifData;
+        exifData.swap(exifData_);
+        return exifData;
+    }
+
+    IptcData Image::takeIptcData()
+    {
+        IptcData iptcData;
+        iptcData.swap(iptcData_);
+        return iptcData;
+    }
+
+    XmpData Image::takeXmpData()
+    {
+        XmpData xmpData;
+        xmpData.swap(xmpData_);
+        writeXmpFromPacket(false);
+        return xmpData;
+    }
+
     void Image::clearExifData()
     {
         exifData_.clear();
     }
 
+    bool Image::patchInPlace(const ExifKey& /*key*/, const Value& /*value*/)
+    {
+        return false;
+    }
+
     void Image::setExifData(const ExifData& exifData)
     {
         exifData_ = exifData;
@@ -320,6 +397,61 @@ namespace Exiv2 {
         return writeXmpFromPacket_;
     }
 
+    void Image::setUseArena(bool flag)
+    {
+        useArena_ = flag;
+    }
+
+    bool Image::useArena() const
+    {
+        return useArena_;
+    }
+
+    void Image::setParseLimits(const ParseLimits& limits)
+    {
+        parseLimits_ = limits;
+    }
+
+    const ParseLimits& Image::parseLimits() const
+    {
+        return parseLimits_;
+    }
+
+    Manufacturer Image::manufacturer() const
+    {
+        ExifData::const_iterator pos = exifData_.findKey(ExifKey("Exif.Image.Make"));
+        if (pos == exifData_.end()) return mfUnknown;
+        return Exiv2::manufacturer(pos->toString());
+    }
+
+    void Image::readMetadata(const ReadOptions& options)
+    {
+        pReadOptions_ = &options;
+        try {
+            readMetadata();
+        }
+        catch (...) {
+            pReadOptions_ = 0;
+            throw;
+        }
+        pReadOptions_ = 0;
+
+        // Remove the metadata which the parsers did not skip themselves
+        // A deferred makernote comes from the TIFF parser, which selects the
+        // Exif metadata itself, and is filtered when it is parsed
+        if (   !options.selectedAll(mdExif)
+            && !exifData_.deferredMakernote()) filterMetadata(exifData_, options);
+        if (!options.selectedAll(mdIptc)) filterMetadata(iptcData_, options);
+        if (!options.selectedAll(mdXmp))  filterMetadata(xmpData_, options);
+        if (!options.selected(mdXmp)) xmpPacket_.clear();
+        if (!options.selected(mdComment)) comment_.clear();
+    }
+
+    const ReadOptions* Image::readOptions() const
+    {
+        return pReadOptions_;
+    }
+
     const NativePreviewList& Image::nativePreviews() const
     {
         return nativePreviews_;
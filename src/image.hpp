@@ -116,6 +116,25 @@ namespace Exiv2 {
               type).
          */
         virtual void readMetadata() =0;
+        /*!
+          @brief Read only the metadata selected by \em options from the
+              image. Before this method is called, the image metadata will be
+              cleared.
+
+          The parsers skip the parts of the image which contain no selected
+          metadata, e.g., Exif directories and makernotes, XMP and IPTC
+          segments, and anything else is removed after reading.
+
+          Subclasses which override readMetadata() make this function
+          visible with <CODE>using Image::readMetadata;</CODE>
+
+          @note Use this method for read-only access only: Metadata which
+              was not read is lost if the image is written afterwards.
+          @throw Error if opening or reading of the file fails or the image
+              data is not valid (does not look like data of the specific image
+              type).
+         */
+        void readMetadata(const ReadOptions& options);
         /*!
           @brief Write metadata back to the image.
 
@@ -129,12 +148,47 @@ namespace Exiv2 {
           @throw Error if the operation fails
          */
         virtual void writeMetadata() =0;
+        /*!
+          @brief Overwrite the value of the Exif tag \em key in the image
+              with \em value, without rewriting any other part of the image.
+
+          The value is only patched if the tag is in the image and its
+          current value has the same type, count and size as \em value.
+          Offsets, image data, makernotes and elements of binary arrays
+          (e.g., most Canon makernote tags) are not patched. If the image
+          was read before, an existing Exif datum \em key is updated too,
+          no datum is added.
+
+          This is much cheaper than writeMetadata() for edits which do not
+          change the size of a value, e.g., of Orientation or a date.
+          The default implementation, used by image types which do not
+          support it, does nothing and returns false.
+
+          @return True if the value was overwritten, false if it could not
+              be patched. The image is not changed in this case.
+          @throw Error if the image cannot be opened or is not valid
+         */
+        virtual bool patchInPlace(const ExifKey& key, const Value& value);
         /*!
           @brief Assign new Exif data. The new Exif data is not written
               to the image until the writeMetadata() method is called.
           @param exifData An ExifData instance holding Exif data to be copied
          */
         virtual void setExifData(const ExifData& exifData);
+        /*!
+          @brief Assign new Exif data, taking over the contents of \em exifData
+              instead of copying them. \em exifData is left empty.
+
+          The default implementation takes over the data if the image
+          supports writing Exif data and calls setExifData() otherwise.
+          Image types which override setExifData() must override this
+          function too.
+         */
+        virtual void adoptExifData(ExifData& exifData);
+#ifdef EXV_HAVE_RVALUE_REFERENCES
+        //! Assign new Exif data, see adoptExifData().
+        void setExifData(ExifData&& exifData) { adoptExifData(exifData); }
+#endif
         /*!
           @brief Erase any buffered Exif data. Exif data is not removed from
               the actual image until the writeMetadata() method is called.
@@ -146,6 +200,20 @@ namespace Exiv2 {
           @param iptcData An IptcData instance holding IPTC data to be copied
          */
         virtual void setIptcData(const IptcData& iptcData);
+        /*!
+          @brief Assign new IPTC data, taking over the contents of \em iptcData
+              instead of copying them. \em iptcData is left empty.
+
+          The default implementation takes over the data if the image
+          supports writing IPTC data and calls setIptcData() otherwise.
+          Image types which override setIptcData() must override this
+          function too.
+         */
+        virtual void adoptIptcData(IptcData& iptcData);
+#ifdef EXV_HAVE_RVALUE_REFERENCES
+        //! Assign new IPTC data, see adoptIptcData().
+        void setIptcData(IptcData&& iptcData) { adoptIptcData(iptcData); }
+#endif
         /*!
           @brief Erase any buffered IPTC data. IPTC data is not removed from
               the actual image until the writeMetadata() method is called.
@@ -189,6 +257,20 @@ namespace Exiv2 {
           @param xmpData An XmpData instance holding XMP data to be copied
          */
         virtual void setXmpData(const XmpData& xmpData);
+        /*!
+          @brief Assign new XMP data, taking over the contents of \em xmpData
+              instead of copying them. \em xmpData is left empty.
+
+          The default implementation takes over the data if the image
+          supports writing XMP data and calls setXmpData() otherwise.
+          Image types which override setXmpData() must override this
+          function too.
+         */
+        virtual void adoptXmpData(XmpData& xmpData);
+#ifdef EXV_HAVE_RVALUE_REFERENCES
+        //! Assign new XMP data, see adoptXmpData().
+        void setXmpData(XmpData&& xmpData) { adoptXmpData(xmpData); }
+#endif
         /*!
           @brief Erase any buffered XMP data. XMP data is not removed from
               the actual image until the writeMetadata() method is called.
@@ -226,6 +308,23 @@ namespace Exiv2 {
               from the actual image until the writeMetadata() method is called.
          */
         virtual void clearMetadata();
+        /*!
+          @brief Move the buffered Exif data out of the image and return it,
+              leaving the image without Exif data. Use this to hand metadata
+              over to another image or container without copying it.
+         */
+        ExifData takeExifData();
+        /*!
+          @brief Move the buffered IPTC data out of the image and return it,
+              leaving the image without IPTC data.
+         */
+        IptcData takeIptcData();
+        /*!
+          @brief Move the buffered XMP data out of the image and return it,
+              leaving the image without XMP data. Like clearXmpData(), this
+              resets the image to write XMP from parsed XMP data.
+         */
+        XmpData takeXmpData();
         /*!
           @brief Returns an ExifData instance containing currently buffered
               Exif data.
@@ -281,6 +380,32 @@ namespace Exiv2 {
           access to the raw XMP packet.
          */
         void writeXmpFromPacket(bool flag);
+        /*!
+          @brief Set whether readMetadata() allocates the decoded values and
+              keys from a memory arena rather than individually from the heap.
+
+          The arena is not owned by the image but by the objects allocated
+          from it. Each call to readMetadata() uses a new arena, which takes
+          memory from the heap in blocks of 16 KB. A block is released when
+          the last object allocated from it is deleted, e.g., when the
+          metadata is cleared or the image is destroyed. Copies of the
+          metadata, which share the values, can therefore safely outlive
+          the image, but a single surviving datum or value keeps its block
+          alive. To keep a few values for a long time, clone them:
+          Value::clone() and copies of keys made outside of readMetadata()
+          are allocated from the heap.
+
+          This reduces heap contention and fragmentation in processes that
+          read many images. The default is false.
+         */
+        void setUseArena(bool flag);
+        /*!
+          @brief Set the limits of the work readMetadata() does to parse the
+              metadata of the image, see ParseLimits. The limits apply to
+              each call of readMetadata(). If a limit is exceeded, the
+              metadata read until then is kept and a warning is issued.
+         */
+        void setParseLimits(const ParseLimits& limits);
         /*!
           @brief Set the byte order to encode the Exif metadata in.
 
@@ -398,6 +523,22 @@ namespace Exiv2 {
         bool supportsMetadata(MetadataId metadataId) const;
         //! Return the flag indicating the source when writing XMP metadata.
         bool writeXmpFromPacket() const;
+        //! Return true if readMetadata() allocates metadata from an arena.
+        bool useArena() const;
+        //! Return the limits of the work done by readMetadata().
+        const ParseLimits& parseLimits() const;
+        /*!
+          @brief Return the camera manufacturer, from the Exif tag
+              Exif.Image.Make of the current Exif data, mfUnknown if the tag
+              is not set or the make is not known. See manufacturer(const std::string&).
+         */
+        Manufacturer manufacturer() const;
+        /*!
+          @brief Return the options of the current call to
+              readMetadata(const ReadOptions&), 0 if all metadata is read.
+              Used by the parsers.
+         */
+        const ReadOptions* readOptions() const;
         //! Return list of native previews. This is meant to be used only by the PreviewManager.
         const NativePreviewList& nativePreviews() const;
         //@}
@@ -428,6 +569,9 @@ namespace Exiv2 {
         const uint16_t    supportedMetadata_; //!< Bitmap with all supported metadata types
         bool              writeXmpFromPacket_;//!< Determines the source when writing XMP
         ByteOrder         byteOrder_;         //!< Byte order
+        bool              useArena_;          //!< Allocate decoded metadata from an arena
+        ParseLimits       parseLimits_;       //!< Limits of the work done by readMetadata()
+        const ReadOptions* pReadOptions_;     //!< Options of the current readMetadata() call
 
     }; // class Image
 
@@ -36,6 +36,7 @@ EXIV2_RCSID("@(#) $Id$")
 #include "value.hpp"
 #include "datasets.hpp"
 #include "jpgimage.hpp"
+#include "parsebudget_int.hpp"
 
 // + standard includes
 #include <iostream>
@@ -97,10 +98,9 @@ namespace Exiv2 {
     }
 
     Iptcdatum::Iptcdatum(const Iptcdatum& rhs)
-        : Metadatum(rhs)
+        : Metadatum(rhs), value_(rhs.value_) // shared value
     {
         if (rhs.key_.get() != 0) key_ = rhs.key_->clone(); // deep copy
-        if (rhs.value_.get() != 0) value_ = rhs.value_->clone(); // deep copy
     }
 
     Iptcdatum::~Iptcdatum()
@@ -226,17 +226,24 @@ namespace Exiv2 {
         key_.reset();
         if (rhs.key_.get() != 0) key_ = rhs.key_->clone(); // deep copy
 
-        value_.reset();
-        if (rhs.value_.get() != 0) value_ = rhs.value_->clone(); // deep copy
+        value_ = rhs.value_; // shared value
 
         return *this;
     } // Iptcdatum::operator=
 
+    void Iptcdatum::swap(Iptcdatum& rhs)
+    {
+        IptcKey::AutoPtr key = key_;
+        key_ = rhs.key_;
+        rhs.key_ = key;
+        value_.swap(rhs.value_);
+    }
+
     Iptcdatum& Iptcdatum::operator=(const uint16_t& value)
     {
         UShortValue::AutoPtr v(new UShortValue);
         v->value_.push_back(value);
-        value_ = v;
+        value_ = Value::AutoPtr(v);
         return *this;
     }
 
@@ -264,7 +271,7 @@ namespace Exiv2 {
             TypeId type = IptcDataSets::dataSetType(tag(), record());
             value_ = Value::create(type);
         }
-        return value_->read(value);
+        return value_.modify()->read(value);
     }
 
     Iptcdatum& IptcData::operator[](const std::string& key)
@@ -418,6 +425,8 @@ namespace Exiv2 {
 #endif
         const byte* pRead = pData;
         iptcData.clear();
+        Internal::ParseBudgetScope budgetScope;
+        Internal::ParseBudget& budget = budgetScope.budget();
 
         uint16_t record = 0;
         uint16_t dataSet = 0;
@@ -449,6 +458,8 @@ namespace Exiv2 {
                 pRead += 2;
             }
             if (pRead + sizeData <= pData + size) {
+                if (   !budget.addComponents()
+                    || !budget.addValueBytes(sizeData)) break;
                 int rc = 0;
                 if ((rc = readData(iptcData, dataSet, record, pRead, sizeData)) != 0) {
 #ifndef SUPPRESS_WARNINGS
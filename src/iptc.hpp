@@ -76,6 +76,10 @@ namespace Exiv2 {
                            const Value* pValue =0);
         //! Copy constructor
         Iptcdatum(const Iptcdatum& rhs);
+#ifdef EXV_HAVE_RVALUE_REFERENCES
+        //! Move constructor, leaves \em rhs without key and value
+        Iptcdatum(Iptcdatum&& rhs) noexcept : Metadatum(rhs) { swap(rhs); }
+#endif
         //! Destructor
         virtual ~Iptcdatum();
         //@}
@@ -84,6 +88,12 @@ namespace Exiv2 {
         //@{
         //! Assignment operator
         Iptcdatum& operator=(const Iptcdatum& rhs);
+#ifdef EXV_HAVE_RVALUE_REFERENCES
+        //! Move assignment operator, exchanges key and value with \em rhs
+        Iptcdatum& operator=(Iptcdatum&& rhs) noexcept { swap(rhs); return *this; }
+#endif
+        //! Exchange key and value with \em rhs, without copying either.
+        void swap(Iptcdatum& rhs);
         /*!
           @brief Assign \em value to the %Iptcdatum. The type of the new Value
                  is set to UShortValue.
@@ -159,7 +169,7 @@ namespace Exiv2 {
     private:
         // DATA
         IptcKey::AutoPtr key_;                  //!< Key
-        Value::AutoPtr   value_;                //!< Value
+        SharedValue      value_;                //!< Value, shared between copies
 
     }; // class Iptcdatum
 
@@ -223,6 +233,8 @@ namespace Exiv2 {
           @brief Delete all Iptcdatum instances resulting in an empty container.
          */
         void clear() { iptcMetadata_.clear(); }
+        //! Exchange the contents with those of \em rhs, without copying any metadata.
+        void swap(IptcData& rhs) { iptcMetadata_.swap(rhs.iptcMetadata_); }
         //! Sort metadata by key
         void sortByKey();
         //! Sort metadata by tag (aka dataset)
@@ -41,7 +41,10 @@ EXIV2_RCSID("@(#) $Id$")
 # include "exv_conf.h"
 #endif
 #include "jp2image.hpp"
+#include "arena_int.hpp"
+#include "parsebudget_int.hpp"
 #include "tiffimage.hpp"
+#include "tiffimage_int.hpp"
 #include "image.hpp"
 #include "basicio.hpp"
 #include "error.hpp"
@@ -151,6 +154,8 @@ namespace Exiv2
 
     void Jp2Image::readMetadata()
     {
+        Internal::ArenaScope arenaScope(useArena());
+        Internal::ParseBudgetScope budgetScope(parseLimits());
 #ifdef DEBUG
         std::cerr << "Exiv2::Jp2Image::readMetadata: Reading JPEG-2000 file " << io_->path() << "\n";
 #endif
@@ -195,6 +200,13 @@ namespace Exiv2
             {
                 // FIXME. Special case. the real box size is given in another place.
             }
+            // The data of UUID boxes is read into memory
+            if (   !budgetScope.budget().addComponents()
+                || (   box.boxType == kJp2BoxTypeUuid
+                    && !budgetScope.budget().addValueBytes(box.boxLength)))
+            {
+                return;
+            }
 
             switch(box.boxType)
             {
@@ -275,11 +287,12 @@ namespace Exiv2
                                     std::cout << "Exiv2::Jp2Image::readMetadata: Exif header found at position " << pos << "\n";
 #endif
                                     pos = pos + sizeof(exifHeader);
-                                    ByteOrder bo = TiffParser::decode(exifData(),
-                                                                      iptcData(),
-                                                                      xmpData(),
-                                                                      rawData.pData_ + pos,
-                                                                      rawData.size_ - pos);
+                                    ByteOrder bo = Internal::decodeTiff(exifData(),
+                                                                        iptcData(),
+                                                                        xmpData(),
+                                                                        rawData,
+                                                                        pos,
+                                                                        readOptions());
                                     setByteOrder(bo);
                                 }
                             }
@@ -333,7 +346,9 @@ namespace Exiv2
                                 xmpPacket_ = xmpPacket_.substr(idx);
                             }
 
-                            if (xmpPacket_.size() > 0 && XmpParser::decode(xmpData_, xmpPacket_))
+                            if (   xmpPacket_.size() > 0
+                                && (!readOptions() || readOptions()->selected(mdXmp))
+                                && XmpParser::decode(xmpData_, xmpPacket_))
                             {
 #ifndef SUPPRESS_WARNINGS
                                 EXV_WARNING << "Failed to decode XMP metadata.\n";
@@ -83,6 +83,7 @@ namespace Exiv2
         //! @name Manipulators
         //@{
         void readMetadata();
+        using Image::readMetadata;
         void writeMetadata();
         /*!
           @brief Todo: Not supported yet(?). Calling this function will throw
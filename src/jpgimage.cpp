@@ -40,6 +40,10 @@ EXIV2_RCSID("@(#) $Id$")
 #endif
 
 #include "jpgimage.hpp"
+#include "tiffimage.hpp"
+#include "tiffimage_int.hpp"
+#include "arena_int.hpp"
+#include "parsebudget_int.hpp"
 #include "error.hpp"
 #include "futils.hpp"
 
@@ -310,8 +314,51 @@ namespace Exiv2 {
         return c;
     }
 
+    bool JpegBase::patchInPlace(const ExifKey& key, const Value& value)
+    {
+        if (io_->open() != 0) throw Error(9, io_->path(), strError());
+        IoCloser closer(*io_);
+        // Ensure that this is the correct image type
+        if (!isThisType(*io_, true)) {
+            if (io_->error() || io_->eof()) throw Error(14);
+            throw Error(15);
+        }
+        const long bufMinSize = 8;
+        byte buf[bufMinSize];
+        // Find the Exif APP1 segment
+        int marker = advanceToMarker();
+        if (marker < 0) throw Error(15);
+        while (marker != sos_ && marker != eoi_) {
+            std::memset(buf, 0x0, bufMinSize);
+            long bufRead = io_->read(buf, bufMinSize);
+            if (io_->error()) throw Error(14);
+            if (bufRead < 2) throw Error(15);
+            uint16_t size = getUShort(buf, bigEndian);
+            if (marker == app1_ && memcmp(buf + 2, exifId_, 6) == 0) {
+                if (size < 8 || bufRead < bufMinSize) return false;
+                // Patch the TIFF structure which follows the Exif header
+                const long start = io_->tell();
+                byte* pData = io_->mmap(true);
+                if (start + size - 8 > io_->size()) return false;
+                if (!TiffParser::patch(pData + start, size - 8, key, value)) {
+                    return false;
+                }
+                ExifData::iterator pos = exifData_.findKey(key);
+                if (pos != exifData_.end()) pos->setValue(&value);
+                return true;
+            }
+            if (size < 2) throw Error(15);
+            if (io_->seek(size - bufRead, BasicIo::cur)) throw Error(14);
+            marker = advanceToMarker();
+            if (marker < 0) throw Error(15);
+        }
+        return false;
+    } // JpegBase::patchInPlace
+
     void JpegBase::readMetadata()
     {
+        Internal::ArenaScope arenaScope(useArena());
+        Internal::ParseBudgetScope budgetScope(parseLimits());
         int rc = 0; // Todo: this should be the return value
 
         if (io_->open() != 0) throw Error(9, io_->path(), strError());
@@ -330,6 +377,15 @@ namespace Exiv2 {
         bool foundCompletePsData = false;
         bool foundExifData = false;
         bool foundXmpData = false;
+        bool foundComment = false;
+        // Segments with metadata which is not selected are skipped
+        const ReadOptions* pOptions = readOptions();
+        if (pOptions != 0) {
+            if (!pOptions->selected(mdExif))    { foundExifData = true;       --search; }
+            if (!pOptions->selected(mdXmp))     { foundXmpData = true;        --search; }
+            if (!pOptions->selected(mdIptc))    { foundCompletePsData = true; --search; }
+            if (!pOptions->selected(mdComment)) { foundComment = true;        --search; }
+        }
 
         // Read section marker
         int marker = advanceToMarker();
@@ -354,9 +410,11 @@ namespace Exiv2 {
                 DataBuf rawExif(size - 8);
                 io_->read(rawExif.pData_, rawExif.size_);
                 if (io_->error() || io_->eof()) throw Error(14);
-                ByteOrder bo = ExifParser::decode(exifData_, rawExif.pData_, rawExif.size_);
+                // The decoded values refer to the buffer, which is taken over
+                const long rawSize = rawExif.size_;
+                ByteOrder bo = Internal::decodeExif(exifData_, rawExif, pOptions);
                 setByteOrder(bo);
-                if (rawExif.size_ > 0 && byteOrder() == invalidByteOrder) {
+                if (rawSize > 0 && byteOrder() == invalidByteOrder) {
 #ifndef SUPPRESS_WARNINGS
                     EXV_WARNING << "Failed to decode Exif metadata.\n";
 #endif
@@ -408,7 +466,7 @@ namespace Exiv2 {
                     foundCompletePsData = true;
                 }
             }
-            else if (marker == com_ && comment_.empty())
+            else if (!foundComment && marker == com_ && comment_.empty())
             {
                 if (size < 2) {
                     rc = 3;
@@ -140,7 +140,13 @@ namespace Exiv2 {
         //! @name Manipulators
         //@{
         void readMetadata();
+        using Image::readMetadata;
         void writeMetadata();
+        /*!
+          @brief Overwrite the value of the Exif tag \em key in the Exif
+              APP1 segment of the JPEG file, see Image::patchInPlace().
+         */
+        bool patchInPlace(const ExifKey& key, const Value& value);
         //@}
 
     protected:
@@ -44,6 +44,7 @@ EXIV2_RCSID("@(#) $Id$")
 
 // + standard includes
 #include <string>
+#include <algorithm>
 #include <cstring>
 
 // *****************************************************************************
@@ -51,8 +52,10 @@ namespace {
     // Todo: Can be generalized further - get any tag as a string/long/...
     //! Get the model name from tag Exif.Image.Model
     std::string getExifModel(Exiv2::Internal::TiffComponent* const pRoot);
-    //! Nikon en/decryption function
-    void ncrypt(Exiv2::byte* pData, uint32_t size, uint32_t count, uint32_t serial);
+    //! Fill the key stream of Nikon en/decryption for the shutter count and serial number
+    void nikonKeyStream(Exiv2::Internal::CryptKey& key, uint32_t count, uint32_t serial);
+    //! Look up the key of Nikon en/decryption in the composite
+    void nikonKey(Exiv2::Internal::CryptKey& key, Exiv2::Internal::TiffComponent* const pRoot);
 }
 
 // *****************************************************************************
@@ -61,35 +64,27 @@ namespace Exiv2 {
     namespace Internal {
 
     const TiffMnRegistry TiffMnCreator::registry_[] = {
-        { "Canon",          canonId,     newIfdMn,       newIfdMn2       },
-        { "FOVEON",         sigmaId,     newSigmaMn,     newSigmaMn2     },
-        { "FUJI",           fujiId,      newFujiMn,      newFujiMn2      },
-        { "KONICA MINOLTA", minoltaId,   newIfdMn,       newIfdMn2       },
-        { "Minolta",        minoltaId,   newIfdMn,       newIfdMn2       },
-        { "NIKON",          ifdIdNotSet, newNikonMn,     0               }, // mnGroup_ is not used
-        { "OLYMPUS",        ifdIdNotSet, newOlympusMn,   0               }, // mnGroup_ is not used
-        { "Panasonic",      panasonicId, newPanasonicMn, newPanasonicMn2 },
-        { "PENTAX",         pentaxId,    newPentaxMn,    newPentaxMn2    },
-        { "SAMSUNG",        samsung2Id,  newSamsungMn,   newSamsungMn2   },
-        { "SIGMA",          sigmaId,     newSigmaMn,     newSigmaMn2     },
-        { "SONY",           ifdIdNotSet, newSonyMn,      0               }, // mnGroup_ is not used
+        // Entries in the order of the Manufacturer enumeration, starting with mfCanon
+        { mfCanon,     canonId,     newIfdMn,       newIfdMn2       },
+        { mfFujifilm,  fujiId,      newFujiMn,      newFujiMn2      },
+        { mfMinolta,   minoltaId,   newIfdMn,       newIfdMn2       },
+        { mfNikon,     ifdIdNotSet, newNikonMn,     0               }, // mnGroup_ is not used
+        { mfOlympus,   ifdIdNotSet, newOlympusMn,   0               }, // mnGroup_ is not used
+        { mfPanasonic, panasonicId, newPanasonicMn, newPanasonicMn2 },
+        { mfPentax,    pentaxId,    newPentaxMn,    newPentaxMn2    },
+        { mfSamsung,   samsung2Id,  newSamsungMn,   newSamsungMn2   },
+        { mfSigma,     sigmaId,     newSigmaMn,     newSigmaMn2     },
+        { mfSony,      ifdIdNotSet, newSonyMn,      0               }, // mnGroup_ is not used
         // Entries below are only used for lookup by group
-        { "-",              nikon1Id,    0,              newIfdMn2       },
-        { "-",              nikon2Id,    0,              newNikon2Mn2    },
-        { "-",              nikon3Id,    0,              newNikon3Mn2    },
-        { "-",              sony1Id,     0,              newSony1Mn2     },
-        { "-",              sony2Id,     0,              newSony2Mn2     },
-        { "-",              olympusId,   0,              newOlympusMn2   },
-        { "-",              olympus2Id,  0,              newOlympus2Mn2  }
+        { mfUnknown,   nikon1Id,    0,              newIfdMn2       },
+        { mfUnknown,   nikon2Id,    0,              newNikon2Mn2    },
+        { mfUnknown,   nikon3Id,    0,              newNikon3Mn2    },
+        { mfUnknown,   sony1Id,     0,              newSony1Mn2     },
+        { mfUnknown,   sony2Id,     0,              newSony2Mn2     },
+        { mfUnknown,   olympusId,   0,              newOlympusMn2   },
+        { mfUnknown,   olympus2Id,  0,              newOlympus2Mn2  }
     };
 
-    bool TiffMnRegistry::operator==(const std::string& key) const
-    {
-        std::string make(make_);
-        if (key.size() > 0 && key[0] == '-') return false;
-        return make == key.substr(0, make.length());
-    }
-
     bool TiffMnRegistry::operator==(IfdId key) const
     {
         return mnGroup_ == key;
@@ -97,23 +92,21 @@ namespace Exiv2 {
 
     TiffComponent* TiffMnCreator::create(uint16_t           tag,
                                          IfdId              group,
-                                         const std::string& make,
+                                         Manufacturer       make,
                                          const byte*        pData,
                                          uint32_t           size,
                                          ByteOrder          byteOrder)
     {
-        TiffComponent* tc = 0;
-        const TiffMnRegistry* tmr = find(registry_, make);
-        if (tmr) {
-            assert(tmr->newMnFct_);
-            tc = tmr->newMnFct_(tag,
-                                group,
-                                tmr->mnGroup_,
-                                pData,
-                                size,
-                                byteOrder);
-        }
-        return tc;
+        if (make == mfUnknown || make > mfLastManufacturer) return 0;
+        const TiffMnRegistry& tmr = registry_[make - mfCanon];
+        assert(tmr.make_ == make);
+        assert(tmr.newMnFct_);
+        return tmr.newMnFct_(tag,
+                             group,
+                             tmr.mnGroup_,
+                             pData,
+                             size,
+                             byteOrder);
     } // TiffMnCreator::create
 
     TiffComponent* TiffMnCreator::create(uint16_t           tag,
@@ -405,7 +398,7 @@ namespace Exiv2 {
         TiffHeader th;
         if (!th.read(buf_.pData_ + 10, 8)) return false;
         byteOrder_ = th.byteOrder();
-        start_ = 10 + th.offset();
+        start_ = 10 + static_cast<uint32_t>(th.offset());
         return true;
     } // Nikon3MnHeader::read
 
@@ -661,8 +654,7 @@ namespace Exiv2 {
                                 uint32_t    size,
                                 ByteOrder   /*byteOrder*/)
     {
-        if (size < 10 ||   std::string(reinterpret_cast<const char*>(pData), 10)
-                        != std::string("OLYMPUS\0II", 10)) {
+        if (size < 10 || std::memcmp(pData, "OLYMPUS\0II", 10) != 0) {
             return newOlympusMn2(tag, group, olympusId);
         }
         return newOlympus2Mn2(tag, group, olympus2Id);
@@ -707,8 +699,7 @@ namespace Exiv2 {
                               ByteOrder   /*byteOrder*/)
     {
         // If there is no "Nikon" string it must be Nikon1 format
-        if (size < 6 ||    std::string(reinterpret_cast<const char*>(pData), 6)
-                        != std::string("Nikon\0", 6)) {
+        if (size < 6 || std::memcmp(pData, "Nikon\0", 6) != 0) {
             return newIfdMn2(tag, group, nikon1Id);
         }
         // If the "Nikon" string is not followed by a TIFF header, we assume
@@ -813,8 +804,7 @@ namespace Exiv2 {
                              ByteOrder   /*byteOrder*/)
     {
         // If there is no "SONY DSC " string we assume it's a simple IFD Makernote
-        if (size < 12 ||   std::string(reinterpret_cast<const char*>(pData), 12)
-                        != std::string("SONY DSC \0\0\0", 12)) {
+        if (size < 12 || std::memcmp(pData, "SONY DSC \0\0\0", 12) != 0) {
             return newSony2Mn2(tag, group, sony2Id);
         }
         return newSony1Mn2(tag, group, sony1Id);
@@ -902,42 +892,25 @@ namespace Exiv2 {
         return aix == 0 ? -1 : aix->idx_;
     }
 
-    DataBuf nikonCrypt(uint16_t tag, const byte* pData, uint32_t size, TiffComponent* const pRoot)
+    bool nikonCrypt(uint16_t tag, byte* pData, uint32_t size, TiffComponent* const pRoot, CryptKey& key)
     {
-        DataBuf buf;
-
-        if (size < 4) return buf;
+        if (size < 4) return false;
         const NikonArrayIdx* nci = find(nikonArrayIdx, NikonArrayIdx::Key(tag, reinterpret_cast<const char*>(pData), size));
-        if (nci == 0 || nci->start_ == NA || size <= nci->start_) return buf;
-
-        // Find Exif.Nikon3.ShutterCount
-        TiffFinder finder(0x00a7, nikon3Id);
-        pRoot->accept(finder);
-        TiffEntryBase* te = dynamic_cast<TiffEntryBase*>(finder.result());
-        if (!te || !te->pValue() || te->pValue()->count() == 0) return buf;
-        uint32_t count = static_cast<uint32_t>(te->pValue()->toLong());
-
-        // Find Exif.Nikon3.SerialNumber
-        finder.init(0x001d, nikon3Id);
-        pRoot->accept(finder);
-        te = dynamic_cast<TiffEntryBase*>(finder.result());
-        if (!te || !te->pValue() || te->pValue()->count() == 0) return buf;
-        bool ok(false);
-        uint32_t serial = stringTo<uint32_t>(te->pValue()->toString(), ok);
-        if (!ok) {
-            std::string model = getExifModel(pRoot);
-            if (model.empty()) return buf;
-            if (model.find("D50") != std::string::npos) {
-                serial = 0x22;
-            }
-            else {
-                serial = 0x60;
+        if (nci == 0 || nci->start_ == NA || size <= nci->start_) return false;
+
+        if (key.state_ == CryptKey::notLookedUp) nikonKey(key, pRoot);
+        if (key.state_ != CryptKey::found) return false;
+
+        // The key stream repeats, xor the data with it block by block
+        const uint32_t blockSize = sizeof(key.stream_);
+        for (uint32_t i = nci->start_; i < size; i += blockSize) {
+            byte* pBlock = pData + i;
+            const uint32_t n = std::min(size - i, blockSize);
+            for (uint32_t j = 0; j < n; ++j) {
+                pBlock[j] ^= key.stream_[j];
             }
         }
-        buf.alloc(size);
-        memcpy(buf.pData_, pData, buf.size_);
-        ncrypt(buf.pData_ + nci->start_, buf.size_ - nci->start_, count, serial);
-        return buf;
+        return true;
     }
 
     int sonyCsSelector(uint16_t /*tag*/, const byte* /*pData*/, uint32_t /*size*/, TiffComponent* const pRoot)
@@ -965,7 +938,41 @@ namespace {
         return te->pValue()->toString();
     }
 
-    void ncrypt(Exiv2::byte* pData, uint32_t size, uint32_t count, uint32_t serial)
+    void nikonKey(Exiv2::Internal::CryptKey& key, Exiv2::Internal::TiffComponent* const pRoot)
+    {
+        using namespace Exiv2::Internal;
+
+        key.state_ = CryptKey::notFound;
+
+        // Find Exif.Nikon3.ShutterCount
+        TiffFinder finder(0x00a7, nikon3Id);
+        pRoot->accept(finder);
+        TiffEntryBase* te = dynamic_cast<TiffEntryBase*>(finder.result());
+        if (!te || !te->pValue() || te->pValue()->count() == 0) return;
+        uint32_t count = static_cast<uint32_t>(te->pValue()->toLong());
+
+        // Find Exif.Nikon3.SerialNumber
+        finder.init(0x001d, nikon3Id);
+        pRoot->accept(finder);
+        te = dynamic_cast<TiffEntryBase*>(finder.result());
+        if (!te || !te->pValue() || te->pValue()->count() == 0) return;
+        bool ok(false);
+        uint32_t serial = Exiv2::stringTo<uint32_t>(te->pValue()->toString(), ok);
+        if (!ok) {
+            std::string model = getExifModel(pRoot);
+            if (model.empty()) return;
+            if (model.find("D50") != std::string::npos) {
+                serial = 0x22;
+            }
+            else {
+                serial = 0x60;
+            }
+        }
+        nikonKeyStream(key, count, serial);
+        key.state_ = CryptKey::found;
+    }
+
+    void nikonKeyStream(Exiv2::Internal::CryptKey& key, uint32_t count, uint32_t serial)
     {
         static const Exiv2::byte xlat[2][256] = {
             { 0xc1,0xbf,0x6d,0x0d,0x59,0xc5,0x13,0x9d,0x83,0x61,0x6b,0x4f,0xc7,0x7f,0x3d,0x3d,
@@ -1001,16 +1008,18 @@ namespace {
               0x3b,0x2d,0xeb,0x25,0x49,0xfa,0xa3,0xaa,0x39,0xa7,0xc5,0xa7,0x50,0x11,0x36,0xfb,
               0xc6,0x67,0x4a,0xf5,0xa5,0x12,0x65,0x7e,0xb0,0xdf,0xaf,0x4e,0xb3,0x61,0x7f,0x2f }
         };
-        Exiv2::byte key = 0;
+        Exiv2::byte k = 0;
         for (int i = 0; i < 4; ++i) {
-            key ^= (count >> (i*8)) & 0xff;
+            k ^= (count >> (i*8)) & 0xff;
         }
         Exiv2::byte ci = xlat[0][serial & 0xff];
-        Exiv2::byte cj = xlat[1][key];
+        Exiv2::byte cj = xlat[1][k];
         Exiv2::byte ck = 0x60;
-        for (uint32_t i = 0; i < size; ++i) {
+        // After 512 bytes, ck has run through all values twice and the sum
+        // of the increments of cj is a multiple of 256: the stream repeats
+        for (uint32_t i = 0; i < sizeof(key.stream_); ++i) {
             cj += ci * ck++;
-            pData[i] ^= cj;
+            key.stream_[i] = cj;
         }
     }
 }
@@ -64,21 +64,11 @@ namespace Exiv2 {
 
     //! Makernote registry structure
     struct TiffMnRegistry {
-        struct MakeKey;
-        /*!
-          @brief Compare a TiffMnRegistry structure with a key being the make
-                 string from the image. The two are equal if
-                 TiffMnRegistry::make_ equals a substring of the key of the
-                 same size. E.g., registry = "OLYMPUS",
-                 key = "OLYMPUS OPTICAL CO.,LTD" (found in the image) match.
-         */
-        bool operator==(const std::string& key) const;
-
         //! Compare a TiffMnRegistry structure with a makernote group
         bool operator==(IfdId key) const;
 
         // DATA
-        const char* make_;                      //!< Camera make
+        Manufacturer make_;                     //!< Camera manufacturer
         IfdId       mnGroup_;                   //!< Group identifier
         NewMnFct    newMnFct_;                  //!< Makernote create function (image)
         NewMnFct2   newMnFct2_;                 //!< Makernote create function (group)
@@ -90,9 +80,10 @@ namespace Exiv2 {
     class TiffMnCreator {
     public:
         /*!
-          @brief Create the Makernote for camera \em make and details from
-                 the makernote entry itself if needed. Return a pointer to
-                 the newly created TIFF component. Set tag and group of the
+          @brief Create the Makernote for a camera of manufacturer \em make
+                 and details from the makernote entry itself if needed. Return
+                 a pointer to the newly created TIFF component, 0 if there is
+                 no makernote for the manufacturer. Set tag and group of the
                  new component to \em tag and \em group. This method is used
                  when a makernote is parsed from the Exif block.
           @note  Ownership for the component is transferred to the caller,
@@ -102,7 +93,7 @@ namespace Exiv2 {
         */
         static TiffComponent* create(uint16_t           tag,
                                      IfdId              group,
-                                     const std::string& make,
+                                     Manufacturer       make,
                                      const byte*        pData,
                                      uint32_t           size,
                                      ByteOrder          byteOrder);
@@ -118,7 +109,11 @@ namespace Exiv2 {
         //! Prevent destruction (needed if used as a policy class)
         ~TiffMnCreator() {}
     private:
-        static const TiffMnRegistry registry_[]; //<! List of makernotes
+        /*!
+          @brief List of makernotes. The first rows are indexed by
+                 Manufacturer, in the order of the enumeration.
+         */
+        static const TiffMnRegistry registry_[];
     }; // class TiffMnCreator
 
     //! Makernote header interface. This class is used with TIFF makernotes.
@@ -646,14 +641,19 @@ namespace Exiv2 {
       @note This function requires access to other components of the composite, it
             should only be called after all other components are read.
 
+      The key is derived from Exif.Nikon3.SerialNumber and
+      Exif.Nikon3.ShutterCount. It is looked up in the composite only once
+      for each \em key object.
+
       @param tag Tag number of the binary array
-      @param pData Pointer to the start of the data to en/decrypt.
+      @param pData Pointer to the start of the data to en/decrypt, in place.
       @param size Size of the data buffer.
       @param pRoot Pointer to the root element of the composite.
-      @return En/decrypted data. Ownership of the memory is passed to the caller.
-              The buffer may be empty in case no decryption was needed.
+      @param key Key of the composite.
+      @return true if the data was en/decrypted, false if the data is not
+              encrypted or the key was not found.
      */
-    DataBuf nikonCrypt(uint16_t tag, const byte* pData, uint32_t size, TiffComponent* const pRoot);
+    bool nikonCrypt(uint16_t tag, byte* pData, uint32_t size, TiffComponent* const pRoot, CryptKey& key);
 
 }}                                      // namespace Internal, Exiv2
 
@@ -33,11 +33,18 @@ EXIV2_RCSID("@(#) $Id$")
 // *****************************************************************************
 // included header files
 #include "metadatum.hpp"
+#include "arena_int.hpp"
 
 // + standard includes
 #include <iostream>
 #include <iomanip>
 
+// *****************************************************************************
+// local declarations
+namespace {
+    //! Return the family name of the keys of metadata type \em family, "" if there is none.
+    std::string familyName(Exiv2::MetadataId family);
+}
 
 // *****************************************************************************
 // class member definitions
@@ -47,6 +54,16 @@ namespace Exiv2 {
     {
     }
 
+    void* Key::operator new(std::size_t size)
+    {
+        return Internal::Arena::allocate(size);
+    }
+
+    void Key::operator delete(void* p)
+    {
+        Internal::Arena::deallocate(p);
+    }
+
     Key::AutoPtr Key::clone() const
     {
         return AutoPtr(clone_());
@@ -92,5 +109,61 @@ namespace Exiv2 {
         return lhs.key() < rhs.key();
     }
 
+    ReadOptions::ReadOptions()
+        : metadata_(mdExif | mdIptc | mdComment | mdXmp),
+          deferMakernote_(false),
+          decodeThreads_(1)
+    {
+    }
+
+    bool ReadOptions::selected(MetadataId family) const
+    {
+        if ((metadata_ & family) == 0) return false;
+        if (family == mdComment) return true;
+        if (groups_.empty() && keys_.empty()) return true;
+        const std::string prefix = familyName(family) + ".";
+        for (std::set<std::string>::const_iterator i = groups_.begin(); i != groups_.end(); ++i) {
+            if (i->compare(0, prefix.size(), prefix) == 0) return true;
+        }
+        for (std::set<std::string>::const_iterator i = keys_.begin(); i != keys_.end(); ++i) {
+            if (i->compare(0, prefix.size(), prefix) == 0) return true;
+        }
+        return false;
+    }
+
+    bool ReadOptions::selectedAll(MetadataId family) const
+    {
+        return (metadata_ & family) != 0 && groups_.empty() && keys_.empty();
+    }
+
+    bool ReadOptions::selected(const Metadatum& md) const
+    {
+        const std::string family = md.familyName();
+        MetadataId id = mdNone;
+        if      (family == familyName(mdExif)) id = mdExif;
+        else if (family == familyName(mdIptc)) id = mdIptc;
+        else if (family == familyName(mdXmp))  id = mdXmp;
+        if (!selected(id)) return false;
+        if (groups_.empty() && keys_.empty()) return true;
+        if (groups_.find(family + "." + md.groupName()) != groups_.end()) return true;
+        return keys_.find(md.key()) != keys_.end();
+    }
+
 }                                       // namespace Exiv2
 
+// *****************************************************************************
+// local definitions
+namespace {
+
+    std::string familyName(Exiv2::MetadataId family)
+    {
+        switch (family) {
+        case Exiv2::mdExif: return "Exif";
+        case Exiv2::mdIptc: return "Iptc";
+        case Exiv2::mdXmp:  return "Xmp";
+        default:            return "";
+        }
+    }
+
+}
+
@@ -41,6 +41,7 @@
 // + standard includes
 #include <string>
 #include <memory>
+#include <set>
 
 // *****************************************************************************
 // namespace extensions
@@ -66,6 +67,10 @@ namespace Exiv2 {
         //@{
         //! Destructor
         virtual ~Key();
+        //! Allocate memory for a key, from the metadata arena if one is in use.
+        static void* operator new(std::size_t size);
+        //! Release memory of a key.
+        static void operator delete(void* p);
         //@}
 
         //! @name Accessors
@@ -316,6 +321,53 @@ namespace Exiv2 {
      */
     EXIV2API bool cmpMetadataByKey(const Metadatum& lhs, const Metadatum& rhs);
 
+    /*!
+      @brief Options to select the metadata read by
+             Image::readMetadata(const ReadOptions&).
+
+      Metadata is read if its family is set in \em metadata_ and, if any
+      groups or keys of that family are listed, if its group (e.g.,
+      "Exif.Photo") is in \em groups_ or its key (e.g.,
+      "Exif.Image.Orientation") is in \em keys_. A family for which groups
+      or keys are listed for other families only is not read at all. The
+      parsers skip the parts of an image which contain no selected metadata.
+
+      If \em deferMakernote_ is set, a known Exif makernote is not parsed
+      while the image is read. The ExifData keeps the makernote and adds its
+      tags when ExifData::parseMakernote() is called. Images which do not
+      keep the data the makernote was read from parse it right away.
+
+      If \em decodeThreads_ is greater than 1, the sub-IFDs and the makernote
+      of TIFF-based images are decoded on up to that many threads once the
+      TIFF structure is read. The metadata is in the same order as when it
+      is decoded in one thread.
+     */
+    struct EXIV2API ReadOptions {
+        //! Default constructor, selects all metadata.
+        ReadOptions();
+
+        //! @name Accessors
+        //@{
+        /*!
+          @brief Return true if metadata of \em family (mdExif, mdIptc,
+                 mdXmp or mdComment) is selected.
+         */
+        bool selected(MetadataId family) const;
+        //! Return true if the metadatum \em md is selected.
+        bool selected(const Metadatum& md) const;
+        //! Return true if all metadata of \em family is selected.
+        bool selectedAll(MetadataId family) const;
+        //@}
+
+        // DATA
+        int                   metadata_; //!< Bitmap of the MetadataId of the families to read
+        std::set<std::string> groups_;   //!< Groups to read, e.g., "Exif.Photo"
+        std::set<std::string> keys_;     //!< Keys to read, e.g., "Exif.Image.Orientation"
+        bool                  deferMakernote_; //!< Parse the Exif makernote only on request
+        int                   decodeThreads_;  //!< Maximum number of threads to decode TIFF sub-trees, default 1
+
+    }; // struct ReadOptions
+
 }                                       // namespace Exiv2
 
 #endif                                  // #ifndef METADATUM_HPP_
@@ -1872,9 +1872,14 @@ namespace Exiv2 {
                  "No Lens" }
     };
 
-    std::ostream& printMinoltaSonyLensID(std::ostream& os, const Value& value, const ExifData* metadata)
+    //! Index of the lens ids, built once
+    const TagDetailsIndex minoltaSonyLensIDIndex(minoltaSonyLensID, EXV_COUNTOF(minoltaSonyLensID));
+
+    std::ostream& printMinoltaSonyLensID(std::ostream& os, const Value& value, const ExifData*)
     {
-        return EXV_PRINT_TAG(minoltaSonyLensID)(os, value, metadata);
+        const TagDetails* td = minoltaSonyLensIDIndex.find(value.toLong());
+        if (!td) return os << "(" << value << ")";
+        return os << exvGettext(td->label_);
     }
 
     // ----------------------------------------------------------------------------------------------------
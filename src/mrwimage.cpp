@@ -38,6 +38,8 @@ EXIV2_RCSID("@(#) $Id$")
 #endif
 
 #include "mrwimage.hpp"
+#include "arena_int.hpp"
+#include "parsebudget_int.hpp"
 #include "tiffimage.hpp"
 #include "image.hpp"
 #include "basicio.hpp"
@@ -102,6 +104,8 @@ namespace Exiv2 {
 
     void MrwImage::readMetadata()
     {
+        Internal::ArenaScope arenaScope(useArena());
+        Internal::ParseBudgetScope budgetScope(parseLimits());
 #ifdef DEBUG
         std::cerr << "Reading MRW file " << io_->path() << "\n";
 #endif
@@ -149,7 +153,8 @@ namespace Exiv2 {
                                           iptcData_,
                                           xmpData_,
                                           buf.pData_,
-                                          buf.size_);
+                                          buf.size_,
+                                          readOptions());
         setByteOrder(bo);
     } // MrwImage::readMetadata
 
@@ -51,6 +51,9 @@ EXIV2_RCSID("@(#) $Id$")
 #include <cassert>
 #include <cstring>
 #include <cmath>
+#include <vector>
+#include <utility>
+#include <algorithm>
 
 // *****************************************************************************
 // class member definitions
@@ -1650,32 +1653,6 @@ namespace Exiv2 {
         return os << a * b / c;
     }
 
-    std::ostream& Nikon3MakerNote::printLensId1(std::ostream& os,
-                                                const Value& value,
-                                                const ExifData* metadata)
-    {
-        return printLensId(os, value, metadata, "NikonLd1");
-    }
-
-    std::ostream& Nikon3MakerNote::printLensId2(std::ostream& os,
-                                                const Value& value,
-                                                const ExifData* metadata)
-    {
-        return printLensId(os, value, metadata, "NikonLd2");
-    }
-
-    std::ostream& Nikon3MakerNote::printLensId3(std::ostream& os,
-                                                const Value& value,
-                                                const ExifData* metadata)
-    {
-        return printLensId(os, value, metadata, "NikonLd3");
-    }
-
-    std::ostream& Nikon3MakerNote::printLensId(std::ostream& os,
-                                               const Value& value,
-                                               const ExifData* metadata,
-                                               const std::string& group)
-    {
 #ifdef EXV_HAVE_LENSDATA
 // 8< - - - 8< do not remove this line >8 - - - >8
 //------------------------------------------------------------------------------
@@ -2277,48 +2254,111 @@ fmountlens[] = {
 #endif
 // 8< - - - 8< do not remove this line >8 - - - >8
 
+    namespace {
+        //! Pack the bytes which identify an F-mount lens into one key
+        uint64_t fmountLensKey(const byte* raw)
+        {
+            uint64_t key = 0;
+            for (int i = 0; i < 8; ++i) key = (key << 8) | raw[i];
+            return key;
+        }
+
+        //! Type of the index of the F-mount lens database: packed key and row
+        typedef std::vector<std::pair<uint64_t, int> > FMountLensIndex;
+
+        //! Index the F-mount lens database, rows with the same key remain in table order
+        FMountLensIndex indexFMountLenses()
+        {
+            FMountLensIndex index;
+            for (int i = 0; fmountlens[i].lensname != NULL; ++i) {
+                const byte raw[] = {
+                    fmountlens[i].lid, fmountlens[i].stps, fmountlens[i].focs, fmountlens[i].focl,
+                    fmountlens[i].aps, fmountlens[i].apl, fmountlens[i].lfw, fmountlens[i].ltype
+                };
+                index.push_back(std::make_pair(fmountLensKey(raw), i));
+            }
+            std::sort(index.begin(), index.end());
+            return index;
+        }
+
+        //! Index of the F-mount lens database, built once
+        const FMountLensIndex fmountLensIndex = indexFMountLenses();
+    }
+#endif // EXV_HAVE_LENSDATA
+
+    namespace {
+        //! Keys of Exif.Nikon3.LensType and the LensIDNumber tags, built once
+        const ExifKey lensTypeKey(0x0083, "Nikon3");
+        const ExifKey lensIdKey1(6, "NikonLd1");
+        const ExifKey lensIdKey2(11, "NikonLd2");
+        const ExifKey lensIdKey3(12, "NikonLd3");
+    }
+
+    std::ostream& Nikon3MakerNote::printLensId1(std::ostream& os,
+                                                const Value& value,
+                                                const ExifData* metadata)
+    {
+        return printLensId(os, value, metadata, lensIdKey1);
+    }
+
+    std::ostream& Nikon3MakerNote::printLensId2(std::ostream& os,
+                                                const Value& value,
+                                                const ExifData* metadata)
+    {
+        return printLensId(os, value, metadata, lensIdKey2);
+    }
+
+    std::ostream& Nikon3MakerNote::printLensId3(std::ostream& os,
+                                                const Value& value,
+                                                const ExifData* metadata)
+    {
+        return printLensId(os, value, metadata, lensIdKey3);
+    }
+
+    std::ostream& Nikon3MakerNote::printLensId(std::ostream& os,
+                                               const Value& value,
+                                               const ExifData* metadata,
+                                               const ExifKey& lensIdKey)
+    {
+#ifdef EXV_HAVE_LENSDATA
         if (metadata == 0) return os << value;
 
         byte raw[] = { 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0 };
 
-        static const char* tags[] = {
-            "LensIDNumber",
-            "LensFStops",
-            "MinFocalLength",
-            "MaxFocalLength",
-            "MaxApertureAtMinFocal",
-            "MaxApertureAtMaxFocal",
-            "MCUVersion"
-        };
-
-        const std::string pre = std::string("Exif.") + group + std::string(".");
-        for (unsigned int i = 0; i < 7; ++i) {
-            ExifKey key(pre + std::string(tags[i]));
-            ExifData::const_iterator md = metadata->findKey(key);
-            if (md == metadata->end() || md->typeId() != unsignedByte || md->count() == 0) {
+        // LensIDNumber, LensFStops, MinFocalLength, MaxFocalLength,
+        // MaxApertureAtMinFocal, MaxApertureAtMaxFocal and MCUVersion
+        // are consecutive tags in all versions of the lens data. The
+        // decoder adds them one after the other, search only for those
+        // which are not.
+        const uint16_t tag = lensIdKey.tag();
+        const int group = lensIdKey.ifdId();
+        ExifData::const_iterator md = metadata->findKey(lensIdKey);
+        for (uint16_t i = 0; i < 8; ++i) {
+            if (i == 7) {
+                md = metadata->findKey(lensTypeKey);
+            }
+            else if (i > 0) {
+                ++md;
+                if (   md == metadata->end()
+                    || md->tag() != tag + i || md->ifdId() != group) {
+                    md = metadata->findKey(ExifKey(tag + i, lensIdKey.groupName()));
+                }
+            }
+            if (   md == metadata->end()
+                || md->typeId() != unsignedByte || md->count() == 0) {
                 return os << value;
             }
             raw[i] = static_cast<byte>(md->toLong());
         }
 
-        ExifData::const_iterator md = metadata->findKey(ExifKey("Exif.Nikon3.LensType"));
-        if (md == metadata->end() || md->typeId() != unsignedByte || md->count() == 0) {
-            return os << value;
-        }
-        raw[7] = static_cast<byte>(md->toLong());
-
-        for (int i = 0; fmountlens[i].lensname != NULL; ++i) {
-            if (   raw[0] == fmountlens[i].lid
-                && raw[1] == fmountlens[i].stps
-                && raw[2] == fmountlens[i].focs
-                && raw[3] == fmountlens[i].focl
-                && raw[4] == fmountlens[i].aps
-                && raw[5] == fmountlens[i].apl
-                && raw[6] == fmountlens[i].lfw
-                && raw[7] == fmountlens[i].ltype) {
-                // Lens found in database
-                return os << fmountlens[i].manuf << " " << fmountlens[i].lensname;
-            }
+        const uint64_t key = fmountLensKey(raw);
+        FMountLensIndex::const_iterator pos
+            = std::lower_bound(fmountLensIndex.begin(), fmountLensIndex.end(),
+                               std::make_pair(key, 0));
+        if (pos != fmountLensIndex.end() && pos->first == key) {
+            // Lens found in database
+            const int i = pos->second;
+            return os << fmountlens[i].manuf << " " << fmountlens[i].lensname;
         }
         // Lens not found in database
         return os << value;
@@ -46,6 +46,7 @@
 // *****************************************************************************
 // included header files
 #include "tags.hpp"
+#include "tags_int.hpp"
 #include "types.hpp"
 
 // + standard includes
@@ -186,8 +187,11 @@ namespace Exiv2 {
         static std::ostream& print0x008b(std::ostream& os, const Value& value, const ExifData*);
         //! Print AF Points In Focus
         static std::ostream& printAfPointsInFocus(std::ostream& os, const Value& value, const ExifData* metadata);
-        //! Print lens name
-        static std::ostream& printLensId(std::ostream& os, const Value& value, const ExifData* metadata, const std::string& group);
+        /*!
+          @brief Print lens name, from the lens data which starts with the
+                 LensIDNumber \em lensIdKey, and Exif.Nikon3.LensType.
+         */
+        static std::ostream& printLensId(std::ostream& os, const Value& value, const ExifData* metadata, const ExifKey& lensIdKey);
         static std::ostream& printLensId1(std::ostream& os, const Value& value, const ExifData* metadata);
         static std::ostream& printLensId2(std::ostream& os, const Value& value, const ExifData* metadata);
         static std::ostream& printLensId3(std::ostream& os, const Value& value, const ExifData* metadata);
@@ -38,6 +38,8 @@ EXIV2_RCSID("@(#) $Id$")
 #endif
 
 #include "orfimage.hpp"
+#include "arena_int.hpp"
+#include "parsebudget_int.hpp"
 #include "orfimage_int.hpp"
 #include "tiffcomposite_int.hpp"
 #include "tiffimage_int.hpp"
@@ -94,6 +96,8 @@ namespace Exiv2 {
 
     void OrfImage::readMetadata()
     {
+        Internal::ArenaScope arenaScope(useArena());
+        Internal::ParseBudgetScope budgetScope(parseLimits());
 #ifdef DEBUG
         std::cerr << "Reading ORF file " << io_->path() << "\n";
 #endif
@@ -111,7 +115,8 @@ namespace Exiv2 {
                                          iptcData_,
                                          xmpData_,
                                          io_->mmap(),
-                                         io_->size());
+                                         io_->size(),
+                                         readOptions());
         setByteOrder(bo);
     } // OrfImage::readMetadata
 
@@ -142,12 +147,30 @@ namespace Exiv2 {
         OrfParser::encode(*io_, pData, size, bo, exifData_, iptcData_, xmpData_); // may throw
     } // OrfImage::writeMetadata
 
+    bool OrfImage::patchInPlace(const ExifKey& key, const Value& value)
+    {
+        if (io_->open() != 0) throw Error(9, io_->path(), strError());
+        IoCloser closer(*io_);
+        // Ensure that this is the correct image type
+        if (!isOrfType(*io_, false)) {
+            if (io_->error() || io_->eof()) throw Error(14);
+            throw Error(3, "ORF");
+        }
+        if (!OrfParser::patch(io_->mmap(true), io_->size(), key, value)) {
+            return false;
+        }
+        ExifData::iterator pos = exifData_.findKey(key);
+        if (pos != exifData_.end()) pos->setValue(&value);
+        return true;
+    } // OrfImage::patchInPlace
+
     ByteOrder OrfParser::decode(
               ExifData& exifData,
               IptcData& iptcData,
               XmpData&  xmpData,
         const byte*     pData,
-              uint32_t  size
+              uint32_t  size,
+        const ReadOptions* pOptions
     )
     {
         OrfHeader orfHeader;
@@ -158,7 +181,8 @@ namespace Exiv2 {
                                         size,
                                         Tag::root,
                                         TiffMapping::findDecoder,
-                                        &orfHeader);
+                                        &orfHeader,
+                                        pOptions);
     }
 
     WriteMethod OrfParser::encode(
@@ -200,6 +224,17 @@ namespace Exiv2 {
                                         header.get());
     }
 
+    bool OrfParser::patch(
+              byte*     pData,
+              uint32_t  size,
+        const ExifKey&  key,
+        const Value&    value
+    )
+    {
+        OrfHeader orfHeader;
+        return TiffParserWorker::patch(pData, size, Tag::root, &orfHeader, key, value);
+    }
+
     // *************************************************************************
     // free functions
     Image::AutoPtr newOrfInstance(BasicIo::AutoPtr io, bool create)
@@ -79,7 +79,13 @@ namespace Exiv2 {
         //! @name Manipulators
         //@{
         void readMetadata();
+        using Image::readMetadata;
         void writeMetadata();
+        /*!
+          @brief Overwrite the value of the Exif tag \em key in the ORF file,
+              see Image::patchInPlace().
+         */
+        bool patchInPlace(const ExifKey& key, const Value& value);
         /*!
           @brief Not supported. ORF format does not contain a comment.
               Calling this function will throw an Error(32).
@@ -122,7 +128,8 @@ namespace Exiv2 {
                   IptcData& iptcData,
                   XmpData&  xmpData,
             const byte*     pData,
-                  uint32_t  size
+                  uint32_t  size,
+            const ReadOptions* pOptions =0
         );
         /*!
           @brief Encode metadata from the provided metadata to ORF format.
@@ -137,6 +144,16 @@ namespace Exiv2 {
             const IptcData& iptcData,
             const XmpData&  xmpData
         );
+        /*!
+          @brief Overwrite the value of the Exif tag \em key in a buffer
+                 with data in ORF format. See TiffParser::patch().
+        */
+        static bool patch(
+                  byte*     pData,
+                  uint32_t  size,
+            const ExifKey&  key,
+            const Value&    value
+        );
     }; // class OrfParser
 
 // *****************************************************************************
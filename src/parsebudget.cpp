@@ -0,0 +1,177 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2011 Andreas Huggel <ahuggel@gmx.net>
+ *
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+  File:      parsebudget.cpp
+  Version:   $Rev$
+  Author(s): Andreas Huggel (ahu) <ahuggel@gmx.net>
+  History:   19-Oct-26, ahu: created
+ */
+// *****************************************************************************
+#include "rcsid_int.hpp"
+EXIV2_RCSID("@(#) $Id$")
+
+// *****************************************************************************
+// included header files
+#ifdef _MSC_VER
+# include "exv_msvc.h"
+#else
+# include "exv_conf.h"
+#endif
+
+#include "parsebudget_int.hpp"
+#include "error.hpp"
+
+// + standard includes
+#include <ctime>
+#if defined WIN32 && !defined __CYGWIN__
+# include <windows.h>
+#elif defined EXV_HAVE_SYS_TIME_H
+# include <sys/time.h>
+#endif
+
+// *****************************************************************************
+// local declarations
+namespace {
+    //! Return a time stamp in milliseconds.
+    uint64_t timeStamp()
+    {
+#if defined WIN32 && !defined __CYGWIN__
+        return GetTickCount();
+#elif defined EXV_HAVE_SYS_TIME_H
+        struct timeval tv;
+        gettimeofday(&tv, 0);
+        return static_cast<uint64_t>(tv.tv_sec) * 1000 + tv.tv_usec / 1000;
+#else
+        return static_cast<uint64_t>(std::time(0)) * 1000;
+#endif
+    }
+}
+
+#if defined __GNUC__
+# define EXV_THREAD_LOCAL __thread
+#elif defined _MSC_VER
+# define EXV_THREAD_LOCAL __declspec(thread)
+#endif
+
+#ifdef EXV_THREAD_LOCAL
+//! The budget which is current for the thread, set by ParseBudgetScope
+static EXV_THREAD_LOCAL Exiv2::Internal::ParseBudget* pCurrentBudget;
+#endif
+
+// *****************************************************************************
+// class member definitions
+namespace Exiv2 {
+    namespace Internal {
+
+    ParseBudget::ParseBudget(const ParseLimits& limits)
+        : limits_(limits),
+          components_(0),
+          valueBytes_(0),
+          depth_(0),
+          start_(limits.maxTime_ != 0 ? timeStamp() : 0),
+          exceeded_(false)
+    {
+    }
+
+    bool ParseBudget::addComponents(uint32_t count)
+    {
+        if (exceeded_) return false;
+        if (   limits_.maxComponents_ != 0
+            && count > limits_.maxComponents_ - components_) {
+            return exceed("components", limits_.maxComponents_);
+        }
+        components_ += count;
+        if (   limits_.maxTime_ != 0
+            && timeStamp() - start_ > limits_.maxTime_) {
+            return exceed("milliseconds", limits_.maxTime_);
+        }
+        return true;
+    }
+
+    bool ParseBudget::addValueBytes(uint32_t size)
+    {
+        if (exceeded_) return false;
+        if (   limits_.maxValueBytes_ != 0
+            && size > limits_.maxValueBytes_ - valueBytes_) {
+            return exceed("value bytes", limits_.maxValueBytes_);
+        }
+        valueBytes_ += size;
+        return true;
+    }
+
+    bool ParseBudget::enter()
+    {
+        ++depth_;
+        if (exceeded_) return false;
+        if (limits_.maxDepth_ != 0 && depth_ > limits_.maxDepth_) {
+            return exceed("nesting levels", limits_.maxDepth_);
+        }
+        return true;
+    }
+
+    void ParseBudget::leave()
+    {
+        if (depth_ > 0) --depth_;
+    }
+
+    bool ParseBudget::exceed(const char* what, uint32_t limit)
+    {
+        exceeded_ = true;
+#ifndef SUPPRESS_WARNINGS
+        EXV_WARNING << "Parse budget of " << limit << " " << what
+                    << " exceeded; metadata truncated.\n";
+#else
+        (void)what;
+        (void)limit;
+#endif
+        return false;
+    }
+
+    ParseBudget* ParseBudget::current()
+    {
+#ifdef EXV_THREAD_LOCAL
+        return pCurrentBudget;
+#else
+        return 0;
+#endif
+    }
+
+    ParseBudgetScope::ParseBudgetScope(const ParseLimits& limits)
+        : budget_(limits), pBudget_(&budget_)
+    {
+#ifdef EXV_THREAD_LOCAL
+        if (pCurrentBudget != 0) {
+            pBudget_ = pCurrentBudget;
+        }
+        else {
+            pCurrentBudget = &budget_;
+        }
+#endif
+    }
+
+    ParseBudgetScope::~ParseBudgetScope()
+    {
+#ifdef EXV_THREAD_LOCAL
+        if (pBudget_ == &budget_) pCurrentBudget = 0;
+#endif
+    }
+
+}}                                      // namespace Internal, Exiv2
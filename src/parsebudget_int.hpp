@@ -0,0 +1,137 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2011 Andreas Huggel <ahuggel@gmx.net>
+ *
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*!
+  @file    parsebudget_int.hpp
+  @brief   Budget for the work done to parse the metadata of an image
+  @version $Rev$
+  @author  Andreas Huggel (ahu)
+           <a href="mailto:ahuggel@gmx.net">ahuggel@gmx.net</a>
+  @date    19-Oct-26, ahu: created
+ */
+#ifndef PARSEBUDGET_INT_HPP_
+#define PARSEBUDGET_INT_HPP_
+
+// *****************************************************************************
+// included header files
+#include "types.hpp"
+
+// *****************************************************************************
+// namespace extensions
+namespace Exiv2 {
+    namespace Internal {
+
+// *****************************************************************************
+// class definitions
+
+    /*!
+      @brief Counts the work done by the parsers which read the metadata of
+             one image against the ParseLimits for the image.
+
+      Parsers charge the components and value bytes they read and enter and
+      leave nesting levels. Once a limit is exceeded, a warning is issued
+      and all further charges fail, so that the parsers stop and keep what
+      they have read. The time limit is checked while components are
+      charged.
+     */
+    class ParseBudget {
+    public:
+        //! @name Creators
+        //@{
+        //! Constructor, taking the limits of the budget.
+        explicit ParseBudget(const ParseLimits& limits);
+        //@}
+
+        //! @name Manipulators
+        //@{
+        /*!
+          @brief Charge \em count components. Return false if a limit is
+                 exceeded; the components should not be read in this case.
+         */
+        bool addComponents(uint32_t count =1);
+        /*!
+          @brief Charge \em size bytes of values. Return false if a limit
+                 is exceeded; the values should not be read in this case.
+         */
+        bool addValueBytes(uint32_t size);
+        /*!
+          @brief Enter a nesting level. Return false if a limit is exceeded;
+                 the level should not be read in this case. Each call must
+                 be paired with a call to leave(), also if it fails.
+         */
+        bool enter();
+        //! Leave a nesting level.
+        void leave();
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return true if a limit was exceeded.
+        bool exceeded() const { return exceeded_; }
+        //! Return the budget of the calling thread, 0 if there is none.
+        static ParseBudget* current();
+        //@}
+
+    private:
+        //! Mark the budget exceeded and issue a warning for \em what.
+        bool exceed(const char* what, uint32_t limit);
+
+        friend class ParseBudgetScope;
+
+        // DATA
+        ParseLimits limits_;            //!< The limits of the budget
+        uint32_t    components_;        //!< Components charged so far
+        uint32_t    valueBytes_;        //!< Value bytes charged so far
+        uint32_t    depth_;             //!< Current nesting level
+        uint64_t    start_;             //!< Time stamp of the start in ms
+        bool        exceeded_;          //!< True once a limit was exceeded
+
+    }; // class ParseBudget
+
+    /*!
+      @brief Make a budget with the given limits current for the calling
+             thread for the lifetime of the scope object, unless a budget is
+             current already. Nested parsers thus share the budget of the
+             outermost scope, e.g., the one of Image::readMetadata(), which
+             applies the limits set for the image.
+     */
+    class ParseBudgetScope {
+    public:
+        //! Constructor, taking the limits for a new budget.
+        explicit ParseBudgetScope(const ParseLimits& limits =ParseLimits());
+        //! Destructor, resets the current budget if the scope created it.
+        ~ParseBudgetScope();
+        //! Return the budget in effect for the scope.
+        ParseBudget& budget() { return *pBudget_; }
+
+    private:
+        // NOT implemented
+        ParseBudgetScope(const ParseBudgetScope& rhs);
+        ParseBudgetScope& operator=(const ParseBudgetScope& rhs);
+
+        // DATA
+        ParseBudget  budget_;           //!< The budget created by this scope
+        ParseBudget* pBudget_;          //!< The budget in effect
+
+    }; // class ParseBudgetScope
+
+}}                                      // namespace Internal, Exiv2
+
+#endif                                  // #ifndef PARSEBUDGET_INT_HPP_
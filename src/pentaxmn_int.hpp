@@ -103,7 +103,7 @@ namespace Exiv2 {
             }
             l += (value.toLong(c) << ((count - c - 1) * 8));
         }
-        const TagDetails* td = find(array, l);
+        const TagDetails* td = IndexedTagDetails<N, array>::index_.find(static_cast<long>(l));
         if (td) {
             os << exvGettext(td->label_);
         }
@@ -42,6 +42,8 @@ EXIV2_RCSID("@(#) $Id$")
 #endif
 
 #include "pgfimage.hpp"
+#include "arena_int.hpp"
+#include "parsebudget_int.hpp"
 #include "image.hpp"
 #include "pngimage.hpp"
 #include "basicio.hpp"
@@ -94,6 +96,8 @@ namespace Exiv2 {
 
     void PgfImage::readMetadata()
     {
+        Internal::ArenaScope arenaScope(useArena());
+        Internal::ParseBudgetScope budgetScope(parseLimits());
 #ifdef DEBUG
         std::cerr << "Exiv2::PgfImage::readMetadata: Reading PGF file " << io_->path() << "\n";
 #endif
@@ -135,9 +139,9 @@ namespace Exiv2 {
 
         Image::AutoPtr image = Exiv2::ImageFactory::open(imgData.pData_, imgData.size_);
         image->readMetadata();
-        exifData() = image->exifData();
-        iptcData() = image->iptcData();
-        xmpData()  = image->xmpData();
+        exifData_.swap(image->exifData());
+        iptcData_.swap(image->iptcData());
+        xmpData_.swap(image->xmpData());
 
     } // PgfImage::readMetadata
 
@@ -46,6 +46,7 @@ extern "C" {
 
 #include "pngchunk_int.hpp"
 #include "tiffimage.hpp"
+#include "tiffimage_int.hpp"
 #include "jpgimage.hpp"
 #include "exif.hpp"
 #include "iptc.hpp"
@@ -232,12 +233,16 @@ namespace Exiv2 {
                                            long    keySize,
                                      const DataBuf arr)
     {
+        // Metadata which is not selected is not decoded
+        const ReadOptions* pOptions = pImage->readOptions();
+
         // We look if an ImageMagick EXIF raw profile exist.
 
         if (   keySize >= 21 
             && (   memcmp("Raw profile type exif", key, 21) == 0
                 || memcmp("Raw profile type APP1", key, 21) == 0)
-            && pImage->exifData().empty())
+            && pImage->exifData().empty()
+            && (!pOptions || pOptions->selected(mdExif)))
         {
             DataBuf exifData = readRawProfile(arr);
             long length      = exifData.size_;
@@ -266,11 +271,12 @@ namespace Exiv2 {
                     std::cout << "Exiv2::PngChunk::parseChunkContent: Exif header found at position " << pos << "\n";
 #endif
                     pos = pos + sizeof(exifHeader);
-                    ByteOrder bo = TiffParser::decode(pImage->exifData(),
-                                                      pImage->iptcData(),
-                                                      pImage->xmpData(),
-                                                      exifData.pData_ + pos,
-                                                      length - pos);
+                    ByteOrder bo = Internal::decodeTiff(pImage->exifData(),
+                                                        pImage->iptcData(),
+                                                        pImage->xmpData(),
+                                                        exifData,
+                                                        pos,
+                                                        pOptions);
                     pImage->setByteOrder(bo);
                 }
                 else
@@ -287,7 +293,8 @@ namespace Exiv2 {
 
         if (   keySize >= 21
             && memcmp("Raw profile type iptc", key, 21) == 0
-            && pImage->iptcData().empty()) {
+            && pImage->iptcData().empty()
+            && (!pOptions || pOptions->selected(mdIptc))) {
             DataBuf psData = readRawProfile(arr);
             if (psData.size_ > 0) {
                 Blob iptcBlob;
@@ -338,7 +345,8 @@ namespace Exiv2 {
 
         if (   keySize >= 20
             && memcmp("Raw profile type xmp", key, 20) == 0
-            && pImage->xmpData().empty()) 
+            && pImage->xmpData().empty()
+            && (!pOptions || pOptions->selected(mdXmp)))
         {
             DataBuf xmpBuf = readRawProfile(arr);
             long length    = xmpBuf.size_;
@@ -369,7 +377,8 @@ namespace Exiv2 {
 
         if (   keySize >= 17
             && memcmp("XML:com.adobe.xmp", key, 17) == 0
-            && pImage->xmpData().empty())
+            && pImage->xmpData().empty()
+            && (!pOptions || pOptions->selected(mdXmp)))
         {
             if (arr.size_ > 0)
             {
@@ -398,7 +407,8 @@ namespace Exiv2 {
 
         if (   keySize >= 11
             && memcmp("Description", key, 11) == 0
-            && pImage->comment().empty())
+            && pImage->comment().empty()
+            && (!pOptions || pOptions->selected(mdComment)))
         {
             pImage->comment().assign(reinterpret_cast<char*>(arr.pData_), arr.size_);
         }
@@ -44,6 +44,8 @@ EXIV2_RCSID("@(#) $Id$")
 #ifdef EXV_HAVE_LIBZ
 #include "pngchunk_int.hpp"
 #include "pngimage.hpp"
+#include "arena_int.hpp"
+#include "parsebudget_int.hpp"
 #include "jpgimage.hpp"
 #include "image.hpp"
 #include "basicio.hpp"
@@ -102,6 +104,8 @@ namespace Exiv2 {
 
     void PngImage::readMetadata()
     {
+        Internal::ArenaScope arenaScope(useArena());
+        Internal::ParseBudgetScope budgetScope(parseLimits());
 #ifdef DEBUG
         std::cerr << "Exiv2::PngImage::readMetadata: Reading PNG file " << io_->path() << "\n";
 #endif
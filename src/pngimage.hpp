@@ -85,6 +85,7 @@ namespace Exiv2
         //! @name Manipulators
         //@{
         void readMetadata();
+        using Image::readMetadata;
         void writeMetadata();
         //@}
 
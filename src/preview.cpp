@@ -795,7 +795,8 @@ namespace {
             }
         }
 
-        Value &dataValue = const_cast<Value&>(preview["Exif.Image." + offsetTag_].value());
+        Exifdatum &dataDatum = preview["Exif.Image." + offsetTag_];
+        const Value &dataValue = dataDatum.value();
 
         if (dataValue.sizeDataArea() == 0) {
             // image data are not available via exifData, read them from image_.io()
@@ -816,7 +817,7 @@ namespace {
                     uint32_t offset = dataValue.toLong(0);
                     uint32_t size = sizes.toLong(0);
                     if (offset + size <= static_cast<uint32_t>(io.size()))
-                        dataValue.setDataArea(base + offset, size);
+                        dataDatum.setDataArea(base + offset, size);
                 }
                 else {
                     // FIXME: the buffer is probably copied twice, it should be optimized
@@ -829,7 +830,7 @@ namespace {
                             memcpy(pos, base + offset, size);
                         pos += size;
                     }
-                    dataValue.setDataArea(buf.pData_, buf.size_);
+                    dataDatum.setDataArea(buf.pData_, buf.size_);
                 }
             }
         }
@@ -33,6 +33,7 @@ EXIV2_RCSID("@(#) $Id$")
 // included header files
 #include "properties.hpp"
 #include "tags_int.hpp"
+#include "arena_int.hpp"
 #include "error.hpp"
 #include "types.hpp"
 #include "value.hpp"
@@ -1198,6 +1199,11 @@ namespace Exiv2 {
         Impl() {}                       //!< Default constructor
         Impl(const std::string& prefix, const std::string& property); //!< Constructor
 
+        //! Allocate from the metadata arena, if one is in use
+        static void* operator new(std::size_t size) { return Internal::Arena::allocate(size); }
+        //! Release memory allocated with operator new
+        static void operator delete(void* p) { Internal::Arena::deallocate(p); }
+
         /*!
           @brief Parse and convert the \em key string into property and prefix.
                  Updates data members if the string can be decomposed, or throws
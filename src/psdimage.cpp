@@ -39,6 +39,9 @@ EXIV2_RCSID("@(#) $Id$")
 # include "exv_conf.h"
 #endif
 #include "psdimage.hpp"
+#include "tiffimage_int.hpp"
+#include "arena_int.hpp"
+#include "parsebudget_int.hpp"
 #include "image.hpp"
 #include "basicio.hpp"
 #include "error.hpp"
@@ -150,6 +153,8 @@ namespace Exiv2 {
 
     void PsdImage::readMetadata()
     {
+        Internal::ArenaScope arenaScope(useArena());
+        Internal::ParseBudgetScope budgetScope(parseLimits());
 #ifdef DEBUG
         std::cerr << "Exiv2::PsdImage::readMetadata: Reading Photoshop file " << io_->path() << "\n";
 #endif
@@ -271,9 +276,11 @@ namespace Exiv2 {
                 DataBuf rawExif(resourceSize);
                 io_->read(rawExif.pData_, rawExif.size_);
                 if (io_->error() || io_->eof()) throw Error(14);
-                ByteOrder bo = ExifParser::decode(exifData_, rawExif.pData_, rawExif.size_);
+                // The decoded values refer to the buffer, which is taken over
+                const long rawSize = rawExif.size_;
+                ByteOrder bo = Internal::decodeExif(exifData_, rawExif, readOptions());
                 setByteOrder(bo);
-                if (rawExif.size_ > 0 && byteOrder() == invalidByteOrder) {
+                if (rawSize > 0 && byteOrder() == invalidByteOrder) {
 #ifndef SUPPRESS_WARNINGS
                     EXV_WARNING << "Failed to decode Exif metadata.\n";
 #endif
@@ -288,7 +295,9 @@ namespace Exiv2 {
                 io_->read(xmpPacket.pData_, xmpPacket.size_);
                 if (io_->error() || io_->eof()) throw Error(14);
                 xmpPacket_.assign(reinterpret_cast<char *>(xmpPacket.pData_), xmpPacket.size_);
-                if (xmpPacket_.size() > 0 && XmpParser::decode(xmpData_, xmpPacket_)) {
+                if (   xmpPacket_.size() > 0
+                    && (!readOptions() || readOptions()->selected(mdXmp))
+                    && XmpParser::decode(xmpData_, xmpPacket_)) {
 #ifndef SUPPRESS_WARNINGS
                     EXV_WARNING << "Failed to decode XMP metadata.\n";
 #endif
@@ -87,6 +87,7 @@ namespace Exiv2 {
         //! @name Manipulators
         //@{
         void readMetadata();
+        using Image::readMetadata;
         void writeMetadata();
         /*!
           @brief Not supported. Calling this function will throw an Error(32).
@@ -38,6 +38,8 @@ EXIV2_RCSID("@(#) $Id$")
 #endif
 
 #include "rafimage.hpp"
+#include "arena_int.hpp"
+#include "parsebudget_int.hpp"
 #include "tiffimage.hpp"
 #include "image.hpp"
 #include "basicio.hpp"
@@ -102,6 +104,8 @@ namespace Exiv2 {
 
     void RafImage::readMetadata()
     {
+        Internal::ArenaScope arenaScope(useArena());
+        Internal::ParseBudgetScope budgetScope(parseLimits());
 #ifdef DEBUG
         std::cerr << "Reading RAF file " << io_->path() << "\n";
 #endif
@@ -122,7 +126,8 @@ namespace Exiv2 {
                                           iptcData_,
                                           xmpData_,
                                           pData + start,
-                                          size - start);
+                                          size - start,
+                                          readOptions());
 
         exifData_["Exif.Image2.JPEGInterchangeFormat"] = getULong(pData + 84, bigEndian);
         exifData_["Exif.Image2.JPEGInterchangeFormatLength"] = getULong(pData + 88, bigEndian);
@@ -79,6 +79,7 @@ namespace Exiv2 {
         //! @name Manipulators
         //@{
         void readMetadata();
+        using Image::readMetadata;
         /*!
           @brief Todo: Write metadata back to the image. This method is not
               yet implemented. Calling it will throw an Error(31).
@@ -89,11 +90,13 @@ namespace Exiv2 {
               this function will throw an Error(32).
          */
         void setExifData(const ExifData& exifData);
+        using Image::setExifData;
         /*!
           @brief Todo: Not supported yet, requires writeMetadata(). Calling
               this function will throw an Error(32).
          */
         void setIptcData(const IptcData& iptcData);
+        using Image::setIptcData;
         /*!
           @brief Not supported. RAF format does not contain a comment.
               Calling this function will throw an Error(32).
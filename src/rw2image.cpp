@@ -38,6 +38,8 @@ EXIV2_RCSID("@(#) $Id$")
 #endif
 
 #include "rw2image.hpp"
+#include "arena_int.hpp"
+#include "parsebudget_int.hpp"
 #include "rw2image_int.hpp"
 #include "tiffcomposite_int.hpp"
 #include "tiffimage_int.hpp"
@@ -107,6 +109,8 @@ namespace Exiv2 {
 
     void Rw2Image::readMetadata()
     {
+        Internal::ArenaScope arenaScope(useArena());
+        Internal::ParseBudgetScope budgetScope(parseLimits());
 #ifdef DEBUG
         std::cerr << "Reading RW2 file " << io_->path() << "\n";
 #endif
@@ -124,7 +128,8 @@ namespace Exiv2 {
                                          iptcData_,
                                          xmpData_,
                                          io_->mmap(),
-                                         io_->size());
+                                         io_->size(),
+                                         readOptions());
         setByteOrder(bo);
 
         // A lot more metadata is hidden in the embedded preview image
@@ -205,10 +210,8 @@ namespace Exiv2 {
             }
         }
 
-        // Add the remaining tags
-        for (ExifData::const_iterator pos = prevData.begin(); pos != prevData.end(); ++pos) {
-            exifData_.add(*pos);
-        }
+        // Move the remaining tags
+        exifData_.append(prevData);
 
     } // Rw2Image::readMetadata
 
@@ -223,7 +226,8 @@ namespace Exiv2 {
               IptcData& iptcData,
               XmpData&  xmpData,
         const byte*     pData,
-              uint32_t  size
+              uint32_t  size,
+        const ReadOptions* pOptions
     )
     {
         Rw2Header rw2Header;
@@ -234,7 +238,8 @@ namespace Exiv2 {
                                         size,
                                         Tag::pana,
                                         TiffMapping::findDecoder,
-                                        &rw2Header);
+                                        &rw2Header,
+                                        pOptions);
     }
 
     // *************************************************************************
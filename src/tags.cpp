@@ -35,6 +35,8 @@ EXIV2_RCSID("@(#) $Id$")
 #include "types.hpp"
 #include "tags.hpp"
 #include "tags_int.hpp"
+#include "exif.hpp"
+#include "arena_int.hpp"
 #include "error.hpp"
 #include "futils.hpp"
 #include "value.hpp"
@@ -56,6 +58,7 @@ EXIV2_RCSID("@(#) $Id$")
 #include <iomanip>
 #include <sstream>
 #include <utility>
+#include <algorithm>
 #include <cstdlib>
 #include <cassert>
 #include <cmath>
@@ -213,6 +216,51 @@ namespace Exiv2 {
         return 0 == strcmp(voc_, key.c_str() + key.size() - strlen(voc_));
     }
 
+    namespace {
+        //! Order rows of a TagDetails table by value
+        bool cmpTagDetailsVal(const TagDetails* lhs, const TagDetails* rhs)
+        {
+            return lhs->val_ < rhs->val_;
+        }
+
+        //! Order a row of a TagDetails table and a value
+        bool cmpTagDetailsKey(const TagDetails* lhs, long val)
+        {
+            return lhs->val_ < val;
+        }
+    }
+
+    TagDetailsIndex::TagDetailsIndex(const TagDetails* table, int size)
+    {
+        rows_.reserve(size);
+        for (int i = 0; i < size; ++i) rows_.push_back(table + i);
+        std::stable_sort(rows_.begin(), rows_.end(), cmpTagDetailsVal);
+    }
+
+    const TagDetails* TagDetailsIndex::find(long val) const
+    {
+        Rows::const_iterator pos = std::lower_bound(rows_.begin(), rows_.end(), val, cmpTagDetailsKey);
+        if (pos == rows_.end() || (*pos)->val_ != val) return 0;
+        return *pos;
+    }
+
+    std::pair<TagDetailsIndex::Rows::const_iterator, TagDetailsIndex::Rows::const_iterator>
+    TagDetailsIndex::equalRange(long val) const
+    {
+        Rows::const_iterator first = std::lower_bound(rows_.begin(), rows_.end(), val, cmpTagDetailsKey);
+        Rows::const_iterator last = first;
+        while (last != rows_.end() && (*last)->val_ == val) ++last;
+        return std::make_pair(first, last);
+    }
+
+    const Exifdatum* findTag(const ExifData& metadata, uint16_t tag, IfdId group)
+    {
+        for (ExifData::const_iterator i = metadata.begin(); i != metadata.end(); ++i) {
+            if (i->tag() == tag && i->ifdId() == group) return &(*i);
+        }
+        return 0;
+    }
+
     //! NewSubfileType, TIFF tag 0x00fe - this is actually a bitmask
     extern const TagDetails exifNewSubfileType[] = {
         {  0, N_("Primary image")                                               },
@@ -2881,6 +2929,11 @@ namespace Exiv2 {
         Impl();                         //!< Default constructor
         //@}
 
+        //! Allocate from the metadata arena, if one is in use
+        static void* operator new(std::size_t size) { return Arena::allocate(size); }
+        //! Release memory allocated with operator new
+        static void operator delete(void* p) { Arena::deallocate(p); }
+
         //! @name Manipulators
         //@{
         /*!
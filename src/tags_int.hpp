@@ -40,12 +40,14 @@
 #include <string>
 #include <iostream>
 #include <memory>
+#include <vector>
 
 // *****************************************************************************
 // namespace extensions
 
 namespace Exiv2 {
     class ExifData;
+    class Exifdatum;
 
     namespace Internal {
 
@@ -186,6 +188,51 @@ namespace Exiv2 {
         bool operator==(long key) const { return val_ == key; }
     }; // struct TagDetails
 
+    /*!
+      @brief Index of a TagDetails lookup table by tag value, for tables
+             which are too large to search linearly, e.g., lens databases.
+             The rows of the table are not copied, rows with the same value
+             remain in the order of the table.
+     */
+    class TagDetailsIndex {
+    public:
+        //! Type of the list of rows, sorted by value
+        typedef std::vector<const TagDetails*> Rows;
+
+        //! @name Creators
+        //@{
+        //! Constructor, indexes the \em size rows of \em table
+        TagDetailsIndex(const TagDetails* table, int size);
+        //@}
+
+        //! @name Accessors
+        //@{
+        /*!
+          @brief Return the first row of the table with value \em val, 0 if
+                 there is none. Same as find(table, val).
+         */
+        const TagDetails* find(long val) const;
+        //! Return the range of rows with value \em val, in the order of the table
+        std::pair<Rows::const_iterator, Rows::const_iterator> equalRange(long val) const;
+        //@}
+
+    private:
+        // DATA
+        Rows rows_;                             //!< Rows of the table, sorted by value
+    }; // class TagDetailsIndex
+
+    /*!
+      @brief The index of the TagDetails lookup table \em array, for print
+             function templates. It is built when the library is loaded.
+     */
+    template <int N, const TagDetails (&array)[N]>
+    struct IndexedTagDetails {
+        static const TagDetailsIndex index_;    //!< Index of the table
+    };
+
+    template <int N, const TagDetails (&array)[N]>
+    const TagDetailsIndex IndexedTagDetails<N, array>::index_(array, N);
+
     /*!
       @brief Helper structure for lookup tables for translations of bitmask
              values to human readable labels.
@@ -289,6 +336,13 @@ namespace Exiv2 {
 // *****************************************************************************
 // free functions
 
+    /*!
+      @brief Return the first Exif datum of \em metadata with tag \em tag
+             in group \em group, 0 if there is none. Compares tag and group
+             numbers instead of keys, for print functions which need the
+             values of other tags.
+     */
+    const Exifdatum* findTag(const ExifData& metadata, uint16_t tag, IfdId group);
     //! Return read-only list of built-in IFD0/1 tags
     const TagInfo* ifdTagList();
     //! Return read-only list of built-in Exif IFD tags
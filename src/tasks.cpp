@@ -0,0 +1,209 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2011 Andreas Huggel <ahuggel@gmx.net>
+ *
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+  File:      tasks.cpp
+  Version:   $Rev$
+  Author(s): Andreas Huggel (ahu) <ahuggel@gmx.net>
+  History:   19-Oct-26, ahu: created
+ */
+// *****************************************************************************
+#include "rcsid_int.hpp"
+EXIV2_RCSID("@(#) $Id$")
+
+// *****************************************************************************
+// included header files
+#ifdef _MSC_VER
+# include "exv_msvc.h"
+#else
+# include "exv_conf.h"
+#endif
+
+#include "tasks_int.hpp"
+#include "arena_int.hpp"
+#include "error.hpp"
+
+// + standard includes
+#include <string>
+#include <new>
+#include <exception>
+#if defined WIN32 && !defined __CYGWIN__
+# include <windows.h>
+# include <process.h>
+#elif defined EXV_HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+// *****************************************************************************
+// local declarations
+namespace {
+
+    using Exiv2::Internal::Task;
+
+    //! The exception thrown by a task, kept to rethrow it on the calling thread
+    class TaskError {
+    public:
+        //! Default constructor, no exception
+        TaskError() : failed_(false), badAlloc_(false) {}
+        //! Keep a copy of the exception which is being handled
+        void keep();
+        //! Rethrow the exception, if there is one
+        void rethrow() const;
+
+    private:
+        // DATA
+        bool failed_;                       //!< True if the task threw
+        bool badAlloc_;                     //!< True if it threw std::bad_alloc
+        std::vector<Exiv2::Error> error_;   //!< The Error it threw (at most one)
+#ifdef EXV_UNICODE_PATH
+        std::vector<Exiv2::WError> wError_; //!< The WError it threw (at most one)
+#endif
+        std::string what_;                  //!< Message of any other exception
+
+    }; // class TaskError
+
+    //! The tasks of one call to runTasks(), shared by its threads
+    struct TaskQueue {
+        const std::vector<Task*>* pTasks_;  //!< The tasks
+        std::vector<TaskError>*   pErrors_; //!< Exceptions thrown by the tasks, by task
+        long next_;                         //!< Number of tasks taken, updated atomically
+    };
+
+    //! Run the tasks of \em queue until there are none left.
+    void runQueue(TaskQueue& queue)
+    {
+        const long size = static_cast<long>(queue.pTasks_->size());
+        for (;;) {
+            const long i = Exiv2::Internal::atomicIncrement(queue.next_) - 1;
+            if (i >= size) break;
+            try {
+                (*queue.pTasks_)[i]->run();
+            }
+            catch (...) {
+                (*queue.pErrors_)[i].keep();
+            }
+        }
+    }
+
+    void TaskError::keep()
+    {
+        failed_ = true;
+        try {
+            try {
+                throw;
+            }
+            catch (const Exiv2::Error& error) {
+                error_.push_back(error);
+            }
+#ifdef EXV_UNICODE_PATH
+            catch (const Exiv2::WError& error) {
+                wError_.push_back(error);
+            }
+#endif
+            catch (const std::bad_alloc&) {
+                badAlloc_ = true;
+            }
+            catch (const std::exception& error) {
+                what_ = error.what();
+            }
+            catch (...) {
+                what_ = "Unknown exception";
+            }
+        }
+        catch (...) {
+            // Copying the exception failed
+            badAlloc_ = true;
+        }
+    }
+
+    void TaskError::rethrow() const
+    {
+        if (!error_.empty()) throw error_[0];
+#ifdef EXV_UNICODE_PATH
+        if (!wError_.empty()) throw wError_[0];
+#endif
+        if (badAlloc_) throw std::bad_alloc();
+        if (failed_) throw Exiv2::Error(1, what_);
+    }
+
+#if defined WIN32 && !defined __CYGWIN__
+    //! Entry function of the additional threads
+    unsigned __stdcall threadMain(void* arg)
+    {
+        runQueue(*static_cast<TaskQueue*>(arg));
+        return 0;
+    }
+#elif defined EXV_HAVE_PTHREAD
+    //! Entry function of the additional threads
+    void* threadMain(void* arg)
+    {
+        runQueue(*static_cast<TaskQueue*>(arg));
+        return 0;
+    }
+#endif
+
+}
+
+// *****************************************************************************
+// free functions
+namespace Exiv2 {
+    namespace Internal {
+
+    void runTasks(const std::vector<Task*>& tasks, int threads)
+    {
+        std::vector<TaskError> errors(tasks.size());
+        TaskQueue queue = { &tasks, &errors, 0 };
+        // Number of threads to start in addition to the calling thread
+        long count = static_cast<long>(tasks.size());
+        if (threads < count) count = threads;
+        --count;
+#if defined WIN32 && !defined __CYGWIN__
+        std::vector<HANDLE> handles;
+        for (long i = 0; i < count; ++i) {
+            uintptr_t h = _beginthreadex(0, 0, threadMain, &queue, 0, 0);
+            if (h == 0) break; // The remaining threads do the work
+            handles.push_back(reinterpret_cast<HANDLE>(h));
+        }
+        runQueue(queue);
+        for (std::vector<HANDLE>::size_type i = 0; i < handles.size(); ++i) {
+            WaitForSingleObject(handles[i], INFINITE);
+            CloseHandle(handles[i]);
+        }
+#elif defined EXV_HAVE_PTHREAD
+        std::vector<pthread_t> ids;
+        for (long i = 0; i < count; ++i) {
+            pthread_t id;
+            if (pthread_create(&id, 0, threadMain, &queue) != 0) break;
+            ids.push_back(id);
+        }
+        runQueue(queue);
+        for (std::vector<pthread_t>::size_type i = 0; i < ids.size(); ++i) {
+            pthread_join(ids[i], 0);
+        }
+#else
+        (void)count;
+        runQueue(queue);
+#endif
+        for (std::vector<TaskError>::const_iterator i = errors.begin(); i != errors.end(); ++i) {
+            i->rethrow();
+        }
+    } // runTasks
+
+}}                                      // namespace Internal, Exiv2
@@ -0,0 +1,85 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2011 Andreas Huggel <ahuggel@gmx.net>
+ *
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*!
+  @file    tasks_int.hpp
+  @brief   Run independent tasks on a few threads
+  @version $Rev$
+  @author  Andreas Huggel (ahu)
+           <a href="mailto:ahuggel@gmx.net">ahuggel@gmx.net</a>
+  @date    19-Oct-26, ahu: created
+ */
+#ifndef TASKS_INT_HPP_
+#define TASKS_INT_HPP_
+
+// *****************************************************************************
+// included header files
+
+// + standard includes
+#include <vector>
+
+// *****************************************************************************
+// namespace extensions
+namespace Exiv2 {
+    namespace Internal {
+
+// *****************************************************************************
+// class definitions
+
+    //! A unit of work for runTasks().
+    class Task {
+    public:
+        //! Virtual destructor.
+        virtual ~Task() {}
+        /*!
+          @brief Do the work. Called from any thread. An exception thrown
+                 here is rethrown by runTasks().
+         */
+        virtual void run() =0;
+
+    }; // class Task
+
+// *****************************************************************************
+// free functions
+
+    /*!
+      @brief Run all \em tasks on up to \em threads threads, including the
+             calling thread, and return when all of them are done.
+
+      Each idle thread takes the next task in order. The tasks must be
+      independent of each other. Everything runs in the calling thread if
+      \em threads is less than 2, if there is only one task or if the
+      library is built without thread support.
+
+      The additional threads are started for each call and joined before
+      it returns; there is no pool of threads which are kept between
+      calls.
+
+      @throw Error, WError or std::bad_alloc thrown by a task, with its code
+             and arguments. If several tasks throw, the exception of the
+             first of them in the order of \em tasks is rethrown after all
+             tasks are done. Other exceptions are rethrown as Error(1)
+             with their message.
+     */
+    void runTasks(const std::vector<Task*>& tasks, int threads);
+
+}}                                      // namespace Internal, Exiv2
+
+#endif                                  // #ifndef TASKS_INT_HPP_
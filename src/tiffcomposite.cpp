@@ -40,6 +40,7 @@ EXIV2_RCSID("@(#) $Id$")
 #include "tiffcomposite_int.hpp"
 #include "tiffvisitor_int.hpp"
 #include "makernote_int.hpp"
+#include "arena_int.hpp"
 #include "value.hpp"
 #include "error.hpp"
 
@@ -54,6 +55,22 @@ EXIV2_RCSID("@(#) $Id$")
 namespace {
     //! Add \em tobe - \em curr 0x00 filler bytes if necessary
     uint32_t fillGap(Exiv2::Internal::IoWrapper& ioWrapper, uint32_t curr, uint32_t tobe);
+    /*!
+      @brief Write an \em offset from an IFD to \em buf: 8 bytes for a BigTIFF
+             IFD, else 4 bytes. Return the number of bytes written.
+     */
+    uint32_t ifdOffset2Data(Exiv2::byte* buf, int64_t offset, bool bigTiff, Exiv2::ByteOrder byteOrder);
+    /*!
+      @brief Return the \em n-th component of an offset or size \em value,
+             without truncating BigTIFF LONG8 and IFD8 values.
+     */
+    uint64_t toUInt64(const Exiv2::Value& value, long n);
+
+    /*!
+      @brief Number of modifications of components with an enabled size
+             cache. Sizes cached before the last modification are stale.
+     */
+    long sizeGeneration = 0;
 }
 
 // *****************************************************************************
@@ -63,14 +80,13 @@ namespace Exiv2 {
 
     bool TiffMappingInfo::operator==(const TiffMappingInfo::Key& key) const
     {
-        return    (   0 == strcmp("*", make_)
-                   || 0 == strncmp(make_, key.m_.c_str(), strlen(make_)))
+        return    (mfUnknown == make_ || key.m_ == make_)
                && (Tag::all == extendedTag_ || key.e_ == extendedTag_)
                && key.g_ == group_;
     }
 
-    IoWrapper::IoWrapper(BasicIo& io, const byte* pHeader, long size)
-        : io_(io), pHeader_(pHeader), size_(size), wroteHeader_(false)
+    IoWrapper::IoWrapper(BasicIo& io, const byte* pHeader, long size, CryptKey* pCryptKey)
+        : io_(io), pHeader_(pHeader), size_(size), wroteHeader_(false), pCryptKey_(pCryptKey)
     {
         if (pHeader_ == 0 || size_ == 0) wroteHeader_ = true;
     }
@@ -94,7 +110,9 @@ namespace Exiv2 {
     }
 
     TiffComponent::TiffComponent(uint16_t tag, IfdId group)
-        : tag_(tag), group_(group), pStart_(0)
+        : tag_(tag), group_(group), pStart_(0),
+          cacheFlags_(0), cachedSize_(0), cachedSizeData_(0), cachedSizeImage_(0),
+          cacheGeneration_(0)
     {
     }
 
@@ -102,7 +120,8 @@ namespace Exiv2 {
         : TiffComponent(tag, group),
           tiffType_(tiffType), count_(0), offset_(0),
           size_(0), pData_(0), isMalloced_(false), idx_(0),
-          pValue_(0)
+          pValue_(0), isDeferred_(false), typeId_(invalidTypeId),
+          byteOrder_(invalidByteOrder)
     {
     }
 
@@ -112,7 +131,7 @@ namespace Exiv2 {
     }
 
     TiffMnEntry::TiffMnEntry(uint16_t tag, IfdId group, IfdId mnGroup)
-        : TiffEntryBase(tag, group, ttUndefined), mnGroup_(mnGroup), mn_(0)
+        : TiffEntryBase(tag, group, ttUndefined), mnGroup_(mnGroup), mn_(0), pMnSpan_(0)
     {
     }
 
@@ -144,7 +163,10 @@ namespace Exiv2 {
           origData_(0),
           origSize_(0),
           pRoot_(0),
-          decoded_(false)
+          decoded_(false),
+          elCount_(0),
+          elIdx_(0),
+          elByteOrder_(invalidByteOrder)
     {
         assert(arrayCfg != 0);
     }
@@ -164,7 +186,10 @@ namespace Exiv2 {
           origData_(0),
           origSize_(0),
           pRoot_(0),
-          decoded_(false)
+          decoded_(false),
+          elCount_(0),
+          elIdx_(0),
+          elByteOrder_(invalidByteOrder)
     {
         // We'll figure out the correct cfg later
         assert(cfgSelFct != 0);
@@ -180,6 +205,16 @@ namespace Exiv2 {
     {
     }
 
+    void* TiffComponent::operator new(std::size_t size)
+    {
+        return Arena::allocate(size, Arena::tiffTreePool);
+    }
+
+    void TiffComponent::operator delete(void* p)
+    {
+        Arena::deallocate(p);
+    }
+
     TiffDirectory::~TiffDirectory()
     {
         for (Components::iterator i = components_.begin(); i != components_.end(); ++i) {
@@ -226,6 +261,7 @@ namespace Exiv2 {
     TiffMnEntry::~TiffMnEntry()
     {
         delete mn_;
+        if (pMnSpan_ != 0) pMnSpan_->release();
     }
 
     TiffIfdMakernote::~TiffIfdMakernote()
@@ -253,7 +289,10 @@ namespace Exiv2 {
           pData_(rhs.pData_),
           isMalloced_(rhs.isMalloced_),
           idx_(rhs.idx_),
-          pValue_(rhs.pValue_ ? rhs.pValue_->clone().release() : 0)
+          pValue_(rhs.pValue_ ? rhs.pValue_->clone().release() : 0),
+          isDeferred_(rhs.isDeferred_),
+          typeId_(rhs.typeId_),
+          byteOrder_(rhs.byteOrder_)
     {
         if (rhs.isMalloced_) {
             pData_ = new byte[rhs.size_];
@@ -264,6 +303,7 @@ namespace Exiv2 {
     TiffDirectory::TiffDirectory(const TiffDirectory& rhs)
         : TiffComponent(rhs),
           hasNext_(rhs.hasNext_),
+          bigTiff_(rhs.bigTiff_),
           pNext_(0)
     {
     }
@@ -285,13 +325,18 @@ namespace Exiv2 {
           origData_(rhs.origData_),
           origSize_(rhs.origSize_),
           pRoot_(rhs.pRoot_),
-          decoded_(false)
+          decoded_(false),
+          elCount_(0),
+          elIdx_(0),
+          elByteOrder_(invalidByteOrder)
     {
     }
 
     TiffComponent::AutoPtr TiffComponent::clone() const
     {
-        return AutoPtr(doClone());
+        AutoPtr copy(doClone());
+        copy->cacheFlags_ = 0;              // The copy computes its own sizes
+        return copy;
     }
 
     TiffEntry* TiffEntry::doClone() const
@@ -371,6 +416,7 @@ namespace Exiv2 {
         pData_ = pData;
         size_  = size;
         if (pData_ == 0) size_ = 0;
+        clearSizes();
     }
 
     void TiffEntryBase::updateValue(Value::AutoPtr value, ByteOrder byteOrder)
@@ -393,11 +439,41 @@ namespace Exiv2 {
         count_ = value->count();
         delete pValue_;
         pValue_ = value.release();
+        isDeferred_ = false;
+        clearSizes();
     } // TiffEntryBase::setValue
 
+    void TiffEntryBase::deferValue(TiffType tiffType, TypeId typeId, ByteOrder byteOrder)
+    {
+        tiffType_ = tiffType;
+        delete pValue_;
+        pValue_ = 0;
+        isDeferred_ = true;
+        typeId_ = typeId;
+        byteOrder_ = byteOrder;
+    } // TiffEntryBase::deferValue
+
+    const Value* TiffEntryBase::pValue() const
+    {
+        if (!isDeferred_) return pValue_;
+        // The value is read on first access, concurrent calls are safe. The
+        // entry stays deferred, its type and count are those of the data.
+        void* const* ppValue = reinterpret_cast<void* const*>(&pValue_);
+        if (atomicLoad(ppValue) == 0) {
+            Value::AutoPtr v = Value::create(typeId_);
+            assert(v.get());
+            v->read(pData_, size_, byteOrder_);
+            // Another thread may have been faster
+            if (atomicCompareAndSwap(reinterpret_cast<void**>(&pValue_), 0, v.get())) {
+                v.release();
+            }
+        }
+        return static_cast<const Value*>(atomicLoad(ppValue));
+    } // TiffEntryBase::pValue
+
     void TiffDataEntry::setStrips(const Value* pSize,
                                   const byte*  pData,
-                                  uint32_t     sizeData,
+                                  uint64_t     sizeData,
                                   uint32_t     baseOffset)
     {
         if (!pValue() || !pSize) {
@@ -428,15 +504,15 @@ namespace Exiv2 {
 #endif
             return;
         }
-        uint32_t size = 0;
+        uint64_t size = 0;
         for (int i = 0; i < pSize->count(); ++i) {
-            size += static_cast<uint32_t>(pSize->toLong(i));
+            size += toUInt64(*pSize, i);
         }
-        uint32_t offset = static_cast<uint32_t>(pValue()->toLong(0));
+        const uint64_t offset = toUInt64(*pValue(), 0);
         // Todo: Remove limitation of JPEG writer: strips must be contiguous
         // Until then we check: last offset + last size - first offset == size?
-        if (  static_cast<uint32_t>(pValue()->toLong(pValue()->count()-1))
-            + static_cast<uint32_t>(pSize->toLong(pSize->count()-1))
+        if (  toUInt64(*pValue(), pValue()->count()-1)
+            + toUInt64(*pSize, pSize->count()-1)
             - offset != size) {
 #ifndef SUPPRESS_WARNINGS
             EXV_WARNING << "Directory " << groupName(group())
@@ -448,6 +524,7 @@ namespace Exiv2 {
         }
         if (   offset > sizeData
             || size > sizeData
+            || size > 0x7fffffff            // DataBuf and Value sizes are long
             || baseOffset + offset > sizeData - size) {
 #ifndef SUPPRESS_WARNINGS
             EXV_WARNING << "Directory " << groupName(group())
@@ -458,13 +535,16 @@ namespace Exiv2 {
             return;
         }
         pDataArea_ = const_cast<byte*>(pData) + baseOffset + offset;
-        sizeDataArea_ = size;
-        const_cast<Value*>(pValue())->setDataArea(pDataArea_, sizeDataArea_);
+        sizeDataArea_ = static_cast<uint32_t>(size);
+        // The value with the data area is no longer that of the raw data
+        Value::AutoPtr value = pValue()->clone();
+        value->setDataArea(pDataArea_, sizeDataArea_);
+        setValue(value);
     } // TiffDataEntry::setStrips
 
     void TiffImageEntry::setStrips(const Value* pSize,
                                    const byte*  pData,
-                                   uint32_t     sizeData,
+                                   uint64_t     sizeData,
                                    uint32_t     baseOffset)
     {
         if (!pValue() || !pSize) {
@@ -487,12 +567,13 @@ namespace Exiv2 {
             return;
         }
         for (int i = 0; i < pValue()->count(); ++i) {
-            const uint32_t offset = static_cast<uint32_t>(pValue()->toLong(i));
+            const uint64_t offset = toUInt64(*pValue(), i);
             const byte* pStrip = pData + baseOffset + offset;
-            const uint32_t size = static_cast<uint32_t>(pSize->toLong(i));
+            const uint64_t size = toUInt64(*pSize, i);
 
             if (   offset > sizeData
                 || size > sizeData
+                || size > 0xffffffff
                 || baseOffset + offset > sizeData - size) {
 #ifndef SUPPRESS_WARNINGS
                 EXV_WARNING << "Directory " << groupName(group())
@@ -503,11 +584,29 @@ namespace Exiv2 {
 #endif
             }
             else if (size != 0) {
-                strips_.push_back(std::make_pair(pStrip, size));
+                strips_.push_back(std::make_pair(pStrip, static_cast<uint32_t>(size)));
             }
         }
+        clearSizes();
     } // TiffImageEntry::setStrips
 
+    bool TiffImageEntry::keepImage(const byte* pData, uint64_t size)
+    {
+        clearSizes();
+        pImage_ = 0;
+        if (pData == 0) return true;
+        if (group() > mnId || (pValue() && pValue()->sizeDataArea() > 0)) return true;
+        for (Strips::const_iterator i = strips_.begin(); i != strips_.end(); ++i) {
+            if (   i->first < pData
+                || i->first > pData + size
+                || i->second > static_cast<uint32_t>(pData + size - i->first)) {
+                return false;
+            }
+        }
+        pImage_ = pData;
+        return true;
+    } // TiffImageEntry::keepImage
+
     uint32_t TiffIfdMakernote::ifdOffset() const
     {
         if (!pHeader_) return 0;
@@ -534,6 +633,63 @@ namespace Exiv2 {
         return pHeader_->baseOffset(mnOffset_);
     }
 
+    bool TiffIfdMakernote::relocations(MnRelocation& relocation,
+                                       const byte*   pData,
+                                       uint32_t      size,
+                                       uint32_t      mnOffset) const
+    {
+        const ByteOrder bo = byteOrder();
+        relocation.positions_.clear();
+        relocation.offset_ = mnOffset;
+        relocation.byteOrder_ = bo;
+
+        // Offsets are absolute unless the base offset moves with the makernote
+        const uint32_t base = pHeader_ ? pHeader_->baseOffset(mnOffset) : 0;
+        const bool absolute = !pHeader_ || pHeader_->baseOffset(0) == pHeader_->baseOffset(1);
+
+        uint32_t idx = ifdOffset();
+        if (size < 2 || idx > size - 2) return false;
+        const uint16_t count = getUShort(pData + idx, bo);
+        idx += 2;
+        if (static_cast<uint32_t>(count) * 12 > size - idx) return false;
+        for (uint16_t i = 0; i < count; ++i, idx += 12) {
+            const uint16_t tag = getUShort(pData + idx, bo);
+            TiffComponent::AutoPtr tc = TiffCreator::create(tag, ifd_.group());
+            if (   dynamic_cast<TiffSubIfd*>(tc.get()) != 0
+                || dynamic_cast<TiffDataEntryBase*>(tc.get()) != 0
+                || dynamic_cast<TiffMnEntry*>(tc.get()) != 0) {
+                return false;
+            }
+            const long typeSize = TypeInfo::typeSize(static_cast<TypeId>(getUShort(pData + idx + 2, bo)));
+            const uint32_t n = getULong(pData + idx + 4, bo);
+            if (typeSize == 0 || n > size) return false;
+            const uint32_t dataSize = n * static_cast<uint32_t>(typeSize);
+            if (dataSize <= 4) continue;
+            // The data must be in the makernote
+            const uint32_t offset = getULong(pData + idx + 8, bo);
+            if (offset > 0xffffffff - base) return false;
+            const uint32_t start = base + offset;
+            if (   start < mnOffset
+                || start - mnOffset > size
+                || dataSize > size - (start - mnOffset)) return false;
+            if (absolute) relocation.positions_.push_back(idx + 8);
+        }
+        if (   ifd_.hasNext() && size >= 4 && idx <= size - 4
+            && getULong(pData + idx, bo) != 0) return false;
+
+        return true;
+    } // TiffIfdMakernote::relocations
+
+    void MnRelocation::relocate(byte* pData, uint32_t size, uint32_t offset) const
+    {
+        const uint32_t delta = offset - offset_;
+        for (std::vector<uint32_t>::const_iterator i = positions_.begin();
+             i != positions_.end(); ++i) {
+            if (size < 4 || *i > size - 4) continue;
+            ul2Data(pData + *i, getULong(pData + *i, byteOrder_) + delta, byteOrder_);
+        }
+    }
+
     bool TiffIfdMakernote::readHeader(const byte* pData,
                                       uint32_t    size,
                                       ByteOrder   byteOrder)
@@ -599,20 +755,67 @@ namespace Exiv2 {
         origSize_ = TiffEntryBase::doSize();
     }
 
-    bool TiffBinaryArray::updOrigDataBuf(const byte* pData, uint32_t size)
+    bool TiffBinaryArray::updOrigDataBuf(TiffComponent* const pRoot, CryptKey& key)
     {
-        assert(pData != 0);
+        assert(pData() != 0);
 
-        if (origSize_ != size) return false;
-        if (origData_ == pData) return true;
-        memcpy(origData_, pData, origSize_);
+        if (origSize_ != TiffEntryBase::doSize()) return false;
+        if (origData_ != pData()) memcpy(origData_, pData(), origSize_);
+        // The data of the array stays unencrypted
+        if (cfg() && cfg()->cryptFct_) {
+            cfg()->cryptFct_(tag(), origData_, origSize_, pRoot, key);
+        }
         return true;
     }
 
+    const ArrayDef* TiffBinaryArray::elDef(uint32_t idx, ArrayDef& gap) const
+    {
+        const ArrayCfg* cfg = this->cfg();
+        assert(cfg != 0);
+        if (arrayDef_ == 0) return &cfg->elDefaultDef_;
+        const ArrayDef* defsEnd = arrayDef_ + defSize_;
+        const ArrayDef* def = std::find(arrayDef_, defsEnd, idx);
+        if (def != defsEnd) return def;
+        if (!cfg->concat_) return &cfg->elDefaultDef_;
+
+        // Determine gap-size
+        const ArrayDef* xdef = arrayDef_;
+        for (; xdef != defsEnd && xdef->idx_ <= idx; ++xdef) {}
+        uint32_t gapSize = 0;
+        if (xdef != defsEnd && xdef->idx_ > idx) {
+            gapSize = xdef->idx_ - idx;
+        }
+        else {
+            gapSize = TiffEntryBase::doSize() - idx;
+        }
+        gap.idx_ = idx;
+        gap.tiffType_ = cfg->elDefaultDef_.tiffType_;
+        gap.count_ = gapSize / cfg->tagStep();
+        if (gap.count_ * cfg->tagStep() != gapSize) {
+            gap.tiffType_ = ttUndefined;
+            gap.count_ = gapSize;
+        }
+        return &gap;
+    } // TiffBinaryArray::elDef
+
+    uint32_t TiffBinaryArray::elSize(uint32_t idx, const ArrayDef& def) const
+    {
+        uint16_t tag = static_cast<uint16_t>(idx / cfg()->tagStep());
+        return EXV_MIN(def.size(tag, cfg()->group_), TiffEntryBase::doSize() - idx);
+    }
+
+    void TiffBinaryArray::deferElements(uint32_t count, int idx, ByteOrder byteOrder)
+    {
+        elCount_ = count;
+        elIdx_ = idx;
+        elByteOrder_ = byteOrder;
+        setDecoded(count > 0);
+    }
+
     uint32_t TiffBinaryArray::addElement(uint32_t idx, const ArrayDef& def)
     {
         uint16_t tag = static_cast<uint16_t>(idx / cfg()->tagStep());
-        int32_t sz = EXV_MIN(def.size(tag, cfg()->group_), TiffEntryBase::doSize() - idx);
+        int32_t sz = elSize(idx, def);
         TiffComponent::AutoPtr tc = TiffCreator::create(tag, cfg()->group_);
         TiffBinaryElement* tp = dynamic_cast<TiffBinaryElement*>(tc.get());
         // The assertion typically fails if a component is not configured in
@@ -747,6 +950,7 @@ namespace Exiv2 {
             mnGroup_ = tpi2.group();
             mn_ = TiffMnCreator::create(tpi1.tag(), tpi1.group(), mnGroup_);
             assert(mn_);
+            cacheAdded(mn_);
         }
         return mn_->addPath(tag, tiffPath, pRoot, object);
     } // TiffMnEntry::doAddPath
@@ -803,7 +1007,9 @@ namespace Exiv2 {
 
     TiffComponent* TiffComponent::addChild(TiffComponent::AutoPtr tiffComponent)
     {
-        return doAddChild(tiffComponent);
+        TiffComponent* tc = doAddChild(tiffComponent);
+        cacheAdded(tc);
+        return tc;
     } // TiffComponent::addChild
 
     TiffComponent* TiffComponent::doAddChild(AutoPtr /*tiffComponent*/)
@@ -850,7 +1056,9 @@ namespace Exiv2 {
 
     TiffComponent* TiffComponent::addNext(TiffComponent::AutoPtr tiffComponent)
     {
-        return doAddNext(tiffComponent);
+        TiffComponent* tc = doAddNext(tiffComponent);
+        cacheAdded(tc);
+        return tc;
     } // TiffComponent::addNext
 
     TiffComponent* TiffComponent::doAddNext(AutoPtr /*tiffComponent*/)
@@ -1019,6 +1227,11 @@ namespace Exiv2 {
 
     uint32_t TiffEntryBase::doCount() const
     {
+        // The count of the value may differ from that of the raw data
+        if (isDeferred_) {
+            const Value* pv = pValue();
+            return pv == 0 ? 0 : static_cast<uint32_t>(pv->count());
+        }
         return count_;
     }
 
@@ -1057,26 +1270,26 @@ namespace Exiv2 {
 
     uint32_t TiffComponent::write(IoWrapper& ioWrapper,
                                   ByteOrder byteOrder,
-                                  int32_t   offset,
+                                  int64_t   offset,
                                   uint32_t  valueIdx,
                                   uint32_t  dataIdx,
-                                  uint32_t& imageIdx)
+                                  uint64_t& imageIdx)
     {
         return doWrite(ioWrapper, byteOrder, offset, valueIdx, dataIdx, imageIdx);
     } // TiffComponent::write
 
     uint32_t TiffDirectory::doWrite(IoWrapper& ioWrapper,
                                     ByteOrder byteOrder,
-                                    int32_t   offset,
+                                    int64_t   offset,
                                     uint32_t  valueIdx,
                                     uint32_t  dataIdx,
-                                    uint32_t& imageIdx)
+                                    uint64_t& imageIdx)
     {
-        bool isRootDir = (imageIdx == uint32_t(-1));
+        bool isRootDir = (imageIdx == uint64_t(-1));
 
         // Number of components to write
         const uint32_t compCount = count();
-        if (compCount > 0xffff) throw Error(49, groupName(group()));
+        if (!bigTiff_ && compCount > 0xffff) throw Error(49, groupName(group()));
 
         // Size of next IFD, if any
         uint32_t sizeNext = 0;
@@ -1086,7 +1299,9 @@ namespace Exiv2 {
         if (compCount == 0 && sizeNext == 0) return 0;
 
         // Size of all directory entries, without values and additional data
-        const uint32_t sizeDir = 2 + 12 * compCount + (hasNext_ ? 4 : 0);
+        const uint32_t sizeInline = bigTiff_ ? 8 : 4;
+        const uint32_t sizeDir = bigTiff_ ? 8 + 20 * compCount + (hasNext_ ? 8 : 0)
+                                          : 2 + 12 * compCount + (hasNext_ ? 4 : 0);
 
         // TIFF standard requires IFD entries to be sorted in ascending order by tag.
         // Not sorting makernote directories sometimes preserves them better.
@@ -1098,7 +1313,7 @@ namespace Exiv2 {
         uint32_t sizeData = 0;
         for (Components::const_iterator i = components_.begin(); i != components_.end(); ++i) {
             uint32_t sv = (*i)->size();
-            if (sv > 4) {
+            if (sv > sizeInline) {
                 sv += sv & 1;               // Align value to word boundary
                 sizeValue += sv;
             }
@@ -1114,20 +1329,27 @@ namespace Exiv2 {
         valueIdx = sizeDir;                 // Offset to the current IFD value
         dataIdx  = sizeDir + sizeValue;     // Offset to the entry's data area
         if (isRootDir) {                    // Absolute offset to the image data
-            imageIdx = offset + dataIdx + sizeData + sizeNext;
+            imageIdx = static_cast<uint64_t>(offset + dataIdx + sizeData + sizeNext);
             imageIdx += imageIdx & 1;       // Align image data to word boundary
         }
 
         // 1st: Write the IFD, a) Number of directory entries
-        byte buf[4];
-        us2Data(buf, static_cast<uint16_t>(compCount), byteOrder);
-        ioWrapper.write(buf, 2);
-        idx += 2;
+        byte buf[8];
+        if (bigTiff_) {
+            ull2Data(buf, compCount, byteOrder);
+            ioWrapper.write(buf, 8);
+            idx += 8;
+        }
+        else {
+            us2Data(buf, static_cast<uint16_t>(compCount), byteOrder);
+            ioWrapper.write(buf, 2);
+            idx += 2;
+        }
         // b) Directory entries - may contain pointers to the value or data
         for (Components::const_iterator i = components_.begin(); i != components_.end(); ++i) {
             idx += writeDirEntry(ioWrapper, byteOrder, offset, *i, valueIdx, dataIdx, imageIdx);
             uint32_t sv = (*i)->size();
-            if (sv > 4) {
+            if (sv > sizeInline) {
                 sv += sv & 1;               // Align value to word boundary
                 valueIdx += sv;
             }
@@ -1137,12 +1359,13 @@ namespace Exiv2 {
         }
         // c) Pointer to the next IFD
         if (hasNext_) {
-            memset(buf, 0x0, 4);
+            const uint32_t sizeNextPtr = bigTiff_ ? 8 : 4;
+            memset(buf, 0x0, sizeNextPtr);
             if (pNext_ && sizeNext) {
-                l2Data(buf, offset + dataIdx, byteOrder);
+                ifdOffset2Data(buf, offset + dataIdx, bigTiff_, byteOrder);
             }
-            ioWrapper.write(buf, 4);
-            idx += 4;
+            ioWrapper.write(buf, sizeNextPtr);
+            idx += sizeNextPtr;
         }
         assert(idx == sizeDir);
 
@@ -1151,7 +1374,7 @@ namespace Exiv2 {
         dataIdx = sizeDir + sizeValue;
         for (Components::const_iterator i = components_.begin(); i != components_.end(); ++i) {
             uint32_t sv = (*i)->size();
-            if (sv > 4) {
+            if (sv > sizeInline) {
                 uint32_t d = (*i)->write(ioWrapper, byteOrder, offset, valueIdx, dataIdx, imageIdx);
                 assert(sv == d);
                 if ((sv & 1) == 1) {
@@ -1186,24 +1409,33 @@ namespace Exiv2 {
 
     uint32_t TiffDirectory::writeDirEntry(IoWrapper&     ioWrapper,
                                           ByteOrder      byteOrder,
-                                          int32_t        offset,
+                                          int64_t        offset,
                                           TiffComponent* pTiffComponent,
                                           uint32_t       valueIdx,
                                           uint32_t       dataIdx,
-                                          uint32_t&      imageIdx) const
+                                          uint64_t&      imageIdx) const
     {
         assert(pTiffComponent);
         TiffEntryBase* pDirEntry = dynamic_cast<TiffEntryBase*>(pTiffComponent);
         assert(pDirEntry);
+        // BigTIFF entries have an 8-byte count and an 8-byte value or offset
+        const uint32_t sizeInline = bigTiff_ ? 8 : 4;
         byte buf[8];
         us2Data(buf,     pDirEntry->tag(),      byteOrder);
         us2Data(buf + 2, pDirEntry->tiffType(), byteOrder);
-        ul2Data(buf + 4, pDirEntry->count(),    byteOrder);
-        ioWrapper.write(buf, 8);
-        if (pDirEntry->size() > 4) {
-            pDirEntry->setOffset(offset + static_cast<int32_t>(valueIdx));
-            l2Data(buf, pDirEntry->offset(), byteOrder);
-            ioWrapper.write(buf, 4);
+        ioWrapper.write(buf, 4);
+        if (bigTiff_) {
+            ull2Data(buf, pDirEntry->count(), byteOrder);
+        }
+        else {
+            ul2Data(buf, pDirEntry->count(), byteOrder);
+        }
+        ioWrapper.write(buf, sizeInline);
+        if (pDirEntry->size() > sizeInline) {
+            const int64_t valueOffset = offset + valueIdx;
+            pDirEntry->setOffset(valueOffset);
+            ifdOffset2Data(buf, valueOffset, bigTiff_, byteOrder);
+            ioWrapper.write(buf, sizeInline);
         }
         else {
             const uint32_t len = pDirEntry->write(ioWrapper,
@@ -1212,32 +1444,33 @@ namespace Exiv2 {
                                                   valueIdx,
                                                   dataIdx,
                                                   imageIdx);
-            assert(len <= 4);
-            if (len < 4) {
-                memset(buf, 0x0, 4);
-                ioWrapper.write(buf, 4 - len);
+            assert(len <= sizeInline);
+            if (len < sizeInline) {
+                memset(buf, 0x0, sizeInline);
+                ioWrapper.write(buf, sizeInline - len);
             }
         }
-        return 12;
+        return bigTiff_ ? 20 : 12;
     } // TiffDirectory::writeDirEntry
 
     uint32_t TiffEntryBase::doWrite(IoWrapper& ioWrapper,
                                     ByteOrder byteOrder,
-                                    int32_t   /*offset*/,
+                                    int64_t   /*offset*/,
                                     uint32_t  /*valueIdx*/,
                                     uint32_t  /*dataIdx*/,
-                                    uint32_t& /*imageIdx*/)
+                                    uint64_t& /*imageIdx*/)
     {
-        if (!pValue_) return 0;
+        const Value* pv = pValue();
+        if (!pv) return 0;
 
-        DataBuf buf(pValue_->size());
-        pValue_->copy(buf.pData_, byteOrder);
+        DataBuf buf(pv->size());
+        pv->copy(buf.pData_, byteOrder);
         ioWrapper.write(buf.pData_, buf.size_);
         return buf.size_;
     } // TiffEntryBase::doWrite
 
     uint32_t TiffEntryBase::writeOffset(byte*     buf,
-                                        int32_t   offset,
+                                        int64_t   offset,
                                         TiffType  tiffType,
                                         ByteOrder byteOrder)
     {
@@ -1245,13 +1478,20 @@ namespace Exiv2 {
         switch(tiffType) {
         case ttUnsignedShort:
         case ttSignedShort:
-            if (static_cast<uint32_t>(offset) > 0xffff) throw Error(26);
+            if (offset > 0xffff) throw Error(26);
             rc = s2Data(buf, static_cast<int16_t>(offset), byteOrder);
             break;
         case ttUnsignedLong:
         case ttSignedLong:
+        case ttTiffIfd:
+            if (offset > static_cast<int64_t>(0xffffffff)) throw Error(26);
             rc = l2Data(buf, static_cast<int32_t>(offset), byteOrder);
             break;
+        case ttUnsignedLong8:
+        case ttSignedLong8:
+        case ttTiffIfd8:
+            rc = ll2Data(buf, offset, byteOrder);
+            break;
         default:
             throw Error(27);
             break;
@@ -1261,19 +1501,19 @@ namespace Exiv2 {
 
     uint32_t TiffDataEntry::doWrite(IoWrapper& ioWrapper,
                                     ByteOrder byteOrder,
-                                    int32_t   offset,
+                                    int64_t   offset,
                                     uint32_t  /*valueIdx*/,
                                     uint32_t  dataIdx,
-                                    uint32_t& /*imageIdx*/)
+                                    uint64_t& /*imageIdx*/)
     {
         if (!pValue() || pValue()->count() == 0) return 0;
 
         DataBuf buf(pValue()->size());
         uint32_t idx = 0;
-        const long prevOffset = pValue()->toLong(0);
+        const uint64_t prevOffset = toUInt64(*pValue(), 0);
         for (uint32_t i = 0; i < count(); ++i) {
-            const long newDataIdx =   pValue()->toLong(i) - prevOffset
-                                    + static_cast<long>(dataIdx);
+            const int64_t newDataIdx =   static_cast<int64_t>(toUInt64(*pValue(), i) - prevOffset)
+                                       + static_cast<int64_t>(dataIdx);
             idx += writeOffset(buf.pData_ + idx,
                                offset + newDataIdx,
                                tiffType(),
@@ -1285,12 +1525,12 @@ namespace Exiv2 {
 
     uint32_t TiffImageEntry::doWrite(IoWrapper& ioWrapper,
                                      ByteOrder byteOrder,
-                                     int32_t   offset,
+                                     int64_t   offset,
                                      uint32_t  /*valueIdx*/,
                                      uint32_t  dataIdx,
-                                     uint32_t& imageIdx)
+                                     uint64_t& imageIdx)
     {
-        uint32_t o2 = imageIdx;
+        int64_t o2 = imageIdx;
         // For makernotes, write TIFF image data to the data area
         if (group() > mnId) o2 = offset + dataIdx;
 #ifdef DEBUG
@@ -1299,10 +1539,18 @@ namespace Exiv2 {
                   << std::setfill('0') << std::hex << tag() << std::dec
                   << ": Writing offset " << o2 << "\n";
 #endif
-        DataBuf buf(static_cast<long>(strips_.size()) * 4);
+        DataBuf buf(static_cast<long>(size()));
         memset(buf.pData_, 0x0, buf.size_);
         uint32_t idx = 0;
         for (Strips::const_iterator i = strips_.begin(); i != strips_.end(); ++i) {
+            if (pImage_ != 0) {
+                // The image data stays where it is
+                idx += writeOffset(buf.pData_ + idx,
+                                   static_cast<int64_t>(i->first - pImage_),
+                                   tiffType(),
+                                   byteOrder);
+                continue;
+            }
             idx += writeOffset(buf.pData_ + idx, o2, tiffType(), byteOrder);
             o2 += i->second;
             o2 += i->second & 1;                // Align strip data to word boundary
@@ -1317,12 +1565,12 @@ namespace Exiv2 {
 
     uint32_t TiffSubIfd::doWrite(IoWrapper& ioWrapper,
                                  ByteOrder byteOrder,
-                                 int32_t   offset,
+                                 int64_t   offset,
                                  uint32_t  /*valueIdx*/,
                                  uint32_t  dataIdx,
-                                 uint32_t& /*imageIdx*/)
+                                 uint64_t& /*imageIdx*/)
     {
-        DataBuf buf(static_cast<long>(ifds_.size()) * 4);
+        DataBuf buf(static_cast<long>(size()));
         uint32_t idx = 0;
         // Sort IFDs by group, needed if image data tags were copied first
         std::sort(ifds_.begin(), ifds_.end(), cmpGroupLt);
@@ -1336,25 +1584,39 @@ namespace Exiv2 {
 
     uint32_t TiffMnEntry::doWrite(IoWrapper& ioWrapper,
                                   ByteOrder byteOrder,
-                                  int32_t   offset,
+                                  int64_t   offset,
                                   uint32_t  valueIdx,
                                   uint32_t  dataIdx,
-                                  uint32_t& imageIdx)
+                                  uint64_t& imageIdx)
     {
-        if (!mn_) {
+        if (!mn_ && relocation_.positions_.empty()) {
             return TiffEntryBase::doWrite(ioWrapper, byteOrder, offset, valueIdx, dataIdx, imageIdx);
         }
+        if (!mn_) {
+            // Unchanged makernote, adjust its offsets to the new position
+            const Value* pv = pValue();
+            if (!pv) return 0;
+            DataBuf buf(pv->size());
+            pv->copy(buf.pData_, byteOrder);
+            if (offset + valueIdx > static_cast<int64_t>(0xffffffff)) throw Error(26);
+            relocation_.relocate(buf.pData_, buf.size_,
+                                 static_cast<uint32_t>(offset + valueIdx));
+            ioWrapper.write(buf.pData_, buf.size_);
+            return buf.size_;
+        }
         return mn_->write(ioWrapper, byteOrder, offset + valueIdx, uint32_t(-1), uint32_t(-1), imageIdx);
     } // TiffMnEntry::doWrite
 
     uint32_t TiffIfdMakernote::doWrite(IoWrapper& ioWrapper,
                                        ByteOrder byteOrder,
-                                       int32_t   offset,
+                                       int64_t   offset,
                                        uint32_t  /*valueIdx*/,
                                        uint32_t  /*dataIdx*/,
-                                       uint32_t& imageIdx)
+                                       uint64_t& imageIdx)
     {
-        mnOffset_ = offset;
+        // Makernote offsets are 32-bit (Exif.MakerNote.Offset is a LONG)
+        if (offset > static_cast<int64_t>(0xffffffff)) throw Error(26);
+        mnOffset_ = static_cast<uint32_t>(offset);
         setImageByteOrder(byteOrder);
         uint32_t len = writeHeader(ioWrapper, this->byteOrder());
         len += ifd_.write(ioWrapper, this->byteOrder(),
@@ -1366,10 +1628,10 @@ namespace Exiv2 {
 
     uint32_t TiffBinaryArray::doWrite(IoWrapper& ioWrapper,
                                       ByteOrder byteOrder,
-                                      int32_t   offset,
+                                      int64_t   offset,
                                       uint32_t  valueIdx,
                                       uint32_t  dataIdx,
-                                      uint32_t& imageIdx)
+                                      uint64_t& imageIdx)
     {
         if (cfg() == 0 || !decoded()) return TiffEntryBase::doWrite(ioWrapper,
                                                                     byteOrder,
@@ -1412,26 +1674,24 @@ namespace Exiv2 {
             uint16_t lastTag = static_cast<uint16_t>(lastDef->idx_ / cfg()->tagStep());
             idx += fillGap(mioWrapper, idx, lastDef->idx_ + lastDef->size(lastTag, cfg()->group_));
         }
-        DataBuf buf;
         if (cfg()->cryptFct_) {
-            buf = cfg()->cryptFct_(tag(), mio.mmap(), static_cast<uint32_t>(mio.size()), pRoot_);
-        }
-        if (buf.size_ > 0) {
-            ioWrapper.write(buf.pData_, buf.size_);
-        }
-        else {
-            ioWrapper.write(mio.mmap(), static_cast<uint32_t>(mio.size()));
+            // Encrypt the data in the memory buffer, with the key of the
+            // write if there is one
+            CryptKey key;
+            CryptKey* pKey = ioWrapper.cryptKey() ? ioWrapper.cryptKey() : &key;
+            cfg()->cryptFct_(tag(), mio.mmap(true), static_cast<uint32_t>(mio.size()), pRoot_, *pKey);
         }
+        ioWrapper.write(mio.mmap(), static_cast<uint32_t>(mio.size()));
 
         return idx;
     } // TiffBinaryArray::doWrite
 
     uint32_t TiffBinaryElement::doWrite(IoWrapper& ioWrapper,
                                         ByteOrder byteOrder,
-                                        int32_t   /*offset*/,
+                                        int64_t   /*offset*/,
                                         uint32_t  /*valueIdx*/,
                                         uint32_t  /*dataIdx*/,
-                                        uint32_t& /*imageIdx*/)
+                                        uint64_t& /*imageIdx*/)
     {
         Value const* pv = pValue();
         if (!pv || pv->count() == 0) return 0;
@@ -1443,18 +1703,18 @@ namespace Exiv2 {
 
     uint32_t TiffComponent::writeData(IoWrapper& ioWrapper,
                                       ByteOrder byteOrder,
-                                      int32_t   offset,
+                                      int64_t   offset,
                                       uint32_t  dataIdx,
-                                      uint32_t& imageIdx) const
+                                      uint64_t& imageIdx) const
     {
         return doWriteData(ioWrapper, byteOrder, offset, dataIdx, imageIdx);
     } // TiffComponent::writeData
 
     uint32_t TiffDirectory::doWriteData(IoWrapper& ioWrapper,
                                         ByteOrder byteOrder,
-                                        int32_t   offset,
+                                        int64_t   offset,
                                         uint32_t  dataIdx,
-                                        uint32_t& imageIdx) const
+                                        uint64_t& imageIdx) const
     {
         uint32_t len = 0;
         for (Components::const_iterator i = components_.begin(); i != components_.end(); ++i) {
@@ -1465,18 +1725,18 @@ namespace Exiv2 {
 
     uint32_t TiffEntryBase::doWriteData(IoWrapper&/*ioWrapper*/,
                                         ByteOrder /*byteOrder*/,
-                                        int32_t   /*offset*/,
+                                        int64_t   /*offset*/,
                                         uint32_t  /*dataIdx*/,
-                                        uint32_t& /*imageIdx*/) const
+                                        uint64_t& /*imageIdx*/) const
     {
         return 0;
     } // TiffEntryBase::doWriteData
 
     uint32_t TiffImageEntry::doWriteData(IoWrapper& ioWrapper,
                                          ByteOrder byteOrder,
-                                         int32_t   /*offset*/,
+                                         int64_t   /*offset*/,
                                          uint32_t  /*dataIdx*/,
-                                         uint32_t& /*imageIdx*/) const
+                                         uint64_t& /*imageIdx*/) const
     {
         uint32_t len = 0;
         // For makernotes, write TIFF image data to the data area
@@ -1488,9 +1748,9 @@ namespace Exiv2 {
 
     uint32_t TiffDataEntry::doWriteData(IoWrapper& ioWrapper,
                                         ByteOrder /*byteOrder*/,
-                                        int32_t   /*offset*/,
+                                        int64_t   /*offset*/,
                                         uint32_t  /*dataIdx*/,
-                                        uint32_t& /*imageIdx*/) const
+                                        uint64_t& /*imageIdx*/) const
     {
         if (!pValue()) return 0;
 
@@ -1505,9 +1765,9 @@ namespace Exiv2 {
 
     uint32_t TiffSubIfd::doWriteData(IoWrapper& ioWrapper,
                                      ByteOrder byteOrder,
-                                     int32_t   offset,
+                                     int64_t   offset,
                                      uint32_t  dataIdx,
-                                     uint32_t& imageIdx) const
+                                     uint64_t& imageIdx) const
     {
         uint32_t len = 0;
         for (Ifds::const_iterator i = ifds_.begin(); i != ifds_.end(); ++i) {
@@ -1522,9 +1782,9 @@ namespace Exiv2 {
 
     uint32_t TiffIfdMakernote::doWriteData(IoWrapper&/*ioWrapper*/,
                                            ByteOrder /*byteOrder*/,
-                                           int32_t   /*offset*/,
+                                           int64_t   /*offset*/,
                                            uint32_t  /*dataIdx*/,
-                                           uint32_t& /*imageIdx*/) const
+                                           uint64_t& /*imageIdx*/) const
     {
         assert(false);
         return 0;
@@ -1588,6 +1848,7 @@ namespace Exiv2 {
     uint32_t TiffImageEntry::doWriteImage(IoWrapper& ioWrapper,
                                           ByteOrder  /*byteOrder*/) const
     {
+        if (pImage_ != 0) return 0;
         uint32_t len = pValue()->sizeDataArea();
         if (len > 0) {
 #ifdef DEBUG
@@ -1624,20 +1885,58 @@ namespace Exiv2 {
         return len;
     } // TiffImageEntry::doWriteImage
 
+    void TiffComponent::cacheSizes(bool enable)
+    {
+        cacheFlags_ = enable ? cacheEnabled : 0;
+        cacheGeneration_ = atomicLoad(&sizeGeneration);
+    } // TiffComponent::cacheSizes
+
+    void TiffComponent::clearSizes()
+    {
+        // Components don't know their parents, so all cached sizes go
+        if (cacheFlags_ & cacheEnabled) atomicIncrement(sizeGeneration);
+    } // TiffComponent::clearSizes
+
+    void TiffComponent::cacheAdded(TiffComponent* tiffComponent)
+    {
+        if (tiffComponent == 0 || !(cacheFlags_ & cacheEnabled)) return;
+        TiffSizeCacher cacher(true);
+        tiffComponent->accept(cacher);
+        clearSizes();
+    } // TiffComponent::cacheAdded
+
+    bool TiffComponent::useCache() const
+    {
+        if (!(cacheFlags_ & cacheEnabled)) return false;
+        const long generation = atomicLoad(&sizeGeneration);
+        if (cacheGeneration_ != generation) {
+            cacheFlags_ = cacheEnabled;
+            cacheGeneration_ = generation;
+        }
+        return true;
+    } // TiffComponent::useCache
+
     uint32_t TiffComponent::size() const
     {
-        return doSize();
+        if (!useCache()) return doSize();
+        if (!(cacheFlags_ & sizeCached)) {
+            cachedSize_ = doSize();
+            cacheFlags_ |= sizeCached;
+        }
+        return cachedSize_;
     } // TiffComponent::size
 
     uint32_t TiffDirectory::doSize() const
     {
         uint32_t compCount = count();
         // Size of the directory, without values and additional data
-        uint32_t len = 2 + 12 * compCount + (hasNext_ ? 4 : 0);
+        const uint32_t sizeInline = bigTiff_ ? 8 : 4;
+        uint32_t len = bigTiff_ ? 8 + 20 * compCount + (hasNext_ ? 8 : 0)
+                                : 2 + 12 * compCount + (hasNext_ ? 4 : 0);
         // Size of IFD values and data
         for (Components::const_iterator i = components_.begin(); i != components_.end(); ++i) {
             uint32_t sv = (*i)->size();
-            if (sv > 4) {
+            if (sv > sizeInline) {
                 sv += sv & 1;               // Align value to word boundary
                 len += sv;
             }
@@ -1663,12 +1962,12 @@ namespace Exiv2 {
 
     uint32_t TiffImageEntry::doSize() const
     {
-        return static_cast<uint32_t>(strips_.size()) * 4;
+        return static_cast<uint32_t>(strips_.size()) * offsetSize(tiffType());
     } // TiffImageEntry::doSize
 
     uint32_t TiffSubIfd::doSize() const
     {
-        return static_cast<uint32_t>(ifds_.size()) * 4;
+        return static_cast<uint32_t>(ifds_.size()) * offsetSize(tiffType());
     } // TiffSubIfd::doSize
 
     uint32_t TiffMnEntry::doSize() const
@@ -1720,7 +2019,12 @@ namespace Exiv2 {
 
     uint32_t TiffComponent::sizeData() const
     {
-        return doSizeData();
+        if (!useCache()) return doSizeData();
+        if (!(cacheFlags_ & sizeDataCached)) {
+            cachedSizeData_ = doSizeData();
+            cacheFlags_ |= sizeDataCached;
+        }
+        return cachedSizeData_;
     } // TiffComponent::sizeData
 
     uint32_t TiffDirectory::doSizeData() const
@@ -1767,7 +2071,12 @@ namespace Exiv2 {
 
     uint32_t TiffComponent::sizeImage() const
     {
-        return doSizeImage();
+        if (!useCache()) return doSizeImage();
+        if (!(cacheFlags_ & sizeImageCached)) {
+            cachedSizeImage_ = doSizeImage();
+            cacheFlags_ |= sizeImageCached;
+        }
+        return cachedSizeImage_;
     } // TiffComponent::sizeImage
 
     uint32_t TiffDirectory::doSizeImage() const
@@ -1803,11 +2112,15 @@ namespace Exiv2 {
 
     uint32_t TiffImageEntry::doSizeImage() const
     {
-        if (!pValue()) return 0;
+        if (!pValue() || pImage_ != 0) return 0;
         uint32_t len = pValue()->sizeDataArea();
-        if (len == 0) {
+        if (len > 0) {
+            len += len & 1;                     // Align image data to word boundary
+        }
+        else {
             for (Strips::const_iterator i = strips_.begin(); i != strips_.end(); ++i) {
                 len += i->second;
+                len += i->second & 1;           // Align strip data to word boundary
             }
         }
         return len;
@@ -1838,6 +2151,18 @@ namespace Exiv2 {
         return static_cast<uint16_t>(typeId);
     }
 
+    uint32_t offsetSize(TiffType tiffType)
+    {
+        switch (tiffType) {
+        case ttUnsignedLong8:
+        case ttSignedLong8:
+        case ttTiffIfd8:
+            return 8;
+        default:
+            return 4;
+        }
+    }
+
     bool cmpTagLt(TiffComponent const* lhs, TiffComponent const* rhs)
     {
         assert(lhs != 0);
@@ -1884,4 +2209,21 @@ namespace {
         return 0;
 
     } // fillGap
+
+    uint32_t ifdOffset2Data(Exiv2::byte* buf, int64_t offset, bool bigTiff, Exiv2::ByteOrder byteOrder)
+    {
+        if (bigTiff) return Exiv2::ll2Data(buf, offset, byteOrder);
+        if (offset > static_cast<int64_t>(0xffffffff)) throw Exiv2::Error(26);
+        return Exiv2::l2Data(buf, static_cast<int32_t>(offset), byteOrder);
+
+    } // ifdOffset2Data
+
+    uint64_t toUInt64(const Exiv2::Value& value, long n)
+    {
+        const Exiv2::ULongLongValue* v = dynamic_cast<const Exiv2::ULongLongValue*>(&value);
+        if (v != 0) return v->value_.at(n);
+        // SHORT and LONG values, toLong() may be negative for offsets >= 2 GB
+        return static_cast<uint32_t>(value.toLong(n));
+
+    } // toUInt64
 }
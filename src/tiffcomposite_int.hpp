@@ -68,11 +68,19 @@ namespace Exiv2 {
     const TiffType ttTiffFloat        =11; //!< TIFF FLOAT type
     const TiffType ttTiffDouble       =12; //!< TIFF DOUBLE type
     const TiffType ttTiffIfd          =13; //!< TIFF IFD type
+    const TiffType ttUnsignedLong8    =16; //!< BigTIFF LONG8 type
+    const TiffType ttSignedLong8      =17; //!< BigTIFF SLONG8 type
+    const TiffType ttTiffIfd8         =18; //!< BigTIFF IFD8 type
 
     //! Convert the \em tiffType of a \em tag and \em group to an Exiv2 \em typeId.
     TypeId toTypeId(TiffType tiffType, uint16_t tag, IfdId group);
     //! Convert the %Exiv2 \em typeId to a TIFF value type.
     TiffType toTiffType(TypeId typeId);
+    /*!
+      @brief Return the number of bytes reserved for each offset in an offset
+             entry of type \em tiffType: 8 for the 64-bit BigTIFF types, else 4.
+     */
+    uint32_t offsetSize(TiffType tiffType);
 
     /*!
       Special TIFF tags for the use in TIFF structures only
@@ -83,6 +91,7 @@ namespace Exiv2 {
         const uint32_t next = 0x30000; //!< Special tag: next IFD
         const uint32_t all  = 0x40000; //!< Special tag: all tags in a group
         const uint32_t pana = 0x80000; //!< Special tag: root IFD of Panasonic RAW images
+        const uint32_t page = 0x90000; //!< Special tag: root IFD of one page, without next IFD
     }
 
     /*!
@@ -131,9 +140,10 @@ namespace Exiv2 {
           brief Constructor.
 
           The IO wrapper owns neither of the objects passed in so the caller is
-          responsible to keep them alive.
+          responsible to keep them alive. If \em pCryptKey is not 0, the
+          binary arrays written through the wrapper share this key.
          */
-        IoWrapper(BasicIo& io, const byte* pHeader, long size);
+        IoWrapper(BasicIo& io, const byte* pHeader, long size, CryptKey* pCryptKey =0);
         //@}
 
         //! @name Manipulators
@@ -154,12 +164,19 @@ namespace Exiv2 {
         int putb(byte data);
         //@}
 
+        //! @name Accessors
+        //@{
+        //! Return the key of the crypt function of binary arrays, 0 if there is none.
+        CryptKey* cryptKey() const { return pCryptKey_; }
+        //@}
+
     private:
         // DATA
         BasicIo& io_;              //! Reference for the IO instance.
         const byte* pHeader_;      //! Pointer to the header data.
         long size_;                //! Size of the header data.
         bool wroteHeader_;         //! Indicates if the header has been written.
+        CryptKey* pCryptKey_;      //! Key of the crypt function of binary arrays.
     }; // class IoWrapper
 
     /*!
@@ -183,6 +200,14 @@ namespace Exiv2 {
         TiffComponent(uint16_t tag, IfdId group);
         //! Virtual destructor.
         virtual ~TiffComponent();
+        /*!
+          @brief Allocate memory for a component. Components created while
+                 TiffParserWorker parses or encodes an image are allocated
+                 from an arena of that session.
+         */
+        static void* operator new(std::size_t size);
+        //! Release memory of a component.
+        static void operator delete(void* p);
         //@}
 
         //! @name Manipulators
@@ -229,6 +254,14 @@ namespace Exiv2 {
                  freed outside of this class.
          */
         void setStart(const byte* pStart) { pStart_ = const_cast<byte*>(pStart); }
+        /*!
+          @brief Enable or disable the size cache of the component. While the
+                 cache is enabled, size(), sizeData() and sizeImage() compute
+                 their result only once, until a component with an enabled
+                 cache is modified, see clearSizes(). Each call discards the
+                 cached sizes.
+         */
+        void cacheSizes(bool enable);
         /*!
           @brief Write a TiffComponent to a binary image.
 
@@ -238,17 +271,18 @@ namespace Exiv2 {
                             the component.
           @param valueIdx   Index of the component to be written relative to offset.
           @param dataIdx    Index of the data area of the component relative to offset.
-          @param imageIdx   Index of the image data area relative to offset.
+          @param imageIdx   Index of the image data area relative to offset,
+                            uint64_t(-1) when writing the root directory.
           @return           Number of bytes written to the IO wrapper including all
                             nested components.
           @throw            Error If the component cannot be written.
          */
         uint32_t write(IoWrapper& ioWrapper,
                        ByteOrder byteOrder,
-                       int32_t   offset,
+                       int64_t   offset,
                        uint32_t  valueIdx,
                        uint32_t  dataIdx,
-                       uint32_t& imageIdx);
+                       uint64_t& imageIdx);
         //@}
 
         //! @name Accessors
@@ -272,9 +306,9 @@ namespace Exiv2 {
          */
         uint32_t writeData(IoWrapper& ioWrapper,
                            ByteOrder byteOrder,
-                           int32_t   offset,
+                           int64_t   offset,
                            uint32_t  dataIdx,
-                           uint32_t& imageIdx) const;
+                           uint64_t& imageIdx) const;
         /*!
           @brief Write the image data of this component to a binary image.
                  Return the number of bytes written. TIFF components implement
@@ -327,13 +361,25 @@ namespace Exiv2 {
         virtual TiffComponent* doAddNext(AutoPtr tiffComponent);
         //! Implements accept().
         virtual void doAccept(TiffVisitor& visitor) =0;
+        /*!
+          @brief Discard the cached sizes after the component is modified.
+                 The sizes of the directories which contain the component
+                 depend on it, so this discards the sizes cached by all
+                 components.
+         */
+        void clearSizes();
+        /*!
+          @brief Enable the size cache of \em tiffComponent, which was added
+                 to the component, if that of the component is enabled.
+         */
+        void cacheAdded(TiffComponent* tiffComponent);
         //! Implements write().
         virtual uint32_t doWrite(IoWrapper& ioWrapper,
                                  ByteOrder byteOrder,
-                                 int32_t   offset,
+                                 int64_t   offset,
                                  uint32_t  valueIdx,
                                  uint32_t  dataIdx,
-                                 uint32_t& imageIdx) =0;
+                                 uint64_t& imageIdx) =0;
         //@}
 
         //! @name Protected Accessors
@@ -343,9 +389,9 @@ namespace Exiv2 {
         //! Implements writeData().
         virtual uint32_t doWriteData(IoWrapper& ioWrapper,
                                      ByteOrder byteOrder,
-                                     int32_t   offset,
+                                     int64_t   offset,
                                      uint32_t  dataIdx,
-                                     uint32_t& imageIdx) const =0;
+                                     uint64_t& imageIdx) const =0;
         //! Implements writeImage().
         virtual uint32_t doWriteImage(IoWrapper& ioWrapper,
                                       ByteOrder byteOrder) const =0;
@@ -360,6 +406,9 @@ namespace Exiv2 {
         //@}
 
     private:
+        //! Return true if the size cache is enabled, discard stale sizes.
+        bool useCache() const;
+
         // DATA
         uint16_t tag_;      //!< Tag that identifies the component
         IfdId    group_;    //!< Group id for this component
@@ -368,6 +417,13 @@ namespace Exiv2 {
           a memory buffer. The buffer is allocated and freed outside of this class.
          */
         byte*    pStart_;
+        //! Flags of the size cache, see cacheSizes()
+        enum { cacheEnabled = 1, sizeCached = 2, sizeDataCached = 4, sizeImageCached = 8 };
+        mutable byte     cacheFlags_;     //!< State of the size cache
+        mutable uint32_t cachedSize_;     //!< Cached result of size()
+        mutable uint32_t cachedSizeData_; //!< Cached result of sizeData()
+        mutable uint32_t cachedSizeImage_; //!< Cached result of sizeImage()
+        mutable long     cacheGeneration_; //!< Modification count when the sizes were cached
 
     }; // class TiffComponent
 
@@ -376,18 +432,17 @@ namespace Exiv2 {
         struct Key;
         /*!
           @brief Compare a TiffMappingInfo with a TiffMappingInfo::Key.
-                 The two are equal if TiffMappingInfo::make_ equals a substring
-                 of the key of the same size. E.g., mapping info = "OLYMPUS",
-                 key = "OLYMPUS OPTICAL CO.,LTD" (found in the image) match,
-                 the extendedTag is Tag::all or equal to the extended tag of the
-                 key, and the group is equal to that of the key.
+                 The two are equal if TiffMappingInfo::make_ is mfUnknown or
+                 equal to the manufacturer of the key, the extendedTag is
+                 Tag::all or equal to the extended tag of the key, and the
+                 group is equal to that of the key.
          */
         bool operator==(const Key& key) const;
         //! Return the tag corresponding to the extended tag
         uint16_t tag() const { return static_cast<uint16_t>(extendedTag_ & 0xffff); }
 
         // DATA
-        const char* make_;        //!< Camera make for which these mapping functions apply
+        Manufacturer make_;       //!< Manufacturer for which these mapping functions apply, mfUnknown for all
         uint32_t    extendedTag_; //!< Tag (32 bit so that it can contain special tags)
         IfdId       group_;       //!< Group that contains the tag
         DecoderFct  decoderFct_;  //!< Decoder function for matching tags
@@ -398,8 +453,8 @@ namespace Exiv2 {
     //! Search key for TIFF mapping structures.
     struct TiffMappingInfo::Key {
         //! Constructor
-        Key(const std::string& m, uint32_t e, IfdId g) : m_(m), e_(e), g_(g) {}
-        std::string m_;                    //!< Camera make
+        Key(Manufacturer m, uint32_t e, IfdId g) : m_(m), e_(e), g_(g) {}
+        Manufacturer m_;                   //!< Camera manufacturer
         uint32_t    e_;                    //!< Extended tag
         IfdId       g_;                    //!< %Group
     };
@@ -412,7 +467,9 @@ namespace Exiv2 {
      */
     class TiffEntryBase : public TiffComponent {
         friend class TiffReader;
+        friend class TiffDecoder;
         friend class TiffEncoder;
+        friend class TiffFormatSetter;
         friend int selectNikonLd(TiffBinaryArray* const, TiffComponent* const);
     public:
         //! @name Creators
@@ -434,7 +491,7 @@ namespace Exiv2 {
          */
         void encode(TiffEncoder& encoder, const Exifdatum* datum);
         //! Set the offset
-        void setOffset(int32_t offset) { offset_ = offset; }
+        void setOffset(int64_t offset) { offset_ = offset; }
         //! Set pointer and size of the entry's data (not taking ownership of the data).
         void setData(byte* pData, int32_t size);
         //! Set the entry's data buffer, taking ownership of the data buffer passed in.
@@ -451,6 +508,13 @@ namespace Exiv2 {
           Update type, count and the pointer to the value.
         */
         void setValue(Value::AutoPtr value);
+        /*!
+          @brief Set the TIFF type and defer reading the value of type
+                 \em typeId from the data of the entry, which must be set,
+                 until the value is first accessed. The data is interpreted
+                 in byte order \em byteOrder.
+         */
+        void deferValue(TiffType tiffType, TypeId typeId, ByteOrder byteOrder);
         //@}
 
         //! @name Accessors
@@ -461,7 +525,7 @@ namespace Exiv2 {
           @brief Return the offset to the data area relative to the base
                  for the component (usually the start of the TIFF header)
          */
-        int32_t offset()         const { return offset_; }
+        int64_t offset()         const { return offset_; }
         /*!
           @brief Return the unique id of the entry in the image
          */
@@ -471,8 +535,11 @@ namespace Exiv2 {
                  value of this component.
          */
         const byte* pData()      const { return pData_; }
-        //! Return a const pointer to the converted value of this component
-        const Value* pValue()    const { return pValue_; }
+        /*!
+          @brief Return a const pointer to the converted value of this
+                 component. Reads a deferred value.
+         */
+        const Value* pValue()    const;
         //@}
 
     protected:
@@ -497,15 +564,15 @@ namespace Exiv2 {
          */
         virtual uint32_t doWrite(IoWrapper& ioWrapper,
                                  ByteOrder byteOrder,
-                                 int32_t   offset,
+                                 int64_t   offset,
                                  uint32_t  valueIdx,
                                  uint32_t  dataIdx,
-                                 uint32_t& imageIdx);
+                                 uint64_t& imageIdx);
         //@}
 
         //! @name Protected Accessors
         //@{
-        //! Implements count().
+        //! Implements count(). Reads a deferred value.
         virtual uint32_t doCount() const;
         /*!
           @brief Implements writeData(). Standard TIFF entries have no data:
@@ -513,9 +580,9 @@ namespace Exiv2 {
          */
         virtual uint32_t doWriteData(IoWrapper& ioWrapper,
                                      ByteOrder byteOrder,
-                                     int32_t   offset,
+                                     int64_t   offset,
                                      uint32_t  dataIdx,
-                                     uint32_t& imageIdx) const;
+                                     uint64_t& imageIdx) const;
         /*!
           @brief Implements writeImage(). Standard TIFF entries have no image data:
                  write nothing and return 0.
@@ -532,7 +599,7 @@ namespace Exiv2 {
 
         //! Helper function to write an \em offset to a preallocated binary buffer
         static uint32_t writeOffset(byte*     buf,
-                                    int32_t   offset,
+                                    int64_t   offset,
                                     TiffType  tiffType,
                                     ByteOrder byteOrder);
 
@@ -546,7 +613,7 @@ namespace Exiv2 {
         // DATA
         TiffType tiffType_;   //!< Field TIFF type
         uint32_t count_;      //!< The number of values of the indicated type
-        int32_t  offset_;     //!< Offset to the data area
+        int64_t  offset_;     //!< Offset to the data area
         /*!
           Size of the data buffer holding the value in bytes, there is no
           minimum size.
@@ -555,7 +622,10 @@ namespace Exiv2 {
         byte*    pData_;      //!< Pointer to the data area
         bool     isMalloced_; //!< True if this entry owns the value data
         int      idx_;        //!< Unique id of the entry in the image
-        Value*   pValue_;     //!< Converted data value
+        mutable Value* pValue_; //!< Converted data value, read on first access if deferred
+        bool     isDeferred_; //!< True if the value has not been read yet
+        TypeId   typeId_;     //!< Type of a deferred value
+        ByteOrder byteOrder_; //!< Byte order of the data of a deferred value
 
     }; // class TiffEntryBase
 
@@ -619,7 +689,7 @@ namespace Exiv2 {
          */
         virtual void setStrips(const Value* pSize,
                                const byte*  pData,
-                               uint32_t     sizeData,
+                               uint64_t     sizeData,
                                uint32_t     baseOffset) =0;
         //@}
 
@@ -666,7 +736,7 @@ namespace Exiv2 {
         //@{
         virtual void setStrips(const Value* pSize,
                                const byte*  pData,
-                               uint32_t     sizeData,
+                               uint64_t     sizeData,
                                uint32_t     baseOffset);
         //@}
 
@@ -688,10 +758,10 @@ namespace Exiv2 {
          */
         virtual uint32_t doWrite(IoWrapper& ioWrapper,
                                  ByteOrder byteOrder,
-                                 int32_t   offset,
+                                 int64_t   offset,
                                  uint32_t  valueIdx,
                                  uint32_t  dataIdx,
-                                 uint32_t& imageIdx);
+                                 uint64_t& imageIdx);
         //@}
 
         //! @name Protected Accessors
@@ -703,9 +773,9 @@ namespace Exiv2 {
          */
         virtual uint32_t doWriteData(IoWrapper& ioWrapper,
                                      ByteOrder byteOrder,
-                                     int32_t   offset,
+                                     int64_t   offset,
                                      uint32_t  dataIdx,
-                                     uint32_t& imageIdx) const;
+                                     uint64_t& imageIdx) const;
         // Using doWriteImage from base class
         // Using doSize() from base class
         //! Implements sizeData(). Return the size of the data area.
@@ -739,7 +809,7 @@ namespace Exiv2 {
         //@{
         //! Constructor
         TiffImageEntry(uint16_t tag, IfdId group, uint16_t szTag, IfdId szGroup)
-            : TiffDataEntryBase(tag, group, szTag, szGroup) {}
+            : TiffDataEntryBase(tag, group, szTag, szGroup), pImage_(0) {}
         //! Virtual destructor.
         virtual ~TiffImageEntry();
         //@}
@@ -748,8 +818,19 @@ namespace Exiv2 {
         //@{
         virtual void setStrips(const Value* pSize,
                                const byte*  pData,
-                               uint32_t     sizeData,
+                               uint64_t     sizeData,
                                uint32_t     baseOffset);
+        /*!
+          @brief Keep the image data at its position in the image \em pData
+                 of size \em size instead of writing it again, e.g., when new
+                 IFDs are appended to the image. The strip pointers are then
+                 written as offsets into \em pData. New image data (a data
+                 area) and image data in makernotes is written as usual.
+
+          @return False if a strip is not in \em pData, true otherwise.
+                  If \em pData is 0, the image data is written again.
+         */
+        bool keepImage(const byte* pData, uint64_t size);
         //@}
 
     protected:
@@ -764,10 +845,10 @@ namespace Exiv2 {
          */
         virtual uint32_t doWrite(IoWrapper& ioWrapper,
                                  ByteOrder byteOrder,
-                                 int32_t   offset,
+                                 int64_t   offset,
                                  uint32_t  valueIdx,
                                  uint32_t  dataIdx,
-                                 uint32_t& imageIdx);
+                                 uint64_t& imageIdx);
         //@}
 
         //! @name Protected Accessors
@@ -783,9 +864,9 @@ namespace Exiv2 {
          */
         virtual uint32_t doWriteData(IoWrapper& ioWrapper,
                                      ByteOrder byteOrder,
-                                     int32_t   offset,
+                                     int64_t   offset,
                                      uint32_t  dataIdx,
-                                     uint32_t& imageIdx) const;
+                                     uint64_t& imageIdx) const;
         /*!
           @brief Implements writeImage(). Write the image data area to the \em ioWrapper.
                  Return the number of bytes written.
@@ -806,6 +887,7 @@ namespace Exiv2 {
 
         // DATA
         Strips   strips_;       //!< Image strips data (never alloc'd) and sizes
+        const byte* pImage_;    //!< Image with the strips if they are kept, else 0
 
     }; // class TiffImageEntry
 
@@ -864,15 +946,29 @@ namespace Exiv2 {
         //@{
         //! Default constructor
         TiffDirectory(uint16_t tag, IfdId group, bool hasNext =true)
-            : TiffComponent(tag, group), hasNext_(hasNext), pNext_(0) {}
+            : TiffComponent(tag, group), hasNext_(hasNext), bigTiff_(false), pNext_(0) {}
         //! Virtual destructor
         virtual ~TiffDirectory();
         //@}
 
+        //! @name Manipulators
+        //@{
+        //! Reserve space for \em count components.
+        void reserve(uint16_t count) { components_.reserve(count); }
+        /*!
+          @brief Set the format of the directory: BigTIFF, with a 64-bit entry
+                 count, 20-byte entries and a 64-bit next pointer, or classic
+                 TIFF.
+         */
+        void setBigTiff(bool bigTiff) { bigTiff_ = bigTiff; clearSizes(); }
+        //@}
+
         //! @name Accessors
         //@{
         //! Return true if the directory has a next pointer
         bool hasNext() const { return hasNext_; }
+        //! Return true if the directory is in BigTIFF format
+        bool bigTiff() const { return bigTiff_; }
         //@}
 
     protected:
@@ -898,10 +994,10 @@ namespace Exiv2 {
          */
         virtual uint32_t doWrite(IoWrapper& ioWrapper,
                                  ByteOrder byteOrder,
-                                 int32_t   offset,
+                                 int64_t   offset,
                                  uint32_t  valueIdx,
                                  uint32_t  dataIdx,
-                                 uint32_t& imageIdx);
+                                 uint64_t& imageIdx);
         //@}
 
         //! @name Protected Accessors
@@ -913,9 +1009,9 @@ namespace Exiv2 {
          */
         virtual uint32_t doWriteData(IoWrapper& ioWrapper,
                                      ByteOrder byteOrder,
-                                     int32_t   offset,
+                                     int64_t   offset,
                                      uint32_t  dataIdx,
-                                     uint32_t& imageIdx) const;
+                                     uint64_t& imageIdx) const;
         /*!
           @brief Implements writeImage(). Write the image data of the TIFF
                  directory to the \em ioWrapper by forwarding the call to each
@@ -958,17 +1054,18 @@ namespace Exiv2 {
         //! Write a binary directory entry for a TIFF component.
         uint32_t writeDirEntry(IoWrapper&     ioWrapper,
                                ByteOrder      byteOrder,
-                               int32_t        offset,
+                               int64_t        offset,
                                TiffComponent* pTiffComponent,
                                uint32_t       valueIdx,
                                uint32_t       dataIdx,
-                               uint32_t&      imageIdx) const;
+                               uint64_t&      imageIdx) const;
         //@}
 
     private:
         // DATA
         Components components_; //!< List of components in this directory
         const bool hasNext_;    //!< True if the directory has a next pointer
+        bool bigTiff_;          //!< True if the directory is in BigTIFF format
         TiffComponent* pNext_;  //!< Pointer to the next IFD
 
     }; // class TiffDirectory
@@ -982,6 +1079,7 @@ namespace Exiv2 {
      */
     class TiffSubIfd : public TiffEntryBase {
         friend class TiffReader;
+        friend class TiffDecoder;
     public:
         //! @name Creators
         //@{
@@ -1014,10 +1112,10 @@ namespace Exiv2 {
          */
         virtual uint32_t doWrite(IoWrapper& ioWrapper,
                                  ByteOrder byteOrder,
-                                 int32_t   offset,
+                                 int64_t   offset,
                                  uint32_t  valueIdx,
                                  uint32_t  dataIdx,
-                                 uint32_t& imageIdx);
+                                 uint64_t& imageIdx);
         //@}
 
         //! @name Protected Accessors
@@ -1029,9 +1127,9 @@ namespace Exiv2 {
          */
         virtual uint32_t doWriteData(IoWrapper& ioWrapper,
                                      ByteOrder byteOrder,
-                                     int32_t   offset,
+                                     int64_t   offset,
                                      uint32_t  dataIdx,
-                                     uint32_t& imageIdx) const;
+                                     uint64_t& imageIdx) const;
         /*!
           @brief Implements writeImage(). Write the image data of each sub-IFD to
                  the \em ioWrapper. Return the number of bytes written.
@@ -1062,6 +1160,27 @@ namespace Exiv2 {
 
     }; // class TiffSubIfd
 
+    /*!
+      @brief Offsets in an unchanged makernote which is written as it was
+             read. Absolute offsets need to be adjusted when such a
+             makernote is moved.
+     */
+    struct MnRelocation {
+        //! Default constructor
+        MnRelocation() : offset_(0), byteOrder_(invalidByteOrder) {}
+        /*!
+          @brief Adjust the offsets in the makernote data \em pData of
+                 \em size bytes for the makernote to be at \em offset.
+         */
+        void relocate(byte* pData, uint32_t size, uint32_t offset) const;
+
+        // DATA
+        std::vector<uint32_t> positions_; //!< Positions of the offsets in the makernote
+        uint32_t  offset_;                //!< Offset of the makernote when it was read
+        ByteOrder byteOrder_;             //!< Byte order of the makernote
+
+    }; // struct MnRelocation
+
     /*!
       @brief This class is the basis for Makernote support in TIFF. It contains
              a pointer to a concrete Makernote. The TiffReader visitor has the
@@ -1095,14 +1214,16 @@ namespace Exiv2 {
         virtual void doEncode(TiffEncoder& encoder, const Exifdatum* datum);
         /*!
           @brief Implements write() by forwarding the call to the actual
-                 concrete Makernote, if there is one.
+                 concrete Makernote, if there is one. Otherwise writes the
+                 makernote data, with offsets adjusted if it is an unchanged
+                 makernote which was moved.
          */
         virtual uint32_t doWrite(IoWrapper& ioWrapper,
                                  ByteOrder byteOrder,
-                                 int32_t   offset,
+                                 int64_t   offset,
                                  uint32_t  valueIdx,
                                  uint32_t  dataIdx,
-                                 uint32_t& imageIdx);
+                                 uint64_t& imageIdx);
         //@}
 
         //! @name Protected Accessors
@@ -1133,6 +1254,8 @@ namespace Exiv2 {
         // DATA
         IfdId          mnGroup_;             //!< New group for concrete mn
         TiffComponent* mn_;                  //!< The Makernote
+        TiffMnSpan*    pMnSpan_;             //!< The Makernote if its parsing is deferred
+        MnRelocation   relocation_;          //!< Offsets to adjust in an unchanged makernote
 
     }; // class TiffMnEntry
 
@@ -1212,6 +1335,19 @@ namespace Exiv2 {
                  Returns 0 if there is no header.
          */
         uint32_t baseOffset() const;
+        /*!
+          @brief Find the offsets in the makernote data \em pData of \em size
+                 bytes, read at \em mnOffset, which need to be adjusted if
+                 the makernote is moved. The header must be read first.
+
+          @return false if the makernote cannot be moved by just adjusting
+                  these offsets, e.g., because it has sub-IFDs or entries
+                  which point to data outside of the makernote.
+         */
+        bool relocations(MnRelocation& relocation,
+                         const byte*   pData,
+                         uint32_t      size,
+                         uint32_t      mnOffset) const;
         //@}
 
     protected:
@@ -1231,10 +1367,10 @@ namespace Exiv2 {
          */
         virtual uint32_t doWrite(IoWrapper& ioWrapper,
                                  ByteOrder byteOrder,
-                                 int32_t   offset,
+                                 int64_t   offset,
                                  uint32_t  valueIdx,
                                  uint32_t  dataIdx,
-                                 uint32_t& imageIdx);
+                                 uint64_t& imageIdx);
         //@}
 
         //! @name Protected Accessors
@@ -1246,9 +1382,9 @@ namespace Exiv2 {
          */
         virtual uint32_t doWriteData(IoWrapper& ioWrapper,
                                      ByteOrder byteOrder,
-                                     int32_t   offset,
+                                     int64_t   offset,
                                      uint32_t  dataIdx,
-                                     uint32_t& imageIdx) const;
+                                     uint64_t& imageIdx) const;
         /*!
           @brief Implements writeImage(). Write the image data of the IFD of
                  the Makernote. Return the number of bytes written.
@@ -1307,8 +1443,27 @@ namespace Exiv2 {
      */
     typedef int (*CfgSelFct)(uint16_t, const byte*, uint32_t, TiffComponent* const);
 
-    //! Function pointer type for a crypt function used for binary arrays.
-    typedef DataBuf (*CryptFct)(uint16_t, const byte*, uint32_t, TiffComponent* const);
+    /*!
+      @brief Key of the crypt function of binary arrays. The crypt function
+             looks the key up in the TIFF tree the first time it is called
+             with an object of this type and reuses it for the other arrays
+             of the same tree.
+     */
+    struct CryptKey {
+        //! State of the key
+        enum State { notLookedUp, notFound, found };
+        //! Default constructor, the key is not looked up yet
+        CryptKey() : state_(notLookedUp) {}
+        // DATA
+        State state_;              //!< State of the key
+        byte  stream_[512];        //!< Key stream, repeated over the data to en/decrypt
+    };
+
+    /*!
+      @brief Function pointer type for a crypt function used for binary arrays.
+             En/decrypts the data in place, returns true if the data is encrypted.
+     */
+    typedef bool (*CryptFct)(uint16_t, byte*, uint32_t, TiffComponent* const, CryptKey&);
 
     //! Defines one tag in a binary array
     struct ArrayDef {
@@ -1376,6 +1531,12 @@ namespace Exiv2 {
         //@{
         //! Add an element to the binary array, return the size of the element
         uint32_t addElement(uint32_t idx, const ArrayDef& def);
+        /*!
+          @brief Set the number of elements which are decoded directly from
+                 the data of the array, instead of adding them, the index of
+                 the first and their byte order. Marks the array decoded.
+         */
+        void deferElements(uint32_t count, int idx, ByteOrder byteOrder);
         /*!
           @brief Setup cfg and def for the component, in case of a complex binary array.
                  Else do nothing. Return true if the initialization succeeded, else false.
@@ -1401,8 +1562,13 @@ namespace Exiv2 {
         bool initialize(TiffComponent* const pRoot);
         //! Initialize the original data buffer and its size from the base entry.
         void iniOrigDataBuf();
-        //! Update the original data buffer and its size, return true if successful.
-        bool updOrigDataBuf(const byte* pData, uint32_t size);
+        /*!
+          @brief Copy the data of the array to the original data buffer and
+                 encrypt it there if needed, with the crypt key \em key of
+                 the tree \em pRoot. Return false if the size of the data
+                 changed.
+         */
+        bool updOrigDataBuf(TiffComponent* const pRoot, CryptKey& key);
         //! Set a flag to indicate if the array was decoded
         void setDecoded(bool decoded) { decoded_ = decoded; }
         //@}
@@ -1417,6 +1583,20 @@ namespace Exiv2 {
         int defSize() const { return defSize_; }
         //! Return the flag which indicates if the array was decoded
         bool decoded() const { return decoded_; }
+        /*!
+          @brief Return the definition of the element at \em idx of the
+                 array. \em gap is set and returned for a gap between the
+                 elements of a concatenated array.
+         */
+        const ArrayDef* elDef(uint32_t idx, ArrayDef& gap) const;
+        //! Return the size of the element at \em idx with definition \em def
+        uint32_t elSize(uint32_t idx, const ArrayDef& def) const;
+        //! Return the number of elements set by deferElements(), 0 if none
+        uint32_t deferredElements() const { return elCount_; }
+        //! Return the index of the first element set by deferElements()
+        int elIdx() const { return elIdx_; }
+        //! Return the byte order of the elements set by deferElements()
+        ByteOrder elByteOrder() const { return elByteOrder_; }
         //@}
 
     protected:
@@ -1446,10 +1626,10 @@ namespace Exiv2 {
          */
         virtual uint32_t doWrite(IoWrapper& ioWrapper,
                                  ByteOrder byteOrder,
-                                 int32_t   offset,
+                                 int64_t   offset,
                                  uint32_t  valueIdx,
                                  uint32_t  dataIdx,
-                                 uint32_t& imageIdx);
+                                 uint64_t& imageIdx);
         //@}
 
         //! @name Protected Accessors
@@ -1486,6 +1666,9 @@ namespace Exiv2 {
         uint32_t origSize_;         //!< Size of the original data buffer
         TiffComponent* pRoot_;      //!< Pointer to the root component of the TIFF tree. (Only used for intrusive writing.)
         bool decoded_;              //!< Flag to indicate if the array was decoded
+        uint32_t elCount_;          //!< Number of elements decoded from the data, without adding them
+        int elIdx_;                 //!< Index of the first of these elements
+        ByteOrder elByteOrder_;     //!< Byte order of these elements
     }; // class TiffBinaryArray
 
     /*!
@@ -1535,10 +1718,10 @@ namespace Exiv2 {
          */
         virtual uint32_t doWrite(IoWrapper& ioWrapper,
                                  ByteOrder byteOrder,
-                                 int32_t   offset,
+                                 int64_t   offset,
                                  uint32_t  valueIdx,
                                  uint32_t  dataIdx,
-                                 uint32_t& imageIdx);
+                                 uint64_t& imageIdx);
         //@}
 
         //! @name Protected Accessors
@@ -1597,6 +1780,13 @@ namespace Exiv2 {
         return TiffComponent::AutoPtr(new TiffDirectory(tag, newGroup));
     }
 
+    //! Function to create and initialize a new TIFF directory without a next pointer
+    template<IfdId newGroup>
+    TiffComponent::AutoPtr newTiffLastDirectory(uint16_t tag, IfdId /*group*/)
+    {
+        return TiffComponent::AutoPtr(new TiffDirectory(tag, newGroup, false));
+    }
+
     //! Function to create and initialize a new TIFF sub-directory
     template<IfdId newGroup>
     TiffComponent::AutoPtr newTiffSubIfd(uint16_t tag, IfdId group)
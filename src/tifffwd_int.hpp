@@ -44,6 +44,7 @@
 namespace Exiv2 {
 
     class Exifdatum;
+    class ExifData;
 
     namespace Internal {
 
@@ -58,6 +59,7 @@ namespace Exiv2 {
     class TiffMnEntry;
     class TiffBinaryArray;
     class TiffBinaryElement;
+    struct CryptKey;
 
     class TiffIfdMakernote;
     class MnHeader;
@@ -67,6 +69,8 @@ namespace Exiv2 {
     class TiffDecoder;
     class TiffEncoder;
     class TiffReader;
+    class TiffSelection;
+    class TiffMnSpan;
 
     class TiffRwState;
     class TiffPathItem;
@@ -90,16 +94,16 @@ namespace Exiv2 {
     /*!
       @brief Type for a function pointer for a function to decode a TIFF component.
      */
-    typedef DecoderFct (*FindDecoderFct)(const std::string& make,
-                                               uint32_t     extendedTag,
-                                               IfdId        group);
+    typedef DecoderFct (*FindDecoderFct)(Manufacturer make,
+                                         uint32_t     extendedTag,
+                                         IfdId        group);
     /*!
       @brief Type for a function pointer for a function to encode a TIFF component.
      */
     typedef EncoderFct (*FindEncoderFct)(
-        const std::string& make,
-              uint32_t     extendedTag,
-              IfdId        group
+        Manufacturer make,
+        uint32_t     extendedTag,
+        IfdId        group
     );
     /*!
       @brief Type for a function pointer for a function to create a TIFF component.
@@ -107,6 +111,11 @@ namespace Exiv2 {
              to reduce dependencies.
      */
     typedef std::auto_ptr<TiffComponent> (*NewTiffCompFct)(uint16_t tag, IfdId group);
+    /*!
+      @brief Type for a function pointer for a function to remove metadata
+             which makes the encoded data too large.
+     */
+    typedef void (*ExifFilterFct)(ExifData& exifData);
 
     //! Stack to hold a path from the TIFF root element to a TIFF entry
     typedef std::stack<TiffPathItem> TiffPath;
@@ -38,6 +38,8 @@ EXIV2_RCSID("@(#) $Id$")
 #endif
 
 #include "tiffimage.hpp"
+#include "arena_int.hpp"
+#include "parsebudget_int.hpp"
 #include "tiffimage_int.hpp"
 #include "tiffcomposite_int.hpp"
 #include "tiffvisitor_int.hpp"
@@ -54,6 +56,7 @@ EXIV2_RCSID("@(#) $Id$")
 #include <iomanip>
 #include <cassert>
 #include <memory>
+#include <algorithm>
 
 /* --------------------------------------------------------------------------
 
@@ -81,7 +84,7 @@ namespace Exiv2 {
 
     TiffImage::TiffImage(BasicIo::AutoPtr io, bool /*create*/)
         : Image(ImageType::tiff, mdExif | mdIptc, io),
-          pixelWidth_(0), pixelHeight_(0)
+          pixelWidth_(0), pixelHeight_(0), writeMode_(twRewrite), lastPage_(false)
     {
     } // TiffImage::TiffImage
 
@@ -172,8 +175,15 @@ namespace Exiv2 {
         throw(Error(32, "Image comment", "TIFF"));
     }
 
+    void TiffImage::setWriteMode(TiffWriteMode writeMode)
+    {
+        writeMode_ = writeMode;
+    }
+
     void TiffImage::readMetadata()
     {
+        Internal::ArenaScope arenaScope(useArena());
+        Internal::ParseBudgetScope budgetScope(parseLimits());
 #ifdef DEBUG
         std::cerr << "Reading TIFF file " << io_->path() << "\n";
 #endif
@@ -185,14 +195,69 @@ namespace Exiv2 {
             throw Error(3, "TIFF");
         }
         clearMetadata();
+        primaryGroup_.clear();
+        mimeType_.clear();
+        pixelWidth_ = 0;
+        pixelHeight_ = 0;
+        pages_.clear();
+        lastPage_ = false;
         ByteOrder bo = TiffParser::decode(exifData_,
                                           iptcData_,
                                           xmpData_,
                                           io_->mmap(),
-                                          io_->size());
+                                          io_->size(),
+                                          readOptions());
         setByteOrder(bo);
     } // TiffImage::readMetadata
 
+    long TiffImage::pageCount()
+    {
+        if (lastPage_) return static_cast<long>(pages_.size());
+        return findPages(0);
+    } // TiffImage::pageCount
+
+    long TiffImage::findPages(std::size_t count)
+    {
+        Internal::ParseBudgetScope budgetScope(parseLimits());
+        if (io_->open() != 0) throw Error(9, io_->path(), strError());
+        IoCloser closer(*io_);
+        // Ensure that this is the correct image type
+        if (!isTiffType(*io_, false)) {
+            if (io_->error() || io_->eof()) throw Error(14);
+            throw Error(3, "TIFF");
+        }
+        lastPage_ = TiffParser::findPages(pages_, io_->mmap(), io_->size(), count);
+        return static_cast<long>(pages_.size());
+    } // TiffImage::findPages
+
+    void TiffImage::readPageMetadata(long page)
+    {
+        Internal::ArenaScope arenaScope(useArena());
+        Internal::ParseBudgetScope budgetScope(parseLimits());
+        const std::size_t count = page < 0 ? 0 : static_cast<std::size_t>(page) + 1;
+        if (count > pages_.size() && !lastPage_) {
+            // Search from the start again, at least twice as far as before
+            findPages(std::max(count, 2 * pages_.size()));
+        }
+        if (page < 0 || count > pages_.size()) throw Error(54, page, pageCount());
+        if (io_->open() != 0) throw Error(9, io_->path(), strError());
+        IoCloser closer(*io_);
+        clearMetadata();
+        // The primary image may be in a different group on this page
+        primaryGroup_.clear();
+        mimeType_.clear();
+        pixelWidth_ = 0;
+        pixelHeight_ = 0;
+        ByteOrder bo = TiffParser::decodePage(exifData_,
+                                              iptcData_,
+                                              xmpData_,
+                                              io_->mmap(),
+                                              io_->size(),
+                                              pages_[page],
+                                              readOptions());
+        setByteOrder(bo);
+    } // TiffImage::readPageMetadata
+
     void TiffImage::writeMetadata()
     {
 #ifdef DEBUG
@@ -217,15 +282,35 @@ namespace Exiv2 {
             bo = littleEndian;
         }
         setByteOrder(bo);
-        TiffParser::encode(*io_, pData, size, bo, exifData_, iptcData_, xmpData_); // may throw
+        pages_.clear();
+        lastPage_ = false;
+        TiffParser::encode(*io_, pData, size, bo, exifData_, iptcData_, xmpData_, writeMode_); // may throw
     } // TiffImage::writeMetadata
 
+    bool TiffImage::patchInPlace(const ExifKey& key, const Value& value)
+    {
+        if (io_->open() != 0) throw Error(9, io_->path(), strError());
+        IoCloser closer(*io_);
+        // Ensure that this is the correct image type
+        if (!isTiffType(*io_, false)) {
+            if (io_->error() || io_->eof()) throw Error(14);
+            throw Error(3, "TIFF");
+        }
+        if (!TiffParser::patch(io_->mmap(true), io_->size(), key, value)) {
+            return false;
+        }
+        ExifData::iterator pos = exifData_.findKey(key);
+        if (pos != exifData_.end()) pos->setValue(&value);
+        return true;
+    } // TiffImage::patchInPlace
+
     ByteOrder TiffParser::decode(
               ExifData& exifData,
               IptcData& iptcData,
               XmpData&  xmpData,
         const byte*     pData,
-              uint32_t  size
+              uint64_t  size,
+        const ReadOptions* pOptions
     )
     {
         return TiffParserWorker::decode(exifData,
@@ -234,17 +319,53 @@ namespace Exiv2 {
                                         pData,
                                         size,
                                         Tag::root,
-                                        TiffMapping::findDecoder);
+                                        TiffMapping::findDecoder,
+                                        0,
+                                        pOptions);
     } // TiffParser::decode
 
+    ByteOrder TiffParser::decodePage(
+              ExifData& exifData,
+              IptcData& iptcData,
+              XmpData&  xmpData,
+        const byte*     pData,
+              uint64_t  size,
+              uint64_t  pageOffset,
+        const ReadOptions* pOptions
+    )
+    {
+        TiffPageHeader header(pageOffset);
+        return TiffParserWorker::decode(exifData,
+                                        iptcData,
+                                        xmpData,
+                                        pData,
+                                        size,
+                                        Tag::page,
+                                        TiffMapping::findDecoder,
+                                        &header,
+                                        pOptions);
+    } // TiffParser::decodePage
+
+    bool TiffParser::findPages(
+              std::vector<uint64_t>& pages,
+        const byte*     pData,
+              uint64_t  size,
+              std::size_t count
+    )
+    {
+        TiffHeader header;
+        return TiffParserWorker::findPages(pages, pData, size, &header, count);
+    } // TiffParser::findPages
+
     WriteMethod TiffParser::encode(
               BasicIo&  io,
         const byte*     pData,
-              uint32_t  size,
+              uint64_t  size,
               ByteOrder byteOrder,
         const ExifData& exifData,
         const IptcData& iptcData,
-        const XmpData&  xmpData
+        const XmpData&  xmpData,
+              TiffWriteMode writeMode
     )
     {
         // Copy to be able to modify the Exif data
@@ -273,9 +394,23 @@ namespace Exiv2 {
                                         xmpData,
                                         Tag::root,
                                         TiffMapping::findEncoder,
-                                        header.get());
+                                        header.get(),
+                                        0,
+                                        0,
+                                        writeMode);
     } // TiffParser::encode
 
+    bool TiffParser::patch(
+              byte*     pData,
+              uint64_t  size,
+        const ExifKey&  key,
+        const Value&    value
+    )
+    {
+        TiffHeader header;
+        return TiffParserWorker::patch(pData, size, Tag::root, &header, key, value);
+    } // TiffParser::patch
+
     // *************************************************************************
     // free functions
     Image::AutoPtr newTiffInstance(BasicIo::AutoPtr io, bool create)
@@ -289,12 +424,22 @@ namespace Exiv2 {
 
     bool isTiffType(BasicIo& iIo, bool advance)
     {
-        const int32_t len = 8;
-        byte buf[len];
+        const long pos = iIo.tell();
+        int32_t len = 8;
+        byte buf[16];
         iIo.read(buf, len);
         if (iIo.error() || iIo.eof()) {
             return false;
         }
+        // The BigTIFF header is 16 bytes long
+        if (   (buf[0] == 0x49 && buf[2] == 43 && buf[3] == 0)
+            || (buf[0] == 0x4d && buf[2] == 0 && buf[3] == 43)) {
+            if (iIo.read(buf + len, 8) != 8 || iIo.error()) {
+                iIo.seek(pos, BasicIo::beg);
+                return false;
+            }
+            len += 8;
+        }
         TiffHeader tiffHeader;
         bool rc = tiffHeader.read(buf, len);
         if (!advance || !rc) {
@@ -1212,7 +1357,11 @@ namespace Exiv2 {
         { Tag::pana, ifdIdNotSet,      ifdIdNotSet,      Tag::pana },
         { Tag::pana, panaRawId,        ifdIdNotSet,      Tag::pana },
         { Tag::pana, exifId,           panaRawId,        0x8769    },
-        { Tag::pana, gpsId,            panaRawId,        0x8825    }
+        { Tag::pana, gpsId,            panaRawId,        0x8825    },
+        // ---------------------------------------------------------
+        // One page of a multi-page TIFF image, other groups as for Tag::root
+        { Tag::page, ifdIdNotSet,      ifdIdNotSet,      Tag::page },
+        { Tag::page, ifd0Id,           ifdIdNotSet,      Tag::page }
     };
 
     /*
@@ -1231,6 +1380,8 @@ namespace Exiv2 {
         //---------  ----------------- -----------------------------------------
         // Root directory
         { Tag::root, ifdIdNotSet,      newTiffDirectory<ifd0Id>                  },
+        // Root directory of one page, its next pointer is not followed
+        { Tag::page, ifdIdNotSet,      newTiffLastDirectory<ifd0Id>              },
 
         // IFD0
         {    0x8769, ifd0Id,           newTiffSubIfd<exifId>                     },
@@ -1670,19 +1821,58 @@ namespace Exiv2 {
 
     // TIFF mapping table for special decoding and encoding requirements
     const TiffMappingInfo TiffMapping::tiffMappingInfo_[] = {
-        { "*",       Tag::all, ignoreId,  0, 0 }, // Do not decode tags with group == ignoreId
-        { "*",         0x02bc, ifd0Id,    &TiffDecoder::decodeXmp,          0 /*done before the tree is traversed*/ },
-        { "*",         0x83bb, ifd0Id,    &TiffDecoder::decodeIptc,         0 /*done before the tree is traversed*/ },
-        { "*",         0x8649, ifd0Id,    &TiffDecoder::decodeIptc,         0 /*done before the tree is traversed*/ }
-    };
+        { mfUnknown, Tag::all, ignoreId,  0, 0 }, // Do not decode tags with group == ignoreId
+        { mfUnknown,   0x02bc, ifd0Id,    &TiffDecoder::decodeXmp,          0 /*done before the tree is traversed*/ },
+        { mfUnknown,   0x83bb, ifd0Id,    &TiffDecoder::decodeIptc,         0 /*done before the tree is traversed*/ },
+        { mfUnknown,   0x8649, ifd0Id,    &TiffDecoder::decodeIptc,         0 /*done before the tree is traversed*/ }
+    };
+
+    namespace {
+        //! Return the rows of the mapping table \em table by group, in table order.
+        std::vector<std::vector<const TiffMappingInfo*> > indexMappings(
+            const TiffMappingInfo* table,
+                  std::size_t      count)
+        {
+            std::vector<std::vector<const TiffMappingInfo*> > index(lastId + 1);
+            for (std::size_t i = 0; i < count; ++i) {
+                if (static_cast<std::size_t>(table[i].group_) >= index.size()) {
+                    index.resize(table[i].group_ + 1);
+                }
+                index[table[i].group_].push_back(&table[i]);
+            }
+            return index;
+        }
+    }
+
+    // The indexes are built from the tables above when the library is loaded
+    const TiffTreeIndex TiffCreator::treeIndex_(tiffTreeStruct_,
+                                                EXV_COUNTOF(tiffTreeStruct_));
+    const TiffGroupIndex TiffCreator::groupIndex_(tiffGroupStruct_,
+                                                  EXV_COUNTOF(tiffGroupStruct_));
+    const std::vector<std::vector<const TiffMappingInfo*> > TiffMapping::mappingIndex_
+        = indexMappings(tiffMappingInfo_, EXV_COUNTOF(tiffMappingInfo_));
+
+    const TiffMappingInfo* TiffMapping::findMapping(Manufacturer make,
+                                                    uint32_t     extendedTag,
+                                                    IfdId        group)
+    {
+        if (static_cast<std::size_t>(group) >= mappingIndex_.size()) return 0;
+        const std::vector<const TiffMappingInfo*>& rows = mappingIndex_[group];
+        for (std::vector<const TiffMappingInfo*>::const_iterator i = rows.begin();
+             i != rows.end(); ++i) {
+            // Check the tag first, to compare the make only for candidates
+            if (   (*i)->extendedTag_ != Tag::all && (*i)->extendedTag_ != extendedTag) continue;
+            if (**i == TiffMappingInfo::Key(make, extendedTag, group)) return *i;
+        }
+        return 0;
+    }
 
-    DecoderFct TiffMapping::findDecoder(const std::string& make,
-                                              uint32_t     extendedTag,
-                                              IfdId        group)
+    DecoderFct TiffMapping::findDecoder(Manufacturer make,
+                                        uint32_t     extendedTag,
+                                        IfdId        group)
     {
         DecoderFct decoderFct = &TiffDecoder::decodeStdTiffEntry;
-        const TiffMappingInfo* td = find(tiffMappingInfo_,
-                                         TiffMappingInfo::Key(make, extendedTag, group));
+        const TiffMappingInfo* td = findMapping(make, extendedTag, group);
         if (td) {
             // This may set decoderFct to 0, meaning that the tag should not be decoded
             decoderFct = td->decoderFct_;
@@ -1691,14 +1881,13 @@ namespace Exiv2 {
     }
 
     EncoderFct TiffMapping::findEncoder(
-        const std::string& make,
-              uint32_t     extendedTag,
-              IfdId        group
+        Manufacturer make,
+        uint32_t     extendedTag,
+        IfdId        group
     )
     {
         EncoderFct encoderFct = 0;
-        const TiffMappingInfo* td = find(tiffMappingInfo_,
-                                         TiffMappingInfo::Key(make, extendedTag, group));
+        const TiffMappingInfo* td = findMapping(make, extendedTag, group);
         if (td) {
             // Returns 0 if no special encoder function is found
             encoderFct = td->encoderFct_;
@@ -1711,13 +1900,85 @@ namespace Exiv2 {
         return key.r_ == root_ && key.g_ == group_;
     }
 
+    TiffGroupIndex::TiffGroupIndex(const TiffGroupStruct* table, std::size_t count)
+        : groups_(lastId + 1)
+    {
+        for (std::size_t i = 0; i < count; ++i) {
+            const TiffGroupStruct& row = table[i];
+            if (static_cast<std::size_t>(row.group_) >= groups_.size()) {
+                groups_.resize(row.group_ + 1);
+            }
+            Group& group = groups_[row.group_];
+            // Rows after the one for all tags of a group are never found
+            if (group.pAll_ != 0) continue;
+            if (row.extendedTag_ == Tag::all) {
+                group.pAll_ = &row;
+            }
+            else {
+                group.tags_.push_back(std::make_pair(row.extendedTag_, &row));
+            }
+        }
+        // Rows with the same tag remain in table order, the first one is found
+        for (std::vector<Group>::iterator i = groups_.begin(); i != groups_.end(); ++i) {
+            std::sort(i->tags_.begin(), i->tags_.end());
+        }
+    }
+
+    const TiffGroupStruct* TiffGroupIndex::find(uint32_t extendedTag, IfdId group) const
+    {
+        if (static_cast<std::size_t>(group) >= groups_.size()) return 0;
+        const Group& g = groups_[group];
+        std::vector<std::pair<uint32_t, const TiffGroupStruct*> >::const_iterator pos
+            = std::lower_bound(g.tags_.begin(), g.tags_.end(),
+                               std::make_pair(extendedTag, static_cast<const TiffGroupStruct*>(0)));
+        if (pos != g.tags_.end() && pos->first == extendedTag) return pos->second;
+        return g.pAll_;
+    }
+
+    TiffTreeIndex::TiffTreeIndex(const TiffTreeStruct* table, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i) {
+            Node node;
+            node.pRow_ = &table[i];
+            node.complete_ = false;
+            // Keeps the first row for a root and group
+            nodes_.insert(std::make_pair(std::make_pair(table[i].root_, table[i].group_), node));
+        }
+        // Follow the parents of each group to the root, as getPath() needs them
+        for (Nodes::iterator i = nodes_.begin(); i != nodes_.end(); ++i) {
+            const uint32_t root = i->first.first;
+            const TiffTreeStruct* ts = i->second.pRow_;
+            i->second.complete_ = true;
+            while (ts->group_ != ifdIdNotSet) {
+                i->second.parents_.push_back(TiffPathItem(ts->parentExtTag_, ts->parentGroup_));
+                ts = find(root, ts->parentGroup_);
+                if (ts == 0 || i->second.parents_.size() > count) {
+                    i->second.complete_ = false;
+                    break;
+                }
+            }
+        }
+    }
+
+    const TiffTreeStruct* TiffTreeIndex::find(uint32_t root, IfdId group) const
+    {
+        Nodes::const_iterator pos = nodes_.find(std::make_pair(root, group));
+        return pos == nodes_.end() ? 0 : pos->second.pRow_;
+    }
+
+    const TiffTreeIndex::Parents* TiffTreeIndex::parents(uint32_t root, IfdId group) const
+    {
+        Nodes::const_iterator pos = nodes_.find(std::make_pair(root, group));
+        if (pos == nodes_.end() || !pos->second.complete_) return 0;
+        return &pos->second.parents_;
+    }
+
     TiffComponent::AutoPtr TiffCreator::create(uint32_t extendedTag,
                                                IfdId    group)
     {
         TiffComponent::AutoPtr tc(0);
         uint16_t tag = static_cast<uint16_t>(extendedTag & 0xffff);
-        const TiffGroupStruct* ts = find(tiffGroupStruct_,
-                                         TiffGroupStruct::Key(extendedTag, group));
+        const TiffGroupStruct* ts = groupIndex_.find(extendedTag, group);
         if (ts && ts->newTiffCompFct_) {
             tc = ts->newTiffCompFct_(tag, group);
         }
@@ -1742,57 +2003,336 @@ namespace Exiv2 {
                               IfdId     group,
                               uint32_t  root)
     {
-        const TiffTreeStruct* ts = 0;
-        do {
-            tiffPath.push(TiffPathItem(extendedTag, group));
-            ts = find(tiffTreeStruct_, TiffTreeStruct::Key(root, group));
-            assert(ts != 0);
-            extendedTag = ts->parentExtTag_;
-            group = ts->parentGroup_;
-        } while (!(ts->root_ == root && ts->group_ == ifdIdNotSet));
+        const TiffTreeIndex::Parents* parents = treeIndex_.parents(root, group);
+        assert(parents != 0);
+        tiffPath.push(TiffPathItem(extendedTag, group));
+        for (TiffTreeIndex::Parents::const_iterator i = parents->begin();
+             i != parents->end(); ++i) {
+            tiffPath.push(*i);
+        }
 
     } // TiffCreator::getPath
 
+    bool TiffCreator::getGroups(std::set<IfdId>& groups,
+                                IfdId            group,
+                                uint32_t         root)
+    {
+        bool makernote = false;
+        while (group != ifdIdNotSet) {
+            groups.insert(group);
+            const TiffTreeStruct* ts = treeIndex_.find(root, group);
+            // Makernotes are only configured for the standard root
+            if (ts == 0) ts = treeIndex_.find(Tag::root, group);
+            if (ts == 0) break;
+            if (ts->parentExtTag_ == 0x927c) makernote = true;
+            group = ts->parentGroup_;
+        }
+        return makernote;
+
+    } // TiffCreator::getGroups
+
+    TiffSelection::TiffSelection(const ReadOptions& options, uint32_t root)
+        : options_(options),
+          all_(options.selectedAll(mdExif)),
+          makernote_(all_),
+          elements_(true)
+    {
+        if (all_ || !options.selected(mdExif)) return;
+
+        const std::string prefix("Exif.");
+        for (std::set<std::string>::const_iterator i = options.groups_.begin();
+             i != options.groups_.end(); ++i) {
+            if (i->compare(0, prefix.size(), prefix) != 0) continue;
+            IfdId group = groupId(i->substr(prefix.size()));
+            if (group == ifdIdNotSet) continue;
+            groups_.insert(group);
+            if (TiffCreator::getGroups(readGroups_, group, root)) makernote_ = true;
+        }
+        for (std::set<std::string>::const_iterator i = options.keys_.begin();
+             i != options.keys_.end(); ++i) {
+            if (i->compare(0, prefix.size(), prefix) != 0) continue;
+            try {
+                ExifKey key(*i);
+                IfdId group = static_cast<IfdId>(key.ifdId());
+                tags_.insert(std::make_pair(key.tag(), group));
+                if (TiffCreator::getGroups(readGroups_, group, root)) makernote_ = true;
+            }
+            catch (const AnyError&) {
+                // Ignore invalid keys, they select nothing
+            }
+        }
+    }
+
+    bool TiffSelection::readGroup(IfdId group) const
+    {
+        return all_ || readGroups_.find(group) != readGroups_.end();
+    }
+
+    bool TiffSelection::selected(uint16_t tag, IfdId group) const
+    {
+        return    all_
+               || groups_.find(group) != groups_.end()
+               || tags_.find(std::make_pair(tag, group)) != tags_.end();
+    }
+
+    TiffMnSpan::TiffMnSpan(RawStore&          store,
+                           const byte*        pData,
+                           uint64_t           size,
+                           uint64_t           offset,
+                           uint32_t           mnSize,
+                           uint16_t           tag,
+                           IfdId              mnGroup,
+                           const std::string& make,
+                           const std::string& model,
+                           ByteOrder          byteOrder,
+                           const ReadOptions* pOptions)
+        : pStore_(&store),
+          pData_(pData),
+          size_(size),
+          offset_(offset),
+          mnSize_(mnSize),
+          tag_(tag),
+          mnGroup_(mnGroup),
+          make_(make),
+          manufacturer_(manufacturer(make)),
+          model_(model),
+          byteOrder_(byteOrder),
+          refCount_(1)
+    {
+        assert(store.contains(pData, size) && offset + mnSize <= size);
+        pStore_->addRef();
+        if (pOptions) options_.reset(new ReadOptions(*pOptions));
+    }
+
+    TiffMnSpan::~TiffMnSpan()
+    {
+        pStore_->release();
+    }
+
+    void TiffMnSpan::addRef()
+    {
+        atomicIncrement(refCount_);
+    }
+
+    void TiffMnSpan::release()
+    {
+        if (atomicDecrement(refCount_) == 0) delete this;
+    }
+
+    void TiffMnSpan::decode(ExifData& exifData) const
+    {
+        ArenaScope treeScope(true, Arena::tiffTreePool);
+        const byte* pMnData = pData_ + offset_;
+        TiffComponent::AutoPtr mn(
+            TiffMnCreator::create(tag_, mnGroup_, manufacturer_, pMnData, mnSize_, byteOrder_));
+        if (mn.get() == 0) return;
+
+        // Root of a tree with the makernote and the tags which are used to parse it
+        TiffComponent::AutoPtr root = TiffCreator::create(Tag::root, ifdIdNotSet);
+        assert(root.get() != 0);
+        const uint16_t tags[] = { 0x010f, 0x0110 };
+        const std::string* values[] = { &make_, &model_ };
+        for (unsigned int i = 0; i < EXV_COUNTOF(tags); ++i) {
+            if (values[i]->empty()) continue;
+            std::auto_ptr<TiffEntry> entry(new TiffEntry(tags[i], ifd0Id));
+            Value::AutoPtr value = Value::create(asciiString);
+            value->read(*values[i]);
+            entry->setValue(value);
+            root->addChild(TiffComponent::AutoPtr(entry.release()));
+        }
+        TiffComponent* pMn = root->addChild(mn);
+        pMn->setStart(pMnData);
+
+        TiffRwState::AutoPtr state(new TiffRwState(byteOrder_, 0));
+        TiffReader reader(pData_, size_, root.get(), state);
+        pMn->accept(reader);
+        reader.postProcess();
+
+        ExifData ed;
+        IptcData iptcData;
+        XmpData xmpData;
+        // The values refer to the TIFF data, copies go to a store of their
+        // own, as the ExifData copies which share this object may be parsed
+        // concurrently
+        RawStore* pStore = new RawStore(*pStore_);
+        TiffDecoder decoder(ed, iptcData, xmpData, root.get(), TiffMapping::findDecoder, 0, pStore);
+        pStore->release();
+        pMn->accept(decoder);
+        if (options_.get()) {
+            for (ExifData::iterator i = ed.begin(); i != ed.end(); ) {
+                if (options_->selected(*i)) ++i;
+                else i = ed.erase(i);
+            }
+        }
+        exifData.append(ed);
+    }
+
     ByteOrder TiffParserWorker::decode(
               ExifData&          exifData,
               IptcData&          iptcData,
               XmpData&           xmpData,
         const byte*              pData,
-              uint32_t           size,
+              uint64_t           size,
               uint32_t           root,
               FindDecoderFct     findDecoderFct,
-              TiffHeaderBase*    pHeader
+              TiffHeaderBase*    pHeader,
+        const ReadOptions*       pOptions,
+              RawStore*          pStore
     )
     {
+        // All nodes of the tree are allocated from an arena and freed at once
+        ArenaScope treeScope(true, Arena::tiffTreePool);
         // Create standard TIFF header if necessary
         std::auto_ptr<TiffHeaderBase> ph;
         if (!pHeader) {
             ph = std::auto_ptr<TiffHeaderBase>(new TiffHeader);
             pHeader = ph.get();
         }
-        TiffComponent::AutoPtr rootDir = parse(pData, size, root, pHeader);
+        // The tree is only decoded, binary arrays are decoded from their data
+        const ReadOptions defaultOptions;
+        TiffSelection selection(pOptions ? *pOptions : defaultOptions, root);
+        selection.skipElements();
+        TiffComponent::AutoPtr rootDir = parse(pData, size, root, pHeader, &selection, pStore);
         if (0 != rootDir.get()) {
             TiffDecoder decoder(exifData,
                                 iptcData,
                                 xmpData,
                                 rootDir.get(),
-                                findDecoderFct);
+                                findDecoderFct,
+                                &selection,
+                                pStore);
             rootDir->accept(decoder);
+            decoder.decodeSubtrees();
         }
         return pHeader->byteOrder();
 
     } // TiffParserWorker::decode
 
+    ByteOrder decodeTiff(ExifData&          exifData,
+                         IptcData&          iptcData,
+                         XmpData&           xmpData,
+                         DataBuf&           buf,
+                         long               offset,
+                         const ReadOptions* pOptions)
+    {
+        if (offset < 0 || offset > buf.size_) throw Error(26);
+        RawStore* pStore = new RawStore(buf);
+        ByteOrder bo = invalidByteOrder;
+        try {
+            bo = TiffParserWorker::decode(exifData,
+                                          iptcData,
+                                          xmpData,
+                                          pStore->pData() + offset,
+                                          pStore->size() - offset,
+                                          Tag::root,
+                                          TiffMapping::findDecoder,
+                                          0,
+                                          pOptions,
+                                          pStore);
+        }
+        catch (...) {
+            pStore->release();
+            throw;
+        }
+        pStore->release();
+        return bo;
+    } // decodeTiff
+
+    bool TiffParserWorker::findPages(
+              std::vector<uint64_t>& pages,
+        const byte*              pData,
+              uint64_t           size,
+              TiffHeaderBase*    pHeader,
+              std::size_t        count
+    )
+    {
+        assert(pHeader);
+        pages.clear();
+        if (pData == 0 || size == 0) return true;
+        if (!pHeader->read(pData, size) || pHeader->offset() >= size) {
+            throw Error(3, "TIFF");
+        }
+        ParseBudgetScope budgetScope;
+        const ByteOrder byteOrder = pHeader->byteOrder();
+        const bool big = pHeader->isBigTiff();
+        const uint64_t sizeCount = big ? 8 : 2;
+        const uint64_t sizeEntry = big ? 20 : 12;
+        const uint64_t sizeNext  = big ? 8 : 4;
+        std::set<uint64_t> dirList;
+        for (uint64_t offset = pHeader->offset(); offset != 0;) {
+            if (count != 0 && pages.size() == count) return false;
+            if (!budgetScope.budget().addComponents()) break;
+            if (offset > size || size - offset < sizeCount) {
+#ifndef SUPPRESS_WARNINGS
+                EXV_ERROR << "Page " << pages.size() + 1
+                          << ": IFD exceeds data buffer, cannot read entry count.\n";
+#endif
+                break;
+            }
+            if (!dirList.insert(offset).second) {
+#ifndef SUPPRESS_WARNINGS
+                EXV_ERROR << "Page " << pages.size() + 1
+                          << ": IFD pointer references a previously read IFD. Ignored.\n";
+#endif
+                break;
+            }
+            const byte* p = pData + offset;
+            const uint64_t n = big ? getULongLong(p, byteOrder) : getUShort(p, byteOrder);
+            // Same sanity check as TiffReader::visitDirectory()
+            if (n > 256) {
+#ifndef SUPPRESS_WARNINGS
+                EXV_ERROR << "Page " << pages.size() + 1 << ": IFD with "
+                          << n << " entries considered invalid; not read.\n";
+#endif
+                break;
+            }
+            pages.push_back(offset);
+            const uint64_t next = offset + sizeCount + n * sizeEntry;
+            if (next > size || size - next < sizeNext) break;
+            offset = big ? getULongLong(pData + next, byteOrder)
+                         : getULong(pData + next, byteOrder);
+        }
+        return true;
+
+    } // TiffParserWorker::findPages
+
+    bool TiffParserWorker::patch(
+              byte*              pData,
+              uint64_t           size,
+              uint32_t           root,
+              TiffHeaderBase*    pHeader,
+        const ExifKey&           key,
+        const Value&             value
+    )
+    {
+        assert(pHeader);
+        ArenaScope treeScope(true, Arena::tiffTreePool);
+        ReadOptions options;
+        options.metadata_ = mdExif;
+        options.keys_.insert(key.key());
+        TiffSelection selection(options, root);
+        TiffComponent::AutoPtr rootDir = parse(pData, size, root, pHeader, &selection);
+        if (0 == rootDir.get()) return false;
+        TiffPatcher patcher(key.tag(), static_cast<IfdId>(key.ifdId()),
+                            value, pHeader->byteOrder(), pData, size);
+        rootDir->accept(patcher);
+        return patcher.patched();
+
+    } // TiffParserWorker::patch
+
     WriteMethod TiffParserWorker::encode(
               BasicIo&           io,
         const byte*              pData,
-              uint32_t           size,
+              uint64_t           size,
         const ExifData&          exifData,
         const IptcData&          iptcData,
         const XmpData&           xmpData,
               uint32_t           root,
               FindEncoderFct     findEncoderFct,
-              TiffHeaderBase*    pHeader
+              TiffHeaderBase*    pHeader,
+              uint32_t           maxSize,
+              ExifFilterFct      filterFct,
+              TiffWriteMode      writeMode
     )
     {
         /*
@@ -1804,10 +2344,27 @@ namespace Exiv2 {
          */
         assert(pHeader);
         assert(pHeader->byteOrder() != invalidByteOrder);
+        if (exifData.deferredMakernote()) {
+            // Encode a copy with the makernote parsed, its tags are needed
+            // unless the makernote is written as it was read
+            ExifData parsed(exifData);
+            parsed.parseMakernote();
+            return encode(io, pData, size, parsed, iptcData, xmpData, root,
+                          findEncoderFct, pHeader, maxSize, filterFct, writeMode);
+        }
+        // The nodes of the parsed and created trees are allocated from an arena
+        ArenaScope treeScope(true, Arena::tiffTreePool);
         WriteMethod writeMethod = wmIntrusive;
-        TiffComponent::AutoPtr parsedTree = parse(pData, size, root, pHeader);
+        // An unchanged makernote is not parsed, it is written as it was read
+        const bool rawMakernote = pData != 0 && !exifData.makernoteModified();
+        ReadOptions options;
+        TiffSelection selection(options, root);
+        selection.skipMakernote();
+        TiffComponent::AutoPtr parsedTree =
+            parse(pData, size, root, pHeader, rawMakernote ? &selection : 0);
         PrimaryGroups primaryGroups;
         findPrimaryGroups(primaryGroups, parsedTree.get());
+        bool movableMakernote = false;
         if (0 != parsedTree.get()) {
             // Attempt to update existing TIFF components based on metadata entries
             TiffEncoder encoder(exifData,
@@ -1817,33 +2374,52 @@ namespace Exiv2 {
                                 false,
                                 &primaryGroups,
                                 pHeader,
-                                findEncoderFct);
+                                findEncoderFct,
+                                rawMakernote);
             parsedTree->accept(encoder);
-            if (!encoder.dirty()) writeMethod = wmNonIntrusive;
+            if (!encoder.dirty() && writeMode != twCompact) writeMethod = wmNonIntrusive;
+            movableMakernote = encoder.movableMakernote();
         }
         if (writeMethod == wmIntrusive) {
-            TiffComponent::AutoPtr createdTree = TiffCreator::create(root, ifdIdNotSet);
-            if (0 != parsedTree.get()) {
-                // Copy image tags from the original image to the composite
-                TiffCopier copier(createdTree.get(), root, pHeader, &primaryGroups);
-                parsedTree->accept(copier);
+            if (rawMakernote && !movableMakernote) {
+                // The makernote is encoded from its tags, read it after all
+                parseMakernote(pData, size, parsedTree.get(), pHeader);
             }
-            // Add entries from metadata to composite
-            TiffEncoder encoder(exifData,
-                                iptcData,
-                                xmpData,
-                                createdTree.get(),
-                                parsedTree.get() == 0,
-                                &primaryGroups,
-                                pHeader,
-                                findEncoderFct);
-            encoder.add(createdTree.get(), parsedTree.get(), root);
-            // Write binary representation from the composite tree
+            CryptKey cryptKey;
+            TiffComponent::AutoPtr createdTree = create(
+                exifData, iptcData, xmpData, parsedTree.get(), root,
+                findEncoderFct, pHeader, primaryGroups, movableMakernote, cryptKey);
             DataBuf header = pHeader->write();
+            if (   filterFct != 0
+                &&   header.size_ + createdTree->size() + createdTree->sizeImage()
+                   > static_cast<long>(maxSize)) {
+                // Too large: filter the metadata and create the tree again
+                ExifData filtered(exifData);
+                filterFct(filtered);
+                const bool raw = movableMakernote && !filtered.makernoteModified();
+                if (movableMakernote && !raw) {
+                    // The makernote is encoded from its tags now, read it after all
+                    parseMakernote(pData, size, parsedTree.get(), pHeader);
+                }
+                createdTree = create(
+                    filtered, iptcData, xmpData, parsedTree.get(), root,
+                    findEncoderFct, pHeader, primaryGroups, raw, cryptKey);
+            }
+            // The image data of a BigTIFF image is never moved, its IFDs
+            // are always appended
+            if (   (writeMode == twAppend || pHeader->isBigTiff())
+                && append(io, pData, size, createdTree.get(), pHeader, cryptKey)) {
+#ifdef DEBUG
+                std::cerr << "Appended IFDs\n";
+#endif
+                return writeMethod;
+            }
+            if (pHeader->isBigTiff()) throw Error(53);
+            // Write binary representation from the composite tree
             BasicIo::AutoPtr tempIo(io.temporary()); // may throw
             assert(tempIo.get() != 0);
-            IoWrapper ioWrapper(*tempIo, header.pData_, header.size_);
-            uint32_t imageIdx(uint32_t(-1));
+            IoWrapper ioWrapper(*tempIo, header.pData_, header.size_, &cryptKey);
+            uint64_t imageIdx(uint64_t(-1));
             createdTree->write(ioWrapper,
                                pHeader->byteOrder(),
                                header.size_,
@@ -1863,11 +2439,121 @@ namespace Exiv2 {
         return writeMethod;
     } // TiffParserWorker::encode
 
+    TiffComponent::AutoPtr TiffParserWorker::create(
+        const ExifData&          exifData,
+        const IptcData&          iptcData,
+        const XmpData&           xmpData,
+              TiffComponent*     pParsedTree,
+              uint32_t           root,
+              FindEncoderFct     findEncoderFct,
+              TiffHeaderBase*    pHeader,
+        const PrimaryGroups&     primaryGroups,
+              bool               rawMakernote,
+              CryptKey&          cryptKey
+    )
+    {
+        TiffComponent::AutoPtr createdTree = TiffCreator::create(root, ifdIdNotSet);
+        if (0 != pParsedTree) {
+            // Copy image tags from the original image to the composite
+            TiffCopier copier(createdTree.get(), root, pHeader, &primaryGroups);
+            pParsedTree->accept(copier);
+        }
+        // Add entries from metadata to composite
+        TiffEncoder encoder(exifData,
+                            iptcData,
+                            xmpData,
+                            createdTree.get(),
+                            pParsedTree == 0,
+                            &primaryGroups,
+                            pHeader,
+                            findEncoderFct,
+                            rawMakernote);
+        encoder.add(createdTree.get(), pParsedTree, root);
+        cryptKey = encoder.cryptKey();
+        // The tree is complete, compute the size of each component only once
+        TiffSizeCacher cacher(true);
+        createdTree->accept(cacher);
+        return createdTree;
+
+    } // TiffParserWorker::create
+
+    bool TiffParserWorker::append(
+              BasicIo&           io,
+        const byte*              pData,
+              uint64_t           size,
+              TiffComponent*     pCreatedTree,
+        const TiffHeaderBase*    pHeader,
+              CryptKey&          cryptKey
+    )
+    {
+        const bool bigTiff = pHeader->isBigTiff();
+        if (pData == 0 || size < pHeader->size()) return false;
+        // Keep the image data where it is. This changes the sizes of the
+        // tree, which discards the cached sizes.
+        TiffImageKeeper keeper(pData, size);
+        pCreatedTree->accept(keeper);
+        if (bigTiff) {
+            TiffFormatSetter formatSetter(true);
+            pCreatedTree->accept(formatSetter);
+        }
+        // Write the new IFDs for the end of the image, on a word boundary
+        const uint64_t offset = size + (size & 1);
+        // Classic TIFF offsets are 32-bit
+        const uint64_t maxOffset = bigTiff ? ~static_cast<uint64_t>(0) >> 1 : 0xffffffff;
+        MemIo mio;
+        bool fits = keeper.kept() && offset < maxOffset;
+        if (fits) {
+            IoWrapper ioWrapper(mio, 0, 0, &cryptKey);
+            uint64_t imageIdx(uint64_t(-1));
+            try {
+                pCreatedTree->write(ioWrapper,
+                                    pHeader->byteOrder(),
+                                    offset,
+                                    uint32_t(-1),
+                                    uint32_t(-1),
+                                    imageIdx);
+            }
+            catch (const Error& e) {
+                // An offset of the new IFDs does not fit into its entry
+                if (e.code() != 26) throw;
+                fits = false;
+            }
+        }
+        if (   !fits
+            || mio.size() == 0
+            || static_cast<uint64_t>(mio.size()) > maxOffset - offset) {
+            // Nothing was written or the offsets are out of range, write a
+            // new TIFF structure with all image data instead
+            TiffImageKeeper writer(0, 0);
+            pCreatedTree->accept(writer);
+            return false;
+        }
+        // Append the IFDs before the header is changed, to keep the image
+        // valid if that fails
+        if (io.seek(0, BasicIo::end) != 0) throw Error(21);
+        if (size & 1) io.putb(0x0);
+        if (io.write(mio.mmap(), mio.size()) != mio.size()) throw Error(21);
+        // Point the header to the new IFD0. Map the IO again, as writing may
+        // have moved or unmapped pData.
+        byte* pImage = io.mmap(true);
+        if (pImage == 0 || static_cast<uint64_t>(io.size()) < pHeader->size()) throw Error(21);
+        if (bigTiff) {
+            ull2Data(pImage + 8, offset, pHeader->byteOrder());
+        }
+        else {
+            ul2Data(pImage + 4, static_cast<uint32_t>(offset), pHeader->byteOrder());
+        }
+        return true;
+
+    } // TiffParserWorker::append
+
     TiffComponent::AutoPtr TiffParserWorker::parse(
         const byte*              pData,
-              uint32_t           size,
+              uint64_t           size,
               uint32_t           root,
-              TiffHeaderBase*    pHeader
+              TiffHeaderBase*    pHeader,
+        const TiffSelection*     pSelection,
+              RawStore*          pStore
     )
     {
         if (pData == 0 || size == 0) return TiffComponent::AutoPtr(0);
@@ -1878,8 +2564,8 @@ namespace Exiv2 {
         if (0 != rootDir.get()) {
             rootDir->setStart(pData + pHeader->offset());
             TiffRwState::AutoPtr state(
-                new TiffRwState(pHeader->byteOrder(), 0));
-            TiffReader reader(pData, size, rootDir.get(), state);
+                new TiffRwState(pHeader->byteOrder(), 0, pHeader->isBigTiff()));
+            TiffReader reader(pData, size, rootDir.get(), state, pSelection, pStore);
             rootDir->accept(reader);
             reader.postProcess();
         }
@@ -1887,6 +2573,28 @@ namespace Exiv2 {
 
     } // TiffParserWorker::parse
 
+    void TiffParserWorker::parseMakernote(
+        const byte*              pData,
+              uint64_t           size,
+              TiffComponent*     pRoot,
+              TiffHeaderBase*    pHeader
+    )
+    {
+        if (pData == 0 || size == 0 || pRoot == 0) return;
+        TiffFinder finder(0x927c, exifId);
+        pRoot->accept(finder);
+        TiffMnEntry* pMnEntry = dynamic_cast<TiffMnEntry*>(finder.result());
+        if (pMnEntry == 0) return;
+        // The makernote entry is in the Exif IFD, which is read in the byte
+        // order of the image and without an offset
+        TiffRwState::AutoPtr state(
+            new TiffRwState(pHeader->byteOrder(), 0, pHeader->isBigTiff()));
+        TiffReader reader(pData, size, pRoot, state);
+        pMnEntry->accept(reader);
+        reader.postProcess();
+
+    } // TiffParserWorker::parseMakernote
+
     void TiffParserWorker::findPrimaryGroups(PrimaryGroups& primaryGroups,
                                              TiffComponent* pSourceDir)
     {
@@ -1929,7 +2637,8 @@ namespace Exiv2 {
         : tag_(tag),
           size_(size),
           byteOrder_(byteOrder),
-          offset_(offset)
+          offset_(offset),
+          bigTiff_(false)
     {
     }
 
@@ -1950,7 +2659,18 @@ namespace Exiv2 {
         else {
             return false;
         }
-        if (tag_ != getUShort(pData + 2, byteOrder_)) return false;
+        bigTiff_ = false;
+        const uint16_t tag = getUShort(pData + 2, byteOrder_);
+        if (tag_ == 42 && tag == 43) {
+            // BigTIFF: offset size 8, a reserved 0 and an 8-byte offset
+            if (   size < 16
+                || getUShort(pData + 4, byteOrder_) != 8
+                || getUShort(pData + 6, byteOrder_) != 0) return false;
+            bigTiff_ = true;
+            offset_ = getULongLong(pData + 8, byteOrder_);
+            return true;
+        }
+        if (tag_ != tag) return false;
         offset_ = getULong(pData + 4, byteOrder_);
 
         return true;
@@ -1958,7 +2678,7 @@ namespace Exiv2 {
 
     DataBuf TiffHeaderBase::write() const
     {
-        DataBuf buf(8);
+        DataBuf buf(size());
         switch (byteOrder_) {
         case littleEndian:
             buf.pData_[0] = 0x49;
@@ -1972,6 +2692,13 @@ namespace Exiv2 {
             assert(false);
             break;
         }
+        if (bigTiff_) {
+            us2Data(buf.pData_ + 2, 43, byteOrder_);
+            us2Data(buf.pData_ + 4, 8, byteOrder_);
+            us2Data(buf.pData_ + 6, 0, byteOrder_);
+            ull2Data(buf.pData_ + 8, 16, byteOrder_);
+            return buf;
+        }
         us2Data(buf.pData_ + 2, tag_, byteOrder_);
         ul2Data(buf.pData_ + 4, 0x00000008, byteOrder_);
         return buf;
@@ -1980,7 +2707,7 @@ namespace Exiv2 {
     void TiffHeaderBase::print(std::ostream& os, const std::string& prefix) const
     {
         os << prefix
-           << _("TIFF header, offset") << " = 0x"
+           << (bigTiff_ ? _("BigTIFF header, offset") : _("TIFF header, offset")) << " = 0x"
            << std::setw(8) << std::setfill('0') << std::hex << std::right
            << offset_;
 
@@ -2002,19 +2729,24 @@ namespace Exiv2 {
         byteOrder_ = byteOrder;
     }
 
-    uint32_t TiffHeaderBase::offset() const
+    uint64_t TiffHeaderBase::offset() const
     {
         return offset_;
     }
 
-    void TiffHeaderBase::setOffset(uint32_t offset)
+    void TiffHeaderBase::setOffset(uint64_t offset)
     {
         offset_ = offset;
     }
 
     uint32_t TiffHeaderBase::size() const
     {
-        return size_;
+        return bigTiff_ ? 16 : size_;
+    }
+
+    bool TiffHeaderBase::isBigTiff() const
+    {
+        return bigTiff_;
     }
 
     uint16_t TiffHeaderBase::tag() const
@@ -2039,6 +2771,22 @@ namespace Exiv2 {
     {
     }
 
+    TiffPageHeader::TiffPageHeader(uint64_t pageOffset)
+        : pageOffset_(pageOffset)
+    {
+    }
+
+    TiffPageHeader::~TiffPageHeader()
+    {
+    }
+
+    bool TiffPageHeader::read(const byte* pData, uint32_t size)
+    {
+        if (!TiffHeader::read(pData, size)) return false;
+        setOffset(pageOffset_);
+        return true;
+    }
+
     bool TiffHeader::isImageTag(      uint16_t       tag,
                                       IfdId          group,
                                 const PrimaryGroups* pPrimaryGroups) const
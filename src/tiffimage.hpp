@@ -37,6 +37,7 @@
 
 // + standard includes
 #include <string>
+#include <vector>
 
 // *****************************************************************************
 // namespace extensions
@@ -85,12 +86,59 @@ namespace Exiv2 {
         //! @name Manipulators
         //@{
         void readMetadata();
+        using Image::readMetadata;
         void writeMetadata();
+        /*!
+          @brief Overwrite the value of the Exif tag \em key in the TIFF file,
+              see Image::patchInPlace().
+         */
+        bool patchInPlace(const ExifKey& key, const Value& value);
         /*!
           @brief Not supported. TIFF format does not contain a comment.
               Calling this function will throw an Error(32).
          */
         void setComment(const std::string& comment);
+        /*!
+          @brief Set how writeMetadata() writes the image if its metadata
+              cannot be updated in place. The default is twRewrite, which
+              writes a new file, including all image data.
+
+              With twAppend, the new IFDs are appended to the end of the file
+              and the TIFF header is updated to point to them. The image data
+              and the previous IFDs stay where they are, the latter become
+              unused. This is much faster for large images, but the file
+              grows with each such write. With twCompact, writeMetadata()
+              writes a new file even if the metadata could be updated in
+              place, which removes unused space from the file.
+
+              The image data of a BigTIFF image is never moved: its metadata
+              is always updated in place or appended, whatever the write
+              mode.
+         */
+        void setWriteMode(TiffWriteMode writeMode);
+        /*!
+          @brief Return the number of pages of the image, i.e., the number
+              of IFDs in the chain of IFD0. The chain is followed without
+              reading the entries of the IFDs and only once, unless the
+              metadata is read or written in between.
+         */
+        long pageCount();
+        /*!
+          @brief Read the metadata of page \em page (starting from 0) of a
+              multi-page TIFF image, instead of the metadata read by
+              readMetadata().
+
+              Only the IFD of the page and its sub-IFDs are decoded and the
+              chain of IFDs is only followed up to the page, so that the
+              time taken does not depend on the number of pages. The
+              IFD of the page is decoded as IFD0, i.e., to "Exif.Image"
+              tags. Note that writeMetadata() writes this metadata to the
+              first page of the image.
+
+          @throw Error if the image cannot be read or does not have page
+              \em page.
+         */
+        void readPageMetadata(long page);
         //@}
 
         //! @name Accessors
@@ -115,12 +163,25 @@ namespace Exiv2 {
         std::string primaryGroup() const;
         //@}
 
+        //! @name Manipulators
+        //@{
+        /*!
+          @brief Open the image and find at least \em count pages (all if
+              \em count is 0) or all there are. Return the number of
+              pages found.
+         */
+        long findPages(std::size_t count);
+        //@}
+
     private:
         // DATA
         mutable std::string primaryGroup_;     //!< The primary group
         mutable std::string mimeType_;         //!< The MIME type
         mutable int pixelWidth_;               //!< Width of the primary image in pixels 
         mutable int pixelHeight_;              //!< Height of the primary image in pixels 
+        TiffWriteMode writeMode_;              //!< How writeMetadata() writes the image
+        std::vector<uint64_t> pages_;          //!< Offsets of the IFDs of the pages found so far
+        bool lastPage_;                        //!< Indicates if pages_ includes the last page
 
     }; // class TiffImage
 
@@ -141,6 +202,8 @@ namespace Exiv2 {
           @param pData    Pointer to the data buffer. Must point to data in TIFF
                           format; no checks are performed.
           @param size     Length of the data buffer.
+          @param pOptions Optional selection of the metadata to decode, see
+                          Image::readMetadata(const ReadOptions&).
 
           @return Byte order in which the data is encoded.
         */
@@ -149,7 +212,43 @@ namespace Exiv2 {
                   IptcData& iptcData,
                   XmpData&  xmpData,
             const byte*     pData,
-                  uint32_t  size
+                  uint64_t  size,
+            const ReadOptions* pOptions =0
+        );
+        /*!
+          @brief Decode the metadata of one page of a multi-page TIFF image
+                 from a buffer \em pData of length \em size to the provided
+                 metadata containers.
+
+          Only the IFD at \em pageOffset and its sub-IFDs are decoded, the
+          IFD is decoded as IFD0 and its next pointer is not followed.
+          Parameters and return value are as for decode(), \em pageOffset
+          is one of the offsets found by findPages().
+        */
+        static ByteOrder decodePage(
+                  ExifData& exifData,
+                  IptcData& iptcData,
+                  XmpData&  xmpData,
+            const byte*     pData,
+                  uint64_t  size,
+                  uint64_t  pageOffset,
+            const ReadOptions* pOptions =0
+        );
+        /*!
+          @brief Find the pages of a multi-page TIFF image in the buffer
+                 \em pData of length \em size and set \em pages to the
+                 offsets of their IFDs. Only the chain of next pointers
+                 which starts at the first IFD is followed, the entries of
+                 the IFDs are not read. The search stops after \em count
+                 pages, unless \em count is 0.
+
+          @return True if \em pages includes the last page of the image.
+        */
+        static bool findPages(
+                  std::vector<uint64_t>& pages,
+            const byte*     pData,
+                  uint64_t  size,
+                  std::size_t count =0
         );
         /*!
           @brief Encode metadata from the provided metadata to TIFF format.
@@ -181,17 +280,40 @@ namespace Exiv2 {
           @param exifData  Exif metadata container.
           @param iptcData  IPTC metadata container.
           @param xmpData   XMP metadata container.
+          @param writeMode How to write the image if it cannot be updated
+                           in place, see TiffImage::setWriteMode(). With
+                           twAppend, the new IFDs are written to the end of
+                           \em io, which must contain the binary image
+                           \em pData, \em size, and the TIFF header in
+                           \em io is updated. The return value is
+                           \c wmIntrusive in this case.
 
           @return Write method used.
         */
         static WriteMethod encode(
                   BasicIo&  io,
             const byte*     pData,
-                  uint32_t  size,
+                  uint64_t  size,
                   ByteOrder byteOrder,
             const ExifData& exifData,
             const IptcData& iptcData,
-            const XmpData&  xmpData
+            const XmpData&  xmpData,
+                  TiffWriteMode writeMode =twRewrite
+        );
+        /*!
+          @brief Overwrite the value of the Exif tag \em key in the buffer
+                 \em pData of length \em size with data in TIFF format with
+                 \em value, see Image::patchInPlace().
+
+          @return True if the value was overwritten, false if the tag is not
+                  in the buffer or \em value does not have the type and size
+                  of its current value. The buffer is unchanged in this case.
+         */
+        static bool patch(
+                  byte*     pData,
+                  uint64_t  size,
+            const ExifKey&  key,
+            const Value&    value
         );
 
     }; // class TiffParser
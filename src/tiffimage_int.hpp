@@ -38,6 +38,10 @@
 #include "types.hpp"
 
 // + standard includes
+#include <set>
+#include <map>
+#include <vector>
+#include <utility>
 
 // *****************************************************************************
 // namespace extensions
@@ -85,7 +89,7 @@ namespace Exiv2 {
         //! Set the byte order.
         virtual void setByteOrder(ByteOrder byteOrder);
         //! Set the offset to the start of the root directory.
-        virtual void setOffset(uint32_t offset);
+        virtual void setOffset(uint64_t offset);
         //@}
 
         //! @name Accessors
@@ -107,9 +111,14 @@ namespace Exiv2 {
         //! Return the byte order (little or big endian).
         virtual ByteOrder byteOrder() const;
         //! Return the offset to the start of the root directory.
-        virtual uint32_t offset() const;
+        virtual uint64_t offset() const;
         //! Return the size (in bytes) of the image header.
         virtual uint32_t size() const;
+        /*!
+          @brief Return \c true if the header read is a BigTIFF header, with
+                 8-byte offsets and 20-byte IFD entries.
+         */
+        virtual bool isBigTiff() const;
         //! Return the tag value (magic number) which identifies the buffer as TIFF data.
         virtual uint16_t tag() const;
         /*!
@@ -136,7 +145,8 @@ namespace Exiv2 {
         const uint16_t tag_;       //!< Tag to identify the buffer as TIFF data
         const uint32_t size_;      //!< Size of the header
         ByteOrder      byteOrder_; //!< Applicable byte order
-        uint32_t       offset_;    //!< Offset to the start of the root dir
+        uint64_t       offset_;    //!< Offset to the start of the root dir
+        bool           bigTiff_;   //!< Indicates a BigTIFF header
 
     }; // class TiffHeaderBase
 
@@ -166,6 +176,31 @@ namespace Exiv2 {
         bool           hasImageTags_;   //!< Indicates if image tags are supported
     }; // class TiffHeader
 
+    /*!
+      @brief Standard TIFF header with the root directory set to the IFD of
+             one page of a multi-page TIFF image, independent of the offset
+             in the header.
+     */
+    class TiffPageHeader : public TiffHeader {
+    public:
+        //! @name Creators
+        //@{
+        //! Constructor taking the offset of the IFD of the page.
+        explicit TiffPageHeader(uint64_t pageOffset);
+        //! Destructor
+        ~TiffPageHeader();
+        //@}
+
+        //! @name Manipulators
+        //@{
+        bool read(const byte* pData, uint32_t size);
+        //@}
+
+    private:
+        // DATA
+        uint64_t       pageOffset_;     //!< Offset of the IFD of the page
+    }; // class TiffPageHeader
+
     /*!
       @brief Data structure used to list image tags for TIFF and TIFF-like images.
      */
@@ -242,6 +277,66 @@ namespace Exiv2 {
         IfdId    g_;                    //!< %Group
     };
 
+    /*!
+      @brief Index of the TIFF group structure table by group and tag. It
+             is built once from the table; find() returns the same row as a
+             linear search of the table with the Exiv2::find() template.
+     */
+    class TiffGroupIndex {
+    public:
+        //! Constructor, indexes the \em count rows of \em table.
+        TiffGroupIndex(const TiffGroupStruct* table, std::size_t count);
+        //! Return the row for \em extendedTag and \em group, 0 if there is none.
+        const TiffGroupStruct* find(uint32_t extendedTag, IfdId group) const;
+
+    private:
+        //! Rows of a group for single tags, sorted by tag, and the row for all tags
+        struct Group {
+            //! Default constructor
+            Group() : pAll_(0) {}
+            std::vector<std::pair<uint32_t, const TiffGroupStruct*> > tags_; //!< Rows by tag
+            const TiffGroupStruct* pAll_;   //!< Row for all other tags
+        };
+        // DATA
+        std::vector<Group> groups_;     //!< Rows by group
+
+    }; // class TiffGroupIndex
+
+    /*!
+      @brief Index of the TIFF tree structure table by root and group, with
+             the path from each group to the root of its tree, computed once
+             from the table.
+     */
+    class TiffTreeIndex {
+    public:
+        //! Path items from the parent of a group up to the root
+        typedef std::vector<TiffPathItem> Parents;
+
+        //! Constructor, indexes the \em count rows of \em table.
+        TiffTreeIndex(const TiffTreeStruct* table, std::size_t count);
+        //! Return the row for \em group in tree \em root, 0 if there is none.
+        const TiffTreeStruct* find(uint32_t root, IfdId group) const;
+        /*!
+          @brief Return the path items from the parent of \em group up to
+                 and including the root of tree \em root, 0 if the path is
+                 not complete.
+         */
+        const Parents* parents(uint32_t root, IfdId group) const;
+
+    private:
+        //! A row and the path from its group to the root
+        struct Node {
+            const TiffTreeStruct* pRow_; //!< The row
+            Parents parents_;           //!< Path items up to the root
+            bool complete_;             //!< True if the path leads to the root
+        };
+        //! Nodes by root and group
+        typedef std::map<std::pair<uint32_t, IfdId>, Node> Nodes;
+        // DATA
+        Nodes nodes_;                   //!< Nodes by root and group
+
+    }; // class TiffTreeIndex
+
     /*!
       @brief TIFF component factory.
      */
@@ -264,10 +359,20 @@ namespace Exiv2 {
                             uint32_t  extendedTag,
                             IfdId     group,
                             uint32_t  root);
+        /*!
+          @brief Add \em group and all groups on the path from the \em root
+                 TIFF element to it to \em groups. Return true if the path
+                 leads through a makernote.
+        */
+        static bool getGroups(std::set<IfdId>& groups,
+                              IfdId            group,
+                              uint32_t         root);
 
     private:
         static const TiffTreeStruct  tiffTreeStruct_[];  //<! TIFF tree structure
         static const TiffGroupStruct tiffGroupStruct_[]; //<! TIFF group structure
+        static const TiffTreeIndex   treeIndex_;         //<! Index of the TIFF tree structure
+        static const TiffGroupIndex  groupIndex_;        //<! Index of the TIFF group structure
 
     }; // class TiffCreator
 
@@ -295,6 +400,10 @@ namespace Exiv2 {
           @param findDecoderFct Function to access special decoding info.
           @param pHeader   Optional pointer to a TIFF header. If not provided,
                            a standard TIFF header is used.
+          @param pOptions  Optional selection of the metadata to decode.
+                           Everything is decoded if not provided.
+          @param pStore    Optional store for the raw data of deferred
+                           values, see RawStore.
 
           @return Byte order in which the data is encoded, invalidByteOrder if
                   decoding failed.
@@ -304,10 +413,38 @@ namespace Exiv2 {
                   IptcData&          iptcData,
                   XmpData&           xmpData,
             const byte*              pData,
-                  uint32_t           size,
+                  uint64_t           size,
                   uint32_t           root,
                   FindDecoderFct     findDecoderFct,
-                  TiffHeaderBase*    pHeader =0
+                  TiffHeaderBase*    pHeader =0,
+            const ReadOptions*       pOptions =0,
+                  RawStore*          pStore =0
+        );
+        /*!
+          @brief Find the pages of the TIFF image in the data buffer
+                 \em pData of length \em size.
+
+          Only the entry counts and next pointers of the chain of IFDs which
+          starts at the root directory are read, the entries are skipped.
+          The chain ends at a null pointer or at the first IFD which is out
+          of bounds, invalid or read before.
+
+          @param pages   Is set to the offsets of the IFDs of the pages, in
+                         the order of the chain.
+          @param pData   Pointer to the data buffer.
+          @param size    Length of the data buffer.
+          @param pHeader Image header to read the byte order, offset size
+                         and the offset of the root directory.
+          @param count   Maximum number of pages to find, 0 for all.
+
+          @return True if \em pages includes the last page of the chain.
+         */
+        static bool findPages(
+                  std::vector<uint64_t>& pages,
+            const byte*              pData,
+                  uint64_t           size,
+                  TiffHeaderBase*    pHeader,
+                  std::size_t        count
         );
         /*!
           @brief Encode TIFF metadata from the metadata containers into a
@@ -318,17 +455,55 @@ namespace Exiv2 {
           3) else, create a new tree and write a new TIFF structure ("intrusive
              writing"). If there is a parsed tree, it is only used to access the
              image data in this case.
+
+          If a filter function \em filterFct is provided and the size of the
+          new TIFF structure, as computed from the tree, exceeds \em maxSize,
+          the tree is created again from a copy of the Exif data reduced by
+          the filter function, before anything is written. The result may
+          still exceed \em maxSize.
+
+          If \em writeMode is twAppend, the new tree is appended to \em io,
+          which must contain the image \em pData, \em size, see append().
+          With twCompact, a new TIFF structure is written even if the
+          metadata could be updated in-place. A BigTIFF image is always
+          updated in place or appended to; if neither is possible, an
+          Error(53) is thrown.
          */
         static WriteMethod encode(
                   BasicIo&           io,
             const byte*              pData,
-                  uint32_t           size,
+                  uint64_t           size,
             const ExifData&          exifData,
             const IptcData&          iptcData,
             const XmpData&           xmpData,
                   uint32_t           root,
                   FindEncoderFct     findEncoderFct,
-                  TiffHeaderBase*    pHeader
+                  TiffHeaderBase*    pHeader,
+                  uint32_t           maxSize =0,
+                  ExifFilterFct      filterFct =0,
+                  TiffWriteMode      writeMode =twRewrite
+        );
+        /*!
+          @brief Overwrite the value of the Exif tag \em key in the binary
+                 image \em pData, \em size with \em value, if the current
+                 value has the same type, count and size.
+
+          Only the directories needed to find the tag are parsed. The value
+          must be that of a standard IFD entry, which includes entries of IFD
+          makernotes; offsets, image data, makernotes and elements of binary
+          arrays are never patched.
+
+          @return True if the value was overwritten, false if the tag was not
+                  found or the new value does not fit. \em pData is not
+                  changed in this case.
+         */
+        static bool patch(
+                  byte*              pData,
+                  uint64_t           size,
+                  uint32_t           root,
+                  TiffHeaderBase*    pHeader,
+            const ExifKey&           key,
+            const Value&             value
         );
 
     private:
@@ -341,14 +516,35 @@ namespace Exiv2 {
           @param size      Length of the data buffer.
           @param root      Root tag of the TIFF tree.
           @param pHeader   Pointer to a TIFF header.
+          @param pSelection Optional selection of the parts of the tree to read.
+          @param pStore    Optional store which holds the buffer, for
+                           makernotes which are parsed later.
           @return          An auto pointer with the root element of the TIFF
                            composite structure. If \em pData is 0 or \em size
                            is 0, the return value is a 0 pointer.
          */
         static std::auto_ptr<TiffComponent> parse(
             const byte*              pData,
-                  uint32_t           size,
+                  uint64_t           size,
                   uint32_t           root,
+                  TiffHeaderBase*    pHeader,
+            const TiffSelection*     pSelection =0,
+                  RawStore*          pStore =0
+        );
+        /*!
+          @brief Read the makernote of the tree \em pRoot, which was parsed
+                 from \em pData with the makernote skipped. The rest of the
+                 tree is not read again.
+
+          @param pData     Pointer to the data buffer the tree was parsed from.
+          @param size      Length of the data buffer.
+          @param pRoot     Root element of the parsed tree.
+          @param pHeader   Pointer to the TIFF header of the tree.
+         */
+        static void parseMakernote(
+            const byte*              pData,
+                  uint64_t           size,
+                  TiffComponent*     pRoot,
                   TiffHeaderBase*    pHeader
         );
         /*!
@@ -362,9 +558,185 @@ namespace Exiv2 {
             PrimaryGroups& primaryGroups,
             TiffComponent* pSourceDir
         );
+        /*!
+          @brief Create a new TIFF tree for intrusive writing with the image
+                 tags of the parsed tree \em pParsedTree, if any, and the
+                 metadata provided. Makes a copy of the makernote of the image
+                 if \em rawMakernote is true. The size caches of the
+                 components of the new tree are enabled. The key to encrypt
+                 binary arrays of the new tree, as far as the encoder looked
+                 it up, is copied to \em cryptKey, for the write of the tree.
+         */
+        static std::auto_ptr<TiffComponent> create(
+            const ExifData&          exifData,
+            const IptcData&          iptcData,
+            const XmpData&           xmpData,
+                  TiffComponent*     pParsedTree,
+                  uint32_t           root,
+                  FindEncoderFct     findEncoderFct,
+                  TiffHeaderBase*    pHeader,
+            const PrimaryGroups&     primaryGroups,
+                  bool               rawMakernote,
+                  CryptKey&          cryptKey
+        );
+        /*!
+          @brief Append the IFDs of the created tree \em pCreatedTree to the
+                 end of the image \em pData, \em size in \em io and point the
+                 TIFF header in \em io to the new IFD0. The image data stays
+                 where it is in the image, new image data is appended after
+                 the IFDs. For a BigTIFF header, the tree is written in
+                 BigTIFF format; otherwise all offsets must fit in 32 bits.
+                 Binary arrays are encrypted with \em cryptKey.
+
+          @return True if the IFDs were appended, false if the image data of
+                  the tree is not in \em pData or nothing needs to be written.
+                  Nothing is written to \em io in this case.
+          @throw Error if writing to \em io fails.
+         */
+        static bool append(
+                  BasicIo&           io,
+            const byte*              pData,
+                  uint64_t           size,
+                  TiffComponent*     pCreatedTree,
+            const TiffHeaderBase*    pHeader,
+                  CryptKey&          cryptKey
+        );
 
     }; // class TiffParserWorker
 
+    /*!
+      @brief The parts of a TIFF tree selected by ReadOptions. Used by
+             TiffReader to skip directories, makernotes and binary arrays
+             which contain no selected metadata and by TiffDecoder to decode
+             only selected entries.
+     */
+    class TiffSelection {
+    public:
+        //! @name Creators
+        //@{
+        //! Constructor, selects what \em options select from the TIFF tree \em root.
+        TiffSelection(const ReadOptions& options, uint32_t root);
+        //@}
+
+        //! @name Manipulators
+        //@{
+        //! Do not read makernotes, keep them as undefined data.
+        void skipMakernote() { makernote_ = false; }
+        /*!
+          @brief Do not add the elements of binary arrays to the tree. Only
+                 for trees which are decoded and not written, the decoder
+                 reads the elements from the data of the arrays.
+         */
+        void skipElements() { elements_ = false; }
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return true if the directory or binary array of \em group needs to be read.
+        bool readGroup(IfdId group) const;
+        //! Return true if makernotes need to be read.
+        bool readMakernote() const { return makernote_; }
+        //! Return true if the elements of binary arrays need to be added to the tree.
+        bool readElements() const { return elements_; }
+        //! Return true if the entry \em tag of \em group is selected.
+        bool selected(uint16_t tag, IfdId group) const;
+        //! Return true if metadata of \em family is selected.
+        bool selected(MetadataId family) const { return options_.selected(family); }
+        //! Return true if parsing of makernotes is deferred.
+        bool deferMakernote() const { return options_.deferMakernote_; }
+        //! Return the options.
+        const ReadOptions& options() const { return options_; }
+        //@}
+
+    private:
+        // DATA
+        const ReadOptions& options_;    //!< The options
+        bool all_;                      //!< True if all Exif metadata is selected
+        bool makernote_;                //!< True if makernotes need to be read
+        bool elements_;                 //!< True if binary array elements need to be added
+        std::set<IfdId> readGroups_;    //!< Groups to read, including parents
+        std::set<IfdId> groups_;        //!< Selected groups
+        std::set<std::pair<uint16_t, IfdId> > tags_; //!< Selected tags and their groups
+
+    }; // class TiffSelection
+
+    /*!
+      @brief A makernote which was not parsed when the image was read.
+
+      Refers to the TIFF data the makernote was read from, which is held
+      by a RawStore, so that offsets relative to the TIFF header remain
+      valid, and keeps the camera make and model and the byte order of the
+      image. The makernote is parsed into a small tree of its own by
+      ExifData::parseMakernote(). Objects are reference counted and shared
+      by all copies of the ExifData they belong to.
+     */
+    class TiffMnSpan {
+    public:
+        //! @name Creators
+        //@{
+        /*!
+          @brief Constructor, for the makernote \em tag of \em mnSize bytes
+                 at \em offset in the \em size bytes of TIFF data at
+                 \em pData, which must be in the buffer of \em store. Keeps a
+                 reference to the store. The reference count starts at 1.
+         */
+        TiffMnSpan(RawStore&          store,
+                   const byte*        pData,
+                   uint64_t           size,
+                   uint64_t           offset,
+                   uint32_t           mnSize,
+                   uint16_t           tag,
+                   IfdId              mnGroup,
+                   const std::string& make,
+                   const std::string& model,
+                   ByteOrder          byteOrder,
+                   const ReadOptions* pOptions);
+        //@}
+
+        //! @name Manipulators
+        //@{
+        //! Increment the reference count.
+        void addRef();
+        //! Decrement the reference count, delete the object if it drops to 0.
+        void release();
+        //@}
+
+        //! @name Accessors
+        //@{
+        /*!
+          @brief Parse the makernote and add its metadata, as far as it is
+                 selected by the read options, to \em exifData.
+         */
+        void decode(ExifData& exifData) const;
+        //@}
+
+    private:
+        //! Destructor, use release()
+        ~TiffMnSpan();
+
+        // NOT implemented
+        //! Copy constructor
+        TiffMnSpan(const TiffMnSpan& rhs);
+        //! Assignment operator
+        TiffMnSpan& operator=(const TiffMnSpan& rhs);
+
+        // DATA
+        RawStore*   pStore_;            //!< Store with the TIFF data
+        const byte* pData_;             //!< Start of the TIFF data
+        uint64_t    size_;              //!< Size of the TIFF data
+        uint64_t    offset_;            //!< Offset of the makernote
+        uint32_t    mnSize_;            //!< Size of the makernote
+        uint16_t    tag_;               //!< Tag of the makernote entry
+        IfdId       mnGroup_;           //!< Group of the makernote
+        std::string make_;              //!< Camera make
+        Manufacturer manufacturer_;     //!< Manufacturer of the camera
+        std::string model_;             //!< Camera model
+        ByteOrder   byteOrder_;         //!< Byte order of the image
+        std::auto_ptr<ReadOptions> options_; //!< Read options, 0 if all metadata is read
+        long        refCount_;          //!< Reference count
+
+    }; // class TiffMnSpan
+
     /*!
       @brief Table of TIFF decoding and encoding functions and find functions.
              This class is separated from the metadata decoder and encoder
@@ -386,9 +758,9 @@ namespace Exiv2 {
 
           @return Pointer to the decoder function
          */
-        static DecoderFct findDecoder(const std::string& make,
-                                            uint32_t     extendedTag,
-                                            IfdId        group);
+        static DecoderFct findDecoder(Manufacturer make,
+                                      uint32_t     extendedTag,
+                                      IfdId        group);
         /*!
           @brief Find special encoder function for a key.
 
@@ -403,13 +775,20 @@ namespace Exiv2 {
           @return Pointer to the encoder function
          */
         static EncoderFct findEncoder(
-            const std::string& make,
-                  uint32_t     extendedTag,
-                  IfdId        group
+            Manufacturer make,
+            uint32_t     extendedTag,
+            IfdId        group
         );
 
     private:
+        //! Return the first row of the mapping table which matches \em key, 0 if none does.
+        static const TiffMappingInfo* findMapping(Manufacturer make,
+                                                  uint32_t     extendedTag,
+                                                  IfdId        group);
+
         static const TiffMappingInfo tiffMappingInfo_[]; //<! TIFF mapping table
+        //! Rows of the mapping table by group, in the order of the table
+        static const std::vector<std::vector<const TiffMappingInfo*> > mappingIndex_;
 
     }; // class TiffMapping
 
@@ -427,6 +806,30 @@ namespace Exiv2 {
 
     }; // class FindExifdatum
 
+// *****************************************************************************
+// free functions
+
+    /*!
+      @brief Decode the TIFF data at \em offset in \em buf, like
+             TiffParser::decode(), and take over the buffer, which is left
+             empty. The deferred values refer to the raw data in the buffer
+             instead of copies of it.
+     */
+    ByteOrder decodeTiff(ExifData&          exifData,
+                         IptcData&          iptcData,
+                         XmpData&           xmpData,
+                         DataBuf&           buf,
+                         long               offset,
+                         const ReadOptions* pOptions);
+
+    /*!
+      @brief Decode the Exif data in \em buf, like ExifParser::decode(),
+             and take over the buffer, see decodeTiff().
+     */
+    ByteOrder decodeExif(ExifData&          exifData,
+                         DataBuf&           buf,
+                         const ReadOptions* pOptions);
+
 }}                                      // namespace Internal, Exiv2
 
 #endif                                  // #ifndef TIFFIMAGE_INT_HPP_
@@ -39,6 +39,7 @@ EXIV2_RCSID("@(#) $Id$")
 #include "tiffcomposite_int.hpp" // Do not change the order of these 2 includes,
 #include "tiffvisitor_int.hpp"   // see bug #487
 #include "tiffimage_int.hpp"
+#include "arena_int.hpp"
 #include "makernote_int.hpp"
 #include "exif.hpp"
 #include "iptc.hpp"
@@ -51,28 +52,11 @@ EXIV2_RCSID("@(#) $Id$")
 #include <string>
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 #include <cassert>
 
 // *****************************************************************************
 namespace {
-    //! Unary predicate that matches an Exifdatum with a given group and index.
-    class FindExifdatum2 {
-    public:
-        //! Constructor, initializes the object with the group and index to look for.
-        FindExifdatum2(Exiv2::Internal::IfdId group, int idx)
-            : groupName_(Exiv2::Internal::groupName(group)), idx_(idx) {}
-        //! Returns true if group and index match.
-        bool operator()(const Exiv2::Exifdatum& md) const
-        {
-            return idx_ == md.idx() && 0 == strcmp(md.groupName().c_str(), groupName_);
-        }
-
-    private:
-        const char* groupName_;
-        int idx_;
-
-    }; // class FindExifdatum2
-
     Exiv2::ByteOrder stringToByteOrder(const std::string& val)
     {
         Exiv2::ByteOrder bo = Exiv2::invalidByteOrder;
@@ -282,22 +266,283 @@ namespace Exiv2 {
         copyObject(object);
     }
 
+    TiffSizeCacher::~TiffSizeCacher()
+    {
+    }
+
+    void TiffSizeCacher::visitEntry(TiffEntry* object)
+    {
+        object->cacheSizes(enable_);
+    }
+
+    void TiffSizeCacher::visitDataEntry(TiffDataEntry* object)
+    {
+        object->cacheSizes(enable_);
+    }
+
+    void TiffSizeCacher::visitImageEntry(TiffImageEntry* object)
+    {
+        object->cacheSizes(enable_);
+    }
+
+    void TiffSizeCacher::visitSizeEntry(TiffSizeEntry* object)
+    {
+        object->cacheSizes(enable_);
+    }
+
+    void TiffSizeCacher::visitDirectory(TiffDirectory* object)
+    {
+        object->cacheSizes(enable_);
+    }
+
+    void TiffSizeCacher::visitSubIfd(TiffSubIfd* object)
+    {
+        object->cacheSizes(enable_);
+    }
+
+    void TiffSizeCacher::visitMnEntry(TiffMnEntry* object)
+    {
+        object->cacheSizes(enable_);
+    }
+
+    void TiffSizeCacher::visitIfdMakernote(TiffIfdMakernote* object)
+    {
+        object->cacheSizes(enable_);
+    }
+
+    void TiffSizeCacher::visitBinaryArray(TiffBinaryArray* object)
+    {
+        object->cacheSizes(enable_);
+    }
+
+    void TiffSizeCacher::visitBinaryElement(TiffBinaryElement* object)
+    {
+        object->cacheSizes(enable_);
+    }
+
+    TiffImageKeeper::~TiffImageKeeper()
+    {
+    }
+
+    void TiffImageKeeper::visitEntry(TiffEntry* /*object*/)
+    {
+    }
+
+    void TiffImageKeeper::visitDataEntry(TiffDataEntry* /*object*/)
+    {
+    }
+
+    void TiffImageKeeper::visitImageEntry(TiffImageEntry* object)
+    {
+        if (!object->keepImage(pData_, size_)) kept_ = false;
+    }
+
+    void TiffImageKeeper::visitSizeEntry(TiffSizeEntry* /*object*/)
+    {
+    }
+
+    void TiffImageKeeper::visitDirectory(TiffDirectory* /*object*/)
+    {
+    }
+
+    void TiffImageKeeper::visitSubIfd(TiffSubIfd* /*object*/)
+    {
+    }
+
+    void TiffImageKeeper::visitMnEntry(TiffMnEntry* /*object*/)
+    {
+    }
+
+    void TiffImageKeeper::visitIfdMakernote(TiffIfdMakernote* /*object*/)
+    {
+    }
+
+    void TiffImageKeeper::visitBinaryArray(TiffBinaryArray* /*object*/)
+    {
+    }
+
+    void TiffImageKeeper::visitBinaryElement(TiffBinaryElement* /*object*/)
+    {
+    }
+
+    TiffFormatSetter::~TiffFormatSetter()
+    {
+    }
+
+    void TiffFormatSetter::visitEntry(TiffEntry* /*object*/)
+    {
+    }
+
+    void TiffFormatSetter::visitDataEntry(TiffDataEntry* /*object*/)
+    {
+    }
+
+    void TiffFormatSetter::visitImageEntry(TiffImageEntry* /*object*/)
+    {
+    }
+
+    void TiffFormatSetter::visitSizeEntry(TiffSizeEntry* /*object*/)
+    {
+    }
+
+    void TiffFormatSetter::visitDirectory(TiffDirectory* object)
+    {
+        if (mnDepth_ == 0) object->setBigTiff(bigTiff_);
+    }
+
+    void TiffFormatSetter::visitSubIfd(TiffSubIfd* object)
+    {
+        if (mnDepth_ > 0) return;
+        if (bigTiff_ && offsetSize(object->tiffType_) == 4) {
+            object->tiffType_ = ttTiffIfd8;
+            object->clearSizes();
+        }
+        else if (!bigTiff_ && offsetSize(object->tiffType_) == 8) {
+            object->tiffType_ = ttUnsignedLong;
+            object->clearSizes();
+        }
+    }
+
+    void TiffFormatSetter::visitMnEntry(TiffMnEntry* /*object*/)
+    {
+    }
+
+    void TiffFormatSetter::visitIfdMakernote(TiffIfdMakernote* /*object*/)
+    {
+        ++mnDepth_;
+    }
+
+    void TiffFormatSetter::visitIfdMakernoteEnd(TiffIfdMakernote* /*object*/)
+    {
+        --mnDepth_;
+    }
+
+    void TiffFormatSetter::visitBinaryArray(TiffBinaryArray* /*object*/)
+    {
+    }
+
+    void TiffFormatSetter::visitBinaryElement(TiffBinaryElement* /*object*/)
+    {
+    }
+
+    TiffPatcher::TiffPatcher(uint16_t     tag,
+                             IfdId        group,
+                             const Value& value,
+                             ByteOrder    byteOrder,
+                             const byte*  pData,
+                             uint64_t     size)
+        : tag_(tag), group_(group), value_(value),
+          origByteOrder_(byteOrder), byteOrder_(byteOrder),
+          pData_(pData), size_(size), found_(false), patched_(false)
+    {
+    }
+
+    TiffPatcher::~TiffPatcher()
+    {
+    }
+
+    bool TiffPatcher::findObject(TiffComponent* object, bool patchable)
+    {
+        if (object->tag() != tag_ || object->group() != group_) return false;
+        found_ = true;
+        setGo(geTraverse, false);
+        return patchable;
+    }
+
+    void TiffPatcher::visitEntry(TiffEntry* object)
+    {
+        if (!findObject(object, true)) return;
+        const Value* pv = object->pValue();
+        const byte* p = object->pData();
+        const uint32_t size = static_cast<uint32_t>(value_.size());
+        if (   pv == 0
+            || pv->typeId() != value_.typeId()
+            || pv->count() != value_.count()
+            || pv->size() != value_.size()
+            || size > object->size()
+            || p < pData_
+            || p > pData_ + size_
+            || size > static_cast<uint64_t>(pData_ + size_ - p)) {
+            return;
+        }
+        value_.copy(const_cast<byte*>(p), byteOrder_);
+        patched_ = true;
+    }
+
+    void TiffPatcher::visitDataEntry(TiffDataEntry* object)
+    {
+        findObject(object, false);
+    }
+
+    void TiffPatcher::visitImageEntry(TiffImageEntry* object)
+    {
+        findObject(object, false);
+    }
+
+    void TiffPatcher::visitSizeEntry(TiffSizeEntry* object)
+    {
+        findObject(object, false);
+    }
+
+    void TiffPatcher::visitDirectory(TiffDirectory* /*object*/)
+    {
+    }
+
+    void TiffPatcher::visitSubIfd(TiffSubIfd* object)
+    {
+        findObject(object, false);
+    }
+
+    void TiffPatcher::visitMnEntry(TiffMnEntry* object)
+    {
+        findObject(object, false);
+    }
+
+    void TiffPatcher::visitIfdMakernote(TiffIfdMakernote* object)
+    {
+        byteOrder_ = object->byteOrder();
+    }
+
+    void TiffPatcher::visitIfdMakernoteEnd(TiffIfdMakernote* /*object*/)
+    {
+        byteOrder_ = origByteOrder_;
+    }
+
+    void TiffPatcher::visitBinaryArray(TiffBinaryArray* object)
+    {
+        findObject(object, false);
+    }
+
+    void TiffPatcher::visitBinaryElement(TiffBinaryElement* object)
+    {
+        findObject(object, false);
+    }
+
     TiffDecoder::TiffDecoder(
         ExifData&            exifData,
         IptcData&            iptcData,
         XmpData&             xmpData,
         TiffComponent* const pRoot,
-        FindDecoderFct       findDecoderFct
+        FindDecoderFct       findDecoderFct,
+        const TiffSelection* pSelection,
+        RawStore*            pStore
     )
         : exifData_(exifData),
           iptcData_(iptcData),
           xmpData_(xmpData),
           pRoot_(pRoot),
           findDecoderFct_(findDecoderFct),
-          decodedIptc_(false)
+          make_(mfUnknown),
+          decodedIptc_(false),
+          pStore_(pStore),
+          pSelection_(pSelection),
+          threads_(pSelection ? pSelection->options().decodeThreads_ : 1)
     {
         assert(pRoot != 0);
 
+        if (pStore_) pStore_->addRef();
+        else pStore_ = new RawStore;
+
         exifData_.clear();
         iptcData_.clear();
         xmpData_.clear();
@@ -307,12 +552,97 @@ namespace Exiv2 {
         pRoot_->accept(finder);
         TiffEntryBase* te = dynamic_cast<TiffEntryBase*>(finder.result());
         if (te && te->pValue()) {
-            make_ = te->pValue()->toString();
+            make_ = manufacturer(te->pValue()->toString());
         }
     }
 
+    TiffDecoder::TiffDecoder(
+        const TiffDecoder&   parent,
+        ExifData&            exifData,
+        IptcData&            iptcData,
+        XmpData&             xmpData
+    )
+        : exifData_(exifData),
+          iptcData_(iptcData),
+          xmpData_(xmpData),
+          pRoot_(parent.pRoot_),
+          findDecoderFct_(parent.findDecoderFct_),
+          make_(parent.make_),
+          // IPTC and XMP are only decoded from IFD0
+          decodedIptc_(true),
+          // A store of its own which refers to the buffer of the parent,
+          // adding copies is not thread-safe
+          pStore_(new RawStore(*parent.pStore_)),
+          pSelection_(parent.pSelection_),
+          threads_(1)
+    {
+    }
+
     TiffDecoder::~TiffDecoder()
     {
+        restoreSubtrees();
+        pStore_->release();
+    }
+
+    TiffDecoder::Subtree::Subtree(const TiffDecoder& parent,
+                                  TiffComponent*     pRoot,
+                                  TiffSubIfd*        pSubIfd,
+                                  TiffMnEntry*       pMnEntry,
+                                  long               pos)
+        : parent_(parent),
+          pRoot_(pRoot),
+          pSubIfd_(pSubIfd),
+          pMnEntry_(pMnEntry),
+          pos_(pos)
+    {
+    }
+
+    void TiffDecoder::Subtree::run()
+    {
+        IptcData iptcData;
+        XmpData xmpData;
+        TiffDecoder decoder(parent_, exifData_, iptcData, xmpData);
+        pRoot_->accept(decoder);
+    }
+
+    void TiffDecoder::decodeSubtrees()
+    {
+        if (subtrees_.empty()) return;
+        try {
+            runTasks(std::vector<Task*>(subtrees_.begin(), subtrees_.end()), threads_);
+        }
+        catch (...) {
+            // Put the subtrees back before the error of a task is passed on
+            restoreSubtrees();
+            throw;
+        }
+
+        // Insert the metadata of the subtrees, from the last to the first so
+        // that the positions of the others stay valid
+        ExifMetadata& md = exifData_.exifMetadata_;
+        bool makernote = false;
+        for (Subtrees::reverse_iterator i = subtrees_.rbegin(); i != subtrees_.rend(); ++i) {
+            ExifMetadata::iterator pos = md.begin();
+            std::advance(pos, (*i)->pos_);
+            md.splice(pos, (*i)->exifData_.exifMetadata_);
+            if ((*i)->pMnEntry_ != 0) makernote = true;
+        }
+        if (makernote) exifData_.setMakernoteCount();
+        restoreSubtrees();
+    } // TiffDecoder::decodeSubtrees
+
+    void TiffDecoder::restoreSubtrees()
+    {
+        for (Subtrees::iterator i = subtrees_.begin(); i != subtrees_.end(); ++i) {
+            if ((*i)->pSubIfd_ != 0) {
+                (*i)->pSubIfd_->ifds_.push_back(static_cast<TiffDirectory*>((*i)->pRoot_));
+            }
+            if ((*i)->pMnEntry_ != 0) {
+                (*i)->pMnEntry_->mn_ = (*i)->pRoot_;
+            }
+            delete *i;
+        }
+        subtrees_.clear();
     }
 
     void TiffDecoder::visitEntry(TiffEntry* object)
@@ -343,12 +673,38 @@ namespace Exiv2 {
     void TiffDecoder::visitSubIfd(TiffSubIfd* object)
     {
         decodeTiffEntry(object);
+        if (threads_ < 2 || object->ifds_.empty()) return;
+
+        // Keep directories with the makernote, to decode the makernote by itself
+        for (TiffSubIfd::Ifds::const_iterator i = object->ifds_.begin();
+             i != object->ifds_.end(); ++i) {
+            TiffFinder finder(0x927c, exifId);
+            (*i)->accept(finder);
+            if (finder.result() != 0) return;
+        }
+        // Take the directories out of the tree, decodeSubtrees() decodes them
+        const long pos = static_cast<long>(exifData_.exifMetadata_.size());
+        for (TiffSubIfd::Ifds::const_iterator i = object->ifds_.begin();
+             i != object->ifds_.end(); ++i) {
+            subtrees_.push_back(new Subtree(*this, *i, object, 0, pos));
+        }
+        object->ifds_.clear();
     }
 
     void TiffDecoder::visitMnEntry(TiffMnEntry* object)
     {
         // Always decode binary makernote tag
         decodeTiffEntry(object);
+        if (object->pMnSpan_ != 0) {
+            object->pMnSpan_->addRef();
+            exifData_.setMakernote(object->pMnSpan_);
+        }
+        if (threads_ > 1 && object->mn_ != 0) {
+            // Take the makernote out of the tree, decodeSubtrees() decodes it
+            const long pos = static_cast<long>(exifData_.exifMetadata_.size());
+            subtrees_.push_back(new Subtree(*this, object->mn_, 0, object, pos));
+            object->mn_ = 0;
+        }
     }
 
     void TiffDecoder::visitIfdMakernote(TiffIfdMakernote* object)
@@ -369,6 +725,11 @@ namespace Exiv2 {
         }
     }
 
+    void TiffDecoder::visitIfdMakernoteEnd(TiffIfdMakernote* /*object*/)
+    {
+        exifData_.setMakernoteCount();
+    }
+
     void TiffDecoder::getObjData(byte const*& pData,
                                  long& size,
                                  uint16_t tag,
@@ -394,6 +755,7 @@ namespace Exiv2 {
     {
         // add Exif tag anyway
         decodeStdTiffEntry(object);
+        if (pSelection_ && !pSelection_->selected(mdXmp)) return;
 
         byte const* pData = 0;
         long size = 0;
@@ -424,7 +786,7 @@ namespace Exiv2 {
 
         // All tags are read at this point, so the first time we come here,
         // find the relevant IPTC tag and decode IPTC if found
-        if (decodedIptc_) {
+        if (decodedIptc_ || (pSelection_ && !pSelection_->selected(mdIptc))) {
             return;
         }
         decodedIptc_ = true;
@@ -474,7 +836,7 @@ namespace Exiv2 {
         assert(object != 0);
 
         // Don't decode the entry if value is not set
-        if (!object->pValue()) return;
+        if (!object->isDeferred_ && !object->pValue()) return;
 
         const DecoderFct decoderFct = findDecoderFct_(make_,
                                                       object->tag(),
@@ -488,19 +850,65 @@ namespace Exiv2 {
     void TiffDecoder::decodeStdTiffEntry(const TiffEntryBase* object)
     {
         assert(object != 0);
+        if (pSelection_ && !pSelection_->selected(object->tag(), object->group())) return;
         ExifKey key(object->tag(), groupName(object->group()));
         key.setIdx(object->idx());
-        exifData_.add(key, object->pValue());
+        if (object->isDeferred_) {
+            // Keep the raw data, the value is created only if it is used
+            SharedValue value;
+            value.defer(*pStore_, object->pData_, object->size_,
+                        object->typeId_, object->byteOrder_);
+            exifData_.add(Exifdatum(key, value));
+        }
+        else {
+            SharedValue value(object->pValue()->clone());
+            value.setStore(*pStore_);
+            exifData_.add(Exifdatum(key, value));
+        }
 
     } // TiffDecoder::decodeTiffEntry
 
     void TiffDecoder::visitBinaryArray(TiffBinaryArray* object)
     {
         if (object->cfg() == 0 || !object->decoded()) {
+            // Arrays with elements in groups which are not selected are not read
+            if (   pSelection_ && object->cfg()
+                && !pSelection_->readGroup(object->cfg()->group_)) return;
             decodeTiffEntry(object);
         }
+        else if (object->deferredElements() > 0) {
+            decodeElements(object);
+        }
     }
 
+    void TiffDecoder::decodeElements(const TiffBinaryArray* object)
+    {
+        const ArrayCfg* cfg = object->cfg();
+        assert(cfg != 0);
+        const uint32_t size = object->TiffEntryBase::doSize();
+        ArrayDef gap = cfg->elDefaultDef_;
+        int elIdx = object->elIdx();
+        uint32_t idx = 0;
+        for (uint32_t i = 0; i < object->deferredElements() && idx < size; ++i) {
+            const ArrayDef* def = object->elDef(idx, gap);
+            const uint32_t sz = object->elSize(idx, *def);
+            // Same as the element TiffReader would have added, but on the stack
+            const uint16_t tag = static_cast<uint16_t>(idx / cfg->tagStep());
+            TiffBinaryElement element(tag, cfg->group_);
+            element.setStart(object->pData() + idx);
+            element.setData(const_cast<byte*>(object->pData() + idx), sz);
+            element.setElDef(*def);
+            element.setElByteOrder(cfg->byteOrder_);
+            element.deferValue(def->tiffType_,
+                               toTypeId(def->tiffType_, tag, cfg->group_),
+                               object->elByteOrder());
+            element.setOffset(0);
+            element.setIdx(elIdx++);
+            decodeTiffEntry(&element);
+            idx += sz;
+        }
+    } // TiffDecoder::decodeElements
+
     void TiffDecoder::visitBinaryElement(TiffBinaryElement* object)
     {
         decodeTiffEntry(object);
@@ -514,7 +922,8 @@ namespace Exiv2 {
             const bool           isNewImage,
             const PrimaryGroups* pPrimaryGroups,
             const TiffHeaderBase* pHeader,
-                  FindEncoderFct findEncoderFct
+                  FindEncoderFct findEncoderFct,
+            const bool           rawMakernote
     )
         : exifData_(exifData),
           iptcData_(iptcData),
@@ -526,8 +935,11 @@ namespace Exiv2 {
           pPrimaryGroups_(pPrimaryGroups),
           pSourceTree_(0),          
           findEncoderFct_(findEncoderFct),
+          make_(mfUnknown),
           dirty_(false),
-          writeMethod_(wmNonIntrusive)
+          writeMethod_(wmNonIntrusive),
+          rawMakernote_(rawMakernote),
+          movableMakernote_(false)
     {
         assert(pRoot != 0);
         assert(pPrimaryGroups != 0);
@@ -536,29 +948,112 @@ namespace Exiv2 {
         byteOrder_ = pHeader->byteOrder();
         origByteOrder_ = byteOrder_;
 
+        // Index the tags, the list is only modified through addDatum() and
+        // eraseDatum() from here on
+        for (ExifData::iterator i = exifData_.begin(); i != exifData_.end(); ++i) {
+            index_.insert(std::make_pair(
+                DatumKey(static_cast<IfdId>(i->ifdId()), i->tag()), i));
+        }
+
         encodeIptc();
         encodeXmp();
 
         // Find camera make
-        ExifKey key("Exif.Image.Make");
-        ExifData::const_iterator pos = exifData_.findKey(key);
+        ExifData::const_iterator pos = findDatum(0x010f, ifd0Id);
+        std::string make;
         if (pos != exifData_.end()) {
-            make_ = pos->toString();
+            make = pos->toString();
         }
-        if (make_.empty() && pRoot_) {
+        if (make.empty() && pRoot_) {
             TiffFinder finder(0x010f, ifd0Id);
             pRoot_->accept(finder);
             TiffEntryBase* te = dynamic_cast<TiffEntryBase*>(finder.result());
             if (te && te->pValue()) {
-                make_ = te->pValue()->toString();
+                make = te->pValue()->toString();
             }
         }
+        make_ = manufacturer(make);
+        if (rawMakernote_) rawMakernote_ = encodeRawMakernote();
     }
 
     TiffEncoder::~TiffEncoder()
     {
     }
 
+    ExifData::iterator TiffEncoder::findDatum(uint16_t tag, IfdId group, int idx)
+    {
+        std::pair<DatumIndex::iterator, DatumIndex::iterator> range
+            = index_.equal_range(DatumKey(group, tag));
+        if (range.first == range.second) return exifData_.end();
+        for (DatumIndex::iterator i = range.first; i != range.second; ++i) {
+            if (i->second->idx() == idx) return i->second;
+        }
+        return range.first->second;
+    }
+
+    ExifData::iterator TiffEncoder::findDatum(uint16_t tag, IfdId group)
+    {
+        DatumIndex::iterator i = index_.find(DatumKey(group, tag));
+        if (i == index_.end()) return exifData_.end();
+        return i->second;
+    }
+
+    void TiffEncoder::addDatum(const Exifdatum& datum)
+    {
+        exifData_.add(datum);
+        ExifData::iterator pos = exifData_.end();
+        --pos;
+        index_.insert(std::make_pair(
+            DatumKey(static_cast<IfdId>(pos->ifdId()), pos->tag()), pos));
+    }
+
+    void TiffEncoder::eraseDatum(ExifData::iterator pos)
+    {
+        std::pair<DatumIndex::iterator, DatumIndex::iterator> range
+            = index_.equal_range(DatumKey(static_cast<IfdId>(pos->ifdId()), pos->tag()));
+        for (DatumIndex::iterator i = range.first; i != range.second; ++i) {
+            if (i->second == pos) {
+                index_.erase(i);
+                break;
+            }
+        }
+        exifData_.erase(pos);
+    }
+
+    bool TiffEncoder::encodeRawMakernote()
+    {
+        ExifData::const_iterator end = exifData_.end();
+        ExifData::const_iterator pos = findDatum(0x0001, mnId);     // Exif.MakerNote.Offset
+        if (pos == end) {
+            // The makernote was not parsed, its data is copied in any case
+            movableMakernote_ = true;
+        }
+        else {
+            const uint32_t mnOffset = static_cast<uint32_t>(pos->toLong());
+            pos = findDatum(0x0002, mnId);                          // Exif.MakerNote.ByteOrder
+            ByteOrder bo = pos == end ? invalidByteOrder : stringToByteOrder(pos->toString());
+            pos = findDatum(0x927c, exifId);                        // Exif.Photo.MakerNote
+            if (pos == end) return false;
+            DataBuf buf(pos->size());
+            pos->copy(buf.pData_, origByteOrder_);
+            std::auto_ptr<TiffComponent> mn(
+                TiffMnCreator::create(0x927c, mnId, make_, buf.pData_, buf.size_, origByteOrder_));
+            TiffIfdMakernote* pMn = dynamic_cast<TiffIfdMakernote*>(mn.get());
+            if (pMn == 0) return false;
+            pMn->setImageByteOrder(origByteOrder_);
+            // The makernote must be read in its own byte order from this image
+            if (   !pMn->readHeader(buf.pData_, buf.size_, origByteOrder_)
+                || (bo != invalidByteOrder && bo != pMn->byteOrder())) return false;
+            movableMakernote_ = pMn->relocations(mnRelocation_, buf.pData_, buf.size_, mnOffset);
+        }
+        // Remove the makernote tags, they are not encoded
+        for (ExifData::iterator i = exifData_.begin(); i != exifData_.end(); ) {
+            if (isMakerIfd(static_cast<IfdId>(i->ifdId()))) eraseDatum(i++);
+            else ++i;
+        }
+        return true;
+    } // TiffEncoder::encodeRawMakernote
+
     void TiffEncoder::encodeIptc()
     {
         // Update IPTCNAA Exif tag, if it exists. Delete the tag if there
@@ -566,16 +1061,16 @@ namespace Exiv2 {
         // If there is new IPTC data and Exif.Image.ImageResources does
         // not exist, create a new IPTCNAA Exif tag.
         bool del = false;
-        ExifKey iptcNaaKey("Exif.Image.IPTCNAA");
-        ExifData::iterator pos = exifData_.findKey(iptcNaaKey);
+        ExifKey iptcNaaKey(0x83bb, groupName(ifd0Id));
+        ExifData::iterator pos = findDatum(iptcNaaKey.tag(), ifd0Id);
         if (pos != exifData_.end()) {
             iptcNaaKey.setIdx(pos->idx());
-            exifData_.erase(pos);
+            eraseDatum(pos);
             del = true;
         }
         DataBuf rawIptc = IptcParser::encode(iptcData_);
-        ExifKey irbKey("Exif.Image.ImageResources");
-        pos = exifData_.findKey(irbKey);
+        ExifKey irbKey(0x8649, groupName(ifd0Id));
+        pos = findDatum(irbKey.tag(), ifd0Id);
         if (pos != exifData_.end()) {
             irbKey.setIdx(pos->idx());
         }
@@ -593,8 +1088,8 @@ namespace Exiv2 {
             }
             value->read(buf.pData_, buf.size_, byteOrder_);
             Exifdatum iptcDatum(iptcNaaKey, value.get());
-            exifData_.add(iptcDatum);
-            pos = exifData_.findKey(irbKey); // needed after add()
+            addDatum(iptcDatum);
+            pos = findDatum(irbKey.tag(), ifd0Id); // needed after add()
         }
         // Also update IPTC IRB in Exif.Image.ImageResources if it exists,
         // but don't create it if not.
@@ -602,24 +1097,24 @@ namespace Exiv2 {
             DataBuf irbBuf(pos->value().size());
             pos->value().copy(irbBuf.pData_, invalidByteOrder);
             irbBuf = Photoshop::setIptcIrb(irbBuf.pData_, irbBuf.size_, iptcData_);
-            exifData_.erase(pos);
+            eraseDatum(pos);
             if (irbBuf.size_ != 0) {
                 Value::AutoPtr value = Value::create(unsignedByte);
                 value->read(irbBuf.pData_, irbBuf.size_, invalidByteOrder);
                 Exifdatum iptcDatum(irbKey, value.get());
-                exifData_.add(iptcDatum);
+                addDatum(iptcDatum);
             }
         }
     } // TiffEncoder::encodeIptc
 
     void TiffEncoder::encodeXmp()
     {
-        ExifKey xmpKey("Exif.Image.XMLPacket");
+        ExifKey xmpKey(0x02bc, groupName(ifd0Id));
         // Remove any existing XMP Exif tag
-        ExifData::iterator pos = exifData_.findKey(xmpKey);
+        ExifData::iterator pos = findDatum(xmpKey.tag(), ifd0Id);
         if (pos != exifData_.end()) {
             xmpKey.setIdx(pos->idx());
-            exifData_.erase(pos);
+            eraseDatum(pos);
         }
         std::string xmpPacket;
         if (XmpParser::encode(xmpPacket, xmpData_) > 1) {
@@ -634,7 +1129,7 @@ namespace Exiv2 {
                         static_cast<long>(xmpPacket.size()),
                         invalidByteOrder);
             Exifdatum xmpDatum(xmpKey, value.get());
-            exifData_.add(xmpDatum);
+            addDatum(xmpDatum);
         }
     } // TiffEncoder::encodeXmp
 
@@ -723,9 +1218,8 @@ namespace Exiv2 {
         }
         else if (del_) {
             // The makernote is made up of decoded tags, delete binary tag
-            ExifKey key(object->tag(), groupName(object->group()));
-            ExifData::iterator pos = exifData_.findKey(key);
-            if (pos != exifData_.end()) exifData_.erase(pos);
+            ExifData::iterator pos = findDatum(object->tag(), object->group());
+            if (pos != exifData_.end()) eraseDatum(pos);
         }
     }
 
@@ -733,7 +1227,7 @@ namespace Exiv2 {
     {
         assert(object != 0);
 
-        ExifData::iterator pos = exifData_.findKey(ExifKey("Exif.MakerNote.ByteOrder"));
+        ExifData::iterator pos = findDatum(0x0002, mnId); // Exif.MakerNote.ByteOrder
         if (pos != exifData_.end()) {
             // Set Makernote byte order
             ByteOrder bo = stringToByteOrder(pos->toString());
@@ -741,16 +1235,16 @@ namespace Exiv2 {
                 object->setByteOrder(bo);
                 setDirty();
             }
-            if (del_) exifData_.erase(pos);
+            if (del_) eraseDatum(pos);
         }
         if (del_) {
             // Remove remaining synthesized tags
-            static const char* synthesizedTags[] = {
-                "Exif.MakerNote.Offset",
+            static const uint16_t synthesizedTags[] = {
+                0x0001,                 // Exif.MakerNote.Offset
             };
             for (unsigned int i = 0; i < EXV_COUNTOF(synthesizedTags); ++i) {
-                ExifData::iterator pos = exifData_.findKey(ExifKey(synthesizedTags[i]));
-                if (pos != exifData_.end()) exifData_.erase(pos);
+                ExifData::iterator pos = findDatum(synthesizedTags[i], mnId);
+                if (pos != exifData_.end()) eraseDatum(pos);
             }
         }
         // Modify encoder for Makernote peculiarities, byte order
@@ -781,16 +1275,9 @@ namespace Exiv2 {
         if (size == 0) return;
         if (!object->initialize(pRoot_)) return;
 
-        // Re-encrypt buffer if necessary
-        const CryptFct cryptFct = object->cfg()->cryptFct_;
-        if (cryptFct != 0) {
-            const byte* pData = object->pData();
-            DataBuf buf = cryptFct(object->tag(), pData, size, pRoot_);
-            if (buf.size_ > 0) {
-                pData = buf.pData_;
-                size = buf.size_;
-            }
-            if (!object->updOrigDataBuf(pData, size)) {
+        // Re-encrypt the data in the original buffer if necessary
+        if (object->cfg()->cryptFct_ != 0) {
+            if (!object->updOrigDataBuf(pRoot_, cryptKey_)) {
                 setDirty();
             }
         }
@@ -827,26 +1314,18 @@ namespace Exiv2 {
         ExifData::iterator pos = exifData_.end();
         const Exifdatum* ed = datum;
         if (ed == 0) {
-            // Non-intrusive writing: find matching tag
-            ExifKey key(object->tag(), groupName(object->group()));
-            pos = exifData_.findKey(key);
+            // Non-intrusive writing: find matching tag, the exact match
+            // in case of duplicate tags
+            pos = findDatum(object->tag(), object->group(), object->idx());
             if (pos != exifData_.end()) {
                 ed = &(*pos);
-                if (object->idx() != pos->idx()) {
-                    // Try to find exact match (in case of duplicate tags)
-                    ExifData::iterator pos2 =
-                        std::find_if(exifData_.begin(), exifData_.end(),
-                                     FindExifdatum2(object->group(), object->idx()));
-                    if (pos2 != exifData_.end() && pos2->key() == key.key()) {
-                        ed = &(*pos2);
-                        pos = pos2; // make sure we delete the correct tag below
-                    }
-                }
             }
             else {
                 setDirty();
 #ifdef DEBUG
-                std::cerr << "DELETING          " << key << ", idx = " << object->idx() << "\n";
+                std::cerr << "DELETING          "
+                          << ExifKey(object->tag(), groupName(object->group()))
+                          << ", idx = " << object->idx() << "\n";
 #endif
             }
         }
@@ -868,7 +1347,7 @@ namespace Exiv2 {
             }
         }
         if (del_ && pos != exifData_.end()) {
-            exifData_.erase(pos);
+            eraseDatum(pos);
         }
 #ifdef DEBUG
         std::cerr << "\n";
@@ -940,11 +1419,11 @@ namespace Exiv2 {
             std::cerr << "\t DATAAREA IS SET (INTRUSIVE WRITING)";
 #endif
             // Set pseudo strips (without a data pointer) from the size tag
-            ExifKey key(object->szTag(), groupName(object->szGroup()));
-            ExifData::const_iterator pos = exifData_.findKey(key);
+            ExifData::const_iterator pos = findDatum(object->szTag(), object->szGroup());
             const byte* zero = 0;
             if (pos == exifData_.end()) {
 #ifndef SUPPRESS_WARNINGS
+                ExifKey key(object->szTag(), groupName(object->szGroup()));
                 EXV_ERROR << "Size tag " << key
                           << " not found. Writing only one strip.\n";
 #endif
@@ -962,7 +1441,7 @@ namespace Exiv2 {
                 if (sizeTotal != sizeDataArea) {
 #ifndef SUPPRESS_WARNINGS
                     ExifKey key2(object->tag(), groupName(object->group()));
-                    EXV_ERROR << "Sum of all sizes of " << key
+                    EXV_ERROR << "Sum of all sizes of " << pos->key()
                               << " != data size of " << key2 << ". "
                               << "This results in an invalid image.\n";
 #endif
@@ -997,7 +1476,32 @@ namespace Exiv2 {
     void TiffEncoder::encodeMnEntry(TiffMnEntry* object, const Exifdatum* datum)
     {
         // Test is required here as well as in the visit function
-        if (!object->mn_) encodeTiffEntryBase(object, datum);
+        if (object->mn_) return;
+        if (rawMakernote_ && writeMethod() == wmIntrusive) {
+            // The offsets are adjusted when the makernote is written
+            object->relocation_ = mnRelocation_;
+        }
+        else if (   rawMakernote_
+                 && object->offset() != static_cast<int64_t>(mnRelocation_.offset_)) {
+            // The makernote is in a different place in this image
+            if (!movableMakernote_) {
+                setDirty();
+                return;
+            }
+            if (!mnRelocation_.positions_.empty()) {
+                if (object->offset() > static_cast<int64_t>(0xffffffff)) throw Error(26);
+                DataBuf buf(datum->size());
+                datum->copy(buf.pData_, byteOrder());
+                mnRelocation_.relocate(buf.pData_, buf.size_,
+                                       static_cast<uint32_t>(object->offset()));
+                DataValue value(buf.pData_, buf.size_);
+                Exifdatum md(*datum);
+                md.setValue(&value);
+                encodeTiffEntryBase(object, &md);
+                return;
+            }
+        }
+        encodeTiffEntryBase(object, datum);
     } // TiffEncoder::encodeMnEntry
 
     void TiffEncoder::encodeSizeEntry(TiffSizeEntry* object, const Exifdatum* datum)
@@ -1080,7 +1584,7 @@ namespace Exiv2 {
         for (ExifData::const_iterator i = exifData_.begin();
              i != exifData_.end(); ++i) {
 
-            IfdId group = groupId(i->groupName());
+            IfdId group = static_cast<IfdId>(i->ifdId());
             // Skip synthesized info tags
             if (group == mnId) {
                 if (i->tag() == 0x0002) {
@@ -1135,16 +1639,21 @@ namespace Exiv2 {
     } // TiffEncoder::add
 
     TiffReader::TiffReader(const byte*    pData,
-                           uint32_t       size,
+                           uint64_t       size,
                            TiffComponent* pRoot,
-                           TiffRwState::AutoPtr state)
+                           TiffRwState::AutoPtr state,
+                           const TiffSelection* pSelection,
+                           RawStore*      pStore)
         : pData_(pData),
           size_(size),
           pLast_(pData + size),
           pRoot_(pRoot),
           pState_(state.release()),
           pOrigState_(pState_),
-          postProc_(false)
+          postProc_(false),
+          pSelection_(pSelection),
+          pStore_(pStore),
+          budgetScope_()
     {
         assert(pData_);
         assert(size_ > 0);
@@ -1184,6 +1693,12 @@ namespace Exiv2 {
         return pState_->baseOffset_;
     }
 
+    bool TiffReader::bigTiff() const
+    {
+        assert(pState_);
+        return pState_->bigTiff_;
+    }
+
     void TiffReader::readDataEntryBase(TiffDataEntryBase* object)
     {
         assert(object != 0);
@@ -1260,17 +1775,30 @@ namespace Exiv2 {
         const byte* p = object->start();
         assert(p >= pData_);
 
+        if (!budgetScope_.budget().enter()) {
+            setGo(geTraverse, false);
+            return;
+        }
+        // The root directory is always read, it is needed to decode the others
+        if (   pSelection_ && object != pRoot_
+            && !pSelection_->readGroup(object->group())) return;
         if (circularReference(object->start(), object->group())) return;
 
-        if (p + 2 > pLast_) {
+        // Classic TIFF and BigTIFF differ in the size of counts and offsets
+        const bool big = bigTiff();
+        object->setBigTiff(big);
+        const uint32_t sizeCount = big ? 8 : 2;
+        const uint32_t sizeEntry = big ? 20 : 12;
+        const uint32_t sizeNext  = big ? 8 : 4;
+        if (p + sizeCount > pLast_) {
 #ifndef SUPPRESS_WARNINGS
             EXV_ERROR << "Directory " << groupName(object->group())
                       << ": IFD exceeds data buffer, cannot read entry count.\n";
 #endif
             return;
         }
-        const uint16_t n = getUShort(p, byteOrder());
-        p += 2;
+        const uint64_t n = big ? getULongLong(p, byteOrder()) : getUShort(p, byteOrder());
+        p += sizeCount;
         // Sanity check with an "unreasonably" large number
         if (n > 256) {
 #ifndef SUPPRESS_WARNINGS
@@ -1279,8 +1807,13 @@ namespace Exiv2 {
 #endif
             return;
         }
+        if (!budgetScope_.budget().addComponents(static_cast<uint32_t>(n) + 1)) {
+            setGo(geTraverse, false);
+            return;
+        }
+        object->reserve(static_cast<uint32_t>(n));
         for (uint16_t i = 0; i < n; ++i) {
-            if (p + 12 > pLast_) {
+            if (p + sizeEntry > pLast_) {
 #ifndef SUPPRESS_WARNINGS
                 EXV_ERROR << "Directory " << groupName(object->group())
                           << ": IFD entry " << i
@@ -1295,11 +1828,11 @@ namespace Exiv2 {
             assert(tc.get());
             tc->setStart(p);
             object->addChild(tc);
-            p += 12;
+            p += sizeEntry;
         }
 
         if (object->hasNext()) {
-            if (p + 4 > pLast_) {
+            if (p + sizeNext > pLast_) {
 #ifndef SUPPRESS_WARNINGS
                 EXV_ERROR << "Directory " << groupName(object->group())
                           << ": IFD exceeds data buffer, cannot read next pointer.\n";
@@ -1307,7 +1840,8 @@ namespace Exiv2 {
                 return;
             }
             TiffComponent::AutoPtr tc(0);
-            uint32_t next = getLong(p, byteOrder());
+            const uint64_t next = big ? getULongLong(p, byteOrder())
+                                      : getULong(p, byteOrder());
             if (next) {
                 tc = TiffCreator::create(Tag::next, object->group());
 #ifndef SUPPRESS_WARNINGS
@@ -1332,21 +1866,31 @@ namespace Exiv2 {
 
     } // TiffReader::visitDirectory
 
+    void TiffReader::visitDirectoryEnd(TiffDirectory* /*object*/)
+    {
+        budgetScope_.budget().leave();
+    } // TiffReader::visitDirectoryEnd
+
     void TiffReader::visitSubIfd(TiffSubIfd* object)
     {
         assert(object != 0);
 
         readTiffEntry(object);
+        const bool long8 =    object->tiffType() == ttUnsignedLong8
+                           || object->tiffType() == ttTiffIfd8;
         if (   (object->tiffType() == ttUnsignedLong || object->tiffType() == ttSignedLong
-                || object->tiffType() == ttTiffIfd)
+                || object->tiffType() == ttTiffIfd || long8)
             && object->count() >= 1) {
             // Todo: Fix hack
             uint32_t maxi = 9;
             if (object->group() == ifd1Id) maxi = 1;
             for (uint32_t i = 0; i < object->count(); ++i) {
-                int32_t offset = getLong(object->pData() + 4*i, byteOrder());
-                if (   baseOffset() + offset > size_
-                    || static_cast<int32_t>(baseOffset()) + offset < 0) {
+                const int64_t pos = long8
+                    ?   static_cast<int64_t>(baseOffset())
+                      + static_cast<int64_t>(getULongLong(object->pData() + 8*i, byteOrder()))
+                    : static_cast<int64_t>(static_cast<uint32_t>(
+                          baseOffset() + getULong(object->pData() + 4*i, byteOrder())));
+                if (pos < 0 || static_cast<uint64_t>(pos) > size_) {
 #ifndef SUPPRESS_WARNINGS
                     EXV_ERROR << "Directory " << groupName(object->group())
                               << ", entry 0x" << std::setw(4)
@@ -1368,7 +1912,7 @@ namespace Exiv2 {
                 // If there are multiple dirs, group is incremented for each
                 TiffComponent::AutoPtr td(new TiffDirectory(object->tag(),
                                                             static_cast<IfdId>(object->newGroup_ + i)));
-                td->setStart(pData_ + baseOffset() + offset);
+                td->setStart(pData_ + pos);
                 object->addChild(td);
             }
         }
@@ -1388,6 +1932,7 @@ namespace Exiv2 {
         assert(object != 0);
 
         readTiffEntry(object);
+        if (pSelection_ && !pSelection_->readMakernote()) return;
         // Find camera make
         TiffFinder finder(0x010f, ifd0Id);
         pRoot_->accept(finder);
@@ -1398,11 +1943,38 @@ namespace Exiv2 {
             // create concrete makernote, based on make and makernote contents
             object->mn_ = TiffMnCreator::create(object->tag(),
                                                 object->mnGroup_,
-                                                make,
+                                                manufacturer(make),
                                                 object->pData_,
                                                 object->size_,
                                                 byteOrder());
         }
+        if (   object->mn_ && object->size_ > 0
+            && pSelection_ && pSelection_->deferMakernote()
+            && pStore_ && pStore_->contains(pData_, size_)) {
+            // Keep what is needed to parse the makernote later. Entries of
+            // some makernotes point to data anywhere in the TIFF data, which
+            // the store keeps as a whole. Without a store that holds the
+            // data, the makernote is parsed right away.
+            finder.init(0x0110, ifd0Id);
+            pRoot_->accept(finder);
+            te = dynamic_cast<TiffEntryBase*>(finder.result());
+            std::string model;
+            if (te && te->pValue()) model = te->pValue()->toString();
+            object->pMnSpan_ = new TiffMnSpan(*pStore_,
+                                              pData_,
+                                              size_,
+                                              object->pData() - pData_,
+                                              object->size_,
+                                              object->tag(),
+                                              object->mnGroup_,
+                                              make,
+                                              model,
+                                              byteOrder(),
+                                              pSelection_->options().selectedAll(mdExif)
+                                              ? 0 : &pSelection_->options());
+            delete object->mn_;
+            object->mn_ = 0;
+        }
         if (object->mn_) object->mn_->setStart(object->pData());
 
     } // TiffReader::visitMnEntry
@@ -1413,15 +1985,17 @@ namespace Exiv2 {
 
         object->setImageByteOrder(byteOrder()); // set the byte order for the image
 
-        if (!object->readHeader(object->start(),
-                                static_cast<uint32_t>(pLast_ - object->start()),
-                                byteOrder())) {
+        // Makernote headers are small, the size only needs to fit into 32 bits
+        const uint32_t sizeMn = static_cast<uint32_t>(
+            std::min(static_cast<uint64_t>(pLast_ - object->start()),
+                     static_cast<uint64_t>(0xffffffff)));
+        if (!object->readHeader(object->start(), sizeMn, byteOrder())) {
 #ifndef SUPPRESS_WARNINGS
             EXV_ERROR << "Failed to read "
                       << groupName(object->ifd_.group())
                       << " IFD Makernote header.\n";
 #ifdef DEBUG
-            if (static_cast<uint32_t>(pLast_ - object->start()) >= 16) {
+            if (sizeMn >= 16) {
                 hexdump(std::cerr, object->start(), 16);
             }
 #endif // DEBUG
@@ -1433,6 +2007,8 @@ namespace Exiv2 {
         object->ifd_.setStart(object->start() + object->ifdOffset());
 
         // Modify reader for Makernote peculiarities, byte order and offset
+        // Makernote offsets are 32-bit (Exif.MakerNote.Offset is a LONG)
+        if (object->start() - pData_ > static_cast<ptrdiff_t>(0xffffffff)) throw Error(26);
         object->mnOffset_ = static_cast<uint32_t>(object->start() - pData_);
         TiffRwState::AutoPtr state(
             new TiffRwState(object->byteOrder(), object->baseOffset())
@@ -1454,7 +2030,10 @@ namespace Exiv2 {
         byte* p = object->start();
         assert(p >= pData_);
 
-        if (p + 12 > pLast_) {
+        // BigTIFF entries have an 8-byte count and an 8-byte value or offset
+        const bool big = bigTiff();
+        const uint32_t sizeInline = big ? 8 : 4;
+        if (p + (big ? 20 : 12) > pLast_) {
 #ifndef SUPPRESS_WARNINGS
             EXV_ERROR << "Entry in directory " << groupName(object->group())
                       << "requests access to memory beyond the data buffer. "
@@ -1467,6 +2046,8 @@ namespace Exiv2 {
         TiffType tiffType = getUShort(p, byteOrder());
         TypeId typeId = toTypeId(tiffType, object->tag(), object->group());
         long typeSize = TypeInfo::typeSize(typeId);
+        // The 64-bit types are only valid in BigTIFF
+        if (!big && offsetSize(tiffType) == 8) typeSize = 0;
         if (0 == typeSize) {
 #ifndef SUPPRESS_WARNINGS
             EXV_WARNING << "Directory " << groupName(object->group())
@@ -1478,7 +2059,7 @@ namespace Exiv2 {
             typeSize = 1;
         }
         p += 2;
-        uint32_t count = getULong(p, byteOrder());
+        const uint64_t count = big ? getULongLong(p, byteOrder()) : getULong(p, byteOrder());
         if (count >= 0x10000000) {
 #ifndef SUPPRESS_WARNINGS
             EXV_ERROR << "Directory " << groupName(object->group())
@@ -1490,27 +2071,31 @@ namespace Exiv2 {
 #endif
             return;
         }
-        p += 4;
-        uint32_t size = typeSize * count;
-        int32_t offset = getLong(p, byteOrder());
+        p += big ? 8 : 4;
+        uint32_t size = typeSize * static_cast<uint32_t>(count);
+        // Classic TIFF offsets are unsigned 32-bit values, relative to the
+        // base offset modulo 2^32 as before
+        const int64_t offset = big ? static_cast<int64_t>(getULongLong(p, byteOrder()))
+                                   : static_cast<int64_t>(getULong(p, byteOrder()));
+        const int64_t pos = big ? static_cast<int64_t>(baseOffset()) + offset
+                                : static_cast<int64_t>(static_cast<uint32_t>(baseOffset() + offset));
         byte* pData = p;
-        if (   size > 4
-            && (   baseOffset() + offset >= size_
-                || static_cast<int32_t>(baseOffset()) + offset <= 0)) {
+        if (   size > sizeInline
+            && (pos <= 0 || static_cast<uint64_t>(pos) >= size_)) {
 #ifndef SUPPRESS_WARNINGS
             EXV_ERROR << "Offset of directory " << groupName(object->group())
                       << ", entry 0x" << std::setw(4)
                       << std::setfill('0') << std::hex << object->tag()
                       << " is out of bounds: "
                       << "Offset = 0x" << std::setw(8)
-                      << std::setfill('0') << std::hex << offset
+                      << std::setfill('0') << std::hex << (big ? offset : offset & 0xffffffff)
                       << "; truncating the entry\n";
 #endif
                 size = 0;
         }
-        if (size > 4) {
-            pData = const_cast<byte*>(pData_) + baseOffset() + offset;
-            if (size > static_cast<uint32_t>(pLast_ - pData)) {
+        if (size > sizeInline) {
+            pData = const_cast<byte*>(pData_) + pos;
+            if (size > static_cast<uint64_t>(pLast_ - pData)) {
 #ifndef SUPPRESS_WARNINGS
                 EXV_ERROR << "Upper boundary of data for "
                           << "directory " << groupName(object->group())
@@ -1518,7 +2103,7 @@ namespace Exiv2 {
                           << std::setfill('0') << std::hex << object->tag()
                           << " is out of bounds: "
                           << "Offset = 0x" << std::setw(8)
-                          << std::setfill('0') << std::hex << offset
+                          << std::setfill('0') << std::hex << (big ? offset : offset & 0xffffffff)
                           << ", size = " << std::dec << size
                           << ", exceeds buffer size by "
                           // cast to make MSVC happy
@@ -1529,12 +2114,12 @@ namespace Exiv2 {
                 // Todo: adjust count, make size a multiple of typeSize
             }
         }
-        Value::AutoPtr v = Value::create(typeId);
-        assert(v.get());
-        v->read(pData, size, byteOrder());
-
-        object->setValue(v);
+        if (!budgetScope_.budget().addValueBytes(size)) {
+            setGo(geTraverse, false);
+            return;
+        }
         object->setData(pData, size);
+        object->deferValue(tiffType, typeId, byteOrder());
         object->setOffset(offset);
         object->setIdx(nextIdx(object->group()));
 
@@ -1573,66 +2158,47 @@ namespace Exiv2 {
         if (!object->initialize(pRoot_)) return;
         const ArrayCfg* cfg = object->cfg();
         if (cfg == 0) return;
+        // The elements are not needed if their group is not selected
+        if (pSelection_ && !pSelection_->readGroup(cfg->group_)) return;
 
         const CryptFct cryptFct = cfg->cryptFct_;
         if (cryptFct != 0) {
-            const byte* pData = object->pData();
-            int32_t size = object->TiffEntryBase::doSize();
-            DataBuf buf = cryptFct(object->tag(), pData, size, pRoot_);
-            if (buf.size_ > 0) object->setData(buf);
-        }
-
-        const ArrayDef* defs = object->def();
-        const ArrayDef* defsEnd = defs + object->defSize();
-        const ArrayDef* def = &cfg->elDefaultDef_;
-        ArrayDef gap = *def;
-
-        for (uint32_t idx = 0; idx < object->TiffEntryBase::doSize(); ) {
-            if (defs) {
-                def = std::find(defs, defsEnd, idx);
-                if (def == defsEnd) {
-                    if (cfg->concat_) {
-                        // Determine gap-size
-                        const ArrayDef* xdef = defs;
-                        for (; xdef != defsEnd && xdef->idx_ <= idx; ++xdef) {}
-                        uint32_t gapSize = 0;
-                        if (xdef != defsEnd && xdef->idx_ > idx) {
-                            gapSize = xdef->idx_ - idx;
-                        }
-                        else {
-                            gapSize = object->TiffEntryBase::doSize() - idx;
-                        }
-                        gap.idx_ = idx;
-                        gap.tiffType_ = cfg->elDefaultDef_.tiffType_;
-                        gap.count_ = gapSize / cfg->tagStep();
-                        if (gap.count_ * cfg->tagStep() != gapSize) {
-                            gap.tiffType_ = ttUndefined;
-                            gap.count_ = gapSize;
-                        }
-                        def = &gap;
-                    }
-                    else {
-                        def = &cfg->elDefaultDef_;
-                    }
-                }
+            DataBuf buf(object->pData(), object->TiffEntryBase::doSize());
+            if (cryptFct(object->tag(), buf.pData_, buf.size_, pRoot_, cryptKey_)) {
+                object->setData(buf);
             }
-            idx += object->addElement(idx, *def); // idx may be different from def->idx_
+        }
+
+        // If the tree is only decoded, the elements are not added, the
+        // decoder reads them from the data of the array
+        const bool addElements = pSelection_ == 0 || pSelection_->readElements();
+        ArrayDef gap = cfg->elDefaultDef_;
+        uint32_t count = 0;
+        for (uint32_t idx = 0; idx < object->TiffEntryBase::doSize(); ++count) {
+            if (!budgetScope_.budget().addComponents()) break;
+            const ArrayDef* def = object->elDef(idx, gap);
+            // idx may be different from def->idx_
+            idx += addElements ? object->addElement(idx, *def) : object->elSize(idx, *def);
+        }
+        if (!addElements && count > 0) {
+            ByteOrder bo = cfg->byteOrder_;
+            if (bo == invalidByteOrder) bo = byteOrder();
+            // Reserve the indexes the elements would have
+            const int idx = nextIdx(cfg->group_);
+            idxSeq_[cfg->group_] += count - 1;
+            object->deferElements(count, idx, bo);
         }
 
     } // TiffReader::visitBinaryArray
 
     void TiffReader::visitBinaryElement(TiffBinaryElement* object)
     {
-        byte* pData   = object->start();
-        uint32_t size = object->TiffEntryBase::doSize();
+        // The data of the element is set by TiffBinaryArray::addElement()
         ByteOrder bo = object->elByteOrder();
         if (bo == invalidByteOrder) bo = byteOrder();
-        TypeId typeId = toTypeId(object->elDef()->tiffType_, object->tag(), object->group());
-        Value::AutoPtr v = Value::create(typeId);
-        assert(v.get());
-        v->read(pData, size, bo);
-
-        object->setValue(v);
+        TiffType tiffType = object->elDef()->tiffType_;
+        TypeId typeId = toTypeId(tiffType, object->tag(), object->group());
+        object->deferValue(tiffType, typeId, bo);
         object->setOffset(0);
         object->setIdx(nextIdx(object->group()));
 
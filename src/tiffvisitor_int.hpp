@@ -34,6 +34,8 @@
 // included header files
 #include "exif.hpp"
 #include "tifffwd_int.hpp"
+#include "parsebudget_int.hpp"
+#include "tasks_int.hpp"
 #include "types.hpp"
 
 // + standard includes
@@ -277,6 +279,231 @@ namespace Exiv2 {
         const PrimaryGroups*  pPrimaryGroups_;
     }; // class TiffCopier
 
+    /*!
+      @brief Enable or disable the size cache of all components of a TIFF
+             composite. Used by TiffParserWorker to compute the size of each
+             component of a created tree only once while it is written. A
+             modification of a component discards the cached sizes.
+     */
+    class TiffSizeCacher : public TiffVisitor {
+    public:
+        //! @name Creators
+        //@{
+        //! Constructor, \em enable determines the new state of the caches.
+        explicit TiffSizeCacher(bool enable) : enable_(enable) {}
+        //! Virtual destructor
+        virtual ~TiffSizeCacher();
+        //@}
+
+        //! @name Manipulators
+        //@{
+        //! Set the size cache of a TIFF entry
+        virtual void visitEntry(TiffEntry* object);
+        //! Set the size cache of a TIFF data entry
+        virtual void visitDataEntry(TiffDataEntry* object);
+        //! Set the size cache of a TIFF image entry
+        virtual void visitImageEntry(TiffImageEntry* object);
+        //! Set the size cache of a TIFF size entry
+        virtual void visitSizeEntry(TiffSizeEntry* object);
+        //! Set the size cache of a TIFF directory
+        virtual void visitDirectory(TiffDirectory* object);
+        //! Set the size cache of a TIFF sub-IFD
+        virtual void visitSubIfd(TiffSubIfd* object);
+        //! Set the size cache of a TIFF makernote
+        virtual void visitMnEntry(TiffMnEntry* object);
+        //! Set the size cache of an IFD makernote
+        virtual void visitIfdMakernote(TiffIfdMakernote* object);
+        //! Set the size cache of a binary array
+        virtual void visitBinaryArray(TiffBinaryArray* object);
+        //! Set the size cache of an element of a binary array
+        virtual void visitBinaryElement(TiffBinaryElement* object);
+        //@}
+
+    private:
+        bool enable_;
+    }; // class TiffSizeCacher
+
+    /*!
+      @brief Keep the image data of all image entries of a TIFF composite at
+             its position in the original image, see
+             TiffImageEntry::keepImage(). Used by TiffParserWorker to append
+             new IFDs to an image without writing its image data again.
+     */
+    class TiffImageKeeper : public TiffVisitor {
+    public:
+        //! @name Creators
+        //@{
+        /*!
+          @brief Constructor, taking the original image \em pData of size
+                 \em size. If \em pData is 0, all image data is written again.
+         */
+        TiffImageKeeper(const byte* pData, uint64_t size)
+            : pData_(pData), size_(size), kept_(true) {}
+        //! Virtual destructor
+        virtual ~TiffImageKeeper();
+        //@}
+
+        //! @name Manipulators
+        //@{
+        //! Does nothing
+        virtual void visitEntry(TiffEntry* object);
+        //! Does nothing
+        virtual void visitDataEntry(TiffDataEntry* object);
+        //! Keep the image data of a TIFF image entry
+        virtual void visitImageEntry(TiffImageEntry* object);
+        //! Does nothing
+        virtual void visitSizeEntry(TiffSizeEntry* object);
+        //! Does nothing
+        virtual void visitDirectory(TiffDirectory* object);
+        //! Does nothing
+        virtual void visitSubIfd(TiffSubIfd* object);
+        //! Does nothing
+        virtual void visitMnEntry(TiffMnEntry* object);
+        //! Does nothing
+        virtual void visitIfdMakernote(TiffIfdMakernote* object);
+        //! Does nothing
+        virtual void visitBinaryArray(TiffBinaryArray* object);
+        //! Does nothing
+        virtual void visitBinaryElement(TiffBinaryElement* object);
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return false if the image data of an entry is not in the original image.
+        bool kept() const { return kept_; }
+        //@}
+
+    private:
+        const byte* pData_;
+        uint64_t    size_;
+        bool        kept_;
+    }; // class TiffImageKeeper
+
+    /*!
+      @brief Set the format of the IFDs of a TIFF composite to BigTIFF or
+             classic TIFF, before the composite is written. In BigTIFF
+             format, sub-IFD pointers are written as IFD8 offsets. Makernote
+             IFDs are always in classic format and are not changed.
+     */
+    class TiffFormatSetter : public TiffVisitor {
+    public:
+        //! @name Creators
+        //@{
+        //! Constructor, \em bigTiff selects the BigTIFF format.
+        explicit TiffFormatSetter(bool bigTiff)
+            : bigTiff_(bigTiff), mnDepth_(0) {}
+        //! Virtual destructor
+        virtual ~TiffFormatSetter();
+        //@}
+
+        //! @name Manipulators
+        //@{
+        //! Does nothing
+        virtual void visitEntry(TiffEntry* object);
+        //! Does nothing
+        virtual void visitDataEntry(TiffDataEntry* object);
+        //! Does nothing
+        virtual void visitImageEntry(TiffImageEntry* object);
+        //! Does nothing
+        virtual void visitSizeEntry(TiffSizeEntry* object);
+        //! Set the format of a directory outside of makernotes
+        virtual void visitDirectory(TiffDirectory* object);
+        //! Set the offset type of a sub-IFD outside of makernotes
+        virtual void visitSubIfd(TiffSubIfd* object);
+        //! Does nothing
+        virtual void visitMnEntry(TiffMnEntry* object);
+        //! Enter a makernote
+        virtual void visitIfdMakernote(TiffIfdMakernote* object);
+        //! Leave a makernote
+        virtual void visitIfdMakernoteEnd(TiffIfdMakernote* object);
+        //! Does nothing
+        virtual void visitBinaryArray(TiffBinaryArray* object);
+        //! Does nothing
+        virtual void visitBinaryElement(TiffBinaryElement* object);
+        //@}
+
+    private:
+        const bool bigTiff_;
+        int        mnDepth_;
+    }; // class TiffFormatSetter
+
+    /*!
+      @brief Overwrite the value of a TIFF entry in the binary image the
+             composite was read from with a new value of the same type and
+             size. Only values of standard IFD entries, including those in IFD
+             makernotes, are patched. Used by TiffParserWorker::patch().
+     */
+    class TiffPatcher : public TiffVisitor {
+    public:
+        //! @name Creators
+        //@{
+        /*!
+          @brief Constructor, taking \em tag and \em group of the entry to
+                 patch, the new \em value, the byte order of the image and
+                 the binary image \em pData of size \em size.
+         */
+        TiffPatcher(uint16_t     tag,
+                    IfdId        group,
+                    const Value& value,
+                    ByteOrder    byteOrder,
+                    const byte*  pData,
+                    uint64_t     size);
+        //! Virtual destructor
+        virtual ~TiffPatcher();
+        //@}
+
+        //! @name Manipulators
+        //@{
+        //! Patch a TIFF entry
+        virtual void visitEntry(TiffEntry* object);
+        //! Does not patch a TIFF data entry
+        virtual void visitDataEntry(TiffDataEntry* object);
+        //! Does not patch a TIFF image entry
+        virtual void visitImageEntry(TiffImageEntry* object);
+        //! Does not patch a TIFF size entry
+        virtual void visitSizeEntry(TiffSizeEntry* object);
+        //! Does nothing
+        virtual void visitDirectory(TiffDirectory* object);
+        //! Does not patch a TIFF sub-IFD
+        virtual void visitSubIfd(TiffSubIfd* object);
+        //! Does not patch a TIFF makernote
+        virtual void visitMnEntry(TiffMnEntry* object);
+        //! Set the byte order of an IFD makernote
+        virtual void visitIfdMakernote(TiffIfdMakernote* object);
+        //! Reset the byte order to that of the image
+        virtual void visitIfdMakernoteEnd(TiffIfdMakernote* object);
+        //! Does not patch a binary array
+        virtual void visitBinaryArray(TiffBinaryArray* object);
+        //! Does not patch an element of a binary array
+        virtual void visitBinaryElement(TiffBinaryElement* object);
+
+        /*!
+          @brief Check if \em object is the entry to patch and stop the
+                 traversal if so. Return true if its value can be patched.
+         */
+        bool findObject(TiffComponent* object, bool patchable);
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return true if the entry was found.
+        bool found() const { return found_; }
+        //! Return true if the value of the entry was overwritten.
+        bool patched() const { return patched_; }
+        //@}
+
+    private:
+        uint16_t     tag_;
+        IfdId        group_;
+        const Value& value_;
+        ByteOrder    origByteOrder_;
+        ByteOrder    byteOrder_;
+        const byte*  pData_;
+        uint64_t     size_;
+        bool         found_;
+        bool         patched_;
+    }; // class TiffPatcher
+
     /*!
       @brief TIFF composite visitor to decode metadata from the TIFF tree and
              add it to an Image, which is supplied in the constructor (Visitor
@@ -289,15 +516,20 @@ namespace Exiv2 {
         //@{
         /*!
           @brief Constructor, taking metadata containers to add the metadata to,
-                 the root element of the composite to decode and a FindDecoderFct
-                 function to get the decoder function for each tag.
+                 the root element of the composite to decode, a FindDecoderFct
+                 function to get the decoder function for each tag, an
+                 optional selection of the metadata to decode and an optional
+                 store for the raw data of deferred values. The store should
+                 hold the buffer which is decoded, see RawStore.
          */
         TiffDecoder(
             ExifData&            exifData,
             IptcData&            iptcData,
             XmpData&             xmpData,
             TiffComponent* const pRoot,
-            FindDecoderFct       findDecoderFct
+            FindDecoderFct       findDecoderFct,
+            const TiffSelection* pSelection =0,
+            RawStore*            pStore =0
         );
         //! Virtual destructor
         virtual ~TiffDecoder();
@@ -321,6 +553,8 @@ namespace Exiv2 {
         virtual void visitMnEntry(TiffMnEntry* object);
         //! Decode an IFD makernote
         virtual void visitIfdMakernote(TiffIfdMakernote* object);
+        //! Remember the makernote tags decoded, to detect changes later
+        virtual void visitIfdMakernoteEnd(TiffIfdMakernote* object);
         //! Decode a binary array
         virtual void visitBinaryArray(TiffBinaryArray* object);
         //! Decode an element of a binary array
@@ -334,11 +568,70 @@ namespace Exiv2 {
         void decodeIptc(const TiffEntryBase* object);
         //! Decode XMP packet from an XMLPacket tag
         void decodeXmp(const TiffEntryBase* object);
+        /*!
+          @brief Decode the sub-IFDs and the makernote which were taken out
+                 of the tree during the traversal, on up to
+                 ReadOptions::decodeThreads_ threads, and insert their
+                 metadata where the traversal would have added it. Call
+                 once after the tree is traversed.
+          @throw Error, WError or std::bad_alloc thrown while decoding the
+                 first subtree which failed, see runTasks().
+         */
+        void decodeSubtrees();
         //@}
 
     private:
+        /*!
+          @brief A subtree taken out of the tree during the traversal, to
+                 decode it to a container of its own with another thread.
+         */
+        class Subtree : public Task {
+        public:
+            //! Constructor, the subtree \em pRoot is put back to \em pSubIfd or \em pMnEntry later
+            Subtree(const TiffDecoder& parent,
+                    TiffComponent*     pRoot,
+                    TiffSubIfd*        pSubIfd,
+                    TiffMnEntry*       pMnEntry,
+                    long               pos);
+            //! Decode the subtree
+            virtual void run();
+
+            // DATA
+            const TiffDecoder& parent_;  //!< The decoder which took the subtree
+            TiffComponent*     pRoot_;   //!< Root of the subtree
+            TiffSubIfd*        pSubIfd_; //!< Sub-IFD entry the subtree was taken from, or 0
+            TiffMnEntry*       pMnEntry_; //!< Makernote entry the subtree was taken from, or 0
+            long               pos_;     //!< Number of metadata decoded before the subtree
+            ExifData           exifData_; //!< Exif metadata of the subtree
+
+        }; // class Subtree
+        friend class Subtree;
+        //! Subtrees in the order of the tree
+        typedef std::vector<Subtree*> Subtrees;
+
+        //! @name Creators
+        //@{
+        /*!
+          @brief Constructor for a decoder of a subtree of \em parent, which
+                 adds the metadata to the empty containers provided.
+         */
+        TiffDecoder(
+            const TiffDecoder&   parent,
+            ExifData&            exifData,
+            IptcData&            iptcData,
+            XmpData&             xmpData
+        );
+        //@}
+
         //! @name Manipulators
         //@{
+        //! Put the subtrees back into the tree and delete the Subtree objects.
+        void restoreSubtrees();
+        /*!
+          @brief Decode the elements of a binary array which were not added
+                 to the tree from the data of the array, as if they had been.
+         */
+        void decodeElements(const TiffBinaryArray* object);
         /*!
           @brief Get the data for a \em tag and \em group, either from the
                  \em object provided, if it matches or from the matching element
@@ -361,8 +654,12 @@ namespace Exiv2 {
         XmpData&  xmpData_;          //!< XMP metadata container
         TiffComponent* const pRoot_; //!< Root element of the composite
         const FindDecoderFct findDecoderFct_; //!< Ptr to the function to find special decoding functions
-        std::string make_;           //!< Camera make, determined from the tags to decode
+        Manufacturer make_;          //!< Camera manufacturer, determined from the tags to decode
         bool decodedIptc_;           //!< Indicates if IPTC has been decoded yet
+        RawStore* pStore_;           //!< Raw data of the deferred values
+        const TiffSelection* pSelection_; //!< Metadata to decode, 0 for all
+        int threads_;                //!< Maximum number of threads to decode subtrees
+        Subtrees subtrees_;          //!< Subtrees taken out of the tree
 
     }; // class TiffDecoder
 
@@ -389,6 +686,13 @@ namespace Exiv2 {
           @brief Constructor, taking the root element of the composite to encode
                  to, the image with the metadata to encode and a function to
                  find special encoders.
+
+          If \em rawMakernote is true, the makernote of the composite is
+          not parsed and it is written as it was read from
+          Exif.Photo.MakerNote, instead of from the makernote tags. This
+          requires that the makernote is unchanged and that it can be read
+          from the image as it is. Check movableMakernote() to find if this
+          is the case and if the makernote can also be moved.
          */
         TiffEncoder(
             const ExifData&      exifData,
@@ -398,7 +702,8 @@ namespace Exiv2 {
             const bool           isNewImage,
             const PrimaryGroups* pPrimaryGroups,
             const TiffHeaderBase* pHeader,
-                  FindEncoderFct findEncoderFct
+                  FindEncoderFct findEncoderFct,
+            const bool           rawMakernote =false
         );
         //! Virtual destructor
         virtual ~TiffEncoder();
@@ -519,11 +824,37 @@ namespace Exiv2 {
         bool dirty() const;
         //! Return the write method used.
         WriteMethod writeMethod() const { return writeMethod_; }
+        /*!
+          @brief Return true if the makernote is written as it was read and
+                 it can be moved to a new position.
+         */
+        bool movableMakernote() const { return rawMakernote_ && movableMakernote_; }
+        //! Return the key to re-encrypt binary arrays, as far as it was looked up.
+        const CryptKey& cryptKey() const { return cryptKey_; }
         //@}
 
     private:
         //! @name Manipulators
         //@{
+        /*!
+          Prepare to write the makernote as it was read: find the offsets
+          to adjust if it is moved and remove the makernote tags. Returns
+          false if the makernote cannot be written as it is to this image.
+          This method is called from the constructor.
+         */
+        bool encodeRawMakernote();
+        /*!
+          @brief Find the tag to encode with \em tag and \em group, prefer
+                 the one with index \em idx if there are several. Return
+                 exifData_.end() if there is none.
+         */
+        ExifData::iterator findDatum(uint16_t tag, IfdId group, int idx);
+        //! Find the first tag to encode with \em tag and \em group.
+        ExifData::iterator findDatum(uint16_t tag, IfdId group);
+        //! Add \em datum to the tags to encode and the index.
+        void addDatum(const Exifdatum& datum);
+        //! Remove the tag at \em pos from the tags to encode and the index.
+        void eraseDatum(ExifData::iterator pos);
         /*!
           Encode IPTC data. Updates or adds tag Exif.Image.IPTCNAA, updates but
           never adds tag Exif.Image.ImageResources.
@@ -560,8 +891,14 @@ namespace Exiv2 {
         //@}
 
     private:
+        //! Key of the index: group and tag
+        typedef std::pair<IfdId, uint16_t> DatumKey;
+        //! Index of the tags to encode, duplicates in the order of the Exif data
+        typedef std::multimap<DatumKey, ExifData::iterator> DatumIndex;
+
         // DATA
         ExifData exifData_;          //!< Copy of the Exif data to encode
+        DatumIndex index_;           //!< Index of exifData_ by group and tag
         const IptcData& iptcData_;   //!< IPTC data to encode, just a reference
         const XmpData&  xmpData_;    //!< XMP data to encode, just a reference
         bool del_;                   //!< Indicates if Exif data entries should be deleted after encoding
@@ -573,9 +910,13 @@ namespace Exiv2 {
         ByteOrder byteOrder_;        //!< Byteorder for encoding
         ByteOrder origByteOrder_;    //!< Byteorder as set in the c'tor
         const FindEncoderFct findEncoderFct_; //!< Ptr to the function to find special encoding functions
-        std::string make_;           //!< Camera make, determined from the tags to encode
+        Manufacturer make_;          //!< Camera manufacturer, determined from the tags to encode
         bool dirty_;                 //!< Signals if any tag is deleted or allocated
         WriteMethod writeMethod_;    //!< Write method used.
+        bool rawMakernote_;          //!< True if the makernote is written as it was read
+        bool movableMakernote_;      //!< True if the makernote can be moved
+        MnRelocation mnRelocation_;  //!< Offsets to adjust if the makernote is moved
+        CryptKey cryptKey_;          //!< Key to re-encrypt binary arrays
 
     }; // class TiffEncoder
 
@@ -595,9 +936,11 @@ namespace Exiv2 {
         //@{
         //! Constructor.
         TiffRwState(ByteOrder byteOrder,
-                    uint32_t  baseOffset)
+                    uint32_t  baseOffset,
+                    bool      bigTiff =false)
             : byteOrder_(byteOrder),
-              baseOffset_(baseOffset) {}
+              baseOffset_(baseOffset),
+              bigTiff_(bigTiff) {}
         //@}
 
         //! @name Accessors
@@ -619,11 +962,18 @@ namespace Exiv2 {
           to the basis for such makernote offsets.
          */
         uint32_t           baseOffset() const { return baseOffset_; }
+        /*!
+          @brief Return \c true if the IFDs use the BigTIFF format, with 64-bit
+                 entry counts and offsets and 20-byte entries. Makernote IFDs
+                 always use the classic format.
+         */
+        bool               bigTiff()    const { return bigTiff_; }
         //@}
 
     private:
         ByteOrder byteOrder_;
         const uint32_t baseOffset_;
+        const bool bigTiff_;
     }; // TiffRwState
 
     /*!
@@ -643,11 +993,19 @@ namespace Exiv2 {
           @param pRoot     Root element of the TIFF composite.
           @param state     State object for creation function, byte order and
                            base offset.
+          @param pSelection Optional selection of the parts of the composite
+                           to read. Everything is read if not provided.
+          @param pStore    Optional store which holds the data buffer. A
+                           makernote is only left to be parsed later, see
+                           ReadOptions::deferMakernote_, if the store is
+                           provided.
          */
         TiffReader(const byte*          pData,
-                   uint32_t             size,
+                   uint64_t             size,
                    TiffComponent*       pRoot,
-                   TiffRwState::AutoPtr state);
+                   TiffRwState::AutoPtr state,
+                   const TiffSelection* pSelection =0,
+                   RawStore*            pStore =0);
 
         //! Virtual destructor
         virtual ~TiffReader();
@@ -665,6 +1023,8 @@ namespace Exiv2 {
         virtual void visitSizeEntry(TiffSizeEntry* object);
         //! Read a TIFF directory from the data buffer
         virtual void visitDirectory(TiffDirectory* object);
+        //! Leave the nesting level of a TIFF directory
+        virtual void visitDirectoryEnd(TiffDirectory* object);
         //! Read a TIFF sub-IFD from the data buffer
         virtual void visitSubIfd(TiffSubIfd* object);
         //! Read a TIFF makernote entry from the data buffer
@@ -709,6 +1069,8 @@ namespace Exiv2 {
         ByteOrder byteOrder() const;
         //! Return the base offset. See class TiffRwState for details
         uint32_t baseOffset() const;
+        //! Return true if the IFDs are in BigTIFF format. See class TiffRwState
+        bool bigTiff() const;
         //@}
 
     private:
@@ -718,7 +1080,7 @@ namespace Exiv2 {
 
         // DATA
         const byte*          pData_;      //!< Pointer to the memory buffer
-        const uint32_t       size_;       //!< Size of the buffer
+        const uint64_t       size_;       //!< Size of the buffer
         const byte*          pLast_;      //!< Pointer to the last byte
         TiffComponent* const pRoot_;      //!< Root element of the composite
         TiffRwState*         pState_;     //!< State class
@@ -727,6 +1089,10 @@ namespace Exiv2 {
         IdxSeq               idxSeq_;     //!< Sequences for group, used for the entry's idx
         PostList             postList_;   //!< List of components with deferred reading
         bool                 postProc_;   //!< True in postProcessList()
+        const TiffSelection* pSelection_; //!< Parts of the composite to read, 0 for all
+        RawStore*            pStore_;     //!< Store which holds the data buffer, may be 0
+        ParseBudgetScope     budgetScope_; //!< Budget for the work done by the reader
+        CryptKey             cryptKey_;   //!< Key to decrypt binary arrays
     }; // class TiffReader
 
 }}                                      // namespace Internal, Exiv2
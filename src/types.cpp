@@ -86,6 +86,9 @@ namespace {
         { Exiv2::tiffFloat,        "Float",       4 },
         { Exiv2::tiffDouble,       "Double",      8 },
         { Exiv2::tiffIfd,          "Ifd",         4 },
+        { Exiv2::unsignedLongLong, "LongLong",    8 },
+        { Exiv2::signedLongLong,   "SLongLong",   8 },
+        { Exiv2::tiffIfd8,         "Ifd8",        8 },
         { Exiv2::string,           "String",      1 },
         { Exiv2::date,             "Date",        8 },
         { Exiv2::time,             "Time",       11 },
@@ -98,12 +101,42 @@ namespace {
         { Exiv2::langAlt,          "LangAlt",     1 }
     };
 
+    //! Camera make prefix and the manufacturer it belongs to
+    struct MakeInfo {
+        const char*         make_;              //!< Start of the camera make
+        Exiv2::Manufacturer manufacturer_;      //!< Manufacturer
+    };
+
+    //! Lookup list of camera makes, see manufacturer()
+    const MakeInfo makeInfo[] = {
+        { "Canon",          Exiv2::mfCanon     },
+        { "FOVEON",         Exiv2::mfSigma     },
+        { "FUJI",           Exiv2::mfFujifilm  },
+        { "KONICA MINOLTA", Exiv2::mfMinolta   },
+        { "Minolta",        Exiv2::mfMinolta   },
+        { "NIKON",          Exiv2::mfNikon     },
+        { "OLYMPUS",        Exiv2::mfOlympus   },
+        { "Panasonic",      Exiv2::mfPanasonic },
+        { "PENTAX",         Exiv2::mfPentax    },
+        { "SAMSUNG",        Exiv2::mfSamsung   },
+        { "SIGMA",          Exiv2::mfSigma     },
+        { "SONY",           Exiv2::mfSony      }
+    };
+
 }
 
 // *****************************************************************************
 // class member definitions
 namespace Exiv2 {
 
+    ParseLimits::ParseLimits()
+        : maxComponents_(1000000),
+          maxValueBytes_(128 * 1024 * 1024),
+          maxDepth_(64),
+          maxTime_(0)
+    {
+    }
+
     const char* TypeInfo::typeName(TypeId typeId)
     {
         const TypeInfoTable* tit = find(typeInfoTable, typeId);
@@ -233,6 +266,18 @@ namespace Exiv2 {
         }
     }
 
+    uint64_t getULongLong(const byte* buf, ByteOrder byteOrder)
+    {
+        uint64_t l = 0;
+        if (byteOrder == littleEndian) {
+            for (int i = 7; i >= 0; --i) l = l << 8 | buf[i];
+        }
+        else {
+            for (int i = 0; i < 8; ++i) l = l << 8 | buf[i];
+        }
+        return l;
+    }
+
     URational getURational(const byte* buf, ByteOrder byteOrder)
     {
         uint32_t nominator = getULong(buf, byteOrder);
@@ -262,6 +307,11 @@ namespace Exiv2 {
         }
     }
 
+    int64_t getLongLong(const byte* buf, ByteOrder byteOrder)
+    {
+        return static_cast<int64_t>(getULongLong(buf, byteOrder));
+    }
+
     Rational getRational(const byte* buf, ByteOrder byteOrder)
     {
         int32_t nominator = getLong(buf, byteOrder);
@@ -347,6 +397,17 @@ namespace Exiv2 {
         return 4;
     }
 
+    long ull2Data(byte* buf, uint64_t l, ByteOrder byteOrder)
+    {
+        if (byteOrder == littleEndian) {
+            for (int i = 0; i < 8; ++i, l >>= 8) buf[i] = (byte)(l & 0xff);
+        }
+        else {
+            for (int i = 7; i >= 0; --i, l >>= 8) buf[i] = (byte)(l & 0xff);
+        }
+        return 8;
+    }
+
     long ur2Data(byte* buf, URational l, ByteOrder byteOrder)
     {
         long o = ul2Data(buf, l.first, byteOrder);
@@ -384,6 +445,11 @@ namespace Exiv2 {
         return 4;
     }
 
+    long ll2Data(byte* buf, int64_t l, ByteOrder byteOrder)
+    {
+        return ull2Data(buf, static_cast<uint64_t>(l), byteOrder);
+    }
+
     long r2Data(byte* buf, Rational l, ByteOrder byteOrder)
     {
         long o = l2Data(buf, l.first, byteOrder);
@@ -628,6 +694,22 @@ namespace Exiv2 {
         return Rational(nom/g, den/g);
     }
 
+    Manufacturer manufacturer(const std::string& make)
+    {
+        if (make.empty()) return mfUnknown;
+        // A linear search is enough: the list is short, the first character
+        // rules out most entries and the make of an image is looked up only
+        // once per TIFF tree and makernote
+        for (unsigned int i = 0; i < EXV_COUNTOF(makeInfo); ++i) {
+            const char* p = makeInfo[i].make_;
+            if (   p[0] == make[0]
+                && make.compare(0, std::strlen(p), p) == 0) {
+                return makeInfo[i].manufacturer_;
+            }
+        }
+        return mfUnknown;
+    }
+
 }                                       // namespace Exiv2
 
 #ifdef EXV_ENABLE_NLS
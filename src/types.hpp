@@ -82,6 +82,16 @@ typedef __int64          int64_t;
 //! Simple common max macro
 #define EXV_MAX(a,b) ((a) > (b) ? (a) : (b))
 
+/*!
+  @brief Defined if the compiler supports rvalue references. Move constructors
+         and other overloads taking rvalue references are only declared if
+         this is defined. They are implemented inline in terms of the swap()
+         members, so that the library binary is the same either way.
+ */
+#if __cplusplus >= 201103L || (defined _MSC_VER && _MSC_VER >= 1900)
+# define EXV_HAVE_RVALUE_REFERENCES 1
+#endif
+
 // *****************************************************************************
 // forward declarations
 struct tm;
@@ -107,12 +117,64 @@ namespace Exiv2 {
     //! Type to indicate write method used by TIFF parsers
     enum WriteMethod { wmIntrusive, wmNonIntrusive };
 
+    /*!
+      @brief How TIFF parsers write an image if its metadata cannot be
+             updated in place, see TiffImage::setWriteMode().
+     */
+    enum TiffWriteMode {
+        twRewrite,  //!< Write a new TIFF structure, including the image data
+        twAppend,   //!< Append new IFDs to the image, the image data stays where it is
+        twCompact   //!< Always write a new TIFF structure, drops unused space
+    };
+
     //! An identifier for each type of metadata
     enum MetadataId { mdNone=0, mdExif=1, mdIptc=2, mdComment=4, mdXmp=8 };
 
     //! An identifier for each mode of metadata support
     enum AccessMode { amNone=0, amRead=1, amWrite=2, amReadWrite=3 };
 
+    /*!
+      @brief Camera manufacturers with a makernote %Exiv2 can read, see
+             manufacturer() and Image::manufacturer().
+     */
+    enum Manufacturer {
+        mfUnknown,      //!< Unknown make or a manufacturer without a known makernote
+        mfCanon,        //!< Canon
+        mfFujifilm,     //!< Fujifilm ("FUJI...")
+        mfMinolta,      //!< Minolta and Konica Minolta
+        mfNikon,        //!< Nikon
+        mfOlympus,      //!< Olympus
+        mfPanasonic,    //!< Panasonic
+        mfPentax,       //!< Pentax
+        mfSamsung,      //!< Samsung
+        mfSigma,        //!< Sigma and Foveon
+        mfSony,         //!< Sony
+        mfLastManufacturer = mfSony //!< Last value, for lookup tables
+    };
+
+    /*!
+      @brief Limits of the work done to read the metadata of an image, which
+             bound the time and memory a corrupt or malicious file can take.
+
+      The TIFF, CRW, JPEG-2000, IPTC and XMP parsers count the components
+      they read (directories, entries, datasets, boxes, XMP properties), the
+      total size of the values and the nesting depth of directories and XMP
+      elements. When a limit is exceeded, a warning is issued and the parsers
+      stop, the metadata read so far is kept. A limit of 0 means no limit.
+      See Image::setParseLimits().
+     */
+    struct EXIV2API ParseLimits {
+        //! Default constructor, sets the default limits.
+        ParseLimits();
+
+        // DATA
+        uint32_t maxComponents_; //!< Maximum number of components, default 1000000
+        uint32_t maxValueBytes_; //!< Maximum total size of the values, default 128 MB
+        uint32_t maxDepth_;      //!< Maximum nesting depth, default 64
+        uint32_t maxTime_;       //!< Maximum time in milliseconds, default 0 (no limit)
+
+    }; // struct ParseLimits
+
     /*!
       @brief %Exiv2 value type identifiers.
 
@@ -133,6 +195,9 @@ namespace Exiv2 {
         tiffFloat          =11, //!< TIFF FLOAT type, single precision (4-byte) IEEE format.
         tiffDouble         =12, //!< TIFF DOUBLE type, double precision (8-byte) IEEE format.
         tiffIfd            =13, //!< TIFF IFD type, 32-bit (4-byte) unsigned integer.
+        unsignedLongLong   =16, //!< BigTIFF LONG8 type, 64-bit (8-byte) unsigned integer.
+        signedLongLong     =17, //!< BigTIFF SLONG8 type, 64-bit (8-byte) signed (twos-complement) integer.
+        tiffIfd8           =18, //!< BigTIFF IFD8 type, 64-bit (8-byte) unsigned integer.
         string        =0x10000, //!< IPTC string type.
         date          =0x10001, //!< IPTC date type.
         time          =0x10002, //!< IPTC time type.
@@ -262,12 +327,16 @@ namespace Exiv2 {
     EXIV2API uint16_t getUShort(const byte* buf, ByteOrder byteOrder);
     //! Read a 4 byte unsigned long value from the data buffer
     EXIV2API uint32_t getULong(const byte* buf, ByteOrder byteOrder);
+    //! Read an 8 byte unsigned long long value from the data buffer
+    EXIV2API uint64_t getULongLong(const byte* buf, ByteOrder byteOrder);
     //! Read an 8 byte unsigned rational value from the data buffer
     EXIV2API URational getURational(const byte* buf, ByteOrder byteOrder);
     //! Read a 2 byte signed short value from the data buffer
     EXIV2API int16_t getShort(const byte* buf, ByteOrder byteOrder);
     //! Read a 4 byte signed long value from the data buffer
     EXIV2API int32_t getLong(const byte* buf, ByteOrder byteOrder);
+    //! Read an 8 byte signed long long value from the data buffer
+    EXIV2API int64_t getLongLong(const byte* buf, ByteOrder byteOrder);
     //! Read an 8 byte signed rational value from the data buffer
     EXIV2API Rational getRational(const byte* buf, ByteOrder byteOrder);
     //! Read a 4 byte single precision floating point value (IEEE 754 binary32) from the data buffer
@@ -294,6 +363,11 @@ namespace Exiv2 {
              return number of bytes written.
      */
     EXIV2API long ul2Data(byte* buf, uint32_t l, ByteOrder byteOrder);
+    /*!
+      @brief Convert an unsigned long long to data, write the data to the buffer,
+             return number of bytes written.
+     */
+    EXIV2API long ull2Data(byte* buf, uint64_t l, ByteOrder byteOrder);
     /*!
       @brief Convert an unsigned rational to data, write the data to the buffer,
              return number of bytes written.
@@ -309,6 +383,11 @@ namespace Exiv2 {
              return number of bytes written.
      */
     EXIV2API long l2Data(byte* buf, int32_t l, ByteOrder byteOrder);
+    /*!
+      @brief Convert a signed long long to data, write the data to the buffer,
+             return number of bytes written.
+     */
+    EXIV2API long ll2Data(byte* buf, int64_t l, ByteOrder byteOrder);
     /*!
       @brief Convert a signed rational to data, write the data to the buffer,
              return number of bytes written.
@@ -413,6 +492,15 @@ namespace Exiv2 {
      */
     EXIV2API Rational floatToRationalCast(float f);
 
+    /*!
+      @brief Return the manufacturer of a camera with the Exif make \em make
+             (tag Exif.Image.Make), or mfUnknown. The make must start with
+             the name the manufacturer uses in its images, e.g., "OLYMPUS"
+             matches "OLYMPUS OPTICAL CO.,LTD" and "OLYMPUS IMAGING CORP.".
+             The comparison is case sensitive.
+     */
+    EXIV2API Manufacturer manufacturer(const std::string& make);
+
 // *****************************************************************************
 // template and inline definitions
 
@@ -33,6 +33,7 @@ EXIV2_RCSID("@(#) $Id$")
 // *****************************************************************************
 // included header files
 #include "value.hpp"
+#include "arena_int.hpp"
 #include "types.hpp"
 #include "error.hpp"
 #include "convert.hpp"
@@ -53,7 +54,12 @@ EXIV2_RCSID("@(#) $Id$")
 namespace Exiv2 {
 
     Value::Value(TypeId typeId)
-        : ok_(true), type_(typeId)
+        : ok_(true), type_(typeId), refCount_(0)
+    {
+    }
+
+    Value::Value(const Value& rhs)
+        : ok_(rhs.ok_), type_(rhs.type_), refCount_(0)
     {
     }
 
@@ -61,6 +67,16 @@ namespace Exiv2 {
     {
     }
 
+    void* Value::operator new(std::size_t size)
+    {
+        return Internal::Arena::allocate(size);
+    }
+
+    void Value::operator delete(void* p)
+    {
+        Internal::Arena::deallocate(p);
+    }
+
     Value& Value::operator=(const Value& rhs)
     {
         if (this == &rhs) return *this;
@@ -69,6 +85,203 @@ namespace Exiv2 {
         return *this;
     }
 
+    SharedValue::SharedValue(Value::AutoPtr value)
+        : pValue_(0), pStore_(0), pRaw_(0), size_(0),
+          typeId_(invalidTypeId), byteOrder_(invalidByteOrder)
+    {
+        attach(value.release());
+    }
+
+    SharedValue::SharedValue(const SharedValue& rhs)
+        : pValue_(0), pStore_(rhs.pStore_), pRaw_(rhs.pRaw_), size_(rhs.size_),
+          typeId_(rhs.typeId_), byteOrder_(rhs.byteOrder_)
+    {
+        if (pStore_) pStore_->addRef();
+        attach(rhs.pValue_);
+    }
+
+    SharedValue::~SharedValue()
+    {
+        release();
+    }
+
+    SharedValue& SharedValue::operator=(const SharedValue& rhs)
+    {
+        if (this == &rhs) return *this;
+        SharedValue tmp(rhs);
+        swap(tmp);
+        return *this;
+    }
+
+    SharedValue& SharedValue::operator=(Value::AutoPtr value)
+    {
+        release();
+        attach(value.release());
+        return *this;
+    }
+
+    void SharedValue::reset()
+    {
+        release();
+    }
+
+    void SharedValue::swap(SharedValue& rhs)
+    {
+        std::swap(pValue_, rhs.pValue_);
+        std::swap(pStore_, rhs.pStore_);
+        std::swap(pRaw_, rhs.pRaw_);
+        std::swap(size_, rhs.size_);
+        std::swap(typeId_, rhs.typeId_);
+        std::swap(byteOrder_, rhs.byteOrder_);
+    }
+
+    void SharedValue::defer(Internal::RawStore& store,
+                            const byte* pData,
+                            long size,
+                            TypeId typeId,
+                            ByteOrder byteOrder)
+    {
+        release();
+        pRaw_ = store.add(pData, size);
+        pStore_ = &store;
+        pStore_->addRef();
+        size_ = size;
+        typeId_ = typeId;
+        byteOrder_ = byteOrder;
+    }
+
+    void SharedValue::setStore(Internal::RawStore& store)
+    {
+        assert(pValue_ != 0);
+        releaseRaw();
+        pStore_ = &store;
+        pStore_->addRef();
+    }
+
+    Value* SharedValue::modify()
+    {
+        get();
+        // The value is about to change and no longer reflects the raw data
+        releaseRaw();
+        if (shared()) {
+            Value::AutoPtr copy = pValue_->clone();
+            release();
+            attach(copy.release());
+        }
+        return pValue_;
+    }
+
+    const Value* SharedValue::get() const
+    {
+        const Value* pValue = static_cast<const Value*>(
+            Internal::atomicLoad(reinterpret_cast<void* const*>(&pValue_)));
+        return pValue || !pStore_ ? pValue : readValue();
+    }
+
+    TypeId SharedValue::typeId() const
+    {
+        if (pValue_ == 0 && pStore_ != 0) {
+            // A CommentValue has type undefined, see Value::create()
+            return typeId_ == comment ? undefined : typeId_;
+        }
+        const Value* pValue = get();
+        return pValue == 0 ? invalidTypeId : pValue->typeId();
+    }
+
+    long SharedValue::count() const
+    {
+        if (pValue_ == 0 && pStore_ != 0) {
+            long ts = rawTypeSize();
+            if (ts != 0) return size_ / ts;
+        }
+        const Value* pValue = get();
+        return pValue == 0 ? 0 : pValue->count();
+    }
+
+    long SharedValue::size() const
+    {
+        if (pValue_ == 0 && pStore_ != 0) {
+            long ts = rawTypeSize();
+            if (ts != 0) return size_ / ts * ts;
+        }
+        const Value* pValue = get();
+        return pValue == 0 ? 0 : pValue->size();
+    }
+
+    long SharedValue::rawTypeSize() const
+    {
+        // See Value::create() and the read() functions of the values
+        switch (typeId_) {
+        case unsignedShort:
+        case unsignedLong:
+        case unsignedRational:
+        case signedShort:
+        case signedLong:
+        case signedRational:
+        case tiffFloat:
+        case tiffDouble:
+        case tiffIfd:
+        case unsignedLongLong:
+        case signedLongLong:
+        case tiffIfd8:
+            return TypeInfo::typeSize(typeId_);
+        case date:
+        case time:
+        case xmpText:
+        case xmpAlt:
+        case xmpBag:
+        case xmpSeq:
+        case langAlt:
+            return 0;
+        default:
+            return 1;
+        }
+    }
+
+    const Value* SharedValue::readValue() const
+    {
+        static const byte empty = 0;
+        Value::AutoPtr value = Value::create(typeId_);
+        value->read(pRaw_ ? pRaw_ : &empty, size_, byteOrder_);
+        Internal::atomicIncrement(value->refCount_);
+        Value* pValue = value.release();
+        // Another thread may have been faster
+        if (!Internal::atomicCompareAndSwap(reinterpret_cast<void**>(&pValue_), 0, pValue)) {
+            delete pValue;
+        }
+        return pValue_;
+    }
+
+    bool SharedValue::shared() const
+    {
+        return pValue_ != 0 && pValue_->refCount_ > 1;
+    }
+
+    void SharedValue::attach(Value* pValue)
+    {
+        pValue_ = pValue;
+        if (pValue_) Internal::atomicIncrement(pValue_->refCount_);
+    }
+
+    void SharedValue::release()
+    {
+        if (pValue_ && Internal::atomicDecrement(pValue_->refCount_) == 0) {
+            delete pValue_;
+        }
+        pValue_ = 0;
+        releaseRaw();
+    }
+
+    void SharedValue::releaseRaw()
+    {
+        if (pStore_) pStore_->release();
+        pStore_ = 0;
+        pRaw_ = 0;
+        size_ = 0;
+        typeId_ = invalidTypeId;
+        byteOrder_ = invalidByteOrder;
+    }
+
     Value::AutoPtr Value::create(TypeId typeId)
     {
         AutoPtr value;
@@ -88,6 +301,13 @@ namespace Exiv2 {
         case tiffIfd:
             value = AutoPtr(new ValueType<uint32_t>(typeId));
             break;
+        case unsignedLongLong:
+        case tiffIfd8:
+            value = AutoPtr(new ValueType<uint64_t>(typeId));
+            break;
+        case signedLongLong:
+            value = AutoPtr(new ValueType<int64_t>);
+            break;
         case unsignedRational:
             value = AutoPtr(new ValueType<URational>);
             break;
@@ -1214,3 +1434,4 @@ namespace Exiv2 {
     }
 
 }                                       // namespace Exiv2
+
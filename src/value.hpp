@@ -39,6 +39,11 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <cstddef>
 #include <iostream>
 #include <iomanip>
 #include <sstream>
@@ -61,6 +66,7 @@ namespace Exiv2 {
       need to downcast it to a specific subclass to access its interface.
      */
     class EXIV2API Value {
+        friend class SharedValue;
     public:
         //! Shortcut for a %Value auto pointer.
         typedef std::auto_ptr<Value> AutoPtr;
@@ -69,6 +75,8 @@ namespace Exiv2 {
         //@{
         //! Constructor, taking a type id to initialize the base class with
         explicit Value(TypeId typeId);
+        //! Copy constructor. The copy is not shared.
+        Value(const Value& rhs);
         //! Virtual destructor.
         virtual ~Value();
         //@}
@@ -237,6 +245,14 @@ namespace Exiv2 {
                   copy and the auto-pointer ensures that it will be deleted.
          */
         static AutoPtr create(TypeId typeId);
+        /*!
+          @brief Allocate memory for a value. Values created while
+                 readMetadata() runs on an image which uses an arena (see
+                 Image::setUseArena()) are allocated from that arena.
+         */
+        static void* operator new(std::size_t size);
+        //! Release memory of a value.
+        static void operator delete(void* p);
 
     protected:
         /*!
@@ -252,6 +268,7 @@ namespace Exiv2 {
         virtual Value* clone_() const =0;
         // DATA
         TypeId type_;                    //!< Type of the data
+        mutable long refCount_;          //!< Number of SharedValue handles to this value
 
     }; // class Value
 
@@ -261,6 +278,136 @@ namespace Exiv2 {
         return value.write(os);
     }
 
+    namespace Internal {
+        class RawStore;
+    }
+
+    /*!
+      @brief Reference-counted handle to a Value with copy-on-write semantics,
+             used by the metadatum classes to hold their values.
+
+      Copying a handle only increments the reference count, so copies of
+      whole metadata containers share the values of the original. The value
+      is treated as immutable while it is shared: modify() clones it first
+      if other handles refer to it. Updates of the reference count are
+      atomic on compilers which support it.
+
+      The creation of the value can be deferred with defer(): the handle then
+      only refers to the raw data and reads the value from it when it is
+      first accessed. This is done by the const accessors too, concurrent
+      calls are safe. The type, count and size of most values are known
+      without reading them.
+     */
+    class EXIV2API SharedValue {
+    public:
+        //! @name Creators
+        //@{
+        //! Default constructor, creates an empty handle.
+        SharedValue()
+            : pValue_(0), pStore_(0), pRaw_(0), size_(0),
+              typeId_(invalidTypeId), byteOrder_(invalidByteOrder) {}
+        //! Constructor, takes ownership of \em value.
+        explicit SharedValue(Value::AutoPtr value);
+        //! Copy constructor, shares the value of \em rhs.
+        SharedValue(const SharedValue& rhs);
+        //! Destructor, deletes the value when the last handle goes away.
+        ~SharedValue();
+        //@}
+
+        //! @name Manipulators
+        //@{
+        //! Assignment operator, shares the value of \em rhs.
+        SharedValue& operator=(const SharedValue& rhs);
+        //! Release the current value and take ownership of \em value.
+        SharedValue& operator=(Value::AutoPtr value);
+        //! Release the current value, leaving the handle empty.
+        void reset();
+        //! Exchange the values of two handles.
+        void swap(SharedValue& rhs);
+        /*!
+          @brief Release the current value and defer the creation of the new
+                 one: add \em size bytes of raw data at \em pData to
+                 \em store and read a value of type \em typeId from them,
+                 using byte order \em byteOrder, when it is first accessed.
+         */
+        void defer(Internal::RawStore& store,
+                   const byte* pData,
+                   long size,
+                   TypeId typeId,
+                   ByteOrder byteOrder);
+        /*!
+          @brief Record that the current value was decoded from raw data
+                 which belongs to \em store, for values which are created
+                 right away. See rawStore(). Requires a value.
+         */
+        void setStore(Internal::RawStore& store);
+        /*!
+          @brief Return a pointer to the value which can be modified. If the
+                 value is shared with other handles, it is cloned first.
+                 Returns 0 if the handle is empty.
+         */
+        Value* modify();
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return a pointer to the value, 0 if the handle is empty.
+        const Value* get() const;
+        //! Member access to the value.
+        const Value* operator->() const { return get(); }
+        //! Dereference the value.
+        const Value& operator*() const { return *get(); }
+        //! Return true if the handle is empty.
+        bool empty() const { return pValue_ == 0 && pStore_ == 0; }
+        //! Return the type of the value, invalidTypeId if the handle is empty.
+        TypeId typeId() const;
+        /*!
+          @brief Return the number of components of the value, 0 if the
+                 handle is empty. Does not read a deferred value if the
+                 count follows from the size of the raw data.
+         */
+        long count() const;
+        /*!
+          @brief Return the size of the value in bytes, 0 if the handle is
+                 empty. Does not read a deferred value if the size follows
+                 from the size of the raw data.
+         */
+        long size() const;
+        //! Return true if the value is shared with other handles.
+        bool shared() const;
+        /*!
+          @brief Return the store of the raw data the value was decoded
+                 from, 0 if it was not decoded or has been modified since.
+         */
+        const Internal::RawStore* rawStore() const { return pStore_; }
+        //@}
+
+    private:
+        //! Attach to \em pValue and increment its reference count.
+        void attach(Value* pValue);
+        //! Decrement the reference count of the value and delete it if it was the last reference.
+        void release();
+        //! Release the raw data of a deferred value.
+        void releaseRaw();
+        //! Create the deferred value from the raw data.
+        const Value* readValue() const;
+        /*!
+          @brief Return the size of the components of the deferred value if
+                 each of them has that size in the raw data, 1 for values
+                 which are read byte by byte, 0 if the value has to be read.
+         */
+        long rawTypeSize() const;
+
+        // DATA
+        mutable Value* pValue_;          //!< Pointer to the (possibly shared) value
+        Internal::RawStore* pStore_;     //!< Store of the raw data of the value
+        const byte* pRaw_;               //!< Raw data of a deferred value
+        long size_;                      //!< Size of the raw data
+        TypeId typeId_;                  //!< Type of a deferred value
+        ByteOrder byteOrder_;            //!< Byte order of the raw data
+
+    }; // class SharedValue
+
     //! %Value for an undefined data type.
     class EXIV2API DataValue : public Value {
     public:
@@ -1195,6 +1342,322 @@ namespace Exiv2 {
 
     }; // class TimeValue
 
+    /*!
+      @brief Sequence container with inline storage for up to \em N elements,
+             used for the values of a ValueType. Most Exif values consist of
+             a single short, long or rational; these are stored within the
+             object itself and only larger values allocate memory on the heap.
+
+             The interface is that of std::vector, without allocators.
+             Iterators are plain pointers and, as for std::vector, they are
+             invalidated when the container grows or elements are inserted
+             or erased. \em T must be default-constructible and assignable.
+     */
+    template<typename T, std::size_t N>
+    class SmallVector {
+    public:
+        //! Type of the elements
+        typedef T value_type;
+        //! Pointer to an element
+        typedef T* pointer;
+        //! Const pointer to an element
+        typedef const T* const_pointer;
+        //! Reference to an element
+        typedef T& reference;
+        //! Const reference to an element
+        typedef const T& const_reference;
+        //! Iterator type
+        typedef T* iterator;
+        //! Const iterator type
+        typedef const T* const_iterator;
+        //! Reverse iterator type
+        typedef std::reverse_iterator<iterator> reverse_iterator;
+        //! Const reverse iterator type
+        typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+        //! Unsigned integral type
+        typedef std::size_t size_type;
+        //! Signed integral type
+        typedef std::ptrdiff_t difference_type;
+
+        //! @name Creators
+        //@{
+        //! Default constructor, creates an empty container.
+        SmallVector() : pData_(inline_), size_(0), capacity_(N) {}
+        //! Constructor, creates a container with \em n copies of \em val.
+        explicit SmallVector(size_type n, const T& val =T())
+            : pData_(inline_), size_(0), capacity_(N)
+        {
+            assign(n, val);
+        }
+        //! Constructor, creates a container with a copy of the range [first, last).
+        template<typename InputIterator>
+        SmallVector(InputIterator first, InputIterator last)
+            : pData_(inline_), size_(0), capacity_(N)
+        {
+            assign(first, last);
+        }
+        //! Copy constructor.
+        SmallVector(const SmallVector& rhs)
+            : pData_(inline_), size_(0), capacity_(N)
+        {
+            copy(rhs.begin(), rhs.end());
+        }
+        //! Destructor.
+        ~SmallVector()
+        {
+            if (pData_ != inline_) delete[] pData_;
+        }
+        //@}
+
+        //! @name Manipulators
+        //@{
+        //! Assignment operator.
+        SmallVector& operator=(const SmallVector& rhs)
+        {
+            if (this != &rhs) copy(rhs.begin(), rhs.end());
+            return *this;
+        }
+        //! Replace the contents with \em n copies of \em val.
+        void assign(size_type n, const T& val)
+        {
+            T tmp(val);
+            size_ = 0;
+            reserve(n);
+            std::fill(pData_, pData_ + n, tmp);
+            size_ = n;
+        }
+        //! Replace the contents with a copy of the range [first, last).
+        template<typename InputIterator>
+        void assign(InputIterator first, InputIterator last)
+        {
+            assign(first, last, Integral<std::numeric_limits<InputIterator>::is_integer>());
+        }
+        //! Make sure the container can hold at least \em n elements.
+        void reserve(size_type n)
+        {
+            if (n <= capacity_) return;
+            T* p = new T[n];
+            std::copy(pData_, pData_ + size_, p);
+            if (pData_ != inline_) delete[] pData_;
+            pData_ = p;
+            capacity_ = n;
+        }
+        //! Change the number of elements to \em n, appending copies of \em val if necessary.
+        void resize(size_type n, const T& val =T())
+        {
+            if (n > size_) insert(end(), n - size_, val);
+            size_ = n;
+        }
+        //! Append a copy of \em val to the container.
+        void push_back(const T& val)
+        {
+            if (size_ == capacity_) {
+                // val may refer to an element of this container
+                T tmp(val);
+                reserve(2 * capacity_);
+                pData_[size_++] = tmp;
+                return;
+            }
+            pData_[size_++] = val;
+        }
+        //! Remove the last element.
+        void pop_back() { --size_; }
+        //! Insert a copy of \em val before \em pos, return an iterator to the new element.
+        iterator insert(iterator pos, const T& val)
+        {
+            size_type i = pos - pData_;
+            insert(pos, 1, val);
+            return pData_ + i;
+        }
+        //! Insert \em n copies of \em val before \em pos.
+        void insert(iterator pos, size_type n, const T& val)
+        {
+            T tmp(val);
+            iterator p = makeRoom(pos, n);
+            std::fill(p, p + n, tmp);
+        }
+        //! Insert a copy of the range [first, last) before \em pos.
+        template<typename InputIterator>
+        void insert(iterator pos, InputIterator first, InputIterator last)
+        {
+            insert(pos, first, last, Integral<std::numeric_limits<InputIterator>::is_integer>());
+        }
+        //! Remove the element at \em pos, return an iterator to the element that followed it.
+        iterator erase(iterator pos)
+        {
+            return erase(pos, pos + 1);
+        }
+        //! Remove the elements in [first, last), return an iterator to the element that followed them.
+        iterator erase(iterator first, iterator last)
+        {
+            std::copy(last, end(), first);
+            size_ -= last - first;
+            return first;
+        }
+        //! Remove all elements. Memory that has been allocated is kept.
+        void clear() { size_ = 0; }
+        //! Exchange the contents with those of \em rhs.
+        void swap(SmallVector& rhs)
+        {
+            if (pData_ != inline_ && rhs.pData_ != rhs.inline_) {
+                std::swap(pData_, rhs.pData_);
+                std::swap(size_, rhs.size_);
+                std::swap(capacity_, rhs.capacity_);
+                return;
+            }
+            SmallVector tmp(rhs);
+            rhs = *this;
+            *this = tmp;
+        }
+        //! Return an iterator to the first element.
+        iterator begin() { return pData_; }
+        //! Return an iterator past the last element.
+        iterator end() { return pData_ + size_; }
+        //! Return a reverse iterator to the last element.
+        reverse_iterator rbegin() { return reverse_iterator(end()); }
+        //! Return a reverse iterator before the first element.
+        reverse_iterator rend() { return reverse_iterator(begin()); }
+        //! Access the \em n-th element.
+        reference operator[](size_type n) { return pData_[n]; }
+        //! Access the \em n-th element, throw std::out_of_range if there is none.
+        reference at(size_type n)
+        {
+            if (n >= size_) throw std::out_of_range("SmallVector::at");
+            return pData_[n];
+        }
+        //! Access the first element.
+        reference front() { return pData_[0]; }
+        //! Access the last element.
+        reference back() { return pData_[size_ - 1]; }
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return a const iterator to the first element.
+        const_iterator begin() const { return pData_; }
+        //! Return a const iterator past the last element.
+        const_iterator end() const { return pData_ + size_; }
+        //! Return a const reverse iterator to the last element.
+        const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+        //! Return a const reverse iterator before the first element.
+        const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+        //! Access the \em n-th element.
+        const_reference operator[](size_type n) const { return pData_[n]; }
+        //! Access the \em n-th element, throw std::out_of_range if there is none.
+        const_reference at(size_type n) const
+        {
+            if (n >= size_) throw std::out_of_range("SmallVector::at");
+            return pData_[n];
+        }
+        //! Access the first element.
+        const_reference front() const { return pData_[0]; }
+        //! Access the last element.
+        const_reference back() const { return pData_[size_ - 1]; }
+        //! Return the number of elements.
+        size_type size() const { return size_; }
+        //! Return the largest possible number of elements.
+        size_type max_size() const { return static_cast<size_type>(-1) / sizeof(T); }
+        //! Return the number of elements that can be held without reallocation.
+        size_type capacity() const { return capacity_; }
+        //! Return true if the container is empty.
+        bool empty() const { return size_ == 0; }
+        //@}
+
+    private:
+        //! Tag to tell integral arguments from iterators, like std::vector does
+        template<bool isInteger> struct Integral {};
+
+        //! @name Manipulators
+        //@{
+        //! Replace the contents with a copy of [first, last), which is not part of this container.
+        void copy(const_iterator first, const_iterator last)
+        {
+            size_type n = static_cast<size_type>(last - first);
+            size_ = 0;
+            reserve(n);
+            std::copy(first, last, pData_);
+            size_ = n;
+        }
+        //! assign() called with two integers: assign \em n copies of \em val.
+        template<typename Integer>
+        void assign(Integer n, Integer val, Integral<true>)
+        {
+            assign(static_cast<size_type>(n), static_cast<T>(val));
+        }
+        //! assign() called with iterators.
+        template<typename InputIterator>
+        void assign(InputIterator first, InputIterator last, Integral<false>)
+        {
+            clear();
+            for (; first != last; ++first) push_back(*first);
+        }
+        //! insert() called with two integers: insert \em n copies of \em val.
+        template<typename Integer>
+        void insert(iterator pos, Integer n, Integer val, Integral<true>)
+        {
+            insert(pos, static_cast<size_type>(n), static_cast<T>(val));
+        }
+        //! insert() called with iterators, which may refer to this container.
+        template<typename InputIterator>
+        void insert(iterator pos, InputIterator first, InputIterator last, Integral<false>)
+        {
+            SmallVector tmp(first, last);
+            iterator p = makeRoom(pos, tmp.size());
+            std::copy(tmp.begin(), tmp.end(), p);
+        }
+        /*!
+          @brief Move the elements from \em pos to the end back by \em n
+                 places, growing the container if necessary. Return the
+                 position of the first of the \em n new places.
+         */
+        iterator makeRoom(iterator pos, size_type n)
+        {
+            size_type i = pos - pData_;
+            if (size_ + n > capacity_) {
+                reserve(size_ + n > 2 * capacity_ ? size_ + n : 2 * capacity_);
+            }
+            std::copy_backward(pData_ + i, pData_ + size_, pData_ + size_ + n);
+            size_ += n;
+            return pData_ + i;
+        }
+        //@}
+
+        // DATA
+        T* pData_;                              //!< Pointer to the elements
+        size_type size_;                        //!< Number of elements
+        size_type capacity_;                    //!< Number of allocated elements
+        T inline_[N];                           //!< Inline storage for small values
+
+    }; // class SmallVector
+
+    //! Return true if \em lhs and \em rhs have the same elements.
+    template<typename T, std::size_t N>
+    bool operator==(const SmallVector<T, N>& lhs, const SmallVector<T, N>& rhs)
+    {
+        return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+    }
+
+    //! Return true if \em lhs and \em rhs differ.
+    template<typename T, std::size_t N>
+    bool operator!=(const SmallVector<T, N>& lhs, const SmallVector<T, N>& rhs)
+    {
+        return !(lhs == rhs);
+    }
+
+    //! Compare \em lhs and \em rhs lexicographically.
+    template<typename T, std::size_t N>
+    bool operator<(const SmallVector<T, N>& lhs, const SmallVector<T, N>& rhs)
+    {
+        return std::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    }
+
+    //! Exchange the contents of \em lhs and \em rhs.
+    template<typename T, std::size_t N>
+    void swap(SmallVector<T, N>& lhs, SmallVector<T, N>& rhs)
+    {
+        lhs.swap(rhs);
+    }
+
     //! Template to determine the TypeId for a type T
     template<typename T> TypeId getType();
 
@@ -1202,12 +1665,16 @@ namespace Exiv2 {
     template<> inline TypeId getType<uint16_t>() { return unsignedShort; }
     //! Specialization for an unsigned long
     template<> inline TypeId getType<uint32_t>() { return unsignedLong; }
+    //! Specialization for an unsigned long long
+    template<> inline TypeId getType<uint64_t>() { return unsignedLongLong; }
     //! Specialization for an unsigned rational
     template<> inline TypeId getType<URational>() { return unsignedRational; }
     //! Specialization for a signed short
     template<> inline TypeId getType<int16_t>() { return signedShort; }
     //! Specialization for a signed long
     template<> inline TypeId getType<int32_t>() { return signedLong; }
+    //! Specialization for a signed long long
+    template<> inline TypeId getType<int64_t>() { return signedLongLong; }
     //! Specialization for a signed rational
     template<> inline TypeId getType<Rational>() { return signedRational; }
     //! Specialization for a float
@@ -1290,19 +1757,19 @@ namespace Exiv2 {
         virtual DataBuf dataArea() const;
         //@}
 
-        //! Container for values
-        typedef std::vector<T> ValueList;
+        //! Container for values, with inline storage for up to 8 bytes of values
+        typedef SmallVector<T, (sizeof(T) < 8 ? 8 / sizeof(T) : 1)> ValueList;
         //! Iterator type defined for convenience.
-        typedef typename std::vector<T>::iterator iterator;
+        typedef typename ValueList::iterator iterator;
         //! Const iterator type defined for convenience.
-        typedef typename std::vector<T>::const_iterator const_iterator;
+        typedef typename ValueList::const_iterator const_iterator;
 
         // DATA
         /*!
           @brief The container for all values. In your application, if you know
                  what subclass of Value you're dealing with (and possibly the T)
-                 then you can access this STL container through the usual
-                 standard library functions.
+                 then you can access this container like a std::vector and
+                 through the usual standard library functions.
          */
         ValueList value_;
 
@@ -1321,12 +1788,16 @@ namespace Exiv2 {
     typedef ValueType<uint16_t> UShortValue;
     //! Unsigned long value type
     typedef ValueType<uint32_t> ULongValue;
+    //! Unsigned long long value type
+    typedef ValueType<uint64_t> ULongLongValue;
     //! Unsigned rational value type
     typedef ValueType<URational> URationalValue;
     //! Signed short value type
     typedef ValueType<int16_t> ShortValue;
     //! Signed long value type
     typedef ValueType<int32_t> LongValue;
+    //! Signed long long value type
+    typedef ValueType<int64_t> LongLongValue;
     //! Signed rational value type
     typedef ValueType<Rational> RationalValue;
     //! Float value type
@@ -1361,6 +1832,12 @@ namespace Exiv2 {
     {
         return getULong(buf, byteOrder);
     }
+    // Specialization for an 8 byte unsigned long long value.
+    template<>
+    inline uint64_t getValue(const byte* buf, ByteOrder byteOrder)
+    {
+        return getULongLong(buf, byteOrder);
+    }
     // Specialization for an 8 byte unsigned rational value.
     template<>
     inline URational getValue(const byte* buf, ByteOrder byteOrder)
@@ -1379,6 +1856,12 @@ namespace Exiv2 {
     {
         return getLong(buf, byteOrder);
     }
+    // Specialization for an 8 byte signed long long value.
+    template<>
+    inline int64_t getValue(const byte* buf, ByteOrder byteOrder)
+    {
+        return getLongLong(buf, byteOrder);
+    }
     // Specialization for an 8 byte signed rational value.
     template<>
     inline Rational getValue(const byte* buf, ByteOrder byteOrder)
@@ -1429,6 +1912,15 @@ namespace Exiv2 {
     {
         return ul2Data(buf, t, byteOrder);
     }
+    /*!
+      @brief Specialization to write an unsigned long long to the data buffer.
+             Return the number of bytes written.
+     */
+    template<>
+    inline long toData(byte* buf, uint64_t t, ByteOrder byteOrder)
+    {
+        return ull2Data(buf, t, byteOrder);
+    }
     /*!
       @brief Specialization to write an unsigned rational to the data buffer.
              Return the number of bytes written.
@@ -1456,6 +1948,15 @@ namespace Exiv2 {
     {
         return l2Data(buf, t, byteOrder);
     }
+    /*!
+      @brief Specialization to write a signed long long to the data buffer.
+             Return the number of bytes written.
+     */
+    template<>
+    inline long toData(byte* buf, int64_t t, ByteOrder byteOrder)
+    {
+        return ll2Data(buf, t, byteOrder);
+    }
     /*!
       @brief Specialization to write a signed rational to the data buffer.
              Return the number of bytes written.
@@ -1552,6 +2053,7 @@ namespace Exiv2 {
         value_.clear();
         long ts = TypeInfo::typeSize(typeId());
         if (len % ts != 0) len = (len / ts) * ts;
+        if (len > 0) value_.reserve(len / ts);
         for (long i = 0; i < len; i += ts) {
             value_.push_back(getValue<T>(buf + i, byteOrder));
         }
@@ -35,6 +35,8 @@ EXIV2_RCSID("@(#) $Id$")
 #include "error.hpp"
 #include "value.hpp"
 #include "properties.hpp"
+#include "parsebudget_int.hpp"
+#include "xmpdecoder_int.hpp"
 
 // + standard includes
 #include <iostream>
@@ -89,6 +91,14 @@ namespace {
     //! Convert XmpFormatFlags to XMP Toolkit format option bits
     XMP_OptionBits xmpFormatOptionBits(Exiv2::XmpParser::XmpFormatFlags flags);
 
+    /*!
+      @brief Charge the nesting levels of the XML elements in \em xmpPacket
+             to \em budget. Return false if the elements are nested too
+             deeply. The check is a quick scan for tags, not a full parse.
+     */
+    bool checkNesting(Exiv2::Internal::ParseBudget& budget,
+                      const std::string& xmpPacket);
+
 # ifdef DEBUG
     //! Print information about a parsed XMP node
     void printNode(const std::string& schemaNs,
@@ -133,7 +143,7 @@ namespace Exiv2 {
 
         // DATA
         XmpKey::AutoPtr key_;                          //!< Key
-        Value::AutoPtr  value_;                        //!< Value
+        SharedValue     value_;                        //!< Value, shared between copies
     };
 
     Xmpdatum::Impl::Impl(const XmpKey& key, const Value* pValue)
@@ -143,9 +153,9 @@ namespace Exiv2 {
     }
 
     Xmpdatum::Impl::Impl(const Impl& rhs)
+        : value_(rhs.value_) // shared value
     {
         if (rhs.key_.get() != 0) key_ = rhs.key_->clone(); // deep copy
-        if (rhs.value_.get() != 0) value_ = rhs.value_->clone(); // deep copy
     }
 
     Xmpdatum::Impl& Xmpdatum::Impl::operator=(const Impl& rhs)
@@ -153,8 +163,7 @@ namespace Exiv2 {
         if (this == &rhs) return *this;
         key_.reset();
         if (rhs.key_.get() != 0) key_ = rhs.key_->clone(); // deep copy
-        value_.reset();
-        if (rhs.value_.get() != 0) value_ = rhs.value_->clone(); // deep copy
+        value_ = rhs.value_; // shared value
         return *this;
     }
 
@@ -176,6 +185,11 @@ namespace Exiv2 {
         return *this;
     }
 
+    void Xmpdatum::swap(Xmpdatum& rhs)
+    {
+        std::swap(p_, rhs.p_);
+    }
+
     Xmpdatum::~Xmpdatum()
     {
         delete p_;
@@ -310,7 +324,7 @@ namespace Exiv2 {
             }
             p_->value_ = Value::create(type);
         }
-        return p_->value_->read(value);
+        return p_->value_.modify()->read(value);
     }
 
     Xmpdatum& XmpData::operator[](const std::string& key)
@@ -395,6 +409,7 @@ namespace Exiv2 {
     bool XmpParser::initialized_ = false;
     XmpParser::XmpLockFct XmpParser::xmpLockFct_ = 0;
     void* XmpParser::pLockData_ = 0;
+    XmpParser::Decoder XmpParser::decoder_ = XmpParser::toolkitDecoder;
 
     bool XmpParser::initialize(XmpParser::XmpLockFct xmpLockFct, void* pLockData)
     {
@@ -430,6 +445,16 @@ namespace Exiv2 {
         }
     }
 
+    void XmpParser::setDecoder(Decoder decoder)
+    {
+        decoder_ = decoder;
+    }
+
+    XmpParser::Decoder XmpParser::decoder()
+    {
+        return decoder_;
+    }
+
 #ifdef EXV_HAVE_XMP_TOOLKIT
     void XmpParser::registerNs(const std::string& ns,
                                const std::string& prefix)
@@ -479,11 +504,27 @@ namespace Exiv2 {
             return 2;
         }
 
+        // The XMP toolkit builds a tree of the entire packet, recursing for
+        // nested elements, check the packet against the budget first
+        Internal::ParseBudgetScope budgetScope;
+        Internal::ParseBudget& budget = budgetScope.budget();
+        if (   !budget.addValueBytes(static_cast<uint32_t>(xmpPacket.size()))
+            || !checkNesting(budget, xmpPacket)) {
+            return 0;
+        }
+
+        // Most packets can be decoded without the trees of the XMP toolkit
+        if (   decoder_ == streamingDecoder
+            && Internal::decodeXmpPacket(xmpData, xmpPacket, budget)) {
+            return 0;
+        }
+
         SXMPMeta meta(xmpPacket.data(), static_cast<XMP_StringLen>(xmpPacket.size()));
         SXMPIterator iter(meta);
         std::string schemaNs, propPath, propValue;
         XMP_OptionBits opt;
         while (iter.Next(&schemaNs, &propPath, &propValue, &opt)) {
+            if (!budget.addComponents()) break;
 #ifdef DEBUG
             printNode(schemaNs, propPath, propValue, opt);
 #endif
@@ -774,6 +815,40 @@ namespace {
         return var;
     }
 
+    bool checkNesting(Exiv2::Internal::ParseBudget& budget,
+                      const std::string& xmpPacket)
+    {
+        const std::string::size_type size = xmpPacket.size();
+        uint32_t depth = 0;
+        bool ok = true;
+        for (std::string::size_type i = xmpPacket.find('<');
+             ok && i != std::string::npos && i + 1 < size;
+             i = xmpPacket.find('<', i + 1)) {
+            const char c = xmpPacket[i + 1];
+            // Processing instructions, comments, declarations
+            if (c == '?' || c == '!') continue;
+            if (c == '/') {
+                if (depth > 0) {
+                    budget.leave();
+                    --depth;
+                }
+                continue;
+            }
+            ++depth;
+            ok = budget.enter();
+            std::string::size_type end = xmpPacket.find('>', i);
+            if (end == std::string::npos) break;
+            // Empty element
+            if (xmpPacket[end - 1] == '/') {
+                budget.leave();
+                --depth;
+            }
+            i = end;
+        }
+        for (; depth > 0; --depth) budget.leave();
+        return ok;
+    }
+
     Exiv2::TypeId arrayValueTypeId(const XMP_OptionBits& opt)
     {
         Exiv2::TypeId typeId(Exiv2::invalidTypeId);
@@ -83,6 +83,8 @@ namespace Exiv2 {
         //@{
         //! Assignment operator
         Xmpdatum& operator=(const Xmpdatum& rhs);
+        //! Exchange key and value with \em rhs, without copying either.
+        void swap(Xmpdatum& rhs);
         /*!
           @brief Assign std::string \em value to the %Xmpdatum.
                  Calls setValue(const std::string&).
@@ -215,6 +217,8 @@ namespace Exiv2 {
         iterator erase(iterator pos);
         //! Delete all Xmpdatum instances resulting in an empty container.
         void clear();
+        //! Exchange the contents with those of \em rhs, without copying any metadata.
+        void swap(XmpData& rhs) { xmpMetadata_.swap(rhs.xmpMetadata_); }
         //! Sort metadata by key
         void sortByKey();
         //! Begin of the metadata
@@ -267,6 +271,11 @@ namespace Exiv2 {
             writeAliasComments  = 0x0400UL,  //!< Show aliases as XML comments.
             omitAllFormatting   = 0x0800UL   //!< Omit all formatting whitespace.
         };
+        //! Decoders for XMP packets, see setDecoder().
+        enum Decoder {
+            streamingDecoder,   //!< Decode from the events of the XML parser where possible.
+            toolkitDecoder      //!< Always decode with the data model of the XMP toolkit (default).
+        };
         /*!
           @brief Decode XMP metadata from an XMP packet \em xmpPacket into
                  \em xmpData. The format of the XMP packet must follow the
@@ -373,6 +382,22 @@ namespace Exiv2 {
           allow the XMP Toolkit to cleanly shutdown.
          */
         static void terminate();
+        /*!
+          @brief Select the decoder decode() uses.
+
+          The default, toolkitDecoder, decodes with the XMP toolkit, like
+          earlier versions. The streaming decoder fills \em xmpData
+          directly from the events of the XML parser, without the XML and
+          XMP trees of the XMP toolkit. Packets with RDF forms it does not
+          handle are passed on to the XMP toolkit. Namespaces declared in a
+          packet are registered with the XMP toolkit only after the packet
+          has been parsed successfully.
+
+          The function is not thread-safe, call it on program startup.
+         */
+        static void setDecoder(Decoder decoder);
+        //! Return the decoder decode() uses.
+        static Decoder decoder();
 
     private:
         /*!
@@ -391,6 +416,7 @@ namespace Exiv2 {
         static bool initialized_; //! Indicates if the XMP Toolkit has been initialized
         static XmpLockFct xmpLockFct_;
         static void* pLockData_;
+        static Decoder decoder_; //! Decoder used by decode()
 
     }; // class XmpParser
 
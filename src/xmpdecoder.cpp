@@ -0,0 +1,1015 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2011 Andreas Huggel <ahuggel@gmx.net>
+ *
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+  File:      xmpdecoder.cpp
+  Version:   $Rev$
+  Author(s): Andreas Huggel (ahu) <ahuggel@gmx.net>
+  History:   19-Oct-26, ahu: created
+ */
+// *****************************************************************************
+#include "rcsid_int.hpp"
+EXIV2_RCSID("@(#) $Id$")
+
+// *****************************************************************************
+// included header files
+#include "xmpdecoder_int.hpp"
+
+#ifdef EXV_HAVE_XMP_TOOLKIT
+
+#include "xmp.hpp"
+#include "value.hpp"
+#include "properties.hpp"
+#include "parsebudget_int.hpp"
+
+// + standard includes
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <cstring>
+#include <cctype>
+
+// Adobe XMP Toolkit and Expat
+# define TXMP_STRING_TYPE std::string
+# include <XMPSDK.hpp>
+# include <expat.h>
+
+// *****************************************************************************
+// local declarations
+namespace {
+
+    //! Separator of namespace URI and local name in the names Expat reports
+    const char nsSeparator = '@';
+    //! Namespace of x:xmpmeta
+    const char xmpMetaNs[] = "adobe:ns:meta/";
+    //! Wrong Dublin Core namespace which the XMP Toolkit replaces
+    const char oldDcNs[] = "http://purl.org/dc/1.1/";
+    //! Namespace of the iX:changes property which the XMP Toolkit drops
+    const char ixNs[] = "http://ns.adobe.com/iX/1.0/";
+
+    //! Kinds of XMP nodes
+    enum NodeKind {
+        simpleNode,                     //!< Simple property, field or array item
+        structNode,                     //!< Struct, its fields follow
+        arrayNode,                      //!< Array, its items follow
+        arrayValueNode,                 //!< Array of simple items, the items are in the node
+        langAltNode                     //!< Alt-text array, the items are in the node
+    };
+
+    /*!
+      @brief An XMP node, which becomes one Xmpdatum. The nodes of a schema
+             are kept in the order the iterator of the XMP Toolkit visits
+             them.
+     */
+    struct XmpNode {
+        //! Constructor
+        XmpNode(NodeKind kind, const std::string& path)
+            : kind_(kind), path_(path), arrayType_(Exiv2::invalidTypeId) {}
+
+        // DATA
+        NodeKind kind_;                 //!< Kind of the node
+        std::string path_;              //!< Path of the node, without the schema prefix
+        std::string value_;             //!< Value of a simple node
+        std::string lang_;              //!< Language of an alt-text item
+        Exiv2::TypeId arrayType_;       //!< xmpBag, xmpSeq or xmpAlt for arrays
+        std::vector<std::string> items_; //!< Items of arrayValueNode and langAltNode
+        std::vector<std::string> langs_; //!< Languages of the items of langAltNode
+    };
+
+    //! The nodes of one schema
+    struct XmpSchema {
+        // DATA
+        std::string ns_;                //!< Namespace URI of the schema
+        std::string prefix_;            //!< Exiv2 prefix of the namespace
+        std::vector<XmpNode> nodes_;    //!< Nodes of the schema
+        std::set<std::string> names_;   //!< Names of the properties, to find duplicates
+    };
+
+    //! Kinds of XML elements
+    enum ElementKind {
+        xmpmetaElement,                 //!< x:xmpmeta or x:xapmeta
+        rdfElement,                     //!< rdf:RDF
+        descriptionElement,             //!< Top-level rdf:Description
+        propertyElement,                //!< Property element of unknown form so far
+        structElement,                  //!< Nested rdf:Description or rdf:parseType="Resource"
+        arrayElement,                   //!< rdf:Bag, rdf:Seq or rdf:Alt
+        emptyElement                    //!< Struct written as attributes, without content
+    };
+
+    //! An open XML element
+    struct Element {
+        //! Constructor
+        explicit Element(ElementKind kind)
+            : kind_(kind), property_(false), top_(false), schema_(0), node_(0),
+              hasNode_(false), hasLang_(false), arrayType_(Exiv2::invalidTypeId),
+              count_(0), simpleItems_(0), langItems_(0) {}
+
+        // DATA
+        ElementKind kind_;              //!< Kind of the element
+        bool property_;                 //!< True for the elements of properties, fields and items
+        bool top_;                      //!< True for top-level properties
+        std::string ns_;                //!< Namespace URI of a property
+        std::string name_;              //!< Name of a property, with the XMP Toolkit's prefix
+        std::string path_;              //!< Path of a property, struct or array
+        std::size_t schema_;            //!< Index of the schema of the element
+        std::size_t node_;              //!< Index of the node of the element in the schema
+        bool hasNode_;                  //!< True if the node of the element has been added
+        bool hasLang_;                  //!< True if the element has an xml:lang attribute
+        std::string lang_;              //!< Normalized xml:lang of an alt-text item
+        std::string text_;              //!< Text of a property element
+        Exiv2::TypeId arrayType_;       //!< Type of an array
+        int count_;                     //!< Number of items of an array
+        int simpleItems_;               //!< Number of simple items of an array
+        int langItems_;                 //!< Number of items of an array with xml:lang
+        std::vector<std::string> names_; //!< Names of the fields of a struct, languages of alt items
+    };
+
+    /*!
+      @brief Parses an XMP packet with Expat and collects the XMP nodes of
+             the RDF forms it knows, see Internal::decodeXmpPacket().
+     */
+    class XmpStreamParser {
+    public:
+        //! @name Creators
+        //@{
+        //! Constructor
+        explicit XmpStreamParser(Exiv2::Internal::ParseBudget& budget);
+        //! Destructor
+        ~XmpStreamParser();
+        //@}
+
+        //! @name Manipulators
+        //@{
+        /*!
+          @brief Parse \em xmpPacket. Return false if the packet needs to be
+                 decoded with the XMP Toolkit. The namespaces declared in
+                 the packet are registered with the XMP Toolkit only if the
+                 parse succeeds.
+         */
+        bool parse(const std::string& xmpPacket);
+        //! Add the parsed nodes to \em xmpData, charged to the budget.
+        void decode(Exiv2::XmpData& xmpData);
+        //@}
+
+    private:
+        //! @name NOT implemented
+        //@{
+        //! Copy constructor.
+        XmpStreamParser(const XmpStreamParser& rhs);
+        //! Assignment operator.
+        XmpStreamParser& operator=(const XmpStreamParser& rhs);
+        //@}
+
+        //! @name Expat handlers
+        //@{
+        static void startNamespace(void* userData, const XML_Char* prefix, const XML_Char* uri);
+        static void startElement(void* userData, const XML_Char* name, const XML_Char** attrs);
+        static void endElement(void* userData, const XML_Char* name);
+        static void characterData(void* userData, const XML_Char* s, int len);
+        static void processingInstruction(void* userData, const XML_Char* target, const XML_Char* data);
+        static void startDoctype(void* userData, const XML_Char* doctypeName,
+                                 const XML_Char* sysid, const XML_Char* pubid, int hasInternalSubset);
+        //@}
+
+        //! @name Manipulators
+        //@{
+        //! Stop parsing, the packet needs to be decoded with the XMP Toolkit.
+        void giveUp();
+        void onStartNamespace(const char* prefix, const char* uri);
+        void onStartElement(const char* name, const char** attrs);
+        void onEndElement();
+        void onCharacterData(const char* s, int len);
+        //! Open the top-level rdf:Description element
+        void startDescription(const char** attrs);
+        //! Open the element of a property, field or array item
+        void startProperty(const std::string& ns, const std::string& local, const char** attrs);
+        //! Open the node element in a property element
+        void startNodeElement(const std::string& ns, const std::string& local, const char** attrs);
+        /*!
+          @brief Set the name, path and schema of property \em e of the open
+                 element \em parent, 0 for top-level properties. Return false
+                 if the property is not supported.
+         */
+        bool initProperty(Element& e, const std::string& ns, const std::string& local, Element* parent);
+        //! Add a simple field for each attribute of struct \em e
+        void addFields(Element& e, const char** attrs);
+        //! Add the node of element \em e
+        XmpNode& addNode(Element& e, NodeKind kind);
+        //! Turn the array \em e into one node if it has only simple items
+        void finishArray(const Element& e);
+        //! Give up on top-level properties the XMP Toolkit normalizes
+        void checkTopLevel(const Element& e);
+        //! Get the XMP Toolkit's prefix of \em ns, with a colon. Return false if there is none.
+        bool sdkPrefix(const std::string& ns, std::string& prefix);
+        //! Register the namespaces declared in the packet with the XMP Toolkit
+        void registerNamespaces();
+        //@}
+
+        //! @name Accessors
+        //@{
+        /*!
+          @brief Get the prefix of \em uri, with a colon, as the XMP Toolkit
+                 will have it after the namespaces declared so far are
+                 registered. Return false if there is none.
+         */
+        bool nsPrefix(const std::string& uri, std::string& prefix) const;
+        /*!
+          @brief Get the URI of \em prefix, with a colon, as the XMP Toolkit
+                 will have it after the namespaces declared so far are
+                 registered. Return false if there is none.
+         */
+        bool nsUri(const std::string& prefix, std::string& uri) const;
+        //! Return the index of the schema for namespace \em ns, create it if needed
+        bool schema(const std::string& ns, std::size_t& index);
+        //@}
+
+        // DATA
+        Exiv2::Internal::ParseBudget& budget_; //!< Budget for the metadata
+        XML_Parser parser_;             //!< Expat parser
+        bool ok_;                       //!< False once the parser gave up
+        bool hasRdf_;                   //!< True once rdf:RDF was seen
+        std::vector<Element> elements_; //!< Stack of open elements
+        std::vector<XmpSchema> schemas_; //!< Schemas, in the order of the XMP Toolkit
+        std::size_t lastSchema_;        //!< Index of the schema used last
+        std::map<std::string, std::string> prefixes_; //!< Cache of XMP Toolkit prefixes
+        std::set<std::string> usedNs_;  //!< Namespaces of the names formed so far
+        //! Namespaces declared in the packet, URI and prefix, in the order of the declarations
+        std::vector<std::pair<std::string, std::string> > newNs_;
+        std::map<std::string, std::string> newPrefixes_; //!< Prefixes with colon of declared URIs
+        std::map<std::string, std::string> newUris_; //!< URIs of declared prefixes with colon
+        std::string elementNs_;         //!< Namespace of the current element
+        std::string elementLocal_;      //!< Local name of the current element
+        std::string attrNs_;            //!< Namespace of the current attribute
+        std::string attrLocal_;         //!< Local name of the current attribute
+    };
+
+    //! Split an Expat name into namespace URI \em ns and local name \em local
+    void splitName(const char* name, std::string& ns, std::string& local);
+
+    //! Return the path of item \em index of the array at \em path
+    std::string itemPath(const std::string& path, int index);
+
+    //! Return true if the \em len characters at \em s are XML whitespace
+    bool isWhitespace(const char* s, std::size_t len);
+
+    /*!
+      @brief Return true if \em xmpPacket is UTF-8 which the XMP Toolkit
+             passes to Expat unchanged: no invalid UTF-8, which it reads as
+             Latin-1, and no control characters or hex escapes with one or
+             two digits other than tab, LF and CR, which it replaces with
+             spaces.
+     */
+    bool isPlainUtf8(const std::string& xmpPacket);
+
+    //! Normalize an xml:lang value like the XMP Toolkit does
+    void normalizeLang(std::string& lang);
+
+}
+
+// *****************************************************************************
+// local definitions
+namespace {
+
+    XmpStreamParser::XmpStreamParser(Exiv2::Internal::ParseBudget& budget)
+        : budget_(budget), parser_(0), ok_(true), hasRdf_(false), lastSchema_(0)
+    {
+    }
+
+    XmpStreamParser::~XmpStreamParser()
+    {
+        if (parser_) XML_ParserFree(parser_);
+    }
+
+    bool XmpStreamParser::parse(const std::string& xmpPacket)
+    {
+        if (!isPlainUtf8(xmpPacket)) return false;
+
+        parser_ = XML_ParserCreateNS(0, nsSeparator);
+        if (!parser_) return false;
+        XML_SetUserData(parser_, this);
+        XML_SetNamespaceDeclHandler(parser_, startNamespace, 0);
+        XML_SetElementHandler(parser_, startElement, endElement);
+        XML_SetCharacterDataHandler(parser_, characterData);
+        XML_SetProcessingInstructionHandler(parser_, processingInstruction);
+        XML_SetStartDoctypeDeclHandler(parser_, startDoctype);
+        if (   XML_Parse(parser_, xmpPacket.data(),
+                         static_cast<int>(xmpPacket.size()), 1) != XML_STATUS_OK
+            || !ok_) {
+            return false;
+        }
+        registerNamespaces();
+        return true;
+    }
+
+    void XmpStreamParser::decode(Exiv2::XmpData& xmpData)
+    {
+        for (std::size_t s = 0; s < schemas_.size(); ++s) {
+            if (!budget_.addComponents()) return;
+            const XmpSchema& schema = schemas_[s];
+            for (std::size_t i = 0; i < schema.nodes_.size(); ++i) {
+                if (!budget_.addComponents()) return;
+                const XmpNode& node = schema.nodes_[i];
+                Exiv2::XmpKey key(schema.prefix_, node.path_);
+                switch (node.kind_) {
+                case simpleNode: {
+                    Exiv2::XmpTextValue val;
+                    val.read(node.value_);
+                    xmpData.add(key, &val);
+                    break;
+                }
+                case structNode:
+                case arrayNode: {
+                    Exiv2::XmpTextValue val;
+                    val.setXmpArrayType(Exiv2::XmpValue::xmpArrayType(node.arrayType_));
+                    val.setXmpStruct(node.kind_ == structNode ? Exiv2::XmpValue::xsStruct
+                                                              : Exiv2::XmpValue::xsNone);
+                    xmpData.add(key, &val);
+                    break;
+                }
+                case arrayValueNode: {
+                    Exiv2::XmpArrayValue val(node.arrayType_);
+                    for (std::size_t j = 0; j < node.items_.size(); ++j) {
+                        val.read(node.items_[j]);
+                    }
+                    xmpData.add(key, &val);
+                    break;
+                }
+                case langAltNode: {
+                    Exiv2::LangAltValue val;
+                    for (std::size_t j = 0; j < node.items_.size(); ++j) {
+                        val.value_[node.langs_[j]] = node.items_[j];
+                    }
+                    xmpData.add(key, &val);
+                    break;
+                }
+                }
+            }
+        }
+    }
+
+    void XmpStreamParser::startNamespace(void* userData, const XML_Char* prefix, const XML_Char* uri)
+    {
+        XmpStreamParser* p = static_cast<XmpStreamParser*>(userData);
+        if (!p->ok_) return;
+        try {
+            p->onStartNamespace(prefix, uri);
+        }
+        catch (...) {
+            p->giveUp();
+        }
+    }
+
+    void XmpStreamParser::startElement(void* userData, const XML_Char* name, const XML_Char** attrs)
+    {
+        XmpStreamParser* p = static_cast<XmpStreamParser*>(userData);
+        if (!p->ok_) return;
+        try {
+            p->onStartElement(name, attrs);
+        }
+        catch (...) {
+            p->giveUp();
+        }
+    }
+
+    void XmpStreamParser::endElement(void* userData, const XML_Char* /*name*/)
+    {
+        XmpStreamParser* p = static_cast<XmpStreamParser*>(userData);
+        if (!p->ok_) return;
+        try {
+            p->onEndElement();
+        }
+        catch (...) {
+            p->giveUp();
+        }
+    }
+
+    void XmpStreamParser::characterData(void* userData, const XML_Char* s, int len)
+    {
+        XmpStreamParser* p = static_cast<XmpStreamParser*>(userData);
+        if (!p->ok_) return;
+        try {
+            p->onCharacterData(s, len);
+        }
+        catch (...) {
+            p->giveUp();
+        }
+    }
+
+    void XmpStreamParser::processingInstruction(void* userData, const XML_Char* target, const XML_Char* /*data*/)
+    {
+        XmpStreamParser* p = static_cast<XmpStreamParser*>(userData);
+        // The XMP Toolkit keeps xpacket processing instructions as XML nodes
+        if (   p->ok_
+            && !p->elements_.empty()
+            && std::strcmp(target, "xpacket") == 0) {
+            p->giveUp();
+        }
+    }
+
+    void XmpStreamParser::startDoctype(void* userData, const XML_Char* /*doctypeName*/,
+                                       const XML_Char* /*sysid*/, const XML_Char* /*pubid*/,
+                                       int /*hasInternalSubset*/)
+    {
+        XmpStreamParser* p = static_cast<XmpStreamParser*>(userData);
+        if (p->ok_) p->giveUp();
+    }
+
+    void XmpStreamParser::giveUp()
+    {
+        ok_ = false;
+        XML_StopParser(parser_, XML_FALSE);
+    }
+
+    void XmpStreamParser::onStartNamespace(const char* prefix, const char* uri)
+    {
+        if (uri == 0) return;
+        if (prefix == 0) prefix = "_dflt_";
+        const bool rdfNs = std::strcmp(uri, kXMP_NS_RDF) == 0;
+        if (   std::strcmp(uri, oldDcNs) == 0
+            || rdfNs != (std::strcmp(prefix, "rdf") == 0)) {
+            giveUp();
+            return;
+        }
+        // Registering a namespace replaces the XMP Toolkit's mapping of the
+        // URI and prefix. Names it formed with the old mapping no longer
+        // resolve, leave such packets to the XMP Toolkit.
+        const std::string newPrefix = std::string(prefix) + ':';
+        std::string oldPrefix, oldUri;
+        if (   (   nsPrefix(uri, oldPrefix)
+                && oldPrefix != newPrefix
+                && usedNs_.find(uri) != usedNs_.end())
+            || (   nsUri(newPrefix, oldUri)
+                && oldUri != uri
+                && usedNs_.find(oldUri) != usedNs_.end())) {
+            giveUp();
+            return;
+        }
+        // The XMP Toolkit's Expat adapter registers the namespace right
+        // away. Use the new mapping for the rest of the packet, but change
+        // the XMP Toolkit's only once the whole packet is parsed.
+        newNs_.push_back(std::make_pair(std::string(uri), std::string(prefix)));
+        newPrefixes_[uri] = newPrefix;
+        newUris_[newPrefix] = uri;
+    }
+
+    void XmpStreamParser::onStartElement(const char* name, const char** attrs)
+    {
+        std::string& ns = elementNs_;
+        std::string& local = elementLocal_;
+        splitName(name, ns, local);
+        const ElementKind parent = elements_.empty() ? xmpmetaElement : elements_.back().kind_;
+        if (elements_.empty() && ns == xmpMetaNs && (local == "xmpmeta" || local == "xapmeta")) {
+            elements_.push_back(Element(xmpmetaElement));
+            return;
+        }
+        switch (parent) {
+        case xmpmetaElement:
+            if (   hasRdf_
+                || ns != kXMP_NS_RDF || local != "RDF"
+                || attrs[0] != 0) {
+                giveUp();
+                return;
+            }
+            hasRdf_ = true;
+            elements_.push_back(Element(rdfElement));
+            break;
+        case rdfElement:
+            if (ns != kXMP_NS_RDF || local != "Description") {
+                giveUp();
+                return;
+            }
+            startDescription(attrs);
+            break;
+        case descriptionElement:
+        case structElement:
+        case arrayElement:
+            startProperty(ns, local, attrs);
+            break;
+        case propertyElement:
+            startNodeElement(ns, local, attrs);
+            break;
+        case emptyElement:
+            giveUp();
+            break;
+        }
+    }
+
+    void XmpStreamParser::onEndElement()
+    {
+        Element& e = elements_.back();
+        if (e.kind_ == propertyElement && !e.hasNode_) {
+            // Literal or empty property element
+            XmpNode& node = addNode(e, simpleNode);
+            node.value_.swap(e.text_);
+            node.lang_ = e.lang_;
+        }
+        else if (e.kind_ == arrayElement) {
+            finishArray(e);
+        }
+        if (!ok_) return;
+        if (e.property_ && elements_.size() > 1) {
+            Element& parent = elements_[elements_.size() - 2];
+            if (parent.kind_ == arrayElement) {
+                if (schemas_[e.schema_].nodes_[e.node_].kind_ == simpleNode) {
+                    ++parent.simpleItems_;
+                }
+                if (e.hasLang_) {
+                    // Duplicate languages
+                    for (std::size_t i = 0; i < parent.names_.size(); ++i) {
+                        if (parent.names_[i] == e.lang_) {
+                            giveUp();
+                            return;
+                        }
+                    }
+                    ++parent.langItems_;
+                    parent.names_.push_back(e.lang_);
+                }
+            }
+        }
+        if (e.top_) checkTopLevel(e);
+        elements_.pop_back();
+    }
+
+    void XmpStreamParser::onCharacterData(const char* s, int len)
+    {
+        if (elements_.empty()) return;
+        Element& e = elements_.back();
+        if (e.kind_ == propertyElement && !e.hasNode_) {
+            e.text_.append(s, len);
+        }
+        else if (e.kind_ == emptyElement || !isWhitespace(s, len)) {
+            giveUp();
+        }
+    }
+
+    void XmpStreamParser::startDescription(const char** attrs)
+    {
+        // Only an empty rdf:about and properties as attributes
+        std::string& ns = attrNs_;
+        std::string& local = attrLocal_;
+        int about = 0;
+        for (const char** a = attrs; *a != 0; a += 2) {
+            splitName(a[0], ns, local);
+            if (   (ns.empty() || ns == kXMP_NS_RDF)
+                && local == "about" && a[1][0] == '\0' && ++about == 1) {
+                continue;
+            }
+            if (ns.empty() || ns == kXMP_NS_RDF || ns == kXMP_NS_XML) {
+                giveUp();
+                return;
+            }
+            Element e(propertyElement);
+            if (!initProperty(e, ns, local, 0)) return;
+            addNode(e, simpleNode).value_ = a[1];
+            checkTopLevel(e);
+            if (!ok_) return;
+        }
+        elements_.push_back(Element(descriptionElement));
+    }
+
+    void XmpStreamParser::startProperty(const std::string& ns, const std::string& local, const char** attrs)
+    {
+        elements_.push_back(Element(propertyElement));
+        Element& e = elements_.back();
+        Element& parent = elements_[elements_.size() - 2];
+        e.property_ = true;
+        if (!initProperty(e, ns, local, parent.kind_ == descriptionElement ? 0 : &parent)) return;
+
+        std::string& ans = attrNs_;
+        std::string& alocal = attrLocal_;
+        bool resource = false;
+        bool fields = false;
+        for (const char** a = attrs; *a != 0; a += 2) {
+            splitName(a[0], ans, alocal);
+            if (ans == kXMP_NS_XML && alocal == "lang") {
+                // Only the items of Alt arrays may have a language
+                if (   parent.kind_ != arrayElement
+                    || parent.arrayType_ != Exiv2::xmpAlt) {
+                    giveUp();
+                    return;
+                }
+                e.hasLang_ = true;
+                e.lang_ = a[1];
+                normalizeLang(e.lang_);
+            }
+            else if (   ans == kXMP_NS_RDF && alocal == "parseType"
+                     && std::strcmp(a[1], "Resource") == 0) {
+                resource = true;
+            }
+            else if (   ans.empty() || ans == kXMP_NS_RDF
+                     || ans == kXMP_NS_XML || ans == oldDcNs) {
+                giveUp();
+                return;
+            }
+            else {
+                fields = true;
+            }
+        }
+        if (   (resource && (fields || e.hasLang_))
+            || (fields && e.hasLang_)) {
+            giveUp();
+            return;
+        }
+        if (resource) {
+            e.kind_ = structElement;
+            addNode(e, structNode);
+        }
+        else if (fields) {
+            e.kind_ = emptyElement;
+            addNode(e, structNode);
+            addFields(e, attrs);
+        }
+    }
+
+    void XmpStreamParser::startNodeElement(const std::string& ns, const std::string& local, const char** attrs)
+    {
+        Element& p = elements_.back();
+        if (   p.hasNode_ || p.hasLang_
+            || !isWhitespace(p.text_.data(), p.text_.size())
+            || ns != kXMP_NS_RDF) {
+            giveUp();
+            return;
+        }
+        Exiv2::TypeId arrayType = Exiv2::invalidTypeId;
+        if (local == "Bag") arrayType = Exiv2::xmpBag;
+        else if (local == "Seq") arrayType = Exiv2::xmpSeq;
+        else if (local == "Alt") arrayType = Exiv2::xmpAlt;
+        p.text_.clear();
+
+        if (arrayType != Exiv2::invalidTypeId) {
+            if (attrs[0] != 0) {
+                giveUp();
+                return;
+            }
+            addNode(p, arrayNode).arrayType_ = arrayType;
+            elements_.push_back(Element(arrayElement));
+            Element& a = elements_.back();
+            const Element& prop = elements_[elements_.size() - 2];
+            a.path_ = prop.path_;
+            a.schema_ = prop.schema_;
+            a.node_ = prop.node_;
+            a.arrayType_ = arrayType;
+            return;
+        }
+        if (local != "Description") {
+            giveUp();
+            return;
+        }
+        addNode(p, structNode);
+        elements_.push_back(Element(structElement));
+        Element& s = elements_.back();
+        const Element& prop = elements_[elements_.size() - 2];
+        s.path_ = prop.path_;
+        s.schema_ = prop.schema_;
+        s.node_ = prop.node_;
+        addFields(s, attrs);
+    }
+
+    bool XmpStreamParser::initProperty(Element& e, const std::string& ns, const std::string& local, Element* parent)
+    {
+        if (parent && parent->kind_ == arrayElement) {
+            if (ns != kXMP_NS_RDF || local != "li") {
+                giveUp();
+                return false;
+            }
+            e.schema_ = parent->schema_;
+            e.path_ = itemPath(parent->path_, ++parent->count_);
+            return true;
+        }
+        std::string prefix;
+        if (   ns.empty() || ns == kXMP_NS_RDF || ns == kXMP_NS_XML || ns == oldDcNs
+            || !sdkPrefix(ns, prefix)) {
+            giveUp();
+            return false;
+        }
+        e.ns_ = ns;
+        e.name_ = prefix + local;
+        if (parent) {
+            // Struct field
+            for (std::size_t i = 0; i < parent->names_.size(); ++i) {
+                if (parent->names_[i] == e.name_) {
+                    giveUp();
+                    return false;
+                }
+            }
+            parent->names_.push_back(e.name_);
+            e.schema_ = parent->schema_;
+            e.path_ = parent->path_ + '/' + e.name_;
+            return true;
+        }
+        // Top-level property
+        e.top_ = true;
+        if (   (ns == ixNs && local == "changes")
+            || SXMPMeta::ResolveAlias(ns.c_str(), local.c_str(), 0, 0, 0)
+            || !schema(ns, e.schema_)
+            || !schemas_[e.schema_].names_.insert(e.name_).second) {
+            giveUp();
+            return false;
+        }
+        e.path_ = local;
+        return true;
+    }
+
+    void XmpStreamParser::addFields(Element& e, const char** attrs)
+    {
+        std::string& ns = attrNs_;
+        std::string& local = attrLocal_;
+        int about = 0;
+        for (const char** a = attrs; *a != 0; a += 2) {
+            splitName(a[0], ns, local);
+            if (e.kind_ == structElement) {
+                // rdf:Description, which may have an rdf:about or rdf:ID
+                if (   (   (ns.empty() && (local == "about" || local == "ID"))
+                        || (ns == kXMP_NS_RDF && (local == "about" || local == "ID" || local == "nodeID")))
+                    && ++about == 1) {
+                    continue;
+                }
+            }
+            if (ns.empty() || ns == kXMP_NS_RDF || ns == kXMP_NS_XML) {
+                giveUp();
+                return;
+            }
+            Element f(propertyElement);
+            if (!initProperty(f, ns, local, &e)) return;
+            addNode(f, simpleNode).value_ = a[1];
+        }
+    }
+
+    XmpNode& XmpStreamParser::addNode(Element& e, NodeKind kind)
+    {
+        std::vector<XmpNode>& nodes = schemas_[e.schema_].nodes_;
+        e.node_ = nodes.size();
+        e.hasNode_ = true;
+        nodes.push_back(XmpNode(kind, e.path_));
+        return nodes.back();
+    }
+
+    void XmpStreamParser::finishArray(const Element& e)
+    {
+        std::vector<XmpNode>& nodes = schemas_[e.schema_].nodes_;
+        XmpNode& array = nodes[e.node_];
+        if (e.langItems_ > 0) {
+            // An alt-text array needs a language for each item
+            if (e.langItems_ != e.count_ || e.simpleItems_ != e.count_) {
+                giveUp();
+                return;
+            }
+            array.kind_ = langAltNode;
+        }
+        else if (e.simpleItems_ == e.count_) {
+            array.kind_ = arrayValueNode;
+        }
+        else {
+            return;
+        }
+        for (std::size_t i = e.node_ + 1; i < nodes.size(); ++i) {
+            array.items_.push_back(std::string());
+            array.items_.back().swap(nodes[i].value_);
+            if (array.kind_ == langAltNode) array.langs_.push_back(nodes[i].lang_);
+        }
+        nodes.resize(e.node_ + 1, XmpNode(simpleNode, std::string()));
+    }
+
+    void XmpStreamParser::checkTopLevel(const Element& e)
+    {
+        const XmpNode& node = schemas_[e.schema_].nodes_[e.node_];
+        const bool isArray =    node.kind_ == arrayNode
+                             || node.kind_ == arrayValueNode
+                             || node.kind_ == langAltNode;
+        const std::string& name = e.name_;
+        bool normalized = false;
+        if (e.ns_ == kXMP_NS_DC) {
+            // The XMP Toolkit turns simple Dublin Core properties which
+            // should be arrays into arrays and repairs their form
+            if (node.kind_ == simpleNode) {
+                normalized =    name == "dc:contributor" || name == "dc:creator"
+                             || name == "dc:date"        || name == "dc:description"
+                             || name == "dc:language"    || name == "dc:publisher"
+                             || name == "dc:relation"    || name == "dc:rights"
+                             || name == "dc:subject"     || name == "dc:title"
+                             || name == "dc:type";
+            }
+            else if (isArray) {
+                normalized =    (name == "dc:subject" && node.arrayType_ != Exiv2::xmpBag)
+                             || (   node.kind_ != langAltNode
+                                 && (   name == "dc:description" || name == "dc:rights"
+                                     || name == "dc:title"));
+            }
+        }
+        else if (e.ns_ == kXMP_NS_XMP_Rights) {
+            normalized =    name == "xmpRights:UsageTerms"
+                         && isArray && node.kind_ != langAltNode;
+        }
+        else if (e.ns_ == kXMP_NS_EXIF) {
+            normalized =    name == "exif:GPSTimeStamp"
+                         || (   name == "exif:UserComment"
+                             && node.kind_ != structNode && node.kind_ != langAltNode);
+        }
+        else if (e.ns_ == kXMP_NS_DM) {
+            normalized = name == "xmpDM:copyright";
+        }
+        if (normalized) giveUp();
+    }
+
+    bool XmpStreamParser::sdkPrefix(const std::string& ns, std::string& prefix)
+    {
+        std::map<std::string, std::string>::const_iterator pos = newPrefixes_.find(ns);
+        if (pos == newPrefixes_.end()) {
+            pos = prefixes_.find(ns);
+            if (pos == prefixes_.end()) {
+                if (!SXMPMeta::GetNamespacePrefix(ns.c_str(), &prefix)) return false;
+                prefixes_[ns] = prefix;
+                usedNs_.insert(ns);
+                return true;
+            }
+        }
+        prefix = pos->second;
+        usedNs_.insert(ns);
+        return true;
+    }
+
+    void XmpStreamParser::registerNamespaces()
+    {
+        for (std::size_t i = 0; i < newNs_.size(); ++i) {
+            SXMPMeta::RegisterNamespace(newNs_[i].first.c_str(), newNs_[i].second.c_str());
+        }
+    }
+
+    bool XmpStreamParser::nsPrefix(const std::string& uri, std::string& prefix) const
+    {
+        std::map<std::string, std::string>::const_iterator pos = newPrefixes_.find(uri);
+        if (pos != newPrefixes_.end()) {
+            prefix = pos->second;
+            return true;
+        }
+        return SXMPMeta::GetNamespacePrefix(uri.c_str(), &prefix);
+    }
+
+    bool XmpStreamParser::nsUri(const std::string& prefix, std::string& uri) const
+    {
+        std::map<std::string, std::string>::const_iterator pos = newUris_.find(prefix);
+        if (pos != newUris_.end()) {
+            uri = pos->second;
+            return true;
+        }
+        return SXMPMeta::GetNamespaceURI(prefix.c_str(), &uri);
+    }
+
+    bool XmpStreamParser::schema(const std::string& ns, std::size_t& index)
+    {
+        if (lastSchema_ < schemas_.size() && schemas_[lastSchema_].ns_ == ns) {
+            index = lastSchema_;
+            return true;
+        }
+        for (index = 0; index < schemas_.size(); ++index) {
+            if (schemas_[index].ns_ == ns) {
+                lastSchema_ = index;
+                return true;
+            }
+        }
+        // Namespaces unknown to Exiv2 are registered by XmpParser::decode()
+        const std::string prefix = Exiv2::XmpProperties::prefix(ns);
+        if (prefix.empty()) return false;
+        schemas_.push_back(XmpSchema());
+        schemas_.back().ns_ = ns;
+        schemas_.back().prefix_ = prefix;
+        lastSchema_ = index;
+        return true;
+    }
+
+    void splitName(const char* name, std::string& ns, std::string& local)
+    {
+        const char* sep = std::strrchr(name, nsSeparator);
+        if (sep == 0) {
+            ns.clear();
+            local = name;
+        }
+        else {
+            ns.assign(name, sep - name);
+            local = sep + 1;
+        }
+    }
+
+    std::string itemPath(const std::string& path, int index)
+    {
+        char buf[16];
+        char* p = buf + sizeof(buf);
+        *--p = ']';
+        do {
+            *--p = static_cast<char>('0' + index % 10);
+            index /= 10;
+        } while (index > 0);
+        *--p = '[';
+        return path + std::string(p, buf + sizeof(buf) - p);
+    }
+
+    bool isWhitespace(const char* s, std::size_t len)
+    {
+        for (std::size_t i = 0; i < len; ++i) {
+            if (s[i] != ' ' && s[i] != '\t' && s[i] != '\n' && s[i] != '\r') return false;
+        }
+        return true;
+    }
+
+    bool isPlainUtf8(const std::string& xmpPacket)
+    {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(xmpPacket.data());
+        const std::size_t size = xmpPacket.size();
+        // UTF-16 and UTF-32
+        if (size >= 2 && (   p[0] == 0 || p[1] == 0
+                          || (p[0] == 0xfe && p[1] == 0xff)
+                          || (p[0] == 0xff && p[1] == 0xfe))) {
+            return false;
+        }
+        for (std::size_t i = 0; i < size; ++i) {
+            const unsigned char c = p[i];
+            if (c >= 0x20 && c < 0x7f && c != '&') continue;
+            if (c >= 0x80) {
+                // Same check as the XMP Toolkit: n high bits, n-1 continuation bytes
+                if ((c & 0xc0) != 0xc0) return false;
+                std::size_t n = 2;
+                for (unsigned char b = static_cast<unsigned char>(c << 2); b & 0x80; b <<= 1) ++n;
+                if (i + n > size) return false;
+                for (std::size_t j = 1; j < n; ++j) {
+                    if ((p[i + j] & 0xc0) != 0x80) return false;
+                }
+                i += n - 1;
+                continue;
+            }
+            if (c == '&') {
+                // Short hex escapes, like "&#x1;", the XMP Toolkit takes
+                // them all for control characters
+                if (size - i < 5 || std::strncmp(xmpPacket.data() + i, "&#x", 3) != 0) continue;
+                std::size_t j = i + 3;
+                unsigned int v = 0;
+                for (int k = 0; k < 2 && j < size && std::isxdigit(p[j]); ++k, ++j) {
+                    v = v * 16 + (p[j] <= '9' ? p[j] - '0' : (p[j] | 0x20) - 'a' + 10);
+                }
+                if (j >= size || p[j] != ';' || j - i + 1 < 5) continue;
+                if (v == '\t' || v == '\n' || v == '\r') continue;
+                return false;
+            }
+            if (c != '\t' && c != '\n' && c != '\r') return false;
+        }
+        return true;
+    }
+
+    void normalizeLang(std::string& lang)
+    {
+        // Primary subtag lower case, 2-letter secondary subtag upper case,
+        // all other subtags lower case
+        std::string::size_type start = 0;
+        for (int tag = 0; start <= lang.size(); ++tag) {
+            std::string::size_type end = lang.find('-', start);
+            if (end == std::string::npos) end = lang.size();
+            const bool upper = tag == 1 && end - start == 2;
+            for (std::string::size_type i = start; i < end; ++i) {
+                if (upper) {
+                    if (lang[i] >= 'a' && lang[i] <= 'z') lang[i] -= 0x20;
+                }
+                else {
+                    if (lang[i] >= 'A' && lang[i] <= 'Z') lang[i] += 0x20;
+                }
+            }
+            start = end + 1;
+        }
+    }
+
+}
+
+// *****************************************************************************
+// class member definitions
+namespace Exiv2 {
+    namespace Internal {
+
+    bool decodeXmpPacket(XmpData& xmpData,
+                         const std::string& xmpPacket,
+                         ParseBudget& budget)
+    {
+        XmpStreamParser parser(budget);
+        if (!parser.parse(xmpPacket)) return false;
+        parser.decode(xmpData);
+        return true;
+    }
+
+}}                                      // namespace Internal, Exiv2
+
+#endif // EXV_HAVE_XMP_TOOLKIT
@@ -0,0 +1,80 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2011 Andreas Huggel <ahuggel@gmx.net>
+ *
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*!
+  @file    xmpdecoder_int.hpp
+  @brief   Streaming decoder which reads XMP packets into XmpData straight
+           from the events of the XML parser
+  @version $Rev$
+  @author  Andreas Huggel (ahu)
+           <a href="mailto:ahuggel@gmx.net">ahuggel@gmx.net</a>
+  @date    19-Oct-26, ahu: created
+ */
+#ifndef XMPDECODER_INT_HPP_
+#define XMPDECODER_INT_HPP_
+
+// *****************************************************************************
+// included header files
+#include "types.hpp"
+
+// + standard includes
+#include <string>
+
+// *****************************************************************************
+// namespace extensions
+namespace Exiv2 {
+
+    class XmpData;
+
+    namespace Internal {
+
+    class ParseBudget;
+
+// *****************************************************************************
+// free functions
+
+#ifdef EXV_HAVE_XMP_TOOLKIT
+    /*!
+      @brief Decode the XMP packet \em xmpPacket into \em xmpData directly
+             from the events of the Expat parser, without building the XML
+             and XMP trees of the XMP Toolkit. The metadata is charged to
+             \em budget like XmpParser::decode() does.
+
+      The decoder knows the RDF forms which XMP serializers commonly write.
+      It gives up as soon as the packet uses anything else or anything the
+      XMP Toolkit would normalize: qualifiers other than the language of
+      alt-text items, aliases, rdf:resource and rdf:value, namespaces Exiv2
+      does not know, input which is not UTF-8, the Dublin Core and Exif
+      properties the Toolkit repairs, and malformed XML. For all packets it
+      accepts, the result is the same as that of the XMP Toolkit. The XMP
+      Toolkit must be initialized.
+
+      @return True if the packet was decoded; false if the caller needs to
+              decode it with the XMP Toolkit. \em xmpData is not modified in
+              that case.
+     */
+    bool decodeXmpPacket(XmpData& xmpData,
+                         const std::string& xmpPacket,
+                         ParseBudget& budget);
+#endif // EXV_HAVE_XMP_TOOLKIT
+
+}}                                      // namespace Internal, Exiv2
+
+#endif                                  // #ifndef XMPDECODER_INT_HPP_
@@ -38,6 +38,8 @@ EXIV2_RCSID("@(#) $Id$")
 #endif
 
 #include "xmpsidecar.hpp"
+#include "arena_int.hpp"
+#include "parsebudget_int.hpp"
 #include "image.hpp"
 #include "basicio.hpp"
 #include "error.hpp"
@@ -84,6 +86,8 @@ namespace Exiv2 {
 
     void XmpSidecar::readMetadata()
     {
+        Internal::ArenaScope arenaScope(useArena());
+        Internal::ParseBudgetScope budgetScope(parseLimits());
 #ifdef DEBUG
         std::cerr << "Reading XMP file " << io_->path() << "\n";
 #endif
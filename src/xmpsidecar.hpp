@@ -76,6 +76,7 @@ namespace Exiv2 {
         //! @name Manipulators
         //@{
         void readMetadata();
+        using Image::readMetadata;
         void writeMetadata();
         /*!
           @brief Not supported. XMP sidecar files do not contain a comment.
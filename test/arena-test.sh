@@ -0,0 +1,36 @@
+#! /bin/sh
+# Test driver for reading metadata with a memory arena
+results="./tmp/arena-test.out"
+good="./data/arena-test.out"
+diffargs="--strip-trailing-cr"
+tmpfile=tmp/ttt
+touch $tmpfile
+diff -q $diffargs $tmpfile $tmpfile 2>/dev/null
+if [ $? -ne 0 ] ; then
+    diffargs=""
+fi
+(
+if [ -z "$EXIV2_BINDIR" ] ; then
+    bin="$VALGRIND ../../src"
+    samples="$VALGRIND ../../samples"
+else
+    bin="$VALGRIND $EXIV2_BINDIR"
+    samples="$VALGRIND $EXIV2_BINDIR"
+fi
+for i in exiv2-nikon-d70.jpg exiv2-canon-powershot-s40.crw glider.exv; do
+    cp -f ./data/$i ./tmp
+done
+cd ./tmp
+for i in exiv2-nikon-d70.jpg exiv2-canon-powershot-s40.crw glider.exv; do
+    echo "------> $i <-------"
+    $samples/arena-test $i
+done
+) > $results
+
+diff -q $diffargs $results $good
+rc=$?
+if [ $rc -eq 0 ] ; then
+    echo "All testcases passed."
+else
+    diff $diffargs $results $good
+fi
@@ -0,0 +1,49 @@
+#! /bin/sh
+# Test driver for BigTIFF images, with the IFDs and image data below and
+# above 4 GB. The large image is created as a sparse file.
+results="./tmp/bigtiff-test.out"
+good="./data/bigtiff-test.out"
+diffargs="--strip-trailing-cr"
+tmpfile=tmp/ttt
+touch $tmpfile
+diff -q $diffargs $tmpfile $tmpfile 2>/dev/null
+if [ $? -ne 0 ] ; then
+    diffargs=""
+fi
+(
+if [ -z "$EXIV2_BINDIR" ] ; then
+    bin="$VALGRIND ../../src"
+    samples="$VALGRIND ../../samples"
+else
+    bin="$VALGRIND $EXIV2_BINDIR"
+    samples="$VALGRIND $EXIV2_BINDIR"
+fi
+cd ./tmp
+
+for offset in 0x100 0x140000000; do
+    file=bigtiff-$offset.tif
+    rm -f $file
+    echo "------> $file <-------"
+    $samples/bigtiff-test $file $offset 2>&1
+    $bin/exiv2 -v -M"set Exif.Photo.PixelYDimension 4" $file 2>&1
+    $bin/exiv2 -pt $file 2>&1
+    rm -f $file
+done
+
+# Classic TIFF with offsets between 2 and 4 GB
+file=classic-0x90000000.tif
+rm -f $file
+echo "------> $file <-------"
+$samples/bigtiff-test $file 0x90000000 classic 2>&1
+$bin/exiv2 -v -M"set Exif.Photo.PixelYDimension 4" $file 2>&1
+$bin/exiv2 -pt $file 2>&1
+rm -f $file
+) > $results
+
+diff -q $diffargs $results $good
+rc=$?
+if [ $rc -eq 0 ] ; then
+    echo "All testcases passed."
+else
+    diff $diffargs $results $good
+fi
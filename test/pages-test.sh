@@ -0,0 +1,37 @@
+#! /bin/sh
+# Test driver for reading the metadata of single pages of multi-page TIFF
+# images.
+results="./tmp/pages-test.out"
+good="./data/pages-test.out"
+diffargs="--strip-trailing-cr"
+tmpfile=tmp/ttt
+touch $tmpfile
+diff -q $diffargs $tmpfile $tmpfile 2>/dev/null
+if [ $? -ne 0 ] ; then
+    diffargs=""
+fi
+(
+if [ -z "$EXIV2_BINDIR" ] ; then
+    samples="$VALGRIND ../../samples"
+else
+    samples="$VALGRIND $EXIV2_BINDIR"
+fi
+cd ./tmp
+
+file=pages-test.tif
+echo "------> 1 page <-------"
+$samples/pages-test $file 1 0 1 2>&1
+echo "------> 3 pages <-------"
+$samples/pages-test $file 3 2 0 1 3 -1 2>&1
+echo "------> 500 pages <-------"
+$samples/pages-test $file 500 0 250 499 500 2>&1
+rm -f $file
+) > $results
+
+diff -q $diffargs $results $good
+rc=$?
+if [ $rc -eq 0 ] ; then
+    echo "All testcases passed."
+else
+    diff $diffargs $results $good
+fi
@@ -0,0 +1,50 @@
+#! /bin/sh
+# Test driver for the parse limits with a corpus of pathological files
+results="./tmp/parselimits-test.out"
+good="./data/parselimits-test.out"
+diffargs="--strip-trailing-cr"
+tmpfile=tmp/ttt
+touch $tmpfile
+diff -q $diffargs $tmpfile $tmpfile 2>/dev/null
+if [ $? -ne 0 ] ; then
+    diffargs=""
+fi
+(
+if [ -z "$EXIV2_BINDIR" ] ; then
+    bin="$VALGRIND ../../src"
+    samples="$VALGRIND ../../samples"
+else
+    bin="$VALGRIND $EXIV2_BINDIR"
+    samples="$VALGRIND $EXIV2_BINDIR"
+fi
+cd ./tmp
+
+# Default limits
+for file in parselimits-values.tif   \
+            parselimits-iptc.tif     \
+            parselimits-loop.crw     \
+            parselimits-nesting.xmp  \
+            parselimits-boxes.jp2; do
+    cp -f ../data/$file .
+    echo "------> $file <-------"
+    $samples/parselimits-test $file 2>&1
+done
+
+# Lower and higher limits
+echo "------> Value bytes <-------"
+$samples/parselimits-test -b 100000 parselimits-values.tif 2>&1
+echo "------> Components <-------"
+$samples/parselimits-test -c 1000 parselimits-iptc.tif 2>&1
+$samples/parselimits-test -c 1000 parselimits-boxes.jp2 2>&1
+echo "------> Nesting depth <-------"
+$samples/parselimits-test -d 8 parselimits-loop.crw 2>&1
+$samples/parselimits-test -d 300 parselimits-nesting.xmp 2>&1
+) > $results
+
+diff -q $diffargs $results $good
+rc=$?
+if [ $rc -eq 0 ] ; then
+    echo "All testcases passed."
+else
+    diff $diffargs $results $good
+fi
@@ -0,0 +1,64 @@
+#! /bin/sh
+# Test driver for Image::patchInPlace: overwrite Exif values in image files
+results="./tmp/patch-test.out"
+good="./data/patch-test.out"
+diffargs="--strip-trailing-cr"
+tmpfile=tmp/ttt
+touch $tmpfile
+diff -q $diffargs $tmpfile $tmpfile 2>/dev/null
+if [ $? -ne 0 ] ; then
+    diffargs=""
+fi
+(
+if [ -z "$EXIV2_BINDIR" ] ; then
+    bin="$VALGRIND ../../src"
+    samples="$VALGRIND ../../samples"
+else
+    bin="$VALGRIND $EXIV2_BINDIR"
+    samples="$VALGRIND $EXIV2_BINDIR"
+fi
+cd ./tmp
+
+file=exiv2-canon-eos-20d.jpg
+cp -f ../data/$file .
+echo "------> $file <-------"
+$samples/patch-test $file Exif.Photo.DateTimeOriginal "2011:01:02 03:04:05"
+$samples/patch-test $file Exif.Image.Orientation 6
+$samples/patch-test $file Exif.Photo.ExposureTime 1/100
+# Wrong count, tag not in the image, element of a binary array
+$samples/patch-test $file Exif.Image.Orientation "6 1"
+$samples/patch-test $file Exif.Photo.DateTimeOriginal "2011:01:02"
+$samples/patch-test $file Exif.Image.Artist "Nobody"
+$samples/patch-test $file Exif.CanonCs.Macro 2
+echo "Bytes changed: `cmp -l $file ../data/$file | wc -l`"
+
+file=exiv2-nikon-d70.jpg
+cp -f ../data/$file .
+echo "------> $file <-------"
+$samples/patch-test $file Exif.Nikon3.Quality "FINER  "
+$samples/patch-test $file Exif.Nikon3.ISOSpeed "0 400"
+echo "Bytes changed: `cmp -l $file ../data/$file | wc -l`"
+
+file=mini9.tif
+cp -f ../data/$file .
+echo "------> $file <-------"
+$samples/patch-test $file Exif.Image.Orientation 8
+$samples/patch-test $file Exif.Image.XResolution 300/1
+# Offsets are not patched
+$samples/patch-test $file Exif.Image.StripOffsets 10
+echo "Bytes changed: `cmp -l $file ../data/$file | wc -l`"
+
+file=exiv2-empty.jpg
+cp -f ../data/$file .
+echo "------> $file <-------"
+$samples/patch-test $file Exif.Image.Orientation 8
+echo "Bytes changed: `cmp -l $file ../data/$file | wc -l`"
+) > $results
+
+diff -q $diffargs $results $good
+rc=$?
+if [ $rc -eq 0 ] ; then
+    echo "All testcases passed."
+else
+    diff $diffargs $results $good
+fi
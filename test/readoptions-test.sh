@@ -0,0 +1,39 @@
+#! /bin/sh
+# Test driver for reading selected metadata
+results="./tmp/readoptions-test.out"
+good="./data/readoptions-test.out"
+diffargs="--strip-trailing-cr"
+tmpfile=tmp/ttt
+touch $tmpfile
+diff -q $diffargs $tmpfile $tmpfile 2>/dev/null
+if [ $? -ne 0 ] ; then
+    diffargs=""
+fi
+(
+if [ -z "$EXIV2_BINDIR" ] ; then
+    bin="$VALGRIND ../../src"
+    samples="$VALGRIND ../../samples"
+else
+    bin="$VALGRIND $EXIV2_BINDIR"
+    samples="$VALGRIND $EXIV2_BINDIR"
+fi
+for i in exiv2-photoshop.psd exiv2-nikon-d70.jpg exiv2-canon-eos-20d.jpg mini9.tif; do
+    cp -f ./data/$i ./tmp
+done
+cd ./tmp
+for i in exiv2-photoshop.psd exiv2-nikon-d70.jpg exiv2-canon-eos-20d.jpg mini9.tif; do
+    echo "------> $i <-------"
+    $samples/readoptions-test $i
+    # exiv2 -g reads only the metadata of the keys
+    $bin/exiv2 -g Exif.Image.Model -g Exif.Photo.ExposureTime -g Xmp.xmp.CreateDate -Pkv $i
+    $bin/exiv2 -Pkv $i | grep -a -E "^(Exif.Image.Model|Exif.Photo.ExposureTime|Xmp.xmp.CreateDate) "
+done
+) > $results
+
+diff -q $diffargs $results $good
+rc=$?
+if [ $rc -eq 0 ] ; then
+    echo "All testcases passed."
+else
+    diff $diffargs $results $good
+fi
@@ -0,0 +1,39 @@
+#! /bin/sh
+# Test driver for TIFF images with nested IFDs: SubIFDs, Exif and
+# Interoperability IFD. The image is written with both write modes; the last
+# file is extended to just below 4 GB as a sparse file, so that the new IFDs
+# cannot be appended and the image is written again.
+results="./tmp/subifd-test.out"
+good="./data/subifd-test.out"
+diffargs="--strip-trailing-cr"
+tmpfile=tmp/ttt
+touch $tmpfile
+diff -q $diffargs $tmpfile $tmpfile 2>/dev/null
+if [ $? -ne 0 ] ; then
+    diffargs=""
+fi
+(
+if [ -z "$EXIV2_BINDIR" ] ; then
+    samples="$VALGRIND ../../samples"
+else
+    samples="$VALGRIND $EXIV2_BINDIR"
+fi
+cd ./tmp
+
+file=subifd-test.tif
+for args in "rewrite" "append" "append 0xfffffff0"; do
+    rm -f $file
+    echo "------> $args <-------"
+    $samples/subifd-test $file $args 2>&1
+    rm -f $file
+done
+
+) > $results
+
+diff -q $diffargs $results $good
+rc=$?
+if [ $rc -eq 0 ] ; then
+    echo "All testcases passed."
+else
+    diff $diffargs $results $good
+fi
@@ -0,0 +1,55 @@
+#! /bin/sh
+# Test driver for decoding the sub-IFDs and makernotes of images on several
+# threads
+results="./tmp/threads-test.out"
+good="./data/threads-test.out"
+diffargs="--strip-trailing-cr"
+tmpfile=tmp/ttt
+touch $tmpfile
+diff -q $diffargs $tmpfile $tmpfile 2>/dev/null
+if [ $? -ne 0 ] ; then
+    diffargs=""
+fi
+(
+if [ -z "$EXIV2_BINDIR" ] ; then
+    bin="$VALGRIND ../../src"
+    samples="$VALGRIND ../../samples"
+else
+    bin="$VALGRIND $EXIV2_BINDIR"
+    samples="$VALGRIND $EXIV2_BINDIR"
+fi
+cd ./tmp
+
+# A TIFF image with two sub-IFDs, an Exif and a GPS IFD
+file=threads-subifds.tif
+cp -f ../data/mini9.tif $file
+$bin/exiv2 -M"set Exif.SubImage1.ImageWidth 9"   \
+           -M"set Exif.SubImage1.ImageLength 9"  \
+           -M"set Exif.SubImage2.ImageWidth 3"   \
+           -M"set Exif.SubImage2.Artist Sub2"    \
+           -M"set Exif.Photo.UserComment Exif"   \
+           -M"set Exif.GPSInfo.GPSVersionID 2 2 0 0" $file
+
+files="$file"
+# Images with makernotes
+for f in exiv2-canon-eos-20d.jpg    \
+         exiv2-nikon-d70.jpg        \
+         exiv2-olympus-c8080wz.jpg  \
+         exiv2-panasonic-dmc-fz5.jpg \
+         exiv2-sony-dsc-w7.jpg      \
+         exiv2-canon-powershot-s40.crw; do
+    cp -f ../data/$f .
+    files="$files $f"
+done
+
+$samples/threads-test 2 $files
+$samples/threads-test 8 $files
+) > $results 2>&1
+
+diff -q $diffargs $results $good
+rc=$?
+if [ $rc -eq 0 ] ; then
+    echo "All testcases passed."
+else
+    diff $diffargs $results $good
+fi
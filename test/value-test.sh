@@ -0,0 +1,34 @@
+#! /bin/sh
+# Test driver for the Value class tests
+results="./tmp/value-test.out"
+good="./data/value-test.out"
+diffargs="--strip-trailing-cr"
+tmpfile=tmp/ttt
+touch $tmpfile
+diff -q $diffargs $tmpfile $tmpfile 2>/dev/null
+if [ $? -ne 0 ] ; then
+    diffargs=""
+fi
+(
+if [ -z "$EXIV2_BINDIR" ] ; then
+    bin="$VALGRIND ../../src"
+    samples="$VALGRIND ../../samples"
+else
+    bin="$VALGRIND $EXIV2_BINDIR"
+    samples="$VALGRIND $EXIV2_BINDIR"
+fi
+cd ./tmp
+$samples/value-test
+for file in exiv2-nikon-d70.jpg exiv2-photoshop.psd imagemagick.png mini9.tif; do
+    cp ../data/$file ./
+    $samples/value-test $file
+done
+) > $results
+
+diff -q $diffargs $results $good
+rc=$?
+if [ $rc -eq 0 ] ; then
+    echo "All testcases passed."
+else
+    diff $diffargs $results $good
+fi
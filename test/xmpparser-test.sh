@@ -49,6 +49,17 @@ $samples/xmpparse ${testfile} > t1 2>&1
 $samples/xmpparse ${testfile}-new > t2 2>&1
 diff t1 t2
 
+# ----------------------------------------------------------------------
+# Streaming decoder and XMP toolkit
+testfile=xmpdecoder.xmp
+cp -f ../data/$testfile .
+$samples/xmpparse -s $testfile
+for testfile in $testfile BlueSquare.xmp StaffPhotographer-Example.xmp xmpsdk.xmp; do
+    $samples/xmpparse -s $testfile > t1 2>&1
+    $samples/xmpparse $testfile > t2 2>&1
+    diff t1 t2
+done
+
 # ----------------------------------------------------------------------
 # xmpsample
 $samples/xmpsample